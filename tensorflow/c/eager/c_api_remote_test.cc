@@ -117,6 +117,99 @@ void TestRemoteExecute(bool async) {
 TEST(CAPI, RemoteExecute) { TestRemoteExecute(false); }
 TEST(CAPI, RemoteExecuteAsync) { TestRemoteExecute(true); }
 
+// Runs a chain of small ops on a remote worker and reports how many ops per
+// second the client gets through, with remote enqueues batched up to
+// `max_batch_size` ops per request.
+void TestRemoteExecuteThroughput(int max_batch_size) {
+  setenv("TF_EAGER_REMOTE_ENQUEUE_BATCH_SIZE",
+         absl::StrCat(max_batch_size).c_str(), /*overwrite=*/1);
+  tensorflow::ServerDef server_def = GetServerDef(2);
+  string serialized = server_def.SerializeAsString();
+  server_def.set_task_index(1);
+
+  std::unique_ptr<tensorflow::GrpcServer> worker_server;
+  ASSERT_TRUE(tensorflow::GrpcServer::Create(
+                  server_def, tensorflow::Env::Default(), &worker_server)
+                  .ok());
+  ASSERT_TRUE(worker_server->Start().ok());
+
+  TF_Status* status = TF_NewStatus();
+  TFE_ContextOptions* opts = TFE_NewContextOptions();
+  TFE_ContextOptionsSetAsync(opts, static_cast<unsigned char>(true));
+  TFE_ContextOptionsSetDevicePlacementPolicy(opts,
+                                             TFE_DEVICE_PLACEMENT_EXPLICIT);
+  TFE_Context* ctx = TFE_NewContext(opts, status);
+  EXPECT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+  TFE_DeleteContextOptions(opts);
+
+  TFE_ContextSetServerDef(ctx, 0, serialized.data(), serialized.size(), status);
+  EXPECT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+
+  const char remote_device_name[] =
+      "/job:localhost/replica:0/task:1/device:CPU:0";
+  TFE_TensorHandle* zero_task0 = TestScalarTensorHandle(ctx, 0.0f);
+  TFE_TensorHandle* one_task0 = TestScalarTensorHandle(ctx, 1.0f);
+  TFE_TensorHandle* sum =
+      TFE_TensorHandleCopyToDevice(zero_task0, ctx, remote_device_name, status);
+  ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+  TFE_TensorHandle* one =
+      TFE_TensorHandleCopyToDevice(one_task0, ctx, remote_device_name, status);
+  ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+
+  // Each op consumes the output of the previous one, so a batch carries ops
+  // whose inputs are produced earlier in the same request.
+  const int kNumOps = 2000;
+  const tensorflow::uint64 start_micros =
+      tensorflow::Env::Default()->NowMicros();
+  for (int i = 0; i < kNumOps; ++i) {
+    TFE_Op* add = AddOp(ctx, sum, one);
+    TFE_OpSetDevice(add, remote_device_name, status);
+    ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+    TFE_TensorHandle* retvals[1];
+    int num_retvals = 1;
+    TFE_Execute(add, &retvals[0], &num_retvals, status);
+    ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+    TFE_DeleteOp(add);
+    TFE_DeleteTensorHandle(sum);
+    sum = retvals[0];
+  }
+  TF_Tensor* t = TFE_TensorHandleResolve(sum, status);
+  ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+  const tensorflow::uint64 elapsed_micros =
+      tensorflow::Env::Default()->NowMicros() - start_micros;
+  LOG(INFO) << "Remote ops with max_batch_size " << max_batch_size << ": "
+            << kNumOps * 1e6 / elapsed_micros << " ops/sec";
+
+  float result = 0;
+  memcpy(&result, TF_TensorData(t), sizeof(result));
+  EXPECT_EQ(kNumOps, result);
+  TF_DeleteTensor(t);
+
+  TFE_DeleteTensorHandle(zero_task0);
+  TFE_DeleteTensorHandle(one_task0);
+  TFE_DeleteTensorHandle(one);
+  TFE_DeleteTensorHandle(sum);
+
+  TFE_Executor* executor = TFE_ContextGetExecutorForThread(ctx);
+  TFE_ExecutorWaitForAllPendingNodes(executor, status);
+  ASSERT_EQ(TF_OK, TF_GetCode(status)) << TF_Message(status);
+  TFE_DeleteExecutor(executor);
+  TFE_DeleteContext(ctx);
+
+  TF_DeleteStatus(status);
+  unsetenv("TF_EAGER_REMOTE_ENQUEUE_BATCH_SIZE");
+
+  // TODO(b/136478427): Figure out how to correctly shut the server down.
+  worker_server.release();
+}
+
+TEST(CAPI, RemoteExecuteThroughput) {
+  TestRemoteExecuteThroughput(/*max_batch_size=*/1);
+}
+TEST(CAPI, RemoteExecuteThroughputBatched) {
+  TestRemoteExecuteThroughput(/*max_batch_size=*/64);
+}
+
 void TestRemoteExecuteSilentCopiesOp(bool async, bool remote,
                                      bool remote_func_outputs = false) {
   return TestRemoteExecuteSilentCopies(async, remote, /*func=*/false,
@@ -185,6 +185,10 @@ void AllocateAndParseFlags() {
   ops_flags = new XlaOpsCommonFlags;
   ops_flags->tf_xla_always_defer_compilation = false;
   ops_flags->tf_xla_async_compilation = false;
+  ops_flags->tf_xla_max_concurrent_async_compilations = 10;
+  ops_flags->tf_xla_persistent_cache_directory = "";
+  ops_flags->tf_xla_shape_buckets = "";
+  ops_flags->tf_xla_compilation_cache_memory_limit_mb = 0;
 
   jitter_flags = new IntroduceFloatingPointJitterPassFlags;
   jitter_flags->jitter_amount = 1e-5;
@@ -245,6 +249,24 @@ void AllocateAndParseFlags() {
             "When lazy compilation is enabled, asynchronous compilation starts "
             "the cluster compilation in the background, and the fallback path "
             "is executed until the compilation has finished."),
+       Flag("tf_xla_max_concurrent_async_compilations",
+            &ops_flags->tf_xla_max_concurrent_async_compilations,
+            "Maximum number of XLA clusters compiled concurrently in the "
+            "background when tf_xla_async_compilation is enabled."),
+       Flag("tf_xla_persistent_cache_directory",
+            &ops_flags->tf_xla_persistent_cache_directory,
+            "If non-empty, XLA:CPU executables are persisted in this "
+            "directory and reloaded instead of recompiled by later "
+            "processes."),
+       Flag("tf_xla_shape_buckets", &ops_flags->tf_xla_shape_buckets,
+            "Comma-separated, increasing list of dimension sizes. Input "
+            "dimensions of XLA:CPU clusters that change between executions "
+            "are padded up to the next size in the list instead of causing a "
+            "recompilation."),
+       Flag("tf_xla_compilation_cache_memory_limit_mb",
+            &ops_flags->tf_xla_compilation_cache_memory_limit_mb,
+            "If positive, least recently used XLA executables are evicted from "
+            "the compilation cache once the cache exceeds this size."),
 
        Flag("tf_introduce_floating_point_jitter_to_tensors",
             setter_for_jitter_tensor_names, "",
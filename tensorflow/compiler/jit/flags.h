@@ -106,6 +106,22 @@ struct XlaOpsCommonFlags {
   // If true, _XlaCompile compiles the cluster asynchronously with respect to
   // the main execution. The fallback path is taken while compilation happens.
   bool tf_xla_async_compilation;
+  // Maximum number of clusters compiled concurrently in the background when
+  // tf_xla_async_compilation is enabled. Clusters that would exceed it keep
+  // running through the fallback path and are compiled later.
+  int32 tf_xla_max_concurrent_async_compilations;
+  // If non-empty, executables compiled for XLA:CPU are also written to this
+  // directory and reused by later processes with identical clusters, XLA
+  // flags and host CPU instead of being compiled again.
+  string tf_xla_persistent_cache_directory;
+  // Comma-separated, increasing list of dimension sizes. If non-empty, input
+  // dimensions of an XLA:CPU cluster that change between executions are
+  // compiled as dynamic dimensions bounded by the next size in the list, so
+  // that one executable serves every size up to that bound.
+  string tf_xla_shape_buckets;
+  // If positive, the compilation cache evicts least recently used entries once
+  // its executables take up more than this many megabytes.
+  int64_t tf_xla_compilation_cache_memory_limit_mb;
 };
 
 // Flags for the build_xla_ops pass.
@@ -86,12 +86,14 @@ class XlaExecutableClosure {
   explicit XlaExecutableClosure(
       xla::LocalClient* client, xla::LocalExecutable* executable,
       const XlaCompiler::CompilationResult* compilation_result,
-      ResourceVarsSnapshot resource_var_snapshots, int num_constant_args)
+      ResourceVarsSnapshot resource_var_snapshots, int num_constant_args,
+      XlaCompilationCache::EntryRef entry_ref)
       : client_(client),
         executable_(executable),
         compilation_result_(compilation_result),
         resource_var_snapshots_(std::move(resource_var_snapshots)),
-        num_constant_args_(num_constant_args) {}
+        num_constant_args_(num_constant_args),
+        entry_ref_(std::move(entry_ref)) {}
 
   XlaExecutableClosure(XlaExecutableClosure&&) = default;
   XlaExecutableClosure& operator=(XlaExecutableClosure&&) = default;
@@ -112,6 +114,9 @@ class XlaExecutableClosure {
   const XlaCompiler::CompilationResult* compilation_result_;
   ResourceVarsSnapshot resource_var_snapshots_;
   int num_constant_args_;
+  // Keeps the compilation cache from evicting `executable_` and
+  // `compilation_result_` until the closure has been consumed by XlaRun.
+  XlaCompilationCache::EntryRef entry_ref_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(XlaExecutableClosure);
 };
@@ -179,7 +184,8 @@ static Status CompileToLocalExecutable(
     XlaCompilationCache::CompileMode compile_mode,
     bool may_alias_resource_update, xla::LocalClient** client,
     const XlaCompiler::CompilationResult** compilation_result,
-    xla::LocalExecutable** executable) {
+    xla::LocalExecutable** executable,
+    XlaCompilationCache::EntryRef* entry_ref) {
   // We store information about the JIT-compiled XLA computation
   // in the ResourceMgr.
   ResourceMgr* rm = ctx->resource_manager();
@@ -220,7 +226,7 @@ static Status CompileToLocalExecutable(
           static_cast<Device*>(ctx->device()));
   TF_RETURN_IF_ERROR(args.status());
   return cache->Compile(options, function, *args, compile_options, compile_mode,
-                        compilation_result, executable);
+                        compilation_result, executable, entry_ref);
 }
 
 void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
@@ -233,6 +239,7 @@ void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
   xla::LocalClient* client;
   const XlaCompiler::CompilationResult* compilation_result;
   xla::LocalExecutable* executable;
+  XlaCompilationCache::EntryRef entry_ref;
 
   std::vector<VariableInfo> variable_infos;
   {
@@ -244,7 +251,7 @@ void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
         ctx, function_, /*has_ref_vars=*/has_ref_vars_, platform_info_, inputs,
         variable_infos, constants_, XlaCompilationCache::CompileMode::kStrict,
         /*may_alias_resource_update=*/true, &client, &compilation_result,
-        &executable);
+        &executable, &entry_ref);
     OP_REQUIRES_OK(ctx, s);
   }
 
@@ -396,6 +403,7 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
   xla::LocalClient* client;
   const XlaCompiler::CompilationResult* kernel;
   xla::LocalExecutable* executable;
+  XlaCompilationCache::EntryRef entry_ref;
   ResourceVarsSnapshot variables;
 
   std::vector<const Tensor*> inputs = InputsFromContext(ctx);
@@ -428,7 +436,7 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
     Status status = CompileToLocalExecutable(
         ctx, function_, has_ref_vars_, platform_info_, inputs, variable_infos,
         constants_, compile_mode, /*may_alias_resource_update=*/false, &client,
-        &kernel, &executable);
+        &kernel, &executable, &entry_ref);
     OP_REQUIRES_OK(ctx, SnapshotResourceVariables(ctx, resources_,
                                                   variable_infos, &variables));
     if (compile_mode != XlaCompilationCache::CompileMode::kLazy ||
@@ -472,7 +480,8 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
   // variables.
   XlaExecutableClosureStore::KeyT key =
       XlaExecutableClosureStore::Global()->Produce(XlaExecutableClosure(
-          client, executable, kernel, std::move(variables), constants_.size()));
+          client, executable, kernel, std::move(variables), constants_.size(),
+          std::move(entry_ref)));
 
   Tensor compilation_key(cpu_allocator, DT_STRING, TensorShape({}));
   compilation_key.flat<tstring>()(0) = key;
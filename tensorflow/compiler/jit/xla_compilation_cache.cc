@@ -15,12 +15,16 @@ limitations under the License.
 
 #include "tensorflow/compiler/jit/xla_compilation_cache.h"
 
+#include <algorithm>
 #include <numeric>
 
 #include "tensorflow/compiler/mlir/mlir_bridge_rollout_policy.h"
+#include "absl/algorithm/container.h"
 #include "absl/base/call_once.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
 #include "absl/types/variant.h"
 #include "tensorflow/compiler/jit/flags.h"
 #include "tensorflow/compiler/jit/xla_activity.pb.h"
@@ -32,6 +36,8 @@ limitations under the License.
 #include "tensorflow/compiler/tf2xla/xla_compiler.h"
 #include "tensorflow/compiler/tf2xla/xla_context.h"
 #include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/function.h"
@@ -44,14 +50,19 @@ limitations under the License.
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/protobuf/graph_debug_info.pb.h"
 #include "tensorflow/core/public/version.h"
 #include "tensorflow/core/tpu/tpu_defs.h"
 #include "tensorflow/core/util/determinism.h"
 #include "tensorflow/core/util/dump_graph.h"
+#include "tensorflow/core/util/version_info.h"
 
 namespace tensorflow {
 namespace {
@@ -114,17 +125,94 @@ struct SignatureHashCombiner {
   }
 };
 
+// Returns a description of the host CPU. Executables persisted on a host with a
+// different description are not reused, since they may use instructions the
+// current host lacks or be tuned for a different microarchitecture.
+std::string HostCpuDescription() {
+  std::string features;
+  for (int feature = port::CPUFeature::MMX;
+       feature <= port::CPUFeature::AVX512_4FMAPS; ++feature) {
+    features.push_back(
+        port::TestCPUFeature(static_cast<port::CPUFeature>(feature)) ? '1'
+                                                                     : '0');
+  }
+  return absl::StrCat(port::CPUVendorIDString(), ":", port::CPUFamily(), ":",
+                      port::CPUModelNum(), ":", features);
+}
+
+// Fingerprints the HLO produced by the TF2XLA bridge. Instruction ids and names
+// are allocated from process-wide counters, so the proto itself is not stable
+// across processes; the canonical text form is.
+uint64 HloFingerprint(const xla::HloModuleProto& proto) {
+  auto config =
+      xla::HloModule::CreateModuleConfigFromProto(proto, xla::DebugOptions());
+  if (config.ok()) {
+    auto module = xla::HloModule::CreateFromProto(proto, config.ValueOrDie());
+    if (module.ok()) {
+      return Fingerprint64(module.ValueOrDie()->ToString(
+          xla::HloPrintOptions::Canonical()
+              .set_print_large_constants(true)
+              .set_print_backend_config(true)
+              .set_print_control_dependencies(true)));
+    }
+  }
+  return DeterministicProtoHash64(proto);
+}
+
+// Parses the tf_xla_shape_buckets flag. Returns an empty ladder, which disables
+// bucketing, if the flag is unset or malformed.
+std::vector<int64_t> ParseShapeBuckets(absl::string_view flag) {
+  std::vector<int64_t> buckets;
+  if (flag.empty()) {
+    return buckets;
+  }
+  for (absl::string_view bucket : absl::StrSplit(flag, ',')) {
+    int64_t size;
+    if (!absl::SimpleAtoi(bucket, &size) || size <= 0 ||
+        (!buckets.empty() && size <= buckets.back())) {
+      LOG(ERROR) << "Ignoring tf_xla_shape_buckets=" << flag
+                 << ": expected an increasing list of positive sizes.";
+      return {};
+    }
+    buckets.push_back(size);
+  }
+  return buckets;
+}
+
+// Estimates the memory held by a compiled cache entry.
+int64_t EstimateEntrySize(const XlaCompiler::CompilationResult& result,
+                          const xla::LocalExecutable* executable) {
+  int64_t size = 0;
+  if (result.computation) {
+    size += result.computation->proto().ByteSizeLong();
+  }
+  if (executable) {
+    size += executable->executable()->SizeOfGeneratedCodeInBytes();
+  }
+  return size;
+}
+
 }  // namespace
 
 constexpr int64_t XlaCompilationCache::kDefaultCompilationThreshold;
-constexpr int64_t
-    XlaCompilationCache::AsyncCompilationState::kNumCompilerThreads;
-constexpr int64_t
-    XlaCompilationCache::AsyncCompilationState::kMaxNumOngoingCompilations;
+
+XlaCompilationCache::AsyncCompilationState::AsyncCompilationState()
+    : max_num_ongoing_compilations(std::max<int64_t>(
+          1, GetXlaOpsCommonFlags().tf_xla_max_concurrent_async_compilations)) {
+  compiler_threads = absl::make_unique<tensorflow::thread::ThreadPool>(
+      tensorflow::Env::Default(), "async_compiler_threads",
+      max_num_ongoing_compilations);
+}
 
 XlaCompilationCache::XlaCompilationCache(xla::LocalClient* client,
                                          DeviceType device_type)
-    : client_(client), device_type_(std::move(device_type)) {}
+    : client_(client),
+      device_type_(std::move(device_type)),
+      memory_limit_bytes_(
+          GetXlaOpsCommonFlags().tf_xla_compilation_cache_memory_limit_mb
+          << 20),
+      shape_buckets_(
+          ParseShapeBuckets(GetXlaOpsCommonFlags().tf_xla_shape_buckets)) {}
 
 XlaCompilationCache::~XlaCompilationCache() {
   // Ensure any use of our programs have completed by waiting for all stream
@@ -142,6 +230,11 @@ XlaCompilationCache::~XlaCompilationCache() {
   // is destructed, which is dependent on the order of the members in the
   // XlaCompilationCache class, which is error prone if the order changes.
   async_compilation_state_.compiler_threads.reset();
+  {
+    mutex_lock lock(compile_cache_mu_);
+    metrics::UpdateXlaCompilationCacheSize(-static_cast<int64_t>(cache_.size()),
+                                           -size_bytes_);
+  }
   // TODO(b/110813685): Think about the program ownership model. Programs are
   // currently owned by the compilation cache which means we must wait for
   // program completion in the destructor. There are multiple compilation caches
@@ -154,6 +247,23 @@ string XlaCompilationCache::DebugString() const {
   return "XLA JIT compilation cache";
 }
 
+XlaCompilationCache::Stats XlaCompilationCache::GetStats() {
+  Stats stats;
+  {
+    mutex_lock lock(compile_cache_mu_);
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.num_entries = cache_.size();
+    stats.size_bytes = size_bytes_;
+  }
+  mutex_lock lock(cluster_compile_stats_mu_);
+  for (const auto& cluster : cluster_compile_stats_) {
+    stats.cluster_entries[cluster.first] = cluster.second.num_cache_entries;
+  }
+  return stats;
+}
+
 // Compute a string signature which encodes the shapes of the
 // arguments in the supplied list.
 string XlaCompilationCache::Signature::HumanString() const {
@@ -161,6 +271,10 @@ string XlaCompilationCache::Signature::HumanString() const {
   for (const auto& a : args) {
     absl::visit(SignatureHumanStringAppender(&result), a);
   }
+  for (const auto& dimension : dynamic_dimensions) {
+    absl::StrAppend(&result, "; dynamic ", dimension.first, ":",
+                    dimension.second);
+  }
   return result;
 }
 
@@ -172,7 +286,7 @@ bool XlaCompilationCache::Signature::operator==(const Signature& other) const {
       return false;
     }
   }
-  return true;
+  return dynamic_dimensions == other.dynamic_dimensions;
 }
 
 uint64 XlaCompilationCache::Signature::Hash::operator()(
@@ -181,6 +295,10 @@ uint64 XlaCompilationCache::Signature::Hash::operator()(
   for (const auto& arg : signature.args) {
     h = absl::visit(SignatureHashCombiner(h), arg);
   }
+  for (const auto& dimension : signature.dynamic_dimensions) {
+    h = Hash64Combine(h, std::hash<int>()(dimension.first));
+    h = Hash64Combine(h, std::hash<int>()(dimension.second));
+  }
   return h;
 }
 
@@ -190,7 +308,8 @@ StatusOr<XlaCompilationCache::Signature> XlaCompilationCache::BuildSignature(
   Signature signature;
   signature.name = Canonicalize(function.name(), AttrSlice(&function.attr()));
 
-  for (const XlaCompiler::Argument& arg : args) {
+  for (int i = 0, end = args.size(); i < end; ++i) {
+    const XlaCompiler::Argument& arg = args[i];
     switch (arg.kind) {
       case XlaCompiler::Argument::kConstant:
       case XlaCompiler::Argument::kConstantResource:
@@ -200,6 +319,14 @@ StatusOr<XlaCompilationCache::Signature> XlaCompilationCache::BuildSignature(
       case XlaCompiler::Argument::kResource:
         signature.args.push_back(
             TensorTypeAndShape(arg.type, arg.DimensionSizesAsInlinedVector()));
+        if (absl::holds_alternative<xla::Shape>(arg.shape)) {
+          const xla::Shape& shape = absl::get<xla::Shape>(arg.shape);
+          for (int dim = 0; shape.IsArray() && dim < shape.rank(); ++dim) {
+            if (shape.is_dynamic_dimension(dim)) {
+              signature.dynamic_dimensions.emplace_back(i, dim);
+            }
+          }
+        }
         break;
       default:
         return errors::InvalidArgument(
@@ -236,11 +363,142 @@ Status XlaCompilationCache::BuildExecutable(
   if (tensorflow::OpDeterminismRequired()) {
     build_options.mutable_debug_options()->set_xla_gpu_deterministic_ops(true);
   }
+
+  const bool persistent_cache_enabled = PersistentCacheEnabled();
+  XlaSerializedCacheKey persistent_cache_key;
+  if (persistent_cache_enabled) {
+    // The object code has to be retained for the executable to be exported.
+    build_options.mutable_debug_options()->set_xla_cpu_retain_object_files(
+        true);
+    persistent_cache_key = BuildSerializedCacheKey(result, build_options);
+    std::unique_ptr<xla::LocalExecutable> persisted =
+        LoadPersistedExecutable(persistent_cache_key, build_options);
+    if (persisted) {
+      *executable = std::move(persisted);
+      return Status::OK();
+    }
+  }
+
   TF_ASSIGN_OR_RETURN(
       auto executables,
       client_->Compile(*result.computation, argument_layouts, build_options));
   TF_RET_CHECK(executables.size() == 1);
   *executable = std::move(executables[0]);
+
+  if (persistent_cache_enabled) {
+    // Failing to persist only costs a recompilation in a later process.
+    Status status = PersistExecutable(persistent_cache_key, **executable);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to persist XLA executable for "
+                   << persistent_cache_key.signature() << ": " << status;
+    }
+  }
+  return Status::OK();
+}
+
+bool XlaCompilationCache::PersistentCacheEnabled() const {
+  return !GetXlaOpsCommonFlags().tf_xla_persistent_cache_directory.empty() &&
+         device_type_ == DeviceType(DEVICE_CPU_XLA_JIT);
+}
+
+XlaSerializedCacheKey XlaCompilationCache::BuildSerializedCacheKey(
+    const XlaCompiler::CompilationResult& result,
+    const xla::ExecutableBuildOptions& build_options) const {
+  const xla::HloModuleProto& hlo_module = result.computation->proto();
+  std::string signature = hlo_module.name();
+  for (const xla::Shape& shape : result.xla_input_shapes) {
+    absl::StrAppend(&signature, ",",
+                    xla::ShapeUtil::HumanStringWithLayout(shape));
+  }
+  absl::StrAppend(
+      &signature, "->",
+      xla::ShapeUtil::HumanStringWithLayout(result.xla_output_shape));
+
+  XlaSerializedCacheKey key;
+  key.set_signature(signature);
+  key.set_hlo_fingerprint(HloFingerprint(hlo_module));
+  key.set_debug_options_fingerprint(
+      DeterministicProtoHash64(build_options.debug_options()));
+  key.set_host_cpu(HostCpuDescription());
+  key.set_device_type(device_type_.type_string());
+  key.set_tf_version(absl::StrCat(TF_VERSION_STRING, ":", TF_GIT_VERSION));
+  key.set_compiler_version(TF_COMPILER_VERSION);
+  return key;
+}
+
+namespace {
+
+std::string PersistentCacheFilePath(const XlaSerializedCacheKey& key) {
+  return io::JoinPath(
+      GetXlaOpsCommonFlags().tf_xla_persistent_cache_directory,
+      absl::StrCat(absl::Hex(DeterministicProtoHash64(key), absl::kZeroPad16),
+                   ".xla_cache"));
+}
+
+}  // namespace
+
+std::unique_ptr<xla::LocalExecutable>
+XlaCompilationCache::LoadPersistedExecutable(
+    const XlaSerializedCacheKey& key,
+    const xla::ExecutableBuildOptions& build_options) {
+  Env* env = Env::Default();
+  const std::string path = PersistentCacheFilePath(key);
+  if (!env->FileExists(path).ok()) {
+    VLOG(2) << "No persisted XLA executable for " << key.signature();
+    return nullptr;
+  }
+
+  XlaSerializedCacheEntry entry;
+  Status status = ReadBinaryProto(env, path, &entry);
+  if (!status.ok()) {
+    LOG(WARNING) << "Ignoring unreadable persisted XLA executable " << path
+                 << ": " << status;
+    return nullptr;
+  }
+  // The file name is only a hash of the key, so check the whole key.
+  std::string expected_key, actual_key;
+  if (!SerializeToStringDeterministic(key, &expected_key) ||
+      !SerializeToStringDeterministic(entry.key(), &actual_key) ||
+      expected_key != actual_key) {
+    LOG(WARNING) << "Ignoring persisted XLA executable " << path
+                 << " whose key does not match " << key.signature();
+    return nullptr;
+  }
+
+  StatusOr<std::unique_ptr<xla::LocalExecutable>> executable =
+      client_->Load(entry.executable(), build_options);
+  if (!executable.ok()) {
+    LOG(WARNING) << "Ignoring persisted XLA executable " << path
+                 << " that failed to load: " << executable.status();
+    return nullptr;
+  }
+  VLOG(1) << "Loaded persisted XLA executable for " << key.signature()
+          << " from " << path;
+  return std::move(executable).ValueOrDie();
+}
+
+Status XlaCompilationCache::PersistExecutable(
+    const XlaSerializedCacheKey& key, const xla::LocalExecutable& executable) {
+  XlaSerializedCacheEntry entry;
+  *entry.mutable_key() = key;
+  TF_ASSIGN_OR_RETURN(*entry.mutable_executable(),
+                      client_->SerializeExecutable(executable));
+
+  Env* env = Env::Default();
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(
+      GetXlaOpsCommonFlags().tf_xla_persistent_cache_directory));
+  // Write to a unique temporary file and rename it into place so that other
+  // processes sharing the directory never observe a partially written entry.
+  const std::string path = PersistentCacheFilePath(key);
+  std::string temp_path = path;
+  if (!env->CreateUniqueFileName(&temp_path, ".tmp")) {
+    return errors::Internal("Could not create a temporary file name for ",
+                            path);
+  }
+  TF_RETURN_IF_ERROR(WriteBinaryProto(env, temp_path, entry));
+  TF_RETURN_IF_ERROR(env->RenameFile(temp_path, path));
+  VLOG(1) << "Persisted XLA executable for " << key.signature() << " to "
+          << path;
   return Status::OK();
 }
 
@@ -250,10 +508,75 @@ Status XlaCompilationCache::Compile(
     const XlaCompiler::CompileOptions& compile_options,
     CompileMode compile_mode,
     const XlaCompiler::CompilationResult** out_compilation_result,
-    xla::LocalExecutable** out_executable) {
+    xla::LocalExecutable** out_executable, EntryRef* out_entry_ref) {
   return CompileImpl(compile_options, options, function, args, /*ctx=*/nullptr,
                      CompileScope::kFunction, compile_mode,
-                     out_compilation_result, out_executable);
+                     out_compilation_result, out_executable, out_entry_ref);
+}
+
+bool XlaCompilationCache::ShapeBucketingEnabled() const {
+  return !shape_buckets_.empty() &&
+         device_type_ == DeviceType(DEVICE_CPU_XLA_JIT);
+}
+
+std::vector<XlaCompiler::Argument> XlaCompilationCache::BucketArguments(
+    const NameAttrList& function,
+    const std::vector<XlaCompiler::Argument>& args) {
+  std::vector<XlaCompiler::Argument> bucketed_args = args;
+  mutex_lock lock(cluster_compile_stats_mu_);
+  ClusterCompileStats& stats = cluster_compile_stats_[function.name()];
+  if (stats.initial_dimensions.size() != args.size()) {
+    // First execution: only record the shapes, which are compiled as is.
+    stats.initial_dimensions.assign(args.size(), {});
+    stats.dimension_changed.assign(args.size(), {});
+    for (int i = 0, end = args.size(); i < end; ++i) {
+      if (args[i].kind == XlaCompiler::Argument::kParameter &&
+          absl::holds_alternative<TensorShape>(args[i].shape)) {
+        stats.initial_dimensions[i] = args[i].DimensionSizesAsInlinedVector();
+        stats.dimension_changed[i].assign(stats.initial_dimensions[i].size(),
+                                          false);
+      }
+    }
+    return bucketed_args;
+  }
+
+  for (int i = 0, end = args.size(); i < end; ++i) {
+    XlaCompiler::Argument& arg = bucketed_args[i];
+    if (arg.kind != XlaCompiler::Argument::kParameter ||
+        !absl::holds_alternative<TensorShape>(arg.shape)) {
+      continue;
+    }
+    const TensorShape& tensor_shape = absl::get<TensorShape>(arg.shape);
+    const absl::InlinedVector<int64_t, 4>& initial =
+        stats.initial_dimensions[i];
+    absl::InlinedVector<bool, 4>& changed = stats.dimension_changed[i];
+    if (tensor_shape.dims() != initial.size()) {
+      continue;
+    }
+    xla::Shape shape;
+    bool bucketed = false;
+    for (int dim = 0; dim < tensor_shape.dims(); ++dim) {
+      const int64_t size = tensor_shape.dim_size(dim);
+      changed[dim] = changed[dim] || size != initial[dim];
+      auto bucket = absl::c_lower_bound(shape_buckets_, size);
+      if (!changed[dim] || bucket == shape_buckets_.end()) {
+        // Sizes beyond the largest bucket are compiled exactly.
+        continue;
+      }
+      if (!bucketed) {
+        if (!TensorShapeToXLAShape(arg.type, tensor_shape, &shape).ok()) {
+          break;
+        }
+        bucketed = true;
+      }
+      shape.set_dimensions(dim, *bucket);
+      shape.set_dynamic_dimension(dim, true);
+    }
+    if (bucketed) {
+      arg.shape = shape;
+    }
+  }
+  return bucketed_args;
 }
 
 static bool ShouldBeMegamorphic(int64_t compile_count,
@@ -385,7 +708,8 @@ Status XlaCompilationCache::CompileSingleOp(
   name.mutable_attr()->erase("_class");
   return CompileImpl(compile_options, options, name, args, ctx,
                      CompileScope::kOp, CompileMode::kStrict,
-                     out_compilation_result, out_executable);
+                     out_compilation_result, out_executable,
+                     /*out_entry_ref=*/nullptr);
 }
 
 namespace {
@@ -461,25 +785,22 @@ Status XlaCompilationCache::CompileStrict(
 }
 
 Status XlaCompilationCache::CompileAsynchronous(
-    Entry* entry, const XlaCompiler::CompileOptions& compile_options,
+    std::shared_ptr<Entry> entry,
+    const XlaCompiler::CompileOptions& compile_options,
     const XlaCompiler::Options& options,
     const std::vector<XlaCompiler::Argument>& args,
     const NameAttrList& function, OpKernelContext* ctx, CompileScope scope) {
-  // Explicitly capture all required data by value for async compilation.
+  // Explicitly capture all required data by value for async compilation. The
+  // caller has already reserved a compilation slot through
+  // TryReserveAsyncCompilation.
   entry->compile_state = CompileState::kCompiling;
-  {
-    mutex_lock lock(async_compilation_state_.async_compilation_state_mu);
-    async_compilation_state_.num_ongoing_compilations++;
-  }
-  // Don't move the above code into the thread function as it synchronously
-  // updates the async compilation state!
 
   // When the ThreadPool for the compilation cache is destroyed, it waits for
-  // compilations to have finished. This means that both 'entry' and 'this' will
-  // be alive for the duration of the compilation.
+  // compilations to have finished. This means that 'this' will be alive for the
+  // duration of the compilation, and the lambda shares ownership of 'entry'.
   // !!Pay attention when additional variables must be captured by this lambda!!
-  // All values are captured by value. Make sure that all pointer values (like
-  // entry) do not get freed until the lambda has finished,\.
+  // All values are captured by value. Make sure that all pointer values do not
+  // get freed until the lambda has finished.
   const std::string& function_name = function.name();
   async_compilation_state_.compiler_threads->Schedule([=] {
     Entry local_entry;
@@ -493,24 +814,103 @@ Status XlaCompilationCache::CompileAsynchronous(
     VLOG(2) << "Finished asynchronous compililation of cluster "
             << function_name << '.';
     {
-      mutex_lock lock(async_compilation_state_.async_compilation_state_mu);
-      async_compilation_state_.num_ongoing_compilations--;
-    }
-    {  // Populate original entry with compilation result.
+      // Populate original entry with compilation result. Requests observe
+      // either kCompiling, and keep taking the fallback path, or kCompiled
+      // together with the finished executable, since both are published under
+      // the entry lock.
       mutex_lock entry_lock(entry->mu);
       if (!s.ok()) {
         entry->compilation_status = s;
       } else {
         entry->compilation_status = local_entry.compilation_status;
       }
-      entry->compilation_result = local_entry.compilation_result;
-      entry->compile_state = local_entry.compile_state;
+      entry->compilation_result = std::move(local_entry.compilation_result);
       entry->executable = std::move(local_entry.executable);
+      entry->compile_state = local_entry.compile_state;
+      AccountCompiledEntry(entry.get());
     }
+    ReleaseAsyncCompilation();
   });
   return Status::OK();
 }
 
+void XlaCompilationCache::AccountCompiledEntry(Entry* entry) {
+  const int64_t size_bytes =
+      EstimateEntrySize(entry->compilation_result, entry->executable.get());
+  std::vector<string> evicted_clusters;
+  {
+    mutex_lock lock(compile_cache_mu_);
+    entry->size_bytes = size_bytes;
+    size_bytes_ += size_bytes;
+    int64_t size_bytes_delta = size_bytes;
+    int64_t num_entries_delta = 0;
+    while (memory_limit_bytes_ > 0 && size_bytes_ > memory_limit_bytes_) {
+      // Evicting is rare enough that a linear scan for the least recently used
+      // entry is cheaper than maintaining an ordered index on every lookup.
+      // Entries that are being compiled or looked up are skipped, since their
+      // lock is held.
+      auto victim = cache_.end();
+      for (auto it = cache_.begin(); it != cache_.end(); ++it) {
+        Entry* candidate = it->second.get();
+        if (candidate == entry || !candidate->evictable ||
+            candidate->size_bytes == 0 ||
+            (victim != cache_.end() &&
+             candidate->last_use >= victim->second->last_use)) {
+          continue;
+        }
+        if (!candidate->mu.try_lock()) {
+          continue;
+        }
+        const bool compiled =
+            candidate->compile_state == CompileState::kCompiled;
+        candidate->mu.unlock();
+        if (compiled) {
+          victim = it;
+        }
+      }
+      if (victim == cache_.end()) {
+        break;
+      }
+      VLOG(1) << "Evicting XLA executable of cluster "
+              << victim->second->cluster_name << " ("
+              << victim->second->size_bytes << " bytes)";
+      size_bytes_ -= victim->second->size_bytes;
+      size_bytes_delta -= victim->second->size_bytes;
+      --num_entries_delta;
+      ++evictions_;
+      evicted_clusters.push_back(victim->second->cluster_name);
+      cache_.erase(victim);
+      metrics::RecordXlaCompilationCacheEviction();
+    }
+    metrics::UpdateXlaCompilationCacheSize(num_entries_delta,
+                                           size_bytes_delta);
+  }
+  if (!evicted_clusters.empty()) {
+    mutex_lock lock(cluster_compile_stats_mu_);
+    for (const string& cluster : evicted_clusters) {
+      cluster_compile_stats_[cluster].num_cache_entries--;
+    }
+  }
+}
+
+bool XlaCompilationCache::TryReserveAsyncCompilation() {
+  mutex_lock lock(async_compilation_state_.async_compilation_state_mu);
+  if (async_compilation_state_.num_ongoing_compilations >=
+      async_compilation_state_.max_num_ongoing_compilations) {
+    metrics::RecordXlaAsyncCompilationDeferred();
+    return false;
+  }
+  ++async_compilation_state_.num_ongoing_compilations;
+  metrics::UpdateXlaAsyncCompilationBacklog(1);
+  return true;
+}
+
+void XlaCompilationCache::ReleaseAsyncCompilation() {
+  mutex_lock lock(async_compilation_state_.async_compilation_state_mu);
+  --async_compilation_state_.num_ongoing_compilations;
+  metrics::UpdateXlaAsyncCompilationBacklog(-1);
+}
+
 bool XlaCompilationCache::ShouldCompileCluster(CompileMode compile_mode,
                                                bool is_megamorphic,
                                                bool is_first_execution,
@@ -541,17 +941,6 @@ bool XlaCompilationCache::ShouldCompileCluster(CompileMode compile_mode,
     return true;
   }
 
-  if (compile_mode == CompileMode::kAsync) {
-    // Asynchronous compilation is enabled.
-    mutex_lock lock(async_compilation_state_.async_compilation_state_mu);
-    if (async_compilation_state_.num_ongoing_compilations >=
-        async_compilation_state_.kMaxNumOngoingCompilations) {
-      VLOG(2) << "Not asynchronously compiling cluster " << function.name()
-              << " because of too many ongoing compilations.";
-      return false;
-    }
-  }
-
   bool reached_compile_threshold = current_request_count >= *compile_threshold;
   if (!reached_compile_threshold) {
     VLOG(2) << "Not compiling cluster " << function.name()
@@ -568,7 +957,7 @@ Status XlaCompilationCache::CompileImpl(
     const std::vector<XlaCompiler::Argument>& args, OpKernelContext* ctx,
     CompileScope scope, CompileMode compile_mode,
     const XlaCompiler::CompilationResult** out_compilation_result,
-    xla::LocalExecutable** out_executable) {
+    xla::LocalExecutable** out_executable, EntryRef* out_entry_ref) {
   if (FailOnXlaCompilation()) {
     return errors::Internal("XLA compilation disabled");
   }
@@ -581,20 +970,40 @@ Status XlaCompilationCache::CompileImpl(
       VLOG(3) << i << ": " << args[i].HumanString();
     }
   }
-  TF_ASSIGN_OR_RETURN(Signature signature, BuildSignature(function, args));
-
+  std::vector<XlaCompiler::Argument> bucketed_args;
+  if (scope == CompileScope::kFunction && ShapeBucketingEnabled()) {
+    bucketed_args = BucketArguments(function, args);
+  }
+  const std::vector<XlaCompiler::Argument>& compile_args =
+      bucketed_args.empty() ? args : bucketed_args;
+  TF_ASSIGN_OR_RETURN(Signature signature,
+                      BuildSignature(function, compile_args));
 
   // The outer lock protects the existence of the cache entry. It does not
-  // protect the contents of the cache entry.
-  Entry* entry;
+  // protect the contents of the cache entry, but the shared ownership keeps the
+  // entry alive if it is evicted while in use.
+  std::shared_ptr<Entry> entry;
+  bool is_new_entry = false;
   {
     mutex_lock lock(compile_cache_mu_);
     // Find or create a cache entry.
-    std::unique_ptr<Entry>& e = cache_[signature];
+    std::shared_ptr<Entry>& e = cache_[signature];
     if (!e) {
-      e.reset(new Entry);
+      e = std::make_shared<Entry>();
+      e->cluster_name = function.name();
+      is_new_entry = true;
+      metrics::UpdateXlaCompilationCacheSize(/*num_entries_delta=*/1,
+                                             /*size_bytes_delta=*/0);
+    }
+    entry = e;
+    entry->last_use = ++use_count_;
+    if (out_entry_ref == nullptr) {
+      entry->evictable = false;
     }
-    entry = e.get();
+    // AccountCompiledEntry records the size of an entry once it is compiled.
+    const bool hit = !is_new_entry && entry->size_bytes > 0;
+    ++(hit ? hits_ : misses_);
+    metrics::RecordXlaCompilationCacheLookup(hit);
   }
 
   // We always compile a cluster the very first time it is executed.  This is an
@@ -614,6 +1023,9 @@ Status XlaCompilationCache::CompileImpl(
         cluster_compile_stats_.emplace(function.name(), ClusterCompileStats{})
             .first;
     is_first_execution = it->second.execution_count++ == 0;
+    if (is_new_entry) {
+      it->second.num_cache_entries++;
+    }
 
     // The is_megamorphic bit is "sticky".  We assume clusters that have been
     // observed to be megamorphic once stay megamorphic forever.
@@ -636,8 +1048,6 @@ Status XlaCompilationCache::CompileImpl(
   }
 
   // Acquire the cache entry lock and compile, if necessary.
-  // TODO(phawkins): this locking will need to be restructured when we implement
-  // cache eviction.
   mutex_lock entry_lock(entry->mu);
   int64_t current_request_count = ++entry->request_count;
   VLOG(2) << "Compilation cache entry hit: "
@@ -656,15 +1066,25 @@ Status XlaCompilationCache::CompileImpl(
       VLOG(2) << "Not compiling for signature: " << human_signature;
       return Status::OK();
     } else if (compile_mode == CompileMode::kAsync) {
+      // The bound on ongoing compilations also applies to first executions,
+      // so a burst of new clusters cannot flood the compiler threads.
+      if (!TryReserveAsyncCompilation()) {
+        VLOG(2) << "Not asynchronously compiling cluster " << function.name()
+                << " because of too many ongoing compilations.";
+        return Status::OK();
+      }
       VLOG(2) << "Queueing asynchronous compilation for signature: "
               << human_signature;
       TF_RETURN_IF_ERROR(CompileAsynchronous(entry, compile_options, options,
-                                             args, function, ctx, scope));
+                                             compile_args, function, ctx,
+                                             scope));
       return Status::OK();
     } else {
       VLOG(2) << "Instantly compiling for signature: " << human_signature;
-      TF_RETURN_IF_ERROR(CompileStrict(entry, compile_options, options, args,
-                                       function, ctx, scope));
+      Status status = CompileStrict(entry.get(), compile_options, options,
+                                    compile_args, function, ctx, scope);
+      AccountCompiledEntry(entry.get());
+      TF_RETURN_IF_ERROR(status);
     }
   } else if (state == CompileState::kCompiling) {
     VLOG(2) << "Ongoing asynchronous compilation for signature: "
@@ -677,6 +1097,9 @@ Status XlaCompilationCache::CompileImpl(
   TF_RETURN_IF_ERROR(entry->compilation_status);
   *out_compilation_result = &entry->compilation_result;
   *out_executable = entry->executable.get();
+  if (out_entry_ref != nullptr) {
+    *out_entry_ref = entry;
+  }
   return Status::OK();
 }
 
@@ -16,11 +16,16 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_JIT_XLA_COMPILATION_CACHE_H_
 #define TENSORFLOW_COMPILER_JIT_XLA_COMPILATION_CACHE_H_
 
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "absl/types/variant.h"
+#include "tensorflow/compiler/jit/xla_compilation_cache.pb.h"
 #include "tensorflow/compiler/tf2xla/xla_compiler.h"
 #include "tensorflow/compiler/tf2xla/xla_context.h"
 #include "tensorflow/compiler/xla/client/local_client.h"
@@ -39,10 +44,18 @@ namespace tensorflow {
 // which converts a Tensorflow graph into a compiled XLA compilation.
 //
 // Since XLA computations must have static shapes, the cache generates a new
-// XLA computation for each new set of input shapes.
+// XLA computation for each new set of input shapes. If tf_xla_shape_buckets is
+// set, input dimensions of XLA:CPU clusters that change between executions are
+// instead compiled as dynamic dimensions bounded by the next bucket size, so
+// that one executable serves a range of shapes.
+//
+// If tf_xla_compilation_cache_memory_limit_mb is set, the least recently used
+// entries are evicted once the cache grows beyond the limit. Otherwise the
+// cache grows without bound.
 //
-// Currently no cache eviction policy is implemented and the cache grows without
-// bound.
+// If tf_xla_persistent_cache_directory is set, XLA:CPU executables are also
+// written to that directory and reloaded instead of recompiled by later
+// processes.
 class XlaCompilationCache : public ResourceBase {
  public:
   XlaCompilationCache(xla::LocalClient* client, DeviceType device_type);
@@ -65,6 +78,11 @@ class XlaCompilationCache : public ResourceBase {
     kFunction,
   };
 
+  // Keeps a cache entry alive. The compilation result and executable returned
+  // for an entry stay valid while a reference to it is held, even if the entry
+  // is evicted from the cache in the meantime.
+  using EntryRef = std::shared_ptr<const void>;
+
   // Compiles a function into a XlaCompiler::CompilationResult that can be used
   // to execute an XLA Computation. Compilation results are cached.
   // `function` is the name of a Tensorflow function to compile.
@@ -84,13 +102,18 @@ class XlaCompilationCache : public ResourceBase {
   // xla::LocalExecutable and sets `out_executable` to point to it. The
   // resulting executable pointer may be null if the computation has no
   // non-constant outputs.
+  //
+  // If `out_entry_ref` is non-null, it is set to a reference that keeps the
+  // results alive. Entries whose results were returned without one are never
+  // evicted.
   Status Compile(const XlaCompiler::Options& options,
                  const NameAttrList& function,
                  const std::vector<XlaCompiler::Argument>& args,
                  const XlaCompiler::CompileOptions& compile_options,
                  CompileMode compile_mode,
                  const XlaCompiler::CompilationResult** out_compilation_result,
-                 xla::LocalExecutable** out_executable);
+                 xla::LocalExecutable** out_executable,
+                 EntryRef* out_entry_ref = nullptr);
 
   // As above, but calls XlaCompiler::CompileSingleOp instead of
   // XlaCompiler::CompileFunction. If MLIR bridge is enabled through ConfigProto
@@ -108,6 +131,20 @@ class XlaCompilationCache : public ResourceBase {
 
   string DebugString() const override;
 
+  // Counters describing the contents and the effectiveness of the cache.
+  struct Stats {
+    // Lookups that found a compiled entry, and lookups that did not.
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t evictions = 0;
+    int64_t num_entries = 0;
+    // Estimated size of the compiled entries.
+    int64_t size_bytes = 0;
+    // Number of entries per cluster.
+    absl::flat_hash_map<string, int64_t> cluster_entries;
+  };
+  Stats GetStats();
+
   // Describes the types, shapes and any compile-time constant arguments
   // to a kernel. Key that uniquely identifies a compilation output.
   struct Signature {
@@ -120,6 +157,10 @@ class XlaCompilationCache : public ResourceBase {
         std::pair<DataType, absl::InlinedVector<int64_t, 4>>;
     absl::InlinedVector<absl::variant<Tensor, TensorTypeAndShape>, 8> args;
 
+    // (argument number, dimension) pairs of the dynamic dimensions of the
+    // args, whose sizes in `args` are upper bounds rather than exact sizes.
+    absl::InlinedVector<std::pair<int, int>, 4> dynamic_dimensions;
+
     bool operator==(const Signature& other) const;
 
     struct Hash {
@@ -136,6 +177,8 @@ class XlaCompilationCache : public ResourceBase {
       absl::Span<const XlaCompiler::Argument> args);
 
  private:
+  friend class XlaCompilationCacheTestHelper;
+
   // Common implementation of Compile and CompileSingleOp. The `OpKernelContext`
   // parameter is always null for the former.
   Status CompileImpl(
@@ -144,7 +187,18 @@ class XlaCompilationCache : public ResourceBase {
       const std::vector<XlaCompiler::Argument>& args, OpKernelContext* ctx,
       CompileScope scope, CompileMode compile_mode,
       const XlaCompiler::CompilationResult** out_compilation_result,
-      xla::LocalExecutable** out_executable);
+      xla::LocalExecutable** out_executable, EntryRef* out_entry_ref);
+
+  // Returns true if the dimensions of arguments should be bucketed. Only
+  // XLA:CPU supports passing arguments with dynamic dimensions.
+  bool ShapeBucketingEnabled() const;
+
+  // Returns `args`, with the dimensions of parameters that have changed since
+  // the first execution of `function` replaced by dynamic dimensions bounded
+  // by their bucket size.
+  std::vector<XlaCompiler::Argument> BucketArguments(
+      const NameAttrList& function,
+      const std::vector<XlaCompiler::Argument>& args);
 
   // Takes `result` which has been compiled from a Tensorflow subgraph to a
   // XLA computation already, and generates an XLA LocalExecutable `executable`.
@@ -152,6 +206,27 @@ class XlaCompilationCache : public ResourceBase {
                          const XlaCompiler::CompilationResult& result,
                          std::unique_ptr<xla::LocalExecutable>* executable);
 
+  // Returns true if executables should be persisted to and reloaded from
+  // tf_xla_persistent_cache_directory. Only XLA:CPU supports serializing
+  // executables.
+  bool PersistentCacheEnabled() const;
+
+  // Builds the key under which the executable compiled from `result` with
+  // `build_options` is persisted.
+  XlaSerializedCacheKey BuildSerializedCacheKey(
+      const XlaCompiler::CompilationResult& result,
+      const xla::ExecutableBuildOptions& build_options) const;
+
+  // Returns the executable persisted for `key`, or nullptr if there is no
+  // usable entry. Stale or corrupt entries are ignored.
+  std::unique_ptr<xla::LocalExecutable> LoadPersistedExecutable(
+      const XlaSerializedCacheKey& key,
+      const xla::ExecutableBuildOptions& build_options);
+
+  // Writes `executable` to the persistent cache under `key`.
+  Status PersistExecutable(const XlaSerializedCacheKey& key,
+                           const xla::LocalExecutable& executable);
+
   // Determines whether the cluster should be compiled.
   bool ShouldCompileCluster(CompileMode compile_mode, bool is_megamorphic,
                             bool is_first_execution,
@@ -165,6 +240,16 @@ class XlaCompilationCache : public ResourceBase {
   struct Entry {
     mutex mu;
 
+    // Name of the cluster the entry was compiled from.
+    string cluster_name;
+
+    // Bookkeeping for eviction, guarded by compile_cache_mu_: the value of
+    // use_count_ when the entry was last looked up, the estimated size of the
+    // compiled entry, and whether the entry may be evicted at all.
+    int64_t last_use = 0;
+    int64_t size_bytes = 0;
+    bool evictable = true;
+
     // The current compilation state for this entry.
     CompileState compile_state = CompileState::kUncompiled;
 
@@ -189,17 +274,37 @@ class XlaCompilationCache : public ResourceBase {
                        const NameAttrList& function, OpKernelContext* ctx,
                        CompileScope scope)
       TF_EXCLUSIVE_LOCKS_REQUIRED(entry->mu);
-  Status CompileAsynchronous(Entry* entry,
+  Status CompileAsynchronous(std::shared_ptr<Entry> entry,
                              const XlaCompiler::CompileOptions& compile_options,
                              const XlaCompiler::Options& options,
                              const std::vector<XlaCompiler::Argument>& args,
                              const NameAttrList& function, OpKernelContext* ctx,
                              CompileScope scope);
 
+  // Records the size of the freshly compiled `entry` and evicts least recently
+  // used entries, other than `entry`, while the cache is over its memory
+  // limit.
+  void AccountCompiledEntry(Entry* entry)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(entry->mu);
+
   mutex compile_cache_mu_;
-  absl::flat_hash_map<Signature, std::unique_ptr<Entry>, Signature::Hash> cache_
+  absl::flat_hash_map<Signature, std::shared_ptr<Entry>, Signature::Hash> cache_
       TF_GUARDED_BY(compile_cache_mu_);
 
+  // Incremented on every lookup, to order entries by recency of use.
+  int64_t use_count_ TF_GUARDED_BY(compile_cache_mu_) = 0;
+  int64_t hits_ TF_GUARDED_BY(compile_cache_mu_) = 0;
+  int64_t misses_ TF_GUARDED_BY(compile_cache_mu_) = 0;
+  int64_t evictions_ TF_GUARDED_BY(compile_cache_mu_) = 0;
+  int64_t size_bytes_ TF_GUARDED_BY(compile_cache_mu_) = 0;
+
+  // Limit on size_bytes_ from tf_xla_compilation_cache_memory_limit_mb, or 0
+  // if the cache is unbounded.
+  int64_t memory_limit_bytes_;
+
+  // Bucket sizes parsed from tf_xla_shape_buckets, in increasing order.
+  std::vector<int64_t> shape_buckets_;
+
   struct ClusterCompileStats {
     // Number of times the cluster has been (re-)compiled.
     int64_t compile_count = 0;
@@ -214,6 +319,15 @@ class XlaCompilationCache : public ResourceBase {
     // change too frequently) to profitably JIT compile.  Once a cluster is
     // tagged megamorphic, it stays megamorphic forever.
     bool is_megamorphic = false;
+
+    // Number of entries the cluster has in the cache.
+    int64_t num_cache_entries = 0;
+
+    // Dimension sizes of the parameters the cluster was first executed with,
+    // by argument number, and which of those dimensions have changed since.
+    // Only maintained when shape bucketing is enabled.
+    std::vector<absl::InlinedVector<int64_t, 4>> initial_dimensions;
+    std::vector<absl::InlinedVector<bool, 4>> dimension_changed;
   };
 
   mutex cluster_compile_stats_mu_;
@@ -225,11 +339,10 @@ class XlaCompilationCache : public ResourceBase {
   struct AsyncCompilationState {
     mutex async_compilation_state_mu;
 
-    // Number of threads for asynchronous compilations.
-    static constexpr int64_t kNumCompilerThreads = 10;
-
-    // Maximum number of ongoing compilations.
-    static constexpr int64_t kMaxNumOngoingCompilations = kNumCompilerThreads;
+    // Maximum number of ongoing compilations, which is also the number of
+    // threads for asynchronous compilations. Set from
+    // tf_xla_max_concurrent_async_compilations.
+    const int64_t max_num_ongoing_compilations;
 
     // Number of ongoing compilations.
     int64_t num_ongoing_compilations TF_GUARDED_BY(async_compilation_state_mu) =
@@ -238,14 +351,17 @@ class XlaCompilationCache : public ResourceBase {
     // Pool of threads for asynchronous compilations.
     std::unique_ptr<thread::ThreadPool> compiler_threads;
 
-    AsyncCompilationState() {
-      compiler_threads = absl::make_unique<tensorflow::thread::ThreadPool>(
-          tensorflow::Env::Default(), "async_compiler_threads",
-          kNumCompilerThreads);
-    }
-
+    AsyncCompilationState();
   } async_compilation_state_;
 
+  // Reserves a slot for a background compilation. Returns false, leaving the
+  // cluster to run through the fallback path, if the maximum number of
+  // ongoing compilations has been reached.
+  bool TryReserveAsyncCompilation();
+
+  // Releases a slot reserved by TryReserveAsyncCompilation.
+  void ReleaseAsyncCompilation();
+
   // The number of times a lazy compilation must be requested for a specific
   // signature before  we attempt to compile it.
   static constexpr int64_t kDefaultCompilationThreshold = 2;
@@ -17,11 +17,39 @@ limitations under the License.
 
 #include "tensorflow/compiler/jit/flags.h"
 #include "tensorflow/compiler/tf2xla/shape_util.h"
+#include "tensorflow/compiler/tf2xla/xla_op_registry.h"
 #include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
+
+// Gives tests access to the internals of XlaCompilationCache.
+class XlaCompilationCacheTestHelper {
+ public:
+  static int64_t MaxNumOngoingCompilations(XlaCompilationCache* cache) {
+    return cache->async_compilation_state_.max_num_ongoing_compilations;
+  }
+  static bool TryReserveAsyncCompilation(XlaCompilationCache* cache) {
+    return cache->TryReserveAsyncCompilation();
+  }
+  static void ReleaseAsyncCompilation(XlaCompilationCache* cache) {
+    cache->ReleaseAsyncCompilation();
+  }
+  static void SetShapeBuckets(XlaCompilationCache* cache,
+                              std::vector<int64_t> shape_buckets) {
+    cache->shape_buckets_ = std::move(shape_buckets);
+  }
+  static void SetMemoryLimit(XlaCompilationCache* cache,
+                             int64_t memory_limit_bytes) {
+    cache->memory_limit_bytes_ = memory_limit_bytes;
+  }
+};
+
 namespace {
 
 using SignatureHash = XlaCompilationCache::Signature::Hash;
@@ -92,6 +120,203 @@ TEST(XlaCompilationCacheTest, SignatureUniqueness) {
   EXPECT_FALSE(s1 == s2);
 }
 
+TEST(XlaCompilationCacheTest, SignatureDynamicDimensions) {
+  NameAttrList fn;
+  fn.set_name("afunction");
+  std::vector<XlaCompiler::Argument> args(1);
+  args[0].kind = XlaCompiler::Argument::kParameter;
+  args[0].type = DT_FLOAT;
+  args[0].shape = xla::ShapeUtil::MakeShape(xla::F32, {8, 4});
+  TF_ASSERT_OK_AND_ASSIGN(XlaCompilationCache::Signature s1,
+                          XlaCompilationCache::BuildSignature(fn, args));
+
+  // A bucketed argument has the same bounds as the static one, but must not
+  // share its cache entry.
+  args[0].shape = xla::ShapeUtil::MakeShape(xla::F32, {8, 4}, {true, false});
+  TF_ASSERT_OK_AND_ASSIGN(XlaCompilationCache::Signature s2,
+                          XlaCompilationCache::BuildSignature(fn, args));
+  ASSERT_EQ(s2.dynamic_dimensions.size(), 1);
+  EXPECT_EQ(s2.dynamic_dimensions[0], std::make_pair(0, 0));
+
+  EXPECT_NE(s1.HumanString(), s2.HumanString());
+  EXPECT_NE(SignatureHash()(s1), SignatureHash()(s2));
+  EXPECT_FALSE(s1 == s2);
+}
+
+TEST(XlaCompilationCacheTest, EmptyCacheStats) {
+  xla::LocalClient* client = xla::ClientLibrary::LocalClientOrDie();
+  auto cache = new XlaCompilationCache(client, DeviceType(DEVICE_CPU_XLA_JIT));
+  core::ScopedUnref cache_ref(cache);
+
+  XlaCompilationCache::Stats stats = cache->GetStats();
+  EXPECT_EQ(stats.hits, 0);
+  EXPECT_EQ(stats.misses, 0);
+  EXPECT_EQ(stats.evictions, 0);
+  EXPECT_EQ(stats.num_entries, 0);
+  EXPECT_EQ(stats.size_bytes, 0);
+  EXPECT_TRUE(stats.cluster_entries.empty());
+}
+
+// Compiles single-op functions through an XLA:CPU compilation cache.
+class XlaCompilationCacheCompileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    XlaOpRegistry::RegisterCompilationKernels();
+    client_ = xla::ClientLibrary::LocalClientOrDie();
+    flib_def_ = absl::make_unique<FunctionLibraryDefinition>(
+        OpRegistry::Global(), FunctionDefLibrary());
+    for (const char* name : {"neg_a", "neg_b", "neg_c"}) {
+      TF_ASSERT_OK(flib_def_->AddFunctionDef(FunctionDefHelper::Define(
+          name, {"x: float"}, {"y: float"}, {},
+          {{{"y"}, "Neg", {"x"}, {{"T", DT_FLOAT}}}})));
+    }
+    cache_ = new XlaCompilationCache(client_, DeviceType(DEVICE_CPU_XLA_JIT));
+  }
+
+  void TearDown() override { cache_->Unref(); }
+
+  // Compiles `function` for a float argument of `shape`.
+  Status Compile(const string& function, const TensorShape& shape) {
+    XlaCompiler::Options options;
+    options.device_type = DeviceType(DEVICE_CPU_XLA_JIT);
+    options.client = client_;
+    options.flib_def = flib_def_.get();
+    NameAttrList fn;
+    fn.set_name(function);
+    std::vector<XlaCompiler::Argument> args(1);
+    args[0].kind = XlaCompiler::Argument::kParameter;
+    args[0].type = DT_FLOAT;
+    args[0].shape = shape;
+    const XlaCompiler::CompilationResult* result;
+    xla::LocalExecutable* executable;
+    XlaCompilationCache::EntryRef entry_ref;
+    TF_RETURN_IF_ERROR(cache_->Compile(
+        options, fn, args, XlaCompiler::CompileOptions{},
+        XlaCompilationCache::CompileMode::kStrict, &result, &executable,
+        &entry_ref));
+    if (executable == nullptr) {
+      return errors::Internal("No executable for ", function);
+    }
+    return Status::OK();
+  }
+
+  xla::LocalClient* client_;
+  std::unique_ptr<FunctionLibraryDefinition> flib_def_;
+  XlaCompilationCache* cache_;
+};
+
+TEST_F(XlaCompilationCacheCompileTest, CompilesOncePerBucket) {
+  XlaCompilationCacheTestHelper::SetShapeBuckets(cache_, {16, 32, 64});
+
+  // The first execution is compiled for its exact shape.
+  TF_ASSERT_OK(Compile("neg_a", TensorShape({5, 3})));
+  // The first dimension changes, so it is bucketed from now on: 20 and 30
+  // share the bucket of 32, and 40 is in the bucket of 64.
+  TF_ASSERT_OK(Compile("neg_a", TensorShape({20, 3})));
+  TF_ASSERT_OK(Compile("neg_a", TensorShape({30, 3})));
+  TF_ASSERT_OK(Compile("neg_a", TensorShape({32, 3})));
+  XlaCompilationCache::Stats stats = cache_->GetStats();
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.num_entries, 2);
+  EXPECT_EQ(stats.cluster_entries["neg_a"], 2);
+
+  TF_ASSERT_OK(Compile("neg_a", TensorShape({40, 3})));
+  // Sizes beyond the largest bucket are compiled exactly.
+  TF_ASSERT_OK(Compile("neg_a", TensorShape({100, 3})));
+  TF_ASSERT_OK(Compile("neg_a", TensorShape({100, 3})));
+  stats = cache_->GetStats();
+  EXPECT_EQ(stats.misses, 4);
+  EXPECT_EQ(stats.hits, 3);
+  EXPECT_EQ(stats.num_entries, 4);
+  EXPECT_EQ(stats.evictions, 0);
+}
+
+TEST_F(XlaCompilationCacheCompileTest, EvictsLeastRecentlyUsed) {
+  TF_ASSERT_OK(Compile("neg_a", TensorShape({8})));
+  TF_ASSERT_OK(Compile("neg_b", TensorShape({8})));
+  // neg_a is used again, so neg_b is now the least recently used entry.
+  TF_ASSERT_OK(Compile("neg_a", TensorShape({8})));
+  XlaCompilationCache::Stats stats = cache_->GetStats();
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.num_entries, 2);
+  ASSERT_GT(stats.size_bytes, 0);
+
+  // The three entries are about equally large, so the limit leaves room for
+  // two of them.
+  const int64_t two_entries_bytes = stats.size_bytes;
+  XlaCompilationCacheTestHelper::SetMemoryLimit(
+      cache_, two_entries_bytes + two_entries_bytes / 4);
+  TF_ASSERT_OK(Compile("neg_c", TensorShape({8})));
+  stats = cache_->GetStats();
+  EXPECT_EQ(stats.evictions, 1);
+  EXPECT_EQ(stats.num_entries, 2);
+  EXPECT_LE(stats.size_bytes, two_entries_bytes + two_entries_bytes / 4);
+  EXPECT_EQ(stats.cluster_entries["neg_a"], 1);
+  EXPECT_EQ(stats.cluster_entries["neg_b"], 0);
+  EXPECT_EQ(stats.cluster_entries["neg_c"], 1);
+
+  // neg_a is still cached, and neg_b has to be compiled again.
+  TF_ASSERT_OK(Compile("neg_a", TensorShape({8})));
+  EXPECT_EQ(cache_->GetStats().hits, 2);
+  TF_ASSERT_OK(Compile("neg_b", TensorShape({8})));
+  stats = cache_->GetStats();
+  EXPECT_EQ(stats.misses, 4);
+  EXPECT_EQ(stats.evictions, 2);
+}
+
+// Returns the value of an unlabeled integer metric, or 0 if it has not been
+// set yet.
+int64_t MetricValue(const string& name) {
+  monitoring::CollectionRegistry::CollectMetricsOptions options;
+  std::unique_ptr<monitoring::CollectedMetrics> metrics =
+      monitoring::CollectionRegistry::Default()->CollectMetrics(options);
+  auto it = metrics->point_set_map.find(name);
+  if (it == metrics->point_set_map.end() || it->second->points.empty()) {
+    return 0;
+  }
+  return it->second->points[0]->int64_value;
+}
+
+TEST(XlaCompilationCacheTest, AsyncCompilationLimit) {
+  constexpr char kBacklog[] = "/tensorflow/core/xla_async_compilation_backlog";
+  constexpr char kDeferred[] =
+      "/tensorflow/core/xla_async_compilations_deferred";
+  xla::LocalClient* client = xla::ClientLibrary::LocalClientOrDie();
+  auto cache = new XlaCompilationCache(client, DeviceType(DEVICE_CPU_XLA_JIT));
+  core::ScopedUnref cache_ref(cache);
+  auto other_cache =
+      new XlaCompilationCache(client, DeviceType(DEVICE_CPU_XLA_JIT));
+  core::ScopedUnref other_cache_ref(other_cache);
+
+  using Helper = XlaCompilationCacheTestHelper;
+  const int64_t limit = Helper::MaxNumOngoingCompilations(cache);
+  const int64_t backlog = MetricValue(kBacklog);
+  const int64_t deferred = MetricValue(kDeferred);
+  for (int64_t i = 0; i < limit; ++i) {
+    EXPECT_TRUE(Helper::TryReserveAsyncCompilation(cache));
+  }
+  EXPECT_FALSE(Helper::TryReserveAsyncCompilation(cache));
+  EXPECT_EQ(MetricValue(kDeferred), deferred + 1);
+
+  // The limit applies per cache, but the backlog counts the compilations of
+  // all caches.
+  EXPECT_TRUE(Helper::TryReserveAsyncCompilation(other_cache));
+  EXPECT_EQ(MetricValue(kBacklog), backlog + limit + 1);
+
+  Helper::ReleaseAsyncCompilation(cache);
+  EXPECT_EQ(MetricValue(kBacklog), backlog + limit);
+  EXPECT_TRUE(Helper::TryReserveAsyncCompilation(cache));
+  EXPECT_EQ(MetricValue(kDeferred), deferred + 1);
+
+  for (int64_t i = 0; i < limit; ++i) {
+    Helper::ReleaseAsyncCompilation(cache);
+  }
+  Helper::ReleaseAsyncCompilation(other_cache);
+  EXPECT_EQ(MetricValue(kBacklog), backlog);
+}
+
 void BM_BuildSignature(::testing::benchmark::State& state) {
   const int n_args = state.range(0);
 
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/jit/xla_launch_util.h"
 
+#include <cstring>
 #include <memory>
 
 #include "absl/algorithm/container.h"
@@ -240,6 +241,37 @@ static void PopulateExecutionInputBuffer(xla::ExecutionInput& execution_input,
   }
 }
 
+// Copies `tensor` into a new buffer laid out the way XLA expects an argument
+// whose shape has dynamic dimensions: the data of `tensor`, padded to the size
+// of `bounded_shape`, followed by the size of every dimension as an int32.
+// Arguments get such shapes when the compilation cache buckets their
+// dimensions.
+static StatusOr<se::OwningDeviceMemory> CopyToBoundedBuffer(
+    const Tensor& tensor, const xla::Shape& bounded_shape, se::Stream* stream,
+    int device_ordinal, se::DeviceMemoryAllocator* allocator) {
+  if (stream != nullptr) {
+    return errors::Unimplemented(
+        "Arguments with dynamic dimensions are only supported on the host");
+  }
+  TF_RET_CHECK(tensor.dims() == bounded_shape.rank());
+  const int64_t data_size = xla::ShapeUtil::ByteSizeOf(
+      xla::ShapeUtil::MakeStaticShape(bounded_shape));
+  const absl::string_view data = tensor.tensor_data();
+  TF_RET_CHECK(data.size() <= data_size);
+  TF_ASSIGN_OR_RETURN(
+      se::OwningDeviceMemory buffer,
+      allocator->Allocate(device_ordinal,
+                          data_size + sizeof(int32_t) * tensor.dims()));
+  char* dst = static_cast<char*>(buffer->opaque());
+  std::memcpy(dst, data.data(), data.size());
+  for (int i = 0; i < tensor.dims(); ++i) {
+    const int32_t dim_size = tensor.dim_size(i);
+    std::memcpy(dst + data_size + i * sizeof(int32_t), &dim_size,
+                sizeof(int32_t));
+  }
+  return std::move(buffer);
+}
+
 StatusOr<std::vector<xla::ExecutionInput>>
 XlaComputationLaunchContext::PopulateInputs(
     OpKernelContext* ctx,
@@ -292,6 +324,18 @@ XlaComputationLaunchContext::PopulateInputs(
 
     arguments.emplace_back(device_shape, host_shape);
     xla::ExecutionInput& execution_input = arguments.back();
+    if (device_shape.IsArray() && device_shape.is_dynamic()) {
+      TF_ASSIGN_OR_RETURN(
+          se::OwningDeviceMemory bounded_buffer,
+          CopyToBoundedBuffer(
+              *t, device_shape,
+              ctx->op_device_context() ? ctx->op_device_context()->stream()
+                                       : nullptr,
+              device_ordinal_, xla_allocator_));
+      *execution_input.MutableBuffer(xla::ShapeIndex{}) =
+          std::move(bounded_buffer);
+      continue;
+    }
     se::DeviceMemoryBase dmem = XlaTensor::DeviceMemoryFromTensor(*t);
     PopulateExecutionInputBuffer(execution_input, xla::ShapeIndex{}, dmem,
                                  donate_buffer, device_ordinal_,
@@ -878,6 +878,19 @@ Status XlaCompiler::XLAShapeForArgument(
         TF_RETURN_IF_ERROR(RewriteLayoutWithShardedShape(
             arg_sharding, /*use_fast_memory=*/false,
             options_.shape_determination_fns, xla_shape));
+        // The representation function only sees the bounds of a dynamically
+        // shaped argument, so carry its dynamic dimensions over.
+        if (absl::holds_alternative<xla::Shape>(arg.shape)) {
+          const xla::Shape& arg_shape = absl::get<xla::Shape>(arg.shape);
+          if (arg_shape.IsArray() && xla_shape->IsArray() &&
+              arg_shape.rank() == xla_shape->rank()) {
+            for (int dim = 0; dim < arg_shape.rank(); ++dim) {
+              if (arg_shape.is_dynamic_dimension(dim)) {
+                xla_shape->set_dynamic_dimension(dim, true);
+              }
+            }
+          }
+        }
       } else {
         if (absl::holds_alternative<xla::Shape>(arg.shape)) {
           *xla_shape = absl::get<xla::Shape>(arg.shape);
@@ -398,6 +398,35 @@ StatusOr<std::vector<std::unique_ptr<LocalExecutable>>> LocalClient::Compile(
   return std::move(local_executables);
 }
 
+StatusOr<std::string> LocalClient::SerializeExecutable(
+    const LocalExecutable& executable) {
+  Compiler* compiler = local_service_->mutable_backend()->compiler();
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<AotCompilationResult> aot_result,
+                      compiler->Export(executable.executable()));
+  return aot_result->SerializeAsString();
+}
+
+StatusOr<std::unique_ptr<LocalExecutable>> LocalClient::Load(
+    const std::string& serialized_aot_result,
+    const ExecutableBuildOptions& options) {
+  ExecutableBuildOptions updated_options = options;
+  if (options.device_ordinal() == -1) {
+    updated_options.set_device_ordinal(default_device_ordinal());
+  }
+  TF_ASSIGN_OR_RETURN(
+      se::StreamExecutor * executor,
+      backend().stream_executor(updated_options.device_ordinal()));
+  Compiler* compiler = local_service_->mutable_backend()->compiler();
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<AotCompilationResult> aot_result,
+      compiler->LoadAotCompilationResult(serialized_aot_result));
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<Executable> executable,
+                      aot_result->LoadExecutable(compiler, executor));
+  return absl::make_unique<LocalExecutable>(std::move(executable),
+                                            local_service_->mutable_backend(),
+                                            updated_options);
+}
+
 StatusOr<ScopedShapedBuffer> LocalClient::LiteralToShapedBuffer(
     const LiteralSlice& literal, int device_ordinal,
     se::DeviceMemoryAllocator* allocator) {
@@ -145,6 +145,17 @@ class LocalClient : public Client {
       const absl::Span<const Shape* const> argument_layouts,
       const ExecutableBuildOptions& options);
 
+  // Serializes `executable` so that it can be reloaded with Load, possibly by
+  // another process. Only supported by backends that implement
+  // Compiler::Export.
+  StatusOr<std::string> SerializeExecutable(const LocalExecutable& executable);
+
+  // Rebuilds an executable from the output of SerializeExecutable without
+  // compiling it again. `options` must describe the device to load it on.
+  StatusOr<std::unique_ptr<LocalExecutable>> Load(
+      const std::string& serialized_aot_result,
+      const ExecutableBuildOptions& options);
+
   // Copy the literal data to the device with the given ordinal and return as a
   // ScopedShapedBuffer. If non-null the given memory allocator is used for
   // device memory allocation. If null, the default memory allocator for the
@@ -76,6 +76,10 @@ DebugOptions DefaultDebugOptionsIgnoringFlags() {
   opts.set_xla_force_host_platform_device_count(1);
   opts.set_xla_gpu_all_reduce_combine_threshold_bytes(30 * 1024 * 1024);
   opts.set_xla_cpu_enable_xprof_traceme(false);
+  opts.set_xla_cpu_retain_object_files(false);
+  opts.set_xla_cpu_enable_work_stealing(false);
+  opts.set_xla_cpu_enable_dot_autotuning(false);
+  opts.set_xla_cpu_max_retained_temp_buffer_bytes(8 << 20);
   opts.set_xla_gpu_unsafe_fallback_to_driver_on_ptxas_not_found(false);
   opts.set_xla_multiheap_size_constraint_per_heap(-1);
   opts.set_xla_detailed_logging_and_dumping(true);
@@ -608,6 +612,46 @@ static void AllocateFlags() {
       flag_values->xla_cpu_enable_xprof_traceme(),
       "If true, XLA CPU generates code to call "
       "TraceMe::Activity{Start|End} around HLO operations."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_retain_object_files",
+      bool_setter_for(&DebugOptions::set_xla_cpu_retain_object_files),
+      flag_values->xla_cpu_retain_object_files(),
+      "If true, XLA CPU keeps the JIT-compiled object code alive so that "
+      "executables can be serialized and reloaded."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_force_compilation_parallelism",
+      int32_setter_for(
+          &DebugOptions::set_xla_cpu_force_compilation_parallelism),
+      flag_values->xla_cpu_force_compilation_parallelism(),
+      "Overrides the number of threads XLA CPU uses to generate code for a "
+      "module. Setting to 0 (the default value) uses the compile thread pool "
+      "if there is one; 1 disables parallel code generation."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_enable_work_stealing",
+      bool_setter_for(&DebugOptions::set_xla_cpu_enable_work_stealing),
+      flag_values->xla_cpu_enable_work_stealing(),
+      "If true, XLA CPU splits parallel loops into chunks at run time and "
+      "balances them across threads with work stealing."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_enable_dot_autotuning",
+      bool_setter_for(&DebugOptions::set_xla_cpu_enable_dot_autotuning),
+      flag_values->xla_cpu_enable_dot_autotuning(),
+      "If true, XLA CPU measures tiled LLVM IR and Eigen implementations of "
+      "every matrix-matrix dot on the host at compile time and emits the "
+      "fastest one."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_dot_autotune_results_path",
+      string_setter_for(&DebugOptions::set_xla_cpu_dot_autotune_results_path),
+      flag_values->xla_cpu_dot_autotune_results_path(),
+      "If non-empty, XLA CPU dot autotuning results are loaded from and saved "
+      "to this file."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_max_retained_temp_buffer_bytes",
+      int64_setter_for(
+          &DebugOptions::set_xla_cpu_max_retained_temp_buffer_bytes),
+      flag_values->xla_cpu_max_retained_temp_buffer_bytes(),
+      "Maximum number of bytes of temporary buffers an XLA CPU executable "
+      "keeps allocated between executions for reuse. 0 disables the reuse."));
   flag_objects->push_back(tensorflow::Flag(
       "xla_gpu_unsafe_fallback_to_driver_on_ptxas_not_found",
       bool_setter_for(
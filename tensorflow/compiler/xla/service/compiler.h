@@ -231,6 +231,14 @@ class Compiler {
                       CompileOptions{device_allocator});
   }
 
+  // Returns an AotCompilationResult wrapping an executable previously built by
+  // this compiler, so that it can be serialized and reloaded later without
+  // recompiling.
+  virtual StatusOr<std::unique_ptr<AotCompilationResult>> Export(
+      Executable* executable) const {
+    return Unimplemented("Export unimplemented.");
+  }
+
   // Returns a (deserialized) AotCompilationResult from a serialized
   // AotCompilationResult.
   virtual StatusOr<std::unique_ptr<AotCompilationResult>>
@@ -18,6 +18,7 @@ limitations under the License.
 #include <stddef.h>
 #include <string.h>
 
+#include <algorithm>
 #include <functional>
 #include <map>
 #include <memory>
@@ -31,8 +32,13 @@ limitations under the License.
 #include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Mangler.h"
@@ -42,9 +48,11 @@ limitations under the License.
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"  // from @llvm-project
 #include "mlir/Dialect/Arithmetic/IR/Arithmetic.h"  // from @llvm-project
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"  // from @llvm-project
@@ -54,6 +62,7 @@ limitations under the License.
 #include "mlir/Dialect/Vector/VectorOps.h"  // from @llvm-project
 #include "mlir/InitAllDialects.h"  // from @llvm-project
 #include "tensorflow/compiler/xla/cpu_function_runtime.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
 #include "tensorflow/compiler/xla/literal.h"
 #include "tensorflow/compiler/xla/map_util.h"
 #include "tensorflow/compiler/xla/protobuf_util.h"
@@ -65,6 +74,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/bfloat16_normalization.h"
 #include "tensorflow/compiler/xla/service/bitcast_dtypes_expander.h"
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
+#include "tensorflow/compiler/xla/service/call_graph.h"
 #include "tensorflow/compiler/xla/service/call_inliner.h"
 #include "tensorflow/compiler/xla/service/cholesky_expander.h"
 #include "tensorflow/compiler/xla/service/comparison_expander.h"
@@ -76,9 +86,11 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/cpu/buffer_info_util.h"
 #include "tensorflow/compiler/xla/service/cpu/compiler_functor.h"
 #include "tensorflow/compiler/xla/service/cpu/conv_canonicalization.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_dot_autotuner.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_executable.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_instruction_fusion.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_layout_assignment.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_multi_output_fusion.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
 #include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
@@ -140,6 +152,10 @@ limitations under the License.
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/casts.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/threadpool.h"
 
 namespace {
 
@@ -504,6 +520,9 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
 
   // Add a fusion pass now that layout assignment is done.
   pipeline.AddPass<CpuInstructionFusion>();
+  // Merge loop fusions that read the same operands, so that those operands
+  // are streamed from memory once.
+  pipeline.AddPass<CpuMultiOutputFusion>();
 
   // The LayoutAssignment pass may leave behind kCopy instructions which are
   // duplicate or NOPs, so remove them with algebraic simplification and CSE.
@@ -530,6 +549,23 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
       module->config().intra_op_parallelism_threads() > 0
           ? module->config().intra_op_parallelism_threads()
           : tensorflow::port::NumSchedulableCPUs();
+  if (!is_aot_compile &&
+      module->config().debug_options().xla_cpu_enable_dot_autotuning()) {
+    // Pick the implementation of every matrix-matrix dot by compiling and
+    // timing the candidates with this compiler.
+    const llvm::TargetMachine* target_machine =
+        target_machine_features->target_machine();
+    pipeline.AddPass<CpuDotAutotuner>(
+        [this](std::unique_ptr<HloModule> module)
+            -> StatusOr<std::unique_ptr<Executable>> {
+          TF_ASSIGN_OR_RETURN(module, RunHloPasses(std::move(module), nullptr,
+                                                   CompileOptions{}));
+          return RunBackend(std::move(module), nullptr, CompileOptions{});
+        },
+        target_machine->getTargetCPU().str(),
+        target_machine->getTargetFeatureString().str(),
+        target_machine_features);
+  }
   if (!is_aot_compile) {
     // Run ParallelTaskAssigner to assign parallel tasks to HLOs in module.
     // Note this is not run for AOT because it would bring in thread pool
@@ -713,14 +749,17 @@ namespace {
 
 // Post-compilation callback functor for use by SimpleOrcJIT.
 //
-// Dumps machine code if dumping is enabled for the module.
+// Dumps machine code if dumping is enabled for the module, and appends a copy
+// of it to `obj_files` if that is non-null.
 struct OrcJITPostCompilationHook {
   // Gets an std::function that implements this hook.
   static std::function<void(const llvm::object::ObjectFile& obj_file)> Create(
-      const HloModule* module) {
+      const HloModule* module,
+      std::shared_ptr<std::vector<std::string>> obj_files = nullptr) {
     // This struct is not copyable, but std::functions must be.  So to create an
     // std::function out of this struct, we have to wrap it in a shared_ptr.
-    auto wrapped = std::make_shared<OrcJITPostCompilationHook>(module);
+    auto wrapped = std::make_shared<OrcJITPostCompilationHook>(
+        module, std::move(obj_files));
     return [wrapped](const llvm::object::ObjectFile& obj_file) {
       (*wrapped)(obj_file);
     };
@@ -728,11 +767,17 @@ struct OrcJITPostCompilationHook {
 
   // Constructor can't be private because we want to call it from
   // std::make_shared, but users should call Create() instead.
-  explicit OrcJITPostCompilationHook(const HloModule* module)
-      : module(module) {}
+  OrcJITPostCompilationHook(
+      const HloModule* module,
+      std::shared_ptr<std::vector<std::string>> obj_files)
+      : module(module), obj_files(std::move(obj_files)) {}
 
  private:
   void operator()(const llvm::object::ObjectFile& obj_file) {
+    if (obj_files) {
+      obj_files->push_back(std::string(obj_file.getData().data(),
+                                       obj_file.getData().size()));
+    }
     if (!DumpingEnabledForHloModule(*module)) {
       return;
     }
@@ -742,6 +787,7 @@ struct OrcJITPostCompilationHook {
   }
 
   const HloModule* module;
+  std::shared_ptr<std::vector<std::string>> obj_files;
 };
 
 void InitializeLLVMCommandLineOptions(const HloModuleConfig& config) {
@@ -749,6 +795,117 @@ void InitializeLLVMCommandLineOptions(const HloModuleConfig& config) {
       config.debug_options().xla_backend_extra_options());
 }
 
+// Splits `llvm_module` into up to `thread_pool->NumThreads()` modules and
+// optimizes and compiles them to object files concurrently.  Parts are only
+// started at the entry function and at `control_flow_functions`, the while,
+// conditional and call computations, which are called once per iteration
+// rather than once per element.  These are externalized so the JIT can link
+// the object files back together.  All other internal functions, in particular
+// reducers and sort comparators, stay internal and are compiled in the same
+// part as their callers, so that LLVM can still inline them.  Returns an empty
+// vector if the module does not split into at least two parts.
+StatusOr<std::vector<std::unique_ptr<llvm::MemoryBuffer>>>
+CompileModuleInParallel(
+    const HloModuleConfig& config, llvm::Module& llvm_module,
+    absl::Span<llvm::Function* const> control_flow_functions,
+    tensorflow::thread::ThreadPool* thread_pool) {
+  const int num_parts = std::min<int>(thread_pool->NumThreads(),
+                                      control_flow_functions.size() + 1);
+  if (num_parts < 2) {
+    return std::vector<std::unique_ptr<llvm::MemoryBuffer>>();
+  }
+  XLA_SCOPED_LOGGING_TIMER(absl::StrCat("CpuCompiler - Compiling ", num_parts,
+                                        " LLVM modules in parallel"));
+
+  std::vector<llvm::Function*> externalized;
+  for (llvm::Function* function : control_flow_functions) {
+    if (function->hasLocalLinkage()) {
+      function->setLinkage(llvm::GlobalValue::ExternalLinkage);
+      function->setVisibility(llvm::GlobalValue::HiddenVisibility);
+      externalized.push_back(function);
+    }
+  }
+
+  // Each part is handed to its thread as bitcode, so that it can be parsed
+  // into an LLVMContext owned by that thread.  With PreserveLocals, every
+  // internal symbol is placed in the same part as all of its users; parts
+  // left without definitions are dropped.
+  std::vector<std::string> bitcode_parts;
+  llvm::SplitModule(
+      llvm_module, num_parts,
+      [&](std::unique_ptr<llvm::Module> part) {
+        if (llvm::all_of(part->global_values(),
+                         [](const llvm::GlobalValue& value) {
+                           return value.isDeclaration();
+                         })) {
+          return;
+        }
+        std::string bitcode;
+        llvm::raw_string_ostream os(bitcode);
+        llvm::WriteBitcodeToFile(*part, os);
+        os.flush();
+        bitcode_parts.push_back(std::move(bitcode));
+      },
+      /*PreserveLocals=*/true);
+  if (bitcode_parts.size() < 2) {
+    // The control flow computations share internal symbols with the entry
+    // computation.  Restore their linkage for the single module path.
+    for (llvm::Function* function : externalized) {
+      function->setLinkage(llvm::GlobalValue::InternalLinkage);
+      function->setVisibility(llvm::GlobalValue::DefaultVisibility);
+    }
+    return std::vector<std::unique_ptr<llvm::MemoryBuffer>>();
+  }
+
+  std::vector<StatusOr<std::unique_ptr<llvm::MemoryBuffer>>> results(
+      bitcode_parts.size());
+  tensorflow::BlockingCounter counter(bitcode_parts.size());
+  for (int i = 0; i < bitcode_parts.size(); ++i) {
+    thread_pool->Schedule([&config, &bitcode_parts, &results, &counter, i] {
+      llvm::LLVMContext context;
+      llvm::Expected<std::unique_ptr<llvm::Module>> part =
+          llvm::parseBitcodeFile(
+              llvm::MemoryBufferRef(bitcode_parts[i],
+                                    absl::StrCat("__compute_module_", i)),
+              context);
+      if (!part) {
+        results[i] = InternalError("Failed to parse LLVM module part %d: %s",
+                                   i, llvm::toString(part.takeError()));
+        counter.DecrementCount();
+        return;
+      }
+      // llvm::TargetMachine is not thread-safe, so each part gets its own.
+      std::unique_ptr<llvm::TargetMachine> target_machine =
+          SimpleOrcJIT::InferTargetMachineForJIT(CompilerTargetOptions(config),
+                                                 CodeGenOptLevel(config));
+      CompilerFunctor compiler_functor(
+          target_machine.get(), CodeGenOptLevel(config),
+          options::OptimizeForSizeRequested(config),
+          config.debug_options().xla_llvm_disable_expensive_passes(),
+          llvm_ir::GetCpuFastMathFlags(config));
+      llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> obj_file =
+          compiler_functor(**part);
+      if (obj_file) {
+        results[i] = std::move(*obj_file);
+      } else {
+        results[i] = InternalError("Failed to compile LLVM module part %d: %s",
+                                   i, llvm::toString(obj_file.takeError()));
+      }
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> obj_files;
+  obj_files.reserve(results.size());
+  for (auto& result : results) {
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<llvm::MemoryBuffer> obj_file,
+                        std::move(result));
+    obj_files.push_back(std::move(obj_file));
+  }
+  return std::move(obj_files);
+}
+
 }  // namespace
 
 StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
@@ -777,6 +934,12 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
   auto llvm_module =
       absl::make_unique<llvm::Module>("__compute_module", *llvm_context);
 
+  // Object files are only retained on request since they duplicate the code
+  // already loaded into the JIT.
+  std::shared_ptr<std::vector<std::string>> obj_files;
+  if (module->config().debug_options().xla_cpu_retain_object_files()) {
+    obj_files = std::make_shared<std::vector<std::string>>();
+  }
   auto jit = SimpleOrcJIT::Create(
       CompilerTargetOptions(module->config()),
       CodeGenOptLevel(module->config()),
@@ -784,11 +947,17 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
       module->config().debug_options().xla_llvm_disable_expensive_passes(),
       llvm_ir::GetCpuFastMathFlags(module->config()), pre_optimization_ir_hook,
       post_optimization_ir_hook,
-      OrcJITPostCompilationHook::Create(module.get()));
+      OrcJITPostCompilationHook::Create(module.get(), obj_files));
   if (!jit) {
     return InternalError("Creating JIT failed: %s",
                          llvm::toString(jit.takeError()));
   }
+  // The JIT drops its target machine once compilation is done, so grab its
+  // description now.
+  std::string target_triple = (*jit)->target_triple().getTriple();
+  std::string cpu_name = (*jit)->target_machine()->getTargetCPU().str();
+  std::string cpu_features =
+      (*jit)->target_machine()->getTargetFeatureString().str();
   llvm_module->setDataLayout((*jit)->data_layout());
   llvm_module->setTargetTriple((*jit)->target_triple().getTriple());
 
@@ -847,18 +1016,25 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
 
   TF_RETURN_IF_ERROR(ir_emitter.EmitConstantGlobals());
 
+  // Functions of control flow computations may be compiled apart from their
+  // callers when generating code in parallel.
+  std::unique_ptr<CallGraph> call_graph = CallGraph::Build(module.get());
+  std::vector<llvm::Function*> control_flow_functions;
   for (auto embedded_computation :
        entry_computation->MakeEmbeddedComputationsList()) {
     if (embedded_computation->IsFusionComputation()) {
       continue;
     }
-    TF_RETURN_IF_ERROR(
-        ir_emitter
-            .EmitComputation(
-                embedded_computation, embedded_computation->name(),
-                /*is_top_level_computation=*/false,
-                schedule.sequence(embedded_computation).instructions())
-            .status());
+    TF_ASSIGN_OR_RETURN(
+        llvm::Function * function,
+        ir_emitter.EmitComputation(
+            embedded_computation, embedded_computation->name(),
+            /*is_top_level_computation=*/false,
+            schedule.sequence(embedded_computation).instructions()));
+    if (call_graph->GetNode(embedded_computation).context() ==
+        CallContext::kControlFlow) {
+      control_flow_functions.push_back(function);
+    }
   }
   std::string function_name_prefix = entry_computation->name().empty()
                                          ? "__compute"
@@ -884,10 +1060,55 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
 
   TF_RETURN_IF_ERROR(VerifyLlvmModule(*llvm_module));
 
-  // JIT compile the LLVM IR module to in-memory machine code.
-  llvm::orc::ThreadSafeModule thread_safe_module(std::move(llvm_module),
-                                                 std::move(llvm_context));
-  cantFail((*jit)->AddModule(std::move(thread_safe_module)));
+  tensorflow::thread::ThreadPool* thread_pool;
+  absl::optional<tensorflow::thread::ThreadPool> overriding_thread_pool;
+  switch (module->config()
+              .debug_options()
+              .xla_cpu_force_compilation_parallelism()) {
+    case 0:
+      thread_pool = options.thread_pool;
+      break;
+    case 1:
+      thread_pool = nullptr;
+      break;
+    default:
+      overriding_thread_pool.emplace(
+          tensorflow::Env::Default(), "xla_cpu_codegen",
+          module->config()
+              .debug_options()
+              .xla_cpu_force_compilation_parallelism());
+      thread_pool = &*overriding_thread_pool;
+      break;
+  }
+
+  // Parallel code generation bypasses the JIT's compile layer and so never
+  // shows the whole optimized module to the IR hooks; keep compilations that
+  // observe the IR on the single module path.
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> parallel_obj_files;
+  if (thread_pool != nullptr && !user_pre_optimization_hook_ &&
+      !user_post_optimization_hook_ && !DumpingEnabledForHloModule(*module)) {
+    TF_ASSIGN_OR_RETURN(
+        parallel_obj_files,
+        CompileModuleInParallel(module->config(), *llvm_module,
+                                control_flow_functions, thread_pool));
+  }
+
+  if (parallel_obj_files.empty()) {
+    // JIT compile the LLVM IR module to in-memory machine code.
+    llvm::orc::ThreadSafeModule thread_safe_module(std::move(llvm_module),
+                                                   std::move(llvm_context));
+    cantFail((*jit)->AddModule(std::move(thread_safe_module)));
+  } else {
+    for (std::unique_ptr<llvm::MemoryBuffer>& obj_file : parallel_obj_files) {
+      if (obj_files) {
+        obj_files->push_back(obj_file->getBuffer().str());
+      }
+      if (llvm::Error error = (*jit)->AddObjectFile(std::move(obj_file))) {
+        return InternalError("Adding object file to the JIT failed: %s",
+                             llvm::toString(std::move(error)));
+      }
+    }
+  }
 
   auto cpu_executable = absl::make_unique<CpuExecutable>(
       std::move(*jit), std::move(assignment), std::move(module), function_name,
@@ -897,6 +1118,14 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
     cpu_executable->set_ir_module_string(ir_module_string);
   }
 
+  // The CpuExecutable constructor looks up the entry function, which forces
+  // the JIT to generate code, so the object files are complete at this point.
+  if (obj_files) {
+    cpu_executable->set_obj_files(std::move(*obj_files));
+  }
+  cpu_executable->set_target_machine_description(
+      std::move(target_triple), std::move(cpu_name), std::move(cpu_features));
+
   // Dump computation proto state and buffer assignment for debug and test, if
   // dump or embed_ir_in_executable is enabled.
   if (embed_ir_in_executable ||
@@ -1146,6 +1375,126 @@ CpuCompiler::CompileAheadOfTime(std::unique_ptr<HloModuleGroup> module_group,
   return std::move(results);
 }
 
+StatusOr<std::unique_ptr<AotCompilationResult>> CpuCompiler::Export(
+    Executable* executable) const {
+  auto* cpu_executable = tensorflow::down_cast<CpuExecutable*>(executable);
+  if (cpu_executable->obj_files().empty()) {
+    return FailedPrecondition(
+        "Cannot export CPU executable %s: its object files were not retained; "
+        "compile with xla_cpu_retain_object_files.",
+        cpu_executable->module().name());
+  }
+  if (cpu_executable->module().config().hlo_profiling_enabled()) {
+    return Unimplemented("Exporting CPU executables with HLO profiling.");
+  }
+  CpuExecutableProto proto;
+  *proto.mutable_hlo_module_proto() = cpu_executable->module().ToProto();
+  *proto.mutable_buffer_assignment() =
+      cpu_executable->buffer_assignment().ToProto();
+  for (const std::string& obj_file : cpu_executable->obj_files()) {
+    proto.add_obj_files(obj_file);
+  }
+  proto.set_entry_function_name(cpu_executable->entry_function_name());
+  proto.set_target_triple(cpu_executable->target_triple());
+  proto.set_cpu_name(cpu_executable->cpu_name());
+  proto.set_cpu_features(cpu_executable->cpu_features());
+  return std::unique_ptr<AotCompilationResult>(
+      absl::make_unique<CpuExecutableAotCompilationResult>(std::move(proto)));
+}
+
+StatusOr<std::unique_ptr<AotCompilationResult>>
+CpuCompiler::LoadAotCompilationResult(
+    const std::string& serialized_aot_result) {
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<AotCompilationResult> aot_result,
+      CpuExecutableAotCompilationResult::FromString(serialized_aot_result));
+  return aot_result;
+}
+
+StatusOr<std::unique_ptr<Executable>>
+CpuExecutableAotCompilationResult::LoadExecutable(
+    Compiler* compiler, se::StreamExecutor* /*executor*/) const {
+  TF_ASSIGN_OR_RETURN(
+      HloModuleConfig module_config,
+      HloModule::CreateModuleConfigFromProto(proto_.hlo_module_proto(),
+                                             GetDebugOptionsFromFlags()));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<HloModule> module,
+      HloModule::CreateFromProto(proto_.hlo_module_proto(), module_config));
+
+  // Scheduling and buffer assignment are deterministic for a given optimized
+  // module, so recomputing them must reproduce the buffer table the object
+  // code indexes into. Check this rather than trusting it.
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<BufferAssignment> assignment,
+                      compiler->AssignBuffers(module.get()));
+  const BufferAssignmentProto assignment_proto = assignment->ToProto();
+  const BufferAssignmentProto& expected = proto_.buffer_assignment();
+  if (assignment_proto.buffer_allocations_size() !=
+      expected.buffer_allocations_size()) {
+    return FailedPrecondition(
+        "Buffer assignment of reloaded module %s has %d allocations, expected "
+        "%d.",
+        module->name(), assignment_proto.buffer_allocations_size(),
+        expected.buffer_allocations_size());
+  }
+  for (int i = 0; i < expected.buffer_allocations_size(); ++i) {
+    if (!protobuf_util::ProtobufEquals(assignment_proto.buffer_allocations(i),
+                                       expected.buffer_allocations(i))) {
+      return FailedPrecondition(
+          "Buffer allocation %d of reloaded module %s does not match the one "
+          "the object code was compiled against.",
+          i, module->name());
+    }
+  }
+
+  auto jit = SimpleOrcJIT::Create(
+      CompilerTargetOptions(module->config()),
+      CodeGenOptLevel(module->config()),
+      options::OptimizeForSizeRequested(module->config()),
+      module->config().debug_options().xla_llvm_disable_expensive_passes(),
+      llvm_ir::GetCpuFastMathFlags(module->config()),
+      /*pre_optimization_hook=*/nullptr, /*post_optimization_hook=*/nullptr,
+      /*post_codegen_hook=*/nullptr);
+  if (!jit) {
+    return InternalError("Creating JIT failed: %s",
+                         llvm::toString(jit.takeError()));
+  }
+  std::string target_triple = (*jit)->target_triple().getTriple();
+  std::string cpu_name = (*jit)->target_machine()->getTargetCPU().str();
+  std::string cpu_features =
+      (*jit)->target_machine()->getTargetFeatureString().str();
+  if (target_triple != proto_.target_triple() ||
+      cpu_name != proto_.cpu_name() || cpu_features != proto_.cpu_features()) {
+    return FailedPrecondition(
+        "Object code for %s was compiled for %s (%s, %s), but the host is %s "
+        "(%s, %s).",
+        module->name(), proto_.target_triple(), proto_.cpu_name(),
+        proto_.cpu_features(), target_triple, cpu_name, cpu_features);
+  }
+
+  for (const std::string& obj_file : proto_.obj_files()) {
+    llvm::Error error = (*jit)->AddObjectFile(
+        llvm::MemoryBuffer::getMemBufferCopy(obj_file, module->name()));
+    if (error) {
+      return InternalError("Loading object file for %s failed: %s",
+                           module->name(), llvm::toString(std::move(error)));
+    }
+  }
+
+  auto cpu_executable = absl::make_unique<CpuExecutable>(
+      std::move(*jit), std::move(assignment), std::move(module),
+      proto_.entry_function_name(),
+      /*hlo_profile_printer_data=*/nullptr,
+      /*hlo_profile_index_map=*/nullptr);
+  cpu_executable->set_obj_files(
+      {proto_.obj_files().begin(), proto_.obj_files().end()});
+  cpu_executable->set_target_machine_description(
+      std::move(target_triple), std::move(cpu_name), std::move(cpu_features));
+  cpu_executable->set_debug_info(
+      cpu_executable->buffer_assignment().GetStats().ToString());
+  return std::unique_ptr<Executable>(std::move(cpu_executable));
+}
+
 se::Platform::Id CpuCompiler::PlatformId() const {
   return se::host::kHostPlatformId;
 }
@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/cpu_function_runtime.h"
 #include "tensorflow/compiler/xla/service/cpu/target_machine_features.h"
 #include "tensorflow/compiler/xla/service/executable.h"
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/llvm_compiler.h"
 #include "tensorflow/compiler/xla/statusor.h"
@@ -114,6 +115,40 @@ class CpuAotCompilationResult : public AotCompilationResult {
   std::unique_ptr<HloProfilePrinterData> hlo_profile_printer_data_;
 };
 
+// The result of exporting a JIT-compiled CpuExecutable: the object code the
+// JIT produced plus everything needed to rebuild the executable around it.
+class CpuExecutableAotCompilationResult : public AotCompilationResult {
+ public:
+  static StatusOr<std::unique_ptr<CpuExecutableAotCompilationResult>>
+  FromString(const std::string& serialized) {
+    CpuExecutableProto proto;
+    if (!proto.ParseFromString(serialized)) {
+      return InternalError("Failed to parse serialized CpuExecutableProto.");
+    }
+    return std::unique_ptr<CpuExecutableAotCompilationResult>(
+        new CpuExecutableAotCompilationResult(std::move(proto)));
+  }
+
+  explicit CpuExecutableAotCompilationResult(CpuExecutableProto proto)
+      : proto_(std::move(proto)) {}
+  ~CpuExecutableAotCompilationResult() override = default;
+
+  StatusOr<std::string> SerializeAsString() const override {
+    return proto_.SerializeAsString();
+  }
+
+  // Rebuilds the executable by loading the serialized object files into a new
+  // JIT. Fails if the host's target machine or the recomputed buffer
+  // assignment differ from the ones the object code was generated against.
+  StatusOr<std::unique_ptr<Executable>> LoadExecutable(
+      Compiler* compiler, se::StreamExecutor* executor) const override;
+
+  const CpuExecutableProto& proto() const { return proto_; }
+
+ private:
+  CpuExecutableProto proto_;
+};
+
 // CPU-targeting implementation of the XLA Compiler interface.
 //
 // The compiler translates XLA HLO code into LLVM IR and uses LLVM's JIT
@@ -144,6 +179,14 @@ class CpuCompiler : public LLVMCompiler {
   CompileAheadOfTime(std::unique_ptr<HloModuleGroup> module_group,
                      const AotCompilationOptions& options) override;
 
+  // Exports a CpuExecutable built by RunBackend. The executable's module must
+  // have been compiled with xla_cpu_retain_object_files set.
+  StatusOr<std::unique_ptr<AotCompilationResult>> Export(
+      Executable* executable) const override;
+
+  StatusOr<std::unique_ptr<AotCompilationResult>> LoadAotCompilationResult(
+      const std::string& serialized_aot_result) override;
+
   se::Platform::Id PlatformId() const override;
 
   HloCostAnalysis::ShapeSizeFunction ShapeSizeBytesFunction() const override;
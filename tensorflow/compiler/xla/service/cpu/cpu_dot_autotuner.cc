@@ -0,0 +1,342 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/compiler/xla/service/cpu/cpu_dot_autotuner.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/cleanup/cleanup.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/compiler/xla/executable_run_options.h"
+#include "tensorflow/compiler/xla/service/computation_layout.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_executable.h"
+#include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
+#include "tensorflow/compiler/xla/service/custom_call_status_internal.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+namespace xla {
+namespace cpu {
+
+namespace {
+
+// Tile sizes tried for tiled LLVM IR GEMMs, as (m, k, n in vector registers).
+// The first one is the default of DotOpEmitter.
+constexpr std::array<std::array<int64_t, 3>, 4> kTileSizes = {{
+    {11, 9, 1},
+    {8, 8, 1},
+    {4, 8, 2},
+    {8, 4, 2},
+}};
+
+// Every candidate runs once to warm up caches and then this many times, and
+// its fastest run counts.
+constexpr int kNumRuns = 5;
+
+// Buffers are aligned like the allocations of CpuExecutable.
+constexpr int kBufferAlignment = 64;
+
+absl::Mutex cache_mu(absl::kConstInit);
+// Autotuning results by CacheKey().
+auto& cache ABSL_GUARDED_BY(cache_mu) =
+    *new absl::flat_hash_map<std::string, DotAutotuneResults::Entry>();
+// Results files that have been loaded into `cache`.
+auto& loaded_paths ABSL_GUARDED_BY(cache_mu) =
+    *new absl::flat_hash_set<std::string>();
+
+std::string CacheKey(const DotAutotuneResults::Entry& entry) {
+  return absl::StrCat(entry.cpu(), "|", entry.target_features(), "|",
+                      entry.dot());
+}
+
+int MaxParallelism(const HloModuleConfig& config) {
+  return config.intra_op_parallelism_threads() > 0
+             ? config.intra_op_parallelism_threads()
+             : tensorflow::port::NumSchedulableCPUs();
+}
+
+// Identifies `dot` by everything that its run time depends on.
+std::string DotKey(const HloInstruction& dot) {
+  const HloModuleConfig& config = dot.GetModule()->config();
+  return absl::StrCat(
+      ShapeUtil::HumanStringWithLayout(dot.operand(0)->shape()), ", ",
+      ShapeUtil::HumanStringWithLayout(dot.operand(1)->shape()), " -> ",
+      ShapeUtil::HumanStringWithLayout(dot.shape()), ", ",
+      dot.dot_dimension_numbers().ShortDebugString(), ", multi_thread_eigen=",
+      config.debug_options().xla_cpu_multi_thread_eigen(),
+      ", threads=", MaxParallelism(config));
+}
+
+// Adds the results in `path`, if it exists, to `cache`.  Results that are
+// already cached are kept.
+Status ReadResults(const std::string& path)
+    ABSL_EXCLUSIVE_LOCKS_REQUIRED(cache_mu) {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  if (!env->FileExists(path).ok()) {
+    return Status::OK();
+  }
+  DotAutotuneResults results;
+  TF_RETURN_IF_ERROR(tensorflow::ReadTextProto(env, path, &results));
+  for (const DotAutotuneResults::Entry& entry : results.entries()) {
+    cache.emplace(CacheKey(entry), entry);
+  }
+  VLOG(1) << "Read " << results.entries_size()
+          << " dot autotuning results from " << path;
+  return Status::OK();
+}
+
+Status LoadResults(const std::string& path)
+    ABSL_EXCLUSIVE_LOCKS_REQUIRED(cache_mu) {
+  if (!loaded_paths.insert(path).second) {
+    return Status::OK();
+  }
+  return ReadResults(path);
+}
+
+Status SaveResults(const std::string& path)
+    ABSL_EXCLUSIVE_LOCKS_REQUIRED(cache_mu) {
+  // Keep the results other processes saved since the file was loaded.
+  TF_RETURN_IF_ERROR(ReadResults(path));
+
+  std::vector<const std::string*> keys;
+  for (const auto& it : cache) {
+    keys.push_back(&it.first);
+  }
+  // Sort the entries to keep the file stable across runs.
+  std::sort(keys.begin(), keys.end(),
+            [](const std::string* a, const std::string* b) { return *a < *b; });
+  DotAutotuneResults results;
+  for (const std::string* key : keys) {
+    *results.add_entries() = cache.at(*key);
+  }
+
+  // Write to a temporary file first, so that processes loading the results
+  // concurrently never see a partially written file.
+  tensorflow::Env* env = tensorflow::Env::Default();
+  std::string tmp_path = path;
+  if (!env->CreateUniqueFileName(&tmp_path, ".tmp")) {
+    return InternalError("Failed to create a temporary file name for %s",
+                         path);
+  }
+  TF_RETURN_IF_ERROR(tensorflow::WriteTextProto(env, tmp_path, results));
+  return env->RenameFile(tmp_path, path);
+}
+
+// Returns a module that computes `dot` of its two parameters, implemented as
+// `config`.
+std::unique_ptr<HloModule> MakeDotModule(const HloInstruction& dot,
+                                         const DotBackendConfig& config) {
+  HloComputation::Builder builder("dot_autotune");
+  HloInstruction* lhs = builder.AddInstruction(
+      HloInstruction::CreateParameter(0, dot.operand(0)->shape(), "lhs"));
+  HloInstruction* rhs = builder.AddInstruction(
+      HloInstruction::CreateParameter(1, dot.operand(1)->shape(), "rhs"));
+  HloInstruction* new_dot = builder.AddInstruction(
+      dot.CloneWithNewOperands(dot.shape(), {lhs, rhs}));
+  TF_CHECK_OK(new_dot->set_backend_config(config));
+  std::unique_ptr<HloComputation> computation = builder.Build();
+
+  // Keep the layouts of the original dot.
+  const HloModuleConfig& original_config = dot.GetModule()->config();
+  HloModuleConfig module_config(computation->ComputeProgramShape(),
+                                /*ignore_layouts=*/false);
+  DebugOptions debug_options = original_config.debug_options();
+  debug_options.set_xla_cpu_enable_dot_autotuning(false);
+  debug_options.set_xla_dump_to("");
+  module_config.set_debug_options(debug_options);
+  module_config.set_intra_op_parallelism_threads(
+      original_config.intra_op_parallelism_threads());
+
+  auto module = absl::make_unique<HloModule>("dot_autotune", module_config);
+  module->AddEntryComputation(std::move(computation));
+  return module;
+}
+
+}  // namespace
+
+/*static*/ void CpuDotAutotuner::ClearCache() {
+  absl::MutexLock lock(&cache_mu);
+  cache.clear();
+  loaded_paths.clear();
+}
+
+StatusOr<int64_t> CpuDotAutotuner::Measure(
+    const HloInstruction& dot, const DotBackendConfig& config,
+    const Eigen::ThreadPoolDevice* device) {
+  TF_ASSIGN_OR_RETURN(std::unique_ptr<Executable> executable,
+                      compile_(MakeDotModule(dot, config)));
+  auto* cpu_executable = static_cast<CpuExecutable*>(executable.get());
+
+  // Allocate every buffer the executable uses.  The values of the parameters
+  // do not affect the run time, so they are only zeroed.
+  const BufferAssignment& assignment = cpu_executable->buffer_assignment();
+  std::vector<void*> buffers(assignment.Allocations().size(), nullptr);
+  auto free_buffers = absl::MakeCleanup([&buffers] {
+    for (void* buffer : buffers) {
+      tensorflow::port::AlignedFree(buffer);
+    }
+  });
+  for (const BufferAllocation& allocation : assignment.Allocations()) {
+    if (allocation.is_constant() || allocation.is_thread_local()) {
+      continue;
+    }
+    void* buffer = tensorflow::port::AlignedMalloc(
+        std::max<int64_t>(allocation.size(), 1), kBufferAlignment);
+    TF_RET_CHECK(buffer != nullptr);
+    std::memset(buffer, 0, allocation.size());
+    buffers[allocation.index()] = buffer;
+  }
+
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(device);
+  XlaCustomCallStatus status;
+  auto run = [&] {
+    cpu_executable->compute_function()(nullptr, &run_options, nullptr,
+                                       buffers.data(), &status, nullptr);
+  };
+
+  run();
+  tensorflow::Env* env = tensorflow::Env::Default();
+  int64_t best_run_time = std::numeric_limits<int64_t>::max();
+  for (int i = 0; i < kNumRuns; ++i) {
+    uint64_t start_nanos = env->NowNanos();
+    run();
+    best_run_time = std::min<int64_t>(best_run_time,
+                                      env->NowNanos() - start_nanos);
+  }
+  if (absl::optional<absl::string_view> message =
+          CustomCallStatusGetMessage(&status)) {
+    return InternalError("Failed to run %s: %s", dot.ToString(), *message);
+  }
+  return best_run_time;
+}
+
+StatusOr<DotAutotuneResults::Entry> CpuDotAutotuner::Autotune(
+    const HloInstruction& dot, const Eigen::ThreadPoolDevice* device) {
+  std::vector<DotBackendConfig> candidates(1);
+  candidates.back().set_strategy(DotBackendConfig::EIGEN);
+  if (DotImplementationCanUseTiledLlvmIrGemm(dot, target_machine_features_)) {
+    for (const std::array<int64_t, 3>& tile_size : kTileSizes) {
+      DotBackendConfig& config = candidates.emplace_back();
+      config.set_strategy(DotBackendConfig::TILED_LLVM_IR_GEMM);
+      config.set_tile_size_m(tile_size[0]);
+      config.set_tile_size_k(tile_size[1]);
+      config.set_tile_size_n_in_vector_width(tile_size[2]);
+    }
+  }
+
+  DotAutotuneResults::Entry best;
+  best.set_run_time_ns(std::numeric_limits<int64_t>::max());
+  for (const DotBackendConfig& config : candidates) {
+    TF_ASSIGN_OR_RETURN(int64_t run_time, Measure(dot, config, device));
+    VLOG(2) << dot.name() << ": " << config.ShortDebugString() << " took "
+            << run_time << "ns";
+    if (run_time < best.run_time_ns()) {
+      *best.mutable_config() = config;
+      best.set_run_time_ns(run_time);
+    }
+  }
+  return best;
+}
+
+StatusOr<bool> CpuDotAutotuner::Run(HloModule* module) {
+  const std::string& path =
+      module->config().debug_options().xla_cpu_dot_autotune_results_path();
+  if (!path.empty()) {
+    absl::MutexLock lock(&cache_mu);
+    TF_RETURN_IF_ERROR(LoadResults(path));
+  }
+
+  // Candidates run on their own pool, with the parallelism the module will
+  // have at run time.
+  std::unique_ptr<tensorflow::thread::ThreadPool> pool;
+  std::unique_ptr<Eigen::ThreadPoolDevice> device;
+
+  bool changed = false;
+  bool measured = false;
+  for (HloComputation* computation : module->MakeNonfusionComputations()) {
+    for (HloInstruction* instr : computation->instructions()) {
+      if (instr->opcode() != HloOpcode::kDot ||
+          !DotImplementationCanBeAutotuned(*instr, target_machine_features_)) {
+        continue;
+      }
+      DotAutotuneResults::Entry key;
+      key.set_cpu(cpu_);
+      key.set_target_features(target_features_);
+      key.set_dot(DotKey(*instr));
+
+      absl::optional<DotAutotuneResults::Entry> entry;
+      {
+        absl::MutexLock lock(&cache_mu);
+        auto it = cache.find(CacheKey(key));
+        if (it != cache.end()) {
+          entry = it->second;
+        }
+      }
+      if (!entry) {
+        if (!pool) {
+          pool = absl::make_unique<tensorflow::thread::ThreadPool>(
+              tensorflow::Env::Default(), "xla_cpu_dot_autotuner",
+              MaxParallelism(module->config()));
+          device = absl::make_unique<Eigen::ThreadPoolDevice>(
+              pool->AsEigenThreadPool(), pool->NumThreads());
+        }
+        // The lock is not held while measuring, so concurrent compilations
+        // may measure the same dot; the first result wins.
+        TF_ASSIGN_OR_RETURN(entry, Autotune(*instr, device.get()));
+        entry->set_cpu(key.cpu());
+        entry->set_target_features(key.target_features());
+        entry->set_dot(key.dot());
+        absl::MutexLock lock(&cache_mu);
+        entry = cache.emplace(CacheKey(key), *std::move(entry)).first->second;
+        measured = true;
+      }
+      VLOG(1) << "Implementing " << instr->name() << " as "
+              << entry->config().ShortDebugString();
+      TF_RETURN_IF_ERROR(instr->set_backend_config(entry->config()));
+      changed = true;
+    }
+  }
+
+  if (measured && !path.empty()) {
+    absl::MutexLock lock(&cache_mu);
+    TF_RETURN_IF_ERROR(SaveResults(path));
+  }
+  return changed;
+}
+
+}  // namespace cpu
+}  // namespace xla
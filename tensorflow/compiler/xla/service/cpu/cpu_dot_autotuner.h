@@ -0,0 +1,90 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_DOT_AUTOTUNER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_DOT_AUTOTUNER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/compiler/xla/service/cpu/backend_config.pb.h"
+#include "tensorflow/compiler/xla/service/cpu/target_machine_features.h"
+#include "tensorflow/compiler/xla/service/executable.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace Eigen {
+struct ThreadPoolDevice;
+}  // namespace Eigen
+
+namespace xla {
+namespace cpu {
+
+// Picks the implementation of every matrix-matrix dot in a module by compiling
+// and timing the candidates on the host: a call into Eigen, and tiled LLVM IR
+// GEMMs with a few different tile sizes.  The fastest candidate is recorded in
+// the DotBackendConfig of the dot, which DotOpEmitter follows.
+//
+// Dots are identified by their shapes, layouts, dimension numbers and threading
+// options, and results are cached per target CPU for the lifetime of the
+// process.  If xla_cpu_dot_autotune_results_path is set, results are also
+// loaded from and saved to that file, so that each dot is only measured once
+// per CPU model.
+class CpuDotAutotuner : public HloModulePass {
+ public:
+  // Compiles a module for the host.  The modules passed to it have dot
+  // autotuning disabled.
+  using CompileFn = std::function<StatusOr<std::unique_ptr<Executable>>(
+      std::unique_ptr<HloModule>)>;
+
+  // `cpu` and `target_features` identify the host in the results cache.
+  CpuDotAutotuner(CompileFn compile, std::string cpu,
+                  std::string target_features,
+                  const TargetMachineFeatures* target_machine_features)
+      : compile_(std::move(compile)),
+        cpu_(std::move(cpu)),
+        target_features_(std::move(target_features)),
+        target_machine_features_(*target_machine_features) {}
+
+  absl::string_view name() const override { return "cpu-dot-autotuner"; }
+
+  StatusOr<bool> Run(HloModule* module) override;
+
+  // Forgets all results, including the ones loaded from results files.
+  static void ClearCache();
+
+ private:
+  // Measures all candidates for `dot` and returns the fastest.
+  StatusOr<DotAutotuneResults::Entry> Autotune(
+      const HloInstruction& dot, const Eigen::ThreadPoolDevice* device);
+
+  // Returns the run time in nanoseconds of `dot` implemented as `config`.
+  StatusOr<int64_t> Measure(const HloInstruction& dot,
+                            const DotBackendConfig& config,
+                            const Eigen::ThreadPoolDevice* device);
+
+  CompileFn compile_;
+  std::string cpu_;
+  std::string target_features_;
+  const TargetMachineFeatures& target_machine_features_;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_DOT_AUTOTUNER_H_
@@ -27,6 +27,7 @@ limitations under the License.
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "tensorflow/compiler/xla/cpu_function_runtime.h"
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
 #include "tensorflow/compiler/xla/service/computation_layout.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
@@ -70,9 +71,11 @@ CpuExecutable::CpuExecutable(
                  std::move(hlo_profile_index_map)),
       jit_(std::move(jit)),
       assignment_(std::move(assignment)),
-      module_name_(entry_function_name) {
+      module_name_(entry_function_name),
+      entry_function_name_(entry_function_name) {
   if (assignment_) {
     buffer_assignment_.reset(new BufferAssignmentProto(assignment_->ToProto()));
+    InitTempArenaPool();
   }
   XlaDebugInfoManager::Get()->RegisterModule(
       ModuleUniqueName(module_name_, shared_module().get()), shared_module(),
@@ -99,6 +102,44 @@ CpuExecutable::~CpuExecutable() {
       buffer_assignment_);
 }
 
+// Returns true if `allocation` only holds values that are dead once the
+// computation returns, so its memory can be reused by the next execution.
+static bool IsTempAllocation(const BufferAllocation& allocation) {
+  return !allocation.is_entry_computation_parameter() &&
+         !allocation.is_constant() && !allocation.is_thread_local() &&
+         !allocation.maybe_live_out();
+}
+
+void CpuExecutable::InitTempArenaPool() {
+  const DebugOptions& debug_options = module().config().debug_options();
+  const int64_t max_retained_bytes =
+      debug_options.xla_cpu_max_retained_temp_buffer_bytes();
+  if (max_retained_bytes <= 0) {
+    return;
+  }
+
+  std::vector<int64_t> offsets(assignment_->Allocations().size(), -1);
+  int64_t arena_bytes = 0;
+  for (const BufferAllocation& allocation : assignment_->Allocations()) {
+    if (!IsTempAllocation(allocation) || allocation.size() == 0) {
+      continue;
+    }
+    offsets[allocation.index()] = arena_bytes;
+    arena_bytes += RoundUpTo<int64_t>(allocation.size(),
+                                      cpu_function_runtime::Align());
+  }
+  // Executables whose temporaries don't fit even a single arena allocate them
+  // per execution as before.
+  if (arena_bytes == 0 || arena_bytes > max_retained_bytes) {
+    return;
+  }
+  VLOG(2) << "Reusing " << arena_bytes << " bytes of temporary buffers across "
+          << "executions of " << module().name();
+  temp_buffer_offsets_ = std::move(offsets);
+  temp_arena_pool_ = TempArenaPool::Create(
+      arena_bytes, cpu_function_runtime::Align(), max_retained_bytes);
+}
+
 static StatusOr<MaybeOwningDeviceMemory> MemoryForAllocation(
     const BufferAllocation& allocation,
     absl::Span<ExecutionInput const> arguments,
@@ -137,7 +178,7 @@ static StatusOr<MaybeOwningDeviceMemory> MemoryForAllocation(
 
 StatusOr<std::vector<MaybeOwningDeviceMemory>> CpuExecutable::CreateBufferTable(
     se::DeviceMemoryAllocator* memory_allocator, int device_ordinal,
-    absl::Span<ExecutionInput const> arguments) {
+    absl::Span<ExecutionInput const> arguments, char* temp_arena) {
   std::vector<MaybeOwningDeviceMemory> buffers(
       assignment_->Allocations().size());
   VLOG(3) << "Allocating " << assignment_->Allocations().size()
@@ -145,6 +186,16 @@ StatusOr<std::vector<MaybeOwningDeviceMemory>> CpuExecutable::CreateBufferTable(
   for (BufferAllocation::Index i = 0; i < assignment_->Allocations().size();
        ++i) {
     const BufferAllocation& allocation = assignment_->GetAllocation(i);
+    if (temp_arena != nullptr && temp_buffer_offsets_[i] >= 0) {
+      char* buffer = temp_arena + temp_buffer_offsets_[i];
+      VLOG(3) << "buffer placed in temp arena " << allocation.size()
+              << " bytes [" << static_cast<void*>(buffer) << "]";
+      // The arena was last written by JITed code, see MemoryForAllocation.
+      ABSL_ANNOTATE_MEMORY_IS_INITIALIZED(buffer, allocation.size());
+      buffers[i] = MaybeOwningDeviceMemory{
+          se::DeviceMemoryBase(buffer, allocation.size())};
+      continue;
+    }
     TF_ASSIGN_OR_RETURN(
         buffers[i], MemoryForAllocation(allocation, arguments, memory_allocator,
                                         device_ordinal));
@@ -355,10 +406,14 @@ StatusOr<ExecutionOutput> CpuExecutable::ExecuteAsyncOnStream(
       run_options->stream()->implementation());
   se::Stream* stream = run_options->stream();
   se::DeviceMemoryAllocator* memory_allocator = run_options->allocator();
+  TempArenaPool::Arena temp_arena;
+  if (temp_arena_pool_) {
+    TF_ASSIGN_OR_RETURN(temp_arena, temp_arena_pool_->Acquire());
+  }
   TF_ASSIGN_OR_RETURN(
       std::vector<MaybeOwningDeviceMemory> buffers,
       CreateBufferTable(memory_allocator, stream->parent()->device_ordinal(),
-                        arguments));
+                        arguments, temp_arena.get()));
 
   TF_ASSIGN_OR_RETURN(
       ExecutionOutput result,
@@ -374,11 +429,15 @@ StatusOr<ExecutionOutput> CpuExecutable::ExecuteAsyncOnStream(
   // run_options needs to change from a pointer to a value type, and arguments
   // needs to change from a Span into a vector.  We use a struct instead
   // of a lambda to make this explicit.
+  //
+  // The temp arena goes back to the pool once the task has run and is
+  // destroyed by the stream.
   struct AsyncRunTask {
     CpuExecutable* executable;
     ServiceExecutableRunOptions run_options;
     std::shared_ptr<std::vector<MaybeOwningDeviceMemory>> task_buffers;
     HloExecutionProfile* hlo_execution_profile;
+    TempArenaPool::Arena temp_arena;
 
     Status operator()() {
       return executable->ExecuteComputeFunction(
@@ -389,7 +448,7 @@ StatusOr<ExecutionOutput> CpuExecutable::ExecuteAsyncOnStream(
       AsyncRunTask{this, *run_options,
                    std::make_shared<std::vector<MaybeOwningDeviceMemory>>(
                        std::move(buffers)),
-                   hlo_execution_profile});
+                   hlo_execution_profile, std::move(temp_arena)});
 
   MarkToBeReleasedArguments(absl::MakeSpan(arguments), result);
   return std::move(result);
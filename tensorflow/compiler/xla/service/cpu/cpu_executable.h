@@ -24,6 +24,7 @@ limitations under the License.
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
 #include "tensorflow/compiler/xla/service/cpu/simple_orc_jit.h"
+#include "tensorflow/compiler/xla/service/cpu/temp_arena_pool.h"
 #include "tensorflow/compiler/xla/service/custom_call_status_internal.h"
 #include "tensorflow/compiler/xla/service/executable.h"
 #include "tensorflow/compiler/xla/service/hlo_dataflow_analysis.h"
@@ -86,9 +87,39 @@ class CpuExecutable : public Executable {
 
   const BufferAssignment& buffer_assignment() const { return *assignment_; }
 
+  const std::string& entry_function_name() const {
+    return entry_function_name_;
+  }
+
+  // Object files the JIT compiled this executable into. Only populated when
+  // the module was compiled with xla_cpu_retain_object_files.
+  const std::vector<std::string>& obj_files() const { return obj_files_; }
+
+  void set_obj_files(std::vector<std::string> obj_files) {
+    obj_files_ = std::move(obj_files);
+  }
+
+  // Description of the target machine the object files were generated for.
+  const std::string& target_triple() const { return target_triple_; }
+  const std::string& cpu_name() const { return cpu_name_; }
+  const std::string& cpu_features() const { return cpu_features_; }
+
+  void set_target_machine_description(std::string target_triple,
+                                      std::string cpu_name,
+                                      std::string cpu_features) {
+    target_triple_ = std::move(target_triple);
+    cpu_name_ = std::move(cpu_name);
+    cpu_features_ = std::move(cpu_features);
+  }
+
   int64_t SizeOfGeneratedCodeInBytes() const override;
 
  private:
+  // Lays out the temporary buffers of the computation in one arena and creates
+  // `temp_arena_pool_`, unless xla_cpu_max_retained_temp_buffer_bytes is too
+  // small to hold an arena.
+  void InitTempArenaPool();
+
   // Creates an array suitable for passing as the "buffer_table" argument to the
   // JIT compiled function pointer.
   //
@@ -106,9 +137,12 @@ class CpuExecutable : public Executable {
   //
   //  - buffers_to_free: buffers whose ownership was donated by the caller that
   //    are to be freed by the caller.
+  //
+  // If `temp_arena` is not null, temporary buffers are placed into it at
+  // `temp_buffer_offsets_` instead of being allocated one by one.
   StatusOr<std::vector<MaybeOwningDeviceMemory>> CreateBufferTable(
       se::DeviceMemoryAllocator* memory_allocator, int device_ordinal,
-      absl::Span<ExecutionInput const> arguments);
+      absl::Span<ExecutionInput const> arguments, char* temp_arena);
 
   // Creates an Execution output holding ScopedShapedBuffer for holding the
   // result of the computation, moving buffers out of allocated_buffers and into
@@ -131,6 +165,15 @@ class CpuExecutable : public Executable {
 
   std::shared_ptr<const BufferAssignmentProto> buffer_assignment_;
 
+  // Offset of each allocation in a temp arena, indexed by allocation index, or
+  // -1 for allocations that are not temporary buffers.  Only set if
+  // `temp_arena_pool_` is.
+  std::vector<int64_t> temp_buffer_offsets_;
+
+  // Arenas holding all the temporary buffers of one execution, kept across
+  // executions so that they aren't allocated and freed on every run.
+  std::shared_ptr<TempArenaPool> temp_arena_pool_;
+
   // The LLVM IR, in string format, of the unoptimized module generated for this
   // CpuExecutable. We save a string instead of an llvm::Module* because leaving
   // llvm::Module* in a singleton can cause the heap checker to emit false
@@ -145,6 +188,13 @@ class CpuExecutable : public Executable {
   // Entry function name for the computation.
   const std::string entry_function_name_;
 
+  // Copies of the object files loaded into `jit_`, if retained.
+  std::vector<std::string> obj_files_;
+
+  std::string target_triple_;
+  std::string cpu_name_;
+  std::string cpu_features_;
+
   CpuExecutable(const CpuExecutable&) = delete;
   CpuExecutable& operator=(const CpuExecutable&) = delete;
 };
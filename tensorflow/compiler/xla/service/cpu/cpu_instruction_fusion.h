@@ -24,6 +24,10 @@ limitations under the License.
 namespace xla {
 namespace cpu {
 
+// Returns true if `hlo` can be emitted as part of a loop fusion, i.e. whether
+// the elemental IR emitter generates an efficient implementation for it.
+bool CanBeLoopFused(const HloInstruction& hlo);
+
 class CpuInstructionFusion : public InstructionFusion {
  public:
   CpuInstructionFusion()
@@ -0,0 +1,237 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/cpu_multi_output_fusion.h"
+
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/xla/layout_util.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_instruction_fusion.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/service/llvm_ir/dynamic_update_slice_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/util.h"
+
+namespace xla {
+namespace cpu {
+
+namespace {
+
+// All outputs of a multi-output fusion are generated from the same loop body,
+// so there is little to gain from fusions that are larger than this, while
+// compile time keeps growing with the size of the body.
+constexpr int64_t kMaxFusedInstructionCount = 128;
+
+// Returns the shapes of the arrays produced by `instr`.
+std::vector<const Shape*> GetOutputShapes(const HloInstruction* instr) {
+  std::vector<const Shape*> shapes;
+  if (instr->IsMultiOutputFusion()) {
+    for (const Shape& shape : instr->shape().tuple_shapes()) {
+      shapes.push_back(&shape);
+    }
+  } else {
+    shapes.push_back(&instr->shape());
+  }
+  return shapes;
+}
+
+int64_t FusedInstructionCount(const HloInstruction* instr) {
+  return instr->opcode() == HloOpcode::kFusion
+             ? instr->fused_instruction_count()
+             : 1;
+}
+
+bool FusionTooLarge(const HloInstruction* instr1,
+                    const HloInstruction* instr2) {
+  return FusedInstructionCount(instr1) + FusedInstructionCount(instr2) >
+         kMaxFusedInstructionCount;
+}
+
+// Reductions over major dimensions have an efficient lowering that is only
+// available to unfused reductions, see CpuInstructionFusion::ShouldFuse.
+bool ReducesMinorDimension(const HloInstruction& reduce) {
+  return absl::c_linear_search(
+      reduce.dimensions(),
+      LayoutUtil::Minor(reduce.operand(0)->shape().layout(), 0));
+}
+
+}  // namespace
+
+bool CpuMultiOutputFusion::ShapesCompatibleForFusion(HloInstruction* instr1,
+                                                     HloInstruction* instr2) {
+  std::vector<const Shape*> shapes = GetOutputShapes(instr1);
+  for (const Shape* shape : GetOutputShapes(instr2)) {
+    shapes.push_back(shape);
+  }
+  const Shape& loop_shape = *shapes.front();
+  return absl::c_all_of(shapes, [&](const Shape* shape) {
+    return shape->IsArray() &&
+           ShapeUtil::EqualIgnoringElementType(*shape, loop_shape);
+  });
+}
+
+bool CpuMultiOutputFusion::IsFusible(HloInstruction* instr) {
+  if (instr->opcode() == HloOpcode::kFusion) {
+    // Output fusions are emitted by the dot emitter, and in-place dynamic
+    // update slices only write part of their output.
+    return instr->IsLoopFusion() &&
+           !llvm_ir::MayBeImplementedAsInPlaceDynamicUpdateSlice(instr);
+  }
+  if (!instr->shape().IsArray() || !CanBeLoopFused(*instr)) {
+    return false;
+  }
+  switch (instr->opcode()) {
+    // These read little or nothing from memory, so there is nothing to share
+    // with a sibling.
+    case HloOpcode::kBitcast:
+    case HloOpcode::kBroadcast:
+    case HloOpcode::kIota:
+      return false;
+    case HloOpcode::kDynamicUpdateSlice:
+      return !llvm_ir::MayBeImplementedAsInPlaceDynamicUpdateSlice(instr);
+    case HloOpcode::kReduce:
+      return ReducesMinorDimension(*instr);
+    default:
+      return true;
+  }
+}
+
+int64_t CpuMultiOutputFusion::GetProfit(HloInstruction* instr1,
+                                        HloInstruction* instr2) {
+  if (FusionTooLarge(instr1, instr2)) {
+    return 0;
+  }
+  // Every operand that both instructions read is only streamed from memory
+  // once after fusion.
+  absl::flat_hash_set<const HloInstruction*> operands2(
+      instr2->operands().begin(), instr2->operands().end());
+  int64_t shared_bytes = 0;
+  for (const HloInstruction* operand : instr1->unique_operands()) {
+    if (!operand->shape().IsArray() ||
+        ShapeUtil::IsEffectiveScalar(operand->shape()) ||
+        !operands2.contains(operand)) {
+      continue;
+    }
+    shared_bytes += ShapeUtil::ByteSizeOf(operand->shape());
+  }
+  return CeilOfRatio<int64_t>(shared_bytes, 1024);
+}
+
+bool CpuMultiOutputFusion::LegalToFuse(HloInstruction* instr1,
+                                       HloInstruction* instr2) {
+  // Unlike the generic implementation this does not require `instr1` to be a
+  // fusion already; Fuse() creates one if neither instruction is.
+  return !FusionTooLarge(instr1, instr2) &&
+         LegalToFuseMainConstraints(instr1, instr2);
+}
+
+HloInstruction* CpuMultiOutputFusion::Fuse(HloInstruction* instr1,
+                                           HloInstruction* instr2) {
+  if (instr1->opcode() != HloOpcode::kFusion &&
+      instr2->opcode() != HloOpcode::kFusion) {
+    instr1 = CreateFusion(instr1, instr2);
+  }
+  return MultiOutputFusion::Fuse(instr1, instr2);
+}
+
+bool CpuMultiOutputFusion::DoProducerConsumerMultiOutputFusion() {
+  bool changed = false;
+  RecomputeReachability();
+
+  // Returns an operand of `consumer` that can be fused into it as an extra
+  // output, or nullptr.
+  auto find_producer = [&](HloInstruction* consumer) -> HloInstruction* {
+    if (consumer->IsMultiOutputFusion() &&
+        !absl::c_all_of(consumer->users(), [](const HloInstruction* user) {
+          return user->opcode() == HloOpcode::kGetTupleElement;
+        })) {
+      return nullptr;
+    }
+    for (HloInstruction* producer : consumer->unique_operands()) {
+      // Producers with a single user are left to CpuInstructionFusion, which
+      // has already decided against fusing them.
+      if (producer->user_count() < 2 || !IsFusible(producer) ||
+          producer->IsMultiOutputFusion() ||
+          FusionTooLarge(producer, consumer) ||
+          !ShapesCompatibleForFusion(producer, consumer)) {
+        continue;
+      }
+      // The consumer must read every element of the producer exactly once at
+      // the index it writes, otherwise the extra output would be recomputed.
+      bool elementwise = true;
+      for (int64_t i = 0; i < consumer->operand_count(); ++i) {
+        if (consumer->operand(i) == producer &&
+            !consumer->IsElementwiseOnOperand(i)) {
+          elementwise = false;
+        }
+      }
+      if (!elementwise) {
+        continue;
+      }
+      // Fusing would create a cycle if the consumer also reads the producer
+      // through another path.
+      if (absl::c_any_of(consumer->operands(), [&](HloInstruction* operand) {
+            return operand != producer &&
+                   reachability()->IsReachable(producer, operand);
+          })) {
+        continue;
+      }
+      return producer;
+    }
+    return nullptr;
+  };
+
+  std::vector<HloInstruction*> post_order =
+      computation()->MakeInstructionPostOrder();
+  absl::flat_hash_set<HloInstruction*> removed;
+  // Visit consumers before their producers, so that a chain of producers can
+  // be fused into the same consumer.
+  for (auto it = post_order.rbegin(); it != post_order.rend(); ++it) {
+    HloInstruction* consumer = *it;
+    if (removed.contains(consumer) || !IsFusible(consumer)) {
+      continue;
+    }
+    while (HloInstruction* producer = find_producer(consumer)) {
+      VLOG(2) << "Fuse producer " << producer->name() << " into its consumer "
+              << consumer->name() << " as an extra output";
+      if (consumer->opcode() != HloOpcode::kFusion) {
+        HloInstruction* fusion =
+            computation()->AddInstruction(HloInstruction::CreateFusion(
+                consumer->shape(), HloInstruction::FusionKind::kLoop,
+                consumer));
+        TF_CHECK_OK(computation()->ReplaceInstruction(consumer, fusion));
+        removed.insert(consumer);
+        consumer = fusion;
+      }
+      if (producer->opcode() == HloOpcode::kFusion) {
+        consumer->MergeFusionInstructionIntoMultiOutput(producer);
+      } else {
+        consumer->FuseInstructionIntoMultiOutput(producer);
+        CHECK_EQ(0, producer->user_count());
+        TF_CHECK_OK(computation()->RemoveInstruction(producer));
+      }
+      removed.insert(producer);
+      RecomputeReachability();
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+}  // namespace cpu
+}  // namespace xla
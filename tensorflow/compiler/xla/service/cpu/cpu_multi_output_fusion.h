@@ -0,0 +1,56 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_MULTI_OUTPUT_FUSION_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_MULTI_OUTPUT_FUSION_H_
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/multi_output_fusion.h"
+
+namespace xla {
+namespace cpu {
+
+// Multi-output fusion for the CPU backend.  Runs after CpuInstructionFusion
+// and merges loop fusions (and unfused loop-fusible instructions) that read the
+// same operands into a single kLoop fusion with a tuple root, e.g. the mean
+// and mean-of-squares reductions of a layer norm.  Producers whose result is
+// also needed outside of an elementwise consumer are fused into the consumer
+// as an extra output.
+//
+// The CPU loop emitter produces all outputs of a multi-output fusion from a
+// single loop nest, so only instructions whose outputs have the same
+// dimensions and layout are fused together.
+class CpuMultiOutputFusion : public MultiOutputFusion {
+ public:
+  CpuMultiOutputFusion() = default;
+
+  absl::string_view name() const override { return "cpu_multi_output_fusion"; }
+
+ protected:
+  bool ShapesCompatibleForFusion(HloInstruction* instr1,
+                                 HloInstruction* instr2) override;
+  bool IsFusible(HloInstruction* instr) override;
+  int64_t GetProfit(HloInstruction* instr1, HloInstruction* instr2) override;
+  bool LegalToFuse(HloInstruction* instr1, HloInstruction* instr2) override;
+  HloInstruction* Fuse(HloInstruction* instr1,
+                       HloInstruction* instr2) override;
+  bool DoProducerConsumerMultiOutputFusion() override;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_MULTI_OUTPUT_FUSION_H_
@@ -0,0 +1,177 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/cpu_multi_output_fusion.h"
+
+#include "tensorflow/compiler/xla/service/hlo_matchers.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+
+namespace op = xla::testing::opcode_matchers;
+
+namespace xla {
+namespace cpu {
+namespace {
+
+using CpuMultiOutputFusionTest = HloTestBase;
+
+TEST_F(CpuMultiOutputFusionTest, SiblingReductions) {
+  // The sum and the sum of squares of a layer norm read the same input.
+  const char* hlo_string = R"(
+HloModule m
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT sum = f32[] add(a, b)
+}
+
+fused_square_sum {
+  p0 = f32[128,512]{1,0} parameter(0)
+  zero = f32[] constant(0)
+  square = f32[128,512]{1,0} multiply(p0, p0)
+  ROOT reduce = f32[128]{0} reduce(square, zero), dimensions={1}, to_apply=add
+}
+
+ENTRY entry {
+  p0 = f32[128,512]{1,0} parameter(0)
+  zero = f32[] constant(0)
+  sum = f32[128]{0} reduce(p0, zero), dimensions={1}, to_apply=add
+  square_sum = f32[128]{0} fusion(p0), kind=kLoop, calls=fused_square_sum
+  ROOT result = (f32[128]{0}, f32[128]{0}) tuple(sum, square_sum)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  ASSERT_TRUE(CpuMultiOutputFusion().Run(module.get()).ValueOrDie());
+  const HloInstruction* fusion =
+      module->entry_computation()->root_instruction()->operand(0)->operand(0);
+  ASSERT_EQ(fusion->opcode(), HloOpcode::kFusion);
+  EXPECT_TRUE(fusion->IsLoopFusion());
+  EXPECT_THAT(fusion->fused_expression_root(),
+              op::Tuple(op::Reduce(), op::Reduce()));
+}
+
+TEST_F(CpuMultiOutputFusionTest, NoSiblingFusionOfDifferentShapes) {
+  const char* hlo_string = R"(
+HloModule m
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT sum = f32[] add(a, b)
+}
+
+ENTRY entry {
+  p0 = f32[128,512]{1,0} parameter(0)
+  zero = f32[] constant(0)
+  sum = f32[128]{0} reduce(p0, zero), dimensions={1}, to_apply=add
+  exp = f32[128,512]{1,0} exponential(p0)
+  ROOT result = (f32[128]{0}, f32[128,512]{1,0}) tuple(sum, exp)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  EXPECT_FALSE(CpuMultiOutputFusion().Run(module.get()).ValueOrDie());
+}
+
+TEST_F(CpuMultiOutputFusionTest, NoSiblingFusionOfMajorReductions) {
+  const char* hlo_string = R"(
+HloModule m
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT sum = f32[] add(a, b)
+}
+
+max {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT max = f32[] maximum(a, b)
+}
+
+ENTRY entry {
+  p0 = f32[128,512]{1,0} parameter(0)
+  zero = f32[] constant(0)
+  sum = f32[512]{0} reduce(p0, zero), dimensions={0}, to_apply=add
+  max = f32[512]{0} reduce(p0, zero), dimensions={0}, to_apply=max
+  ROOT result = (f32[512]{0}, f32[512]{0}) tuple(sum, max)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  EXPECT_FALSE(CpuMultiOutputFusion().Run(module.get()).ValueOrDie());
+}
+
+TEST_F(CpuMultiOutputFusionTest, ProducerConsumer) {
+  // `exp` is needed both by the root and by the elementwise fusion.
+  const char* hlo_string = R"(
+HloModule m
+
+fused_add {
+  p0 = f32[64,64]{1,0} parameter(0)
+  p1 = f32[64,64]{1,0} parameter(1)
+  ROOT add = f32[64,64]{1,0} add(p0, p1)
+}
+
+ENTRY entry {
+  p0 = f32[64,64]{1,0} parameter(0)
+  p1 = f32[64,64]{1,0} parameter(1)
+  exp = f32[64,64]{1,0} exponential(p0)
+  add = f32[64,64]{1,0} fusion(exp, p1), kind=kLoop, calls=fused_add
+  ROOT result = (f32[64,64]{1,0}, f32[64,64]{1,0}) tuple(exp, add)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  ASSERT_TRUE(CpuMultiOutputFusion().Run(module.get()).ValueOrDie());
+  const HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::Tuple(op::GetTupleElement(op::Fusion()),
+                              op::GetTupleElement(op::Fusion())));
+  EXPECT_EQ(root->operand(0)->operand(0), root->operand(1)->operand(0));
+  EXPECT_THAT(root->operand(0)->operand(0)->fused_expression_root(),
+              op::Tuple(op::Add(), op::Exp()));
+}
+
+TEST_F(CpuMultiOutputFusionTest, NoProducerConsumerFusionOfBroadcastUse) {
+  // The consumer reads every element of the reduction 512 times, so the
+  // reduction would be recomputed for every element of the consumer.
+  const char* hlo_string = R"(
+HloModule m
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT sum = f32[] add(a, b)
+}
+
+fused_sub {
+  p0 = f32[128,512]{1,0} parameter(0)
+  p1 = f32[128]{0} parameter(1)
+  bcast = f32[128,512]{1,0} broadcast(p1), dimensions={0}
+  ROOT sub = f32[128,512]{1,0} subtract(p0, bcast)
+}
+
+ENTRY entry {
+  p0 = f32[128,512]{1,0} parameter(0)
+  zero = f32[] constant(0)
+  sum = f32[128]{0} reduce(p0, zero), dimensions={1}, to_apply=add
+  sub = f32[128,512]{1,0} fusion(p0, sum), kind=kLoop, calls=fused_sub
+  ROOT result = (f32[128]{0}, f32[128,512]{1,0}) tuple(sum, sub)
+})";
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  EXPECT_FALSE(CpuMultiOutputFusion().Run(module.get()).ValueOrDie());
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -126,6 +126,8 @@ extern const char* const kReleaseOutfeedBufferAfterPopulationSymbolName =
     "__xla_cpu_runtime_ReleaseOutfeedBufferAfterPopulation";
 extern const char* const kParallelForkJoinSymbolName =
     "__xla_cpu_runtime_ParallelForkJoin";
+extern const char* const kParallelForkJoinWorkStealingSymbolName =
+    "__xla_cpu_runtime_ParallelForkJoinWorkStealing";
 extern const char* const kPrintfToStderrSymbolName =
     "__xla_cpu_runtime_PrintfToStderr";
 extern const char* const kStatusIsSuccessSymbolName =
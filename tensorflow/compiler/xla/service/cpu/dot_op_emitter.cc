@@ -32,6 +32,7 @@ limitations under the License.
 #include "mlir/IR/Value.h"  // from @llvm-project
 #include "mlir/Pass/Pass.h"  // from @llvm-project
 #include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/service/cpu/backend_config.pb.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
@@ -69,6 +70,8 @@ struct DotInfo {
   Shape rhs_shape;
   Shape result_shape;
   DotDimensionNumbers dim_nums;
+  // The implementation chosen by CpuDotAutotuner, if any.
+  DotBackendConfig backend_config;
 
   DotInfo() = default;
 
@@ -78,6 +81,11 @@ struct DotInfo {
     rhs_shape = instr.operand(1)->shape();
     result_shape = instr.shape();
     dim_nums = instr.dot_dimension_numbers();
+    StatusOr<DotBackendConfig> config =
+        instr.backend_config<DotBackendConfig>();
+    if (config.ok()) {
+      backend_config = std::move(config).ValueOrDie();
+    }
   }
 };
 
@@ -193,14 +201,19 @@ class DotOpEmitter {
   }
 
   std::tuple<int64_t, int64_t, int64_t> GetGemmTileSize() const {
+    if (auto tile_size = options::LlvmIrGemmTileSize(hlo_module_config_)) {
+      return *tile_size;
+    }
+    const DotBackendConfig& config = dot_info_.backend_config;
+    if (config.strategy() == DotBackendConfig::TILED_LLVM_IR_GEMM) {
+      return std::make_tuple(config.tile_size_m(), config.tile_size_k(),
+                             config.tile_size_n_in_vector_width());
+    }
     // Tuned for broadwell - Intel(R) Xeon(R) CPU E5-2690 v4 @ 2.60GHz
     //
     // TODO(b/80093688): Tune for other architectures and centralize this
     // information in one place.
-    const std::tuple<int64_t, int64_t, int64_t> kDefaultTileSize =
-        std::tuple<int64_t, int64_t, int64_t>(11, 9, 1);
-    return options::LlvmIrGemmTileSize(hlo_module_config_)
-        .value_or(kDefaultTileSize);
+    return std::tuple<int64_t, int64_t, int64_t>(11, 9, 1);
   }
 
   std::array<int64_t, 3> GetMlirGemmTileSize() const {
@@ -990,6 +1003,27 @@ bool IsAlignedGemm(const DotInfo& dot_info,
                        dot_info.result_shape, target_machine_features);
 }
 
+// Returns true if the tiled LLVM IR GEMM emitter supports the aligned GEMM
+// `dot_info`, regardless of whether it is expected to be profitable.
+bool TiledLlvmIrGemmSupports(const DotInfo& dot_info) {
+  bool lhs_canonical = dot_info.dim_nums.lhs_contracting_dimensions(0) == 1;
+  bool rhs_canonical = dot_info.dim_nums.rhs_contracting_dimensions(0) == 0;
+
+  if (!(lhs_canonical && rhs_canonical)) {
+    return false;
+  }
+
+  if (dot_info.result_shape.element_type() == F16 ||
+      dot_info.result_shape.element_type() == C64 ||
+      dot_info.result_shape.element_type() == C128) {
+    // TODO(sanjoy): This is probably easy to fix, but I want to keep the CL
+    // adding this comment NFC.
+    return false;
+  }
+
+  return true;
+}
+
 bool CanEmitTiledLlvmIrGemm(
     const HloModuleConfig& config, const DotInfo& dot_info,
     const TargetMachineFeatures& target_machine_features) {
@@ -1013,22 +1047,7 @@ bool CanEmitTiledLlvmIrGemm(
     }
   }
 
-  bool lhs_canonical = dot_info.dim_nums.lhs_contracting_dimensions(0) == 1;
-  bool rhs_canonical = dot_info.dim_nums.rhs_contracting_dimensions(0) == 0;
-
-  if (!(lhs_canonical && rhs_canonical)) {
-    return false;
-  }
-
-  if (dot_info.result_shape.element_type() == F16 ||
-      dot_info.result_shape.element_type() == C64 ||
-      dot_info.result_shape.element_type() == C128) {
-    // TODO(sanjoy): This is probably easy to fix, but I want to keep the CL
-    // adding this comment NFC.
-    return false;
-  }
-
-  return true;
+  return TiledLlvmIrGemmSupports(dot_info);
 }
 
 DotImplementationStrategy GetDotImplementationStrategy(
@@ -1062,6 +1081,18 @@ DotImplementationStrategy GetDotImplementationStrategy(
   }
 
   if (IsAlignedGemm(dot_info, target_machine_features)) {
+    // A measured choice takes precedence over the heuristics below.
+    switch (dot_info.backend_config.strategy()) {
+      case DotBackendConfig::TILED_LLVM_IR_GEMM:
+        if (TiledLlvmIrGemmSupports(dot_info)) {
+          return DotImplementationStrategy::kTiledLlvmIrGemm;
+        }
+        break;
+      case DotBackendConfig::EIGEN:
+        return DotImplementationStrategy::kEigen;
+      default:
+        break;
+    }
     if (CanEmitTiledLlvmIrGemm(config, dot_info, target_machine_features)) {
       return DotImplementationStrategy::kTiledLlvmIrGemm;
     }
@@ -1245,6 +1276,29 @@ bool DotImplementationCanHandleTranspose(
          impl_strategy == DotImplementationStrategy::kEigen;
 }
 
+bool DotImplementationCanBeAutotuned(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features) {
+  if (IsBatchDot(dot_instr)) {
+    return false;
+  }
+  DotInfo dot_info(dot_instr);
+  dot_info.backend_config.Clear();
+  DotImplementationStrategy impl_strategy =
+      GetDotImplementationStrategy(dot_instr.parent()->parent()->config(),
+                                   dot_info, target_machine_features);
+  return impl_strategy == DotImplementationStrategy::kTiledLlvmIrGemm ||
+         impl_strategy == DotImplementationStrategy::kEigen;
+}
+
+bool DotImplementationCanUseTiledLlvmIrGemm(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features) {
+  DotInfo dot_info(dot_instr);
+  return IsAlignedGemm(dot_info, target_machine_features) &&
+         TiledLlvmIrGemmSupports(dot_info);
+}
+
 bool DotOperandsAndResultMustHaveRowMajorLayout(
     const HloInstruction& dot_instr,
     const TargetMachineFeatures& target_machine_features) {
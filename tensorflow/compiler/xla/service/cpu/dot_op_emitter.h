@@ -42,6 +42,19 @@ bool DotImplementationCanHandleTranspose(
     const HloInstruction& dot_instr,
     const TargetMachineFeatures& target_machine_features);
 
+// Returns true if `dot_instr` is a matrix-matrix product that is lowered either
+// into a tiled LLVM IR GEMM or into a call into Eigen, so that the choice can
+// be made by CpuDotAutotuner through a DotBackendConfig.
+bool DotImplementationCanBeAutotuned(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features);
+
+// Returns true if a DotBackendConfig can lower `dot_instr` into a tiled LLVM IR
+// GEMM, i.e. if its layouts and element type are supported by that emitter.
+bool DotImplementationCanUseTiledLlvmIrGemm(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features);
+
 // Returns the index for an operand to `hlo` that should ideally be column
 // major.  Returns nullopt if there is no such operand or if `hlo` is not a dot
 // or a fusion containing a dot.
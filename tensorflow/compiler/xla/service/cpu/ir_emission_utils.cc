@@ -40,6 +40,13 @@ int64_t GetMinimumAlignmentForArray(
       allocation_size_bytes);
 }
 
+const Shape& GetLoopShape(const HloInstruction& instruction) {
+  if (instruction.IsMultiOutputFusion() && instruction.IsLoopFusion()) {
+    return instruction.shape().tuple_shapes(0);
+  }
+  return instruction.shape();
+}
+
 bool PotentiallyImplementedAsEigenConvolution(
     const HloInstruction& convolution,
     const TargetMachineFeatures& target_machine_features) {
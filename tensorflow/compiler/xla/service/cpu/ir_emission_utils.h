@@ -32,6 +32,12 @@ bool PotentiallyImplementedAsEigenConvolution(
 int64_t GetMinimumAlignmentForArray(
     const Shape& shape, const TargetMachineFeatures& target_machine_features);
 
+// Returns the array shape of the loop nest that computes `instruction`.  This
+// is the shape of `instruction`, except for multi-output loop fusions, which
+// compute all of their outputs (which have the same dimensions) in one loop
+// nest over the shape of the first output.
+const Shape& GetLoopShape(const HloInstruction& instruction);
+
 // Dynamic loop bounds are specified as an array of dimension index
 // [start, limit) pairs of ir values (one for each partitioned outer dimension).
 //
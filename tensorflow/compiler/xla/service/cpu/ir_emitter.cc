@@ -2192,8 +2192,9 @@ Status IrEmitter::HandleCall(HloInstruction* call) {
     // each call such that it only generates one partition of the output.
     HloInstruction* root = computation->root_instruction();
     TF_RETURN_IF_ERROR(EmitCallToParallelForkJoin(
-        call_args, root->shape(), root->outer_dimension_partitions(), &b_,
-        call_ir_function, computation->name()));
+        call_args, GetLoopShape(*root), root->outer_dimension_partitions(), &b_,
+        call_ir_function, computation->name(),
+        hlo_module_config_.debug_options().xla_cpu_enable_work_stealing()));
 
     if (ComputationTransitivelyContainsCustomCall(computation)) {
       EmitEarlyReturnIfErrorStatus();
@@ -3258,7 +3259,6 @@ Status IrEmitter::EmitTargetElementLoop(
        target_op->opcode() == HloOpcode::kReduce ||
        target_op->opcode() == HloOpcode::kReduceWindow)) {
     // For multiple outputs fusion, we need to emit each operand and the root.
-    TF_RET_CHECK(num_dynamic_loop_bounds_ == 0);
     std::vector<llvm_ir::IrArray> output_arrays;
     for (int64_t i = 0; i < ShapeUtil::TupleElementCount(target_shape); ++i) {
       TF_ASSIGN_OR_RETURN(BufferAllocation::Slice slice,
@@ -3268,15 +3268,39 @@ Status IrEmitter::EmitTargetElementLoop(
       output_arrays.push_back(
           llvm_ir::IrArray(op_target_address, element_shape));
     }
-    TF_RETURN_IF_ERROR(
-        llvm_ir::LoopEmitter(element_generator, output_arrays, &b_)
-            .EmitLoop(IrName(target_op)));
 
     std::vector<llvm::Value*> tuple_operand_ptrs;
     for (int64_t i = 0; i < output_arrays.size(); ++i) {
       tuple_operand_ptrs.push_back(output_arrays[i].GetBasePointer());
     }
-    llvm_ir::EmitTuple(target_array, tuple_operand_ptrs, &b_);
+
+    if (ShouldEmitParallelLoopFor(*target_op)) {
+      TF_RET_CHECK(target_op->IsMultiOutputFusion());
+      std::vector<std::pair<llvm::Value*, llvm::Value*>> dynamic_loop_bounds =
+          compute_function_->GetDynamicLoopBounds();
+      TF_RETURN_IF_ERROR(ParallelLoopEmitter(element_generator, output_arrays,
+                                             &dynamic_loop_bounds, &b_)
+                             .EmitLoop(IrName(target_op)));
+
+      // Every partition computes the same tuple, so only the partition that
+      // starts at the origin writes it.
+      llvm::Value* is_first_partition = b_.getTrue();
+      for (const auto& bounds : dynamic_loop_bounds) {
+        is_first_partition =
+            And(is_first_partition, ICmpEQ(bounds.first, b_.getInt64(0)));
+      }
+      llvm_ir::LlvmIfData if_first_partition = llvm_ir::EmitIfThenElse(
+          is_first_partition, "first_partition", &b_, /*emit_else=*/false);
+      SetToFirstInsertPoint(if_first_partition.true_block, &b_);
+      llvm_ir::EmitTuple(target_array, tuple_operand_ptrs, &b_);
+      SetToFirstInsertPoint(if_first_partition.after_block, &b_);
+    } else {
+      TF_RET_CHECK(num_dynamic_loop_bounds_ == 0);
+      TF_RETURN_IF_ERROR(
+          llvm_ir::LoopEmitter(element_generator, output_arrays, &b_)
+              .EmitLoop(IrName(target_op)));
+      llvm_ir::EmitTuple(target_array, tuple_operand_ptrs, &b_);
+    }
 
   } else {
     if (ShouldEmitParallelLoopFor(*target_op)) {
@@ -247,12 +247,14 @@ std::vector<llvm::Value*> GetArrayFunctionCallArguments(
 }
 
 // Emits a call to a runtime fork/join function which dispatches parallel
-// calls to 'parallel_function' (and joins threads before returning).
+// calls to 'parallel_function' (and joins threads before returning). If
+// 'work_stealing' is true, the partitions are split further at run time and
+// balanced across threads with work stealing.
 Status EmitCallToParallelForkJoin(
     const std::vector<llvm::Value*>& arguments, const Shape& shape,
     const std::vector<int64_t>& dimension_partition_counts,
     llvm::IRBuilder<>* b, llvm::Function* parallel_function,
-    const std::string& name) {
+    const std::string& name, bool work_stealing) {
   llvm::Module* module = b->GetInsertBlock()->getModule();
 
   // Build ParallelForkJoin function type.
@@ -277,8 +279,10 @@ Status EmitCallToParallelForkJoin(
 
   llvm::Function* fork_join_func = llvm::dyn_cast<llvm::Function>(
       module
-          ->getOrInsertFunction(runtime::kParallelForkJoinSymbolName,
-                                fork_join_type)
+          ->getOrInsertFunction(
+              work_stealing ? runtime::kParallelForkJoinWorkStealingSymbolName
+                            : runtime::kParallelForkJoinSymbolName,
+              fork_join_type)
           .getCallee());
   fork_join_func->setCallingConv(llvm::CallingConv::C);
   fork_join_func->setDoesNotThrow();
@@ -144,12 +144,14 @@ std::vector<llvm::Value*> GetArrayFunctionCallArguments(
     llvm::Value* status_arg, llvm::Value* profile_counters_arg);
 
 // Emits a call to a runtime fork/join function which dispatches parallel
-// calls to 'parallel_function' (and joins threads before returning).
+// calls to 'parallel_function' (and joins threads before returning). If
+// 'work_stealing' is true, the partitions are split further at run time and
+// balanced across threads with work stealing.
 Status EmitCallToParallelForkJoin(
     const std::vector<llvm::Value*>& arguments, const Shape& shape,
     const std::vector<int64_t>& dimension_partition_counts,
     llvm::IRBuilder<>* b, llvm::Function* parallel_function,
-    const std::string& name);
+    const std::string& name, bool work_stealing);
 
 }  // namespace cpu
 }  // namespace xla
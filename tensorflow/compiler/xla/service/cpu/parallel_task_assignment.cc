@@ -24,10 +24,28 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
 #include "tensorflow/compiler/xla/service/llvm_ir/dynamic_update_slice_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 
 namespace xla {
 namespace cpu {
 
+namespace {
+
+// Returns the total size of the arrays produced by `instruction`.
+int64_t OutputSizeBytes(const HloCostAnalysis::ShapeSizeFunction& shape_size,
+                        const HloInstruction& instruction) {
+  int64_t size = 0;
+  ShapeUtil::ForEachSubshape(
+      instruction.shape(), [&](const Shape& subshape, const ShapeIndex&) {
+        if (subshape.IsArray()) {
+          size += shape_size(subshape);
+        }
+      });
+  return size;
+}
+
+}  // namespace
+
 class SimpleCostModel : public ParallelCostModel {
  public:
   SimpleCostModel(const int64_t max_parallelism,
@@ -37,7 +55,7 @@ class SimpleCostModel : public ParallelCostModel {
 
   int64_t GetParallelTaskCount(HloInstruction* instruction) override {
     // Simple cost model based on hlo size and typical L2 cache size.
-    const int64_t instruction_cost = shape_size_(instruction->shape());
+    const int64_t instruction_cost = OutputSizeBytes(shape_size_, *instruction);
     const int64_t min_cost_per_thread = 256LL << 10;  // 256KB L2 Cache size.
     // Return target parallel task count in [1, max_parallelism_].
     return std::min(
@@ -80,7 +98,7 @@ class DefaultCostModel : public ParallelCostModel {
           max_parallelism_,
           std::ceil(std::sqrt(tensorflow::port::MaxParallelism())));
       // Use shape size instruction cost and L2 cache size min per-thread cost.
-      instruction_cost = shape_size_(instruction->shape());
+      instruction_cost = OutputSizeBytes(shape_size_, *instruction);
       min_cost_per_thread = 256LL << 10;  // 256KB L2 Cache size.
     } else {
       // Use max parallelism for compute bound instructions.
@@ -137,7 +155,7 @@ int64_t ParallelTaskAssignment::GetTargetParallelTaskCount(
   // *) Internal threading (library calls to kConv, kDot, kFft, kCustomCall).
   // *) Emit custom loops (kSelectAndScatter).
   // *) Operations that are not thread safe (like infeed and rng).
-  // *) Tuple-shaped.
+  // *) Tuple-shaped, except for multi-output loop fusions.
   // *) Operations that might be implemented as an in-place
   //    dynamic-update-slice, because we can't know how many output elements
   //    they will write (out-of-place will touch the whole output buffer, while
@@ -145,7 +163,9 @@ int64_t ParallelTaskAssignment::GetTargetParallelTaskCount(
   // TODO(b/27458679) Parallelize instructions which are skipped here.
   auto opcode = instruction->opcode();
   if (llvm_ir::MayBeImplementedAsInPlaceDynamicUpdateSlice(instruction) ||
-      instruction->shape().IsTuple() || opcode == HloOpcode::kRng ||
+      (instruction->shape().IsTuple() &&
+       !(instruction->IsMultiOutputFusion() && instruction->IsLoopFusion())) ||
+      opcode == HloOpcode::kRng ||
       opcode == HloOpcode::kConstant) {
     return 1;
   }
@@ -221,8 +241,9 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
     // Get target parallel task count computed for 'instruction'.
     const int64_t target_parallel_task_count = (*it).second;
     // Assign feasible dimension partitions (based on actual dimension sizes).
-    auto dim_partition_counts = ShapePartitionAssigner(instruction->shape())
-                                    .Run(target_parallel_task_count);
+    auto dim_partition_counts =
+        ShapePartitionAssigner(GetLoopShape(*instruction))
+            .Run(target_parallel_task_count);
     const int64_t total_partition_count =
         ShapePartitionAssigner::GetTotalPartitionCount(dim_partition_counts);
     if (total_partition_count <= 1) {
@@ -92,6 +92,30 @@ TEST_F(ParallelTaskAssignmentTest,
   EXPECT_FALSE(changed);
 }
 
+TEST_F(ParallelTaskAssignmentTest, MultiOutputLoopFusionParallelized) {
+  const std::string hlo_string = R"(
+    HloModule TestTaskParallel_MultiOutputFusion
+    fused_computation {
+      p0 = f32[1234567,4]{1,0} parameter(0)
+      p1 = f32[1234567,4]{1,0} parameter(1)
+      add = f32[1234567,4]{1,0} add(p0, p1)
+      mul = f32[1234567,4]{1,0} multiply(p0, p1)
+      ROOT tuple = (f32[1234567,4]{1,0}, f32[1234567,4]{1,0}) tuple(add, mul)
+    }
+    ENTRY MultiOutputFusion {
+      p0 = f32[1234567,4]{1,0} parameter(0)
+      p1 = f32[1234567,4]{1,0} parameter(1)
+      ROOT fusion = (f32[1234567,4]{1,0}, f32[1234567,4]{1,0}) fusion(p0, p1),
+        kind=kLoop, calls=fused_computation
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+}
+
 TEST_F(ParallelTaskAssignmentTest, RngOperationNotParallelized) {
   const std::string hlo_string = R"(
     HloModule TestTaskParallel_rng
@@ -17,6 +17,12 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <vector>
+
 #include "absl/base/dynamic_annotations.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
@@ -29,6 +35,150 @@ limitations under the License.
 using ComputeFunctionType = void (*)(void*, const void*, const void**, void**,
                                      void*, int64_t*, uint64_t*);
 
+namespace {
+
+// Sets `status` to a failure listing the errors in `statuses` (if any), where
+// `statuses[i]` is the result of a call for partition `partition_ids[i]`.
+void ReportPartitionErrors(const std::vector<XlaCustomCallStatus>& statuses,
+                           const std::vector<int32_t>& partition_ids,
+                           void* status) {
+  // Collect all error messages (if any).
+  std::vector<std::pair<int32_t, absl::string_view>> error_messages;
+  for (size_t i = 0; i < statuses.size(); ++i) {
+    absl::optional<absl::string_view> msg =
+        xla::CustomCallStatusGetMessage(&statuses[i]);
+    if (msg) {
+      error_messages.emplace_back(partition_ids[i], *msg);
+    }
+  }
+
+  if (!error_messages.empty()) {
+    // Join all error messages into a single string to serve as the message for
+    // the returned status.
+    std::string error_message = absl::StrJoin(
+        error_messages, "\n",
+        [](std::string* out, std::pair<int32_t, absl::string_view> p) {
+          int32_t idx = p.first;
+          absl::string_view msg = p.second;
+          absl::StrAppend(out,
+                          absl::StrFormat("Partition %d error: %s", idx, msg));
+        });
+    XlaCustomCallStatusSetFailure(
+        reinterpret_cast<XlaCustomCallStatus*>(status), error_message.data(),
+        error_message.length());
+  }
+}
+
+// A range [begin, end) of chunk indices owned by one worker.  Both bounds are
+// packed into a single word, so that the owner (which takes chunks from the
+// front) and thieves (which take the back half) can update the range with one
+// compare-and-swap.  Every chunk is handed out exactly once, so a range that
+// compares equal to an earlier value always describes the same chunks.
+class ChunkRange {
+ public:
+  void Reset(uint32_t begin, uint32_t end) {
+    range_.store(Pack(begin, end), std::memory_order_release);
+  }
+
+  // Takes the first chunk of the range.
+  bool PopFront(uint32_t* chunk) {
+    uint64_t range = range_.load(std::memory_order_acquire);
+    while (Begin(range) < End(range)) {
+      if (range_.compare_exchange_weak(range,
+                                       Pack(Begin(range) + 1, End(range)),
+                                       std::memory_order_acq_rel)) {
+        *chunk = Begin(range);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Takes the back half of the range, and at least one chunk.
+  bool StealBack(uint32_t* begin, uint32_t* end) {
+    uint64_t range = range_.load(std::memory_order_acquire);
+    while (Begin(range) < End(range)) {
+      const uint32_t middle = Begin(range) + (End(range) - Begin(range)) / 2;
+      if (range_.compare_exchange_weak(range, Pack(Begin(range), middle),
+                                       std::memory_order_acq_rel)) {
+        *begin = middle;
+        *end = End(range);
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  static uint64_t Pack(uint32_t begin, uint32_t end) {
+    return (static_cast<uint64_t>(end) << 32) | begin;
+  }
+  static uint32_t Begin(uint64_t range) { return range & 0xffffffff; }
+  static uint32_t End(uint64_t range) { return range >> 32; }
+
+  std::atomic<uint64_t> range_{0};
+};
+
+// Number of chunks each compile-time partition is split into at run time.
+constexpr int64_t kChunksPerPartition = 8;
+
+// State shared by the workers of one __xla_cpu_runtime_ParallelForkJoin call.
+// Workers that start after all chunks are done may outlive the call, so the
+// state is reference counted.
+struct WorkStealingState {
+  WorkStealingState(int32_t num_chunks, int32_t num_workers)
+      : statuses(num_chunks), ranges(num_workers), pending(num_chunks) {}
+
+  ComputeFunctionType function;
+  void* result_ptr;
+  const void* run_options_ptr;
+  void** buffer_table;
+  uint64_t* prof_counters;
+  int64_t stride;
+
+  // Loop bounds of every chunk, in the layout of the 'partitions' argument.
+  std::vector<int64_t> chunk_bounds;
+  // The compile-time partition each chunk belongs to.
+  std::vector<int32_t> partition_ids;
+  std::vector<XlaCustomCallStatus> statuses;
+  std::vector<ChunkRange> ranges;
+  tensorflow::BlockingCounter pending;
+};
+
+void RunChunk(WorkStealingState* state, uint32_t chunk) {
+  state->function(state->result_ptr, state->run_options_ptr, nullptr,
+                  state->buffer_table, &state->statuses[chunk],
+                  &state->chunk_bounds[chunk * state->stride],
+                  state->prof_counters);
+  state->pending.DecrementCount();
+}
+
+// Runs the chunks of `worker` and then steals from the other workers until
+// no chunks are left to take.
+void RunWorker(WorkStealingState* state, int32_t worker) {
+  const int32_t num_workers = state->ranges.size();
+  ChunkRange& own = state->ranges[worker];
+  while (true) {
+    uint32_t chunk;
+    while (own.PopFront(&chunk)) {
+      RunChunk(state, chunk);
+    }
+    bool stole = false;
+    for (int32_t i = 1; i < num_workers && !stole; ++i) {
+      uint32_t begin, end;
+      if (state->ranges[(worker + i) % num_workers].StealBack(&begin, &end)) {
+        own.Reset(begin, end);
+        stole = true;
+      }
+    }
+    if (!stole) {
+      return;
+    }
+  }
+}
+
+}  // namespace
+
 // Dispatches 'num_partitions - 1' calls to 'function_ptr' in parallel.
 // Calls 'function_ptr' for first partition inline.
 // Uses blocking counter to synchronize threads after parallel calls complete.
@@ -102,30 +252,89 @@ ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_ParallelForkJoin(
   VLOG(3) << "ParallelForkJoin partition 0 done.";
   bc.Wait();
 
-  // Collect all error messages (if any).
-  std::vector<std::pair<int32_t, absl::string_view>> error_messages;
+  std::vector<int32_t> partition_ids(num_partitions);
+  std::iota(partition_ids.begin(), partition_ids.end(), 0);
+  ReportPartitionErrors(statuses, partition_ids, status);
+  VLOG(2) << "ParallelForkJoin EXIT";
+}
+
+// Same as __xla_cpu_runtime_ParallelForkJoin, but splits every partition into
+// up to kChunksPerPartition chunks along its most-major partitioned dimension
+// and runs the chunks with work stealing.  Every worker starts with the chunks
+// of a contiguous set of partitions, and a worker that runs out of chunks
+// takes the back half of the chunks of another worker.  This keeps all
+// threads busy when partitions have skewed costs or when some of the tasks
+// are queued behind other work in the intra-op thread pool.
+//
+// The call returns once all chunks are done; workers scheduled on the thread
+// pool that have not started by then find no work and exit immediately.
+ABSL_ATTRIBUTE_NO_SANITIZE_MEMORY void
+__xla_cpu_runtime_ParallelForkJoinWorkStealing(
+    void* result_ptr, const void* run_options_ptr, const void** params,
+    void** buffer_table, void* status, uint64_t* prof_counters,
+    int32_t num_partitions, int64_t* partitions, int32_t num_partitioned_dims,
+    void* function_ptr) {
+  VLOG(2) << "ParallelForkJoinWorkStealing ENTRY"
+          << " num_partitions: " << num_partitions
+          << " num_partitioned_dims: " << num_partitioned_dims;
+  CHECK_EQ(params, nullptr);
+  CHECK_GT(num_partitions, 1);
+  CHECK_GT(num_partitioned_dims, 0);
+  CHECK_NE(function_ptr, nullptr);
+  CHECK_NE(partitions, nullptr);
+  const xla::ExecutableRunOptions* run_options =
+      static_cast<const xla::ExecutableRunOptions*>(run_options_ptr);
+  CHECK_NE(run_options, nullptr);
+  CHECK_NE(run_options->intra_op_thread_pool(), nullptr);
+
+  const int64_t stride = 2 * num_partitioned_dims;
+
+  // Split every partition into chunks along its first dimension, and record
+  // where the chunks of every partition start.
+  std::vector<int64_t> chunk_bounds;
+  std::vector<int32_t> partition_ids;
+  std::vector<uint32_t> first_chunk(num_partitions + 1, 0);
   for (int32_t i = 0; i < num_partitions; ++i) {
-    absl::optional<absl::string_view> msg =
-        xla::CustomCallStatusGetMessage(&statuses[i]);
-    if (msg) {
-      error_messages.emplace_back(i, *msg);
+    const int64_t* bounds = &partitions[i * stride];
+    const int64_t size = bounds[1] - bounds[0];
+    const int64_t num_chunks =
+        std::max<int64_t>(1, std::min(size, kChunksPerPartition));
+    for (int64_t j = 0; j < num_chunks; ++j) {
+      const size_t offset = chunk_bounds.size();
+      chunk_bounds.insert(chunk_bounds.end(), bounds, bounds + stride);
+      chunk_bounds[offset] = bounds[0] + size * j / num_chunks;
+      chunk_bounds[offset + 1] = bounds[0] + size * (j + 1) / num_chunks;
+      partition_ids.push_back(i);
     }
+    first_chunk[i + 1] = partition_ids.size();
   }
 
-  if (!error_messages.empty()) {
-    // Join all error messages into a single string to serve as the message for
-    // the returned status.
-    std::string error_message = absl::StrJoin(
-        error_messages, "\n",
-        [](std::string* out, std::pair<int32_t, absl::string_view> p) {
-          int32_t idx = p.first;
-          absl::string_view msg = p.second;
-          absl::StrAppend(out,
-                          absl::StrFormat("Partition %d error: %s", idx, msg));
-        });
-    XlaCustomCallStatusSetFailure(
-        reinterpret_cast<XlaCustomCallStatus*>(status), error_message.data(),
-        error_message.length());
+  const int32_t num_chunks = partition_ids.size();
+  const int32_t num_workers = std::min<int32_t>(
+      num_partitions, run_options->intra_op_thread_pool()->numThreads() + 1);
+  auto state = std::make_shared<WorkStealingState>(num_chunks, num_workers);
+  state->function = reinterpret_cast<ComputeFunctionType>(function_ptr);
+  state->result_ptr = result_ptr;
+  state->run_options_ptr = run_options_ptr;
+  state->buffer_table = buffer_table;
+  state->prof_counters = prof_counters;
+  state->stride = stride;
+  state->chunk_bounds = std::move(chunk_bounds);
+  state->partition_ids = std::move(partition_ids);
+  for (int32_t i = 0; i < num_workers; ++i) {
+    state->ranges[i].Reset(
+        first_chunk[static_cast<int64_t>(num_partitions) * i / num_workers],
+        first_chunk[static_cast<int64_t>(num_partitions) * (i + 1) /
+                    num_workers]);
   }
-  VLOG(2) << "ParallelForkJoin EXIT";
+
+  for (int32_t i = 1; i < num_workers; ++i) {
+    run_options->intra_op_thread_pool()->enqueueNoNotification(
+        [state, i]() { RunWorker(state.get(), i); });
+  }
+  RunWorker(state.get(), 0);
+  state->pending.Wait();
+
+  ReportPartitionErrors(state->statuses, state->partition_ids, status);
+  VLOG(2) << "ParallelForkJoinWorkStealing EXIT";
 }
@@ -28,6 +28,14 @@ extern void __xla_cpu_runtime_ParallelForkJoin(
     int32_t num_partitions, int64_t* partitions, int32_t num_partitioned_dims,
     void* function_ptr);
 
+// Same as __xla_cpu_runtime_ParallelForkJoin, but balances the work across
+// threads with work stealing. See comments in runtime_fork_join.cc.
+extern void __xla_cpu_runtime_ParallelForkJoinWorkStealing(
+    void* result_ptr, const void* run_options_ptr, const void** params,
+    void** buffer_table, void* status, uint64_t* prof_counters,
+    int32_t num_partitions, int64_t* partitions, int32_t num_partitioned_dims,
+    void* function_ptr);
+
 }  // extern "C"
 
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_FORK_JOIN_H_
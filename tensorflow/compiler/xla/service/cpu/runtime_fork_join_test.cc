@@ -0,0 +1,178 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#define EIGEN_USE_THREADS
+#include "tensorflow/compiler/xla/service/cpu/runtime_fork_join.h"
+
+#include <atomic>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/compiler/xla/executable_run_options.h"
+#include "tensorflow/compiler/xla/service/custom_call_status.h"
+#include "tensorflow/compiler/xla/service/custom_call_status_internal.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+namespace xla {
+namespace {
+
+using ForkJoinFunction = decltype(&__xla_cpu_runtime_ParallelForkJoin);
+
+ForkJoinFunction GetForkJoinFunction(bool work_stealing) {
+  return work_stealing ? &__xla_cpu_runtime_ParallelForkJoinWorkStealing
+                       : &__xla_cpu_runtime_ParallelForkJoin;
+}
+
+// Returns the loop bounds of a [rows, cols] array split into `row_partitions`
+// x `col_partitions` partitions, in the layout expected by the fork/join
+// runtime.
+std::vector<int64_t> Partition2D(int64_t rows, int64_t cols,
+                                 int64_t row_partitions,
+                                 int64_t col_partitions) {
+  std::vector<int64_t> partitions;
+  for (int64_t i = 0; i < row_partitions; ++i) {
+    for (int64_t j = 0; j < col_partitions; ++j) {
+      partitions.push_back(rows * i / row_partitions);
+      partitions.push_back(rows * (i + 1) / row_partitions);
+      partitions.push_back(cols * j / col_partitions);
+      partitions.push_back(cols * (j + 1) / col_partitions);
+    }
+  }
+  return partitions;
+}
+
+struct CountContext {
+  int64_t cols;
+  std::vector<std::atomic<int>> counts;
+};
+
+// Counts how often every element of a 2D array is visited.
+void CountElements(void* result, const void* run_options, const void** params,
+                   void** buffer_table, void* status, int64_t* bounds,
+                   uint64_t* prof_counters) {
+  auto* context = static_cast<CountContext*>(result);
+  for (int64_t i = bounds[0]; i < bounds[1]; ++i) {
+    for (int64_t j = bounds[2]; j < bounds[3]; ++j) {
+      context->counts[i * context->cols + j].fetch_add(1);
+    }
+  }
+}
+
+// Fails the call that computes row 0.
+void FailFirstRow(void* result, const void* run_options, const void** params,
+                  void** buffer_table, void* status, int64_t* bounds,
+                  uint64_t* prof_counters) {
+  if (bounds[0] == 0) {
+    const absl::string_view message = "first row";
+    XlaCustomCallStatusSetFailure(static_cast<XlaCustomCallStatus*>(status),
+                                  message.data(), message.size());
+  }
+}
+
+class RuntimeForkJoinTest : public ::testing::TestWithParam<bool> {
+ protected:
+  RuntimeForkJoinTest()
+      : pool_(tensorflow::Env::Default(), "XLAEigen", 4),
+        device_(pool_.AsEigenThreadPool(), pool_.NumThreads()) {
+    run_options_.set_intra_op_thread_pool(&device_);
+  }
+
+  tensorflow::thread::ThreadPool pool_;
+  Eigen::ThreadPoolDevice device_;
+  ExecutableRunOptions run_options_;
+};
+
+TEST_P(RuntimeForkJoinTest, VisitsEveryElementOnce) {
+  const int64_t rows = 37;
+  const int64_t cols = 10;
+  CountContext context{cols, std::vector<std::atomic<int>>(rows * cols)};
+  std::vector<int64_t> partitions = Partition2D(rows, cols, 5, 2);
+
+  XlaCustomCallStatus status;
+  GetForkJoinFunction(GetParam())(
+      &context, &run_options_, nullptr, nullptr, &status, nullptr,
+      /*num_partitions=*/10, partitions.data(), /*num_partitioned_dims=*/2,
+      reinterpret_cast<void*>(&CountElements));
+
+  EXPECT_FALSE(CustomCallStatusGetMessage(&status).has_value());
+  for (int64_t i = 0; i < rows * cols; ++i) {
+    EXPECT_EQ(context.counts[i].load(), 1) << "element " << i;
+  }
+}
+
+TEST_P(RuntimeForkJoinTest, ReportsPartitionErrors) {
+  std::vector<int64_t> partitions = Partition2D(64, 1, 4, 1);
+
+  XlaCustomCallStatus status;
+  GetForkJoinFunction(GetParam())(
+      nullptr, &run_options_, nullptr, nullptr, &status, nullptr,
+      /*num_partitions=*/4, partitions.data(), /*num_partitioned_dims=*/2,
+      reinterpret_cast<void*>(&FailFirstRow));
+
+  absl::optional<absl::string_view> message =
+      CustomCallStatusGetMessage(&status);
+  ASSERT_TRUE(message.has_value());
+  EXPECT_EQ(*message, "Partition 0 error: first row");
+}
+
+INSTANTIATE_TEST_SUITE_P(ForkJoinAndWorkStealing, RuntimeForkJoinTest,
+                         ::testing::Bool());
+
+// Burns time proportional to the square of the row index, so that the last
+// partitions are much more expensive than the first ones.
+void SkewedRows(void* result, const void* run_options, const void** params,
+                void** buffer_table, void* status, int64_t* bounds,
+                uint64_t* prof_counters) {
+  float* sink = static_cast<float*>(result);
+  float acc = 0;
+  for (int64_t i = bounds[0]; i < bounds[1]; ++i) {
+    for (int64_t j = 0; j < i * i; ++j) {
+      acc += 1.0f / (j + 1);
+    }
+  }
+  sink[bounds[0]] = acc;
+}
+
+// Runs a loop of state.range(0) skewed rows split into 16 partitions on a
+// pool of 8 threads, with (state.range(1) == 1) or without work stealing.
+void BM_SkewedParallelLoop(::testing::benchmark::State& state) {
+  const int64_t rows = state.range(0);
+  tensorflow::thread::ThreadPool pool(tensorflow::Env::Default(), "XLAEigen",
+                                      8);
+  Eigen::ThreadPoolDevice device(pool.AsEigenThreadPool(), pool.NumThreads());
+  ExecutableRunOptions run_options;
+  run_options.set_intra_op_thread_pool(&device);
+  std::vector<int64_t> partitions = Partition2D(rows, 1, 16, 1);
+  std::vector<float> sink(rows);
+  ForkJoinFunction fork_join = GetForkJoinFunction(state.range(1) == 1);
+
+  for (auto s : state) {
+    XlaCustomCallStatus status;
+    fork_join(sink.data(), &run_options, nullptr, nullptr, &status, nullptr,
+              /*num_partitions=*/16, partitions.data(),
+              /*num_partitioned_dims=*/2, reinterpret_cast<void*>(&SkewedRows));
+  }
+}
+BENCHMARK(BM_SkewedParallelLoop)
+    ->ArgPair(256, 0)
+    ->ArgPair(256, 1)
+    ->ArgPair(1024, 0)
+    ->ArgPair(1024, 1);
+
+}  // namespace
+}  // namespace xla
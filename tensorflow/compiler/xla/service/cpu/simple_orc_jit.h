@@ -28,6 +28,7 @@ limitations under the License.
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/SymbolStringPool.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Target/TargetMachine.h"
 #include "tensorflow/compiler/xla/service/cpu/compiler_functor.h"
 #include "tensorflow/compiler/xla/types.h"
@@ -79,6 +80,12 @@ class SimpleOrcJIT : public llvm::JITEventListener {
 
   llvm::Error AddModule(llvm::orc::ThreadSafeModule module);
 
+  // Adds an already compiled relocatable object file to the JIT. The object
+  // file must have been generated for this JIT's target machine.  Symbols left
+  // undefined by it are resolved against the other objects in the JIT, which
+  // lets a module be compiled as several separately generated objects.
+  llvm::Error AddObjectFile(std::unique_ptr<llvm::MemoryBuffer> obj_file);
+
   // Discards objects we no longer need once we are done compiling.
   void DoneCompiling();
 
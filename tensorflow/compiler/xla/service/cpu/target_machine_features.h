@@ -101,6 +101,8 @@ class LLVMTargetMachineFeatures : public TargetMachineFeatures {
 
   int64_t minimum_alignment_for_allocation(int64_t size_bytes) const override;
 
+  llvm::TargetMachine* target_machine() const { return target_machine_; }
+
  private:
   llvm::TargetTransformInfo* GetTargetTransformInfoFor(
       const llvm::Function& function) const;
@@ -0,0 +1,75 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/temp_arena_pool.h"
+
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/core/platform/mem.h"
+
+namespace xla {
+namespace cpu {
+
+/*static*/ std::shared_ptr<TempArenaPool> TempArenaPool::Create(
+    int64_t arena_bytes, int64_t alignment, int64_t max_retained_bytes) {
+  return std::shared_ptr<TempArenaPool>(
+      new TempArenaPool(arena_bytes, alignment, max_retained_bytes));
+}
+
+TempArenaPool::~TempArenaPool() {
+  for (char* arena : free_arenas_) {
+    tensorflow::port::AlignedFree(arena);
+  }
+}
+
+StatusOr<TempArenaPool::Arena> TempArenaPool::Acquire() {
+  char* arena = nullptr;
+  {
+    absl::MutexLock lock(&mu_);
+    if (!free_arenas_.empty()) {
+      arena = free_arenas_.back();
+      free_arenas_.pop_back();
+    }
+  }
+  if (arena == nullptr) {
+    arena = static_cast<char*>(
+        tensorflow::port::AlignedMalloc(arena_bytes_, alignment_));
+    if (arena == nullptr) {
+      return ResourceExhausted(
+          "Failed to allocate %d bytes for temporary buffers", arena_bytes_);
+    }
+  }
+  // The deleter keeps the pool alive until the arena is back.
+  std::shared_ptr<TempArenaPool> pool = shared_from_this();
+  return Arena(arena, [pool](char* arena) { pool->Release(arena); });
+}
+
+void TempArenaPool::Release(char* arena) {
+  {
+    absl::MutexLock lock(&mu_);
+    if (static_cast<int64_t>(free_arenas_.size()) < max_retained_arenas_) {
+      free_arenas_.push_back(arena);
+      return;
+    }
+  }
+  tensorflow::port::AlignedFree(arena);
+}
+
+int64_t TempArenaPool::num_retained_arenas() const {
+  absl::MutexLock lock(&mu_);
+  return free_arenas_.size();
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,79 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_TEMP_ARENA_POOL_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_TEMP_ARENA_POOL_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "tensorflow/compiler/xla/statusor.h"
+
+namespace xla {
+namespace cpu {
+
+// A pool of equally sized host memory blocks ("arenas") that hold all
+// temporary buffers of one execution of a CpuExecutable.
+//
+// Arenas are allocated on first use and returned to the pool when the
+// execution is done, so the pool ends up with one arena per execution that
+// ran concurrently.  Returned arenas that would make the pool retain more than
+// `max_retained_bytes` are freed instead.
+class TempArenaPool : public std::enable_shared_from_this<TempArenaPool> {
+ public:
+  // An arena in use.  It goes back to the pool when the last reference to it
+  // is dropped, which may outlive the CpuExecutable that owns the pool.
+  using Arena = std::shared_ptr<char>;
+
+  // Arenas are aligned to `alignment` bytes.
+  static std::shared_ptr<TempArenaPool> Create(int64_t arena_bytes,
+                                               int64_t alignment,
+                                               int64_t max_retained_bytes);
+  ~TempArenaPool();
+
+  // Returns an arena of arena_bytes() bytes, reusing a retained one if there
+  // is one.
+  StatusOr<Arena> Acquire();
+
+  int64_t arena_bytes() const { return arena_bytes_; }
+
+  // The number of arenas currently held by the pool and not in use.
+  int64_t num_retained_arenas() const;
+
+ private:
+  TempArenaPool(int64_t arena_bytes, int64_t alignment,
+                int64_t max_retained_bytes)
+      : arena_bytes_(arena_bytes),
+        alignment_(alignment),
+        max_retained_arenas_(arena_bytes > 0
+                                 ? max_retained_bytes / arena_bytes
+                                 : 0) {}
+
+  void Release(char* arena);
+
+  const int64_t arena_bytes_;
+  const int64_t alignment_;
+  const int64_t max_retained_arenas_;
+
+  mutable absl::Mutex mu_;
+  std::vector<char*> free_arenas_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_TEMP_ARENA_POOL_H_
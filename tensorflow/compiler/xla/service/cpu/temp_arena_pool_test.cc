@@ -0,0 +1,80 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/temp_arena_pool.h"
+
+#include <cstdint>
+#include <memory>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+TEST(TempArenaPoolTest, ReusesReleasedArenas) {
+  std::shared_ptr<TempArenaPool> pool =
+      TempArenaPool::Create(/*arena_bytes=*/1024, /*alignment=*/64,
+                            /*max_retained_bytes=*/4096);
+  TempArenaPool::Arena arena = pool->Acquire().ValueOrDie();
+  char* data = arena.get();
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(data) % 64, 0);
+  EXPECT_EQ(pool->num_retained_arenas(), 0);
+
+  arena.reset();
+  EXPECT_EQ(pool->num_retained_arenas(), 1);
+  arena = pool->Acquire().ValueOrDie();
+  EXPECT_EQ(arena.get(), data);
+  EXPECT_EQ(pool->num_retained_arenas(), 0);
+}
+
+TEST(TempArenaPoolTest, ConcurrentUsersGetDistinctArenas) {
+  std::shared_ptr<TempArenaPool> pool =
+      TempArenaPool::Create(/*arena_bytes=*/1024, /*alignment=*/64,
+                            /*max_retained_bytes=*/4096);
+  TempArenaPool::Arena a = pool->Acquire().ValueOrDie();
+  TempArenaPool::Arena b = pool->Acquire().ValueOrDie();
+  EXPECT_NE(a.get(), b.get());
+  a.reset();
+  b.reset();
+  EXPECT_EQ(pool->num_retained_arenas(), 2);
+}
+
+TEST(TempArenaPoolTest, RetainsAtMostMaxRetainedBytes) {
+  std::shared_ptr<TempArenaPool> pool =
+      TempArenaPool::Create(/*arena_bytes=*/1024, /*alignment=*/64,
+                            /*max_retained_bytes=*/2048);
+  TempArenaPool::Arena a = pool->Acquire().ValueOrDie();
+  TempArenaPool::Arena b = pool->Acquire().ValueOrDie();
+  TempArenaPool::Arena c = pool->Acquire().ValueOrDie();
+  a.reset();
+  b.reset();
+  c.reset();
+  EXPECT_EQ(pool->num_retained_arenas(), 2);
+}
+
+TEST(TempArenaPoolTest, ArenasOutliveThePool) {
+  std::shared_ptr<TempArenaPool> pool =
+      TempArenaPool::Create(/*arena_bytes=*/1024, /*alignment=*/64,
+                            /*max_retained_bytes=*/4096);
+  TempArenaPool::Arena arena = pool->Acquire().ValueOrDie();
+  pool.reset();
+  arena.get()[1023] = 1;
+  arena.reset();
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
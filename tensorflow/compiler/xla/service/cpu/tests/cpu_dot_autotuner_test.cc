@@ -0,0 +1,112 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/cpu_dot_autotuner.h"
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/compiler/xla/service/cpu/backend_config.pb.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+const char* const kDotHlo = R"(
+HloModule dot
+
+ENTRY dot {
+  lhs = f32[64,128] parameter(0)
+  rhs = f32[128,96] parameter(1)
+  ROOT dot = f32[64,96] dot(lhs, rhs), lhs_contracting_dims={1},
+                                        rhs_contracting_dims={0}
+})";
+
+class CpuDotAutotunerTest : public HloTestBase {
+ protected:
+  void SetUp() override { CpuDotAutotuner::ClearCache(); }
+
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = HloTestBase::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_enable_dot_autotuning(true);
+    debug_options.set_xla_cpu_dot_autotune_results_path(results_path_);
+    return debug_options;
+  }
+
+  // Returns the backend config of the dot after running the CPU HLO passes.
+  DotBackendConfig GetOptimizedDotConfig() {
+    std::unique_ptr<HloModule> module =
+        ParseAndReturnVerifiedModule(kDotHlo).ValueOrDie();
+    module = backend()
+                 .compiler()
+                 ->RunHloPasses(std::move(module),
+                                backend().default_stream_executor(),
+                                /*device_allocator=*/nullptr)
+                 .ValueOrDie();
+    for (const HloInstruction* instr :
+         module->entry_computation()->instructions()) {
+      if (instr->opcode() == HloOpcode::kDot) {
+        return instr->backend_config<DotBackendConfig>().ValueOrDie();
+      }
+    }
+    ADD_FAILURE() << "No dot in " << module->ToString();
+    return DotBackendConfig();
+  }
+
+  std::string results_path_;
+};
+
+TEST_F(CpuDotAutotunerTest, AutotunedDotIsCorrect) {
+  EXPECT_NE(GetOptimizedDotConfig().strategy(), DotBackendConfig::DEFAULT);
+  EXPECT_TRUE(RunAndCompare(kDotHlo, ErrorSpec{1e-4, 1e-4}));
+}
+
+TEST_F(CpuDotAutotunerTest, ResultsAreLoadedFromFile) {
+  results_path_ = tensorflow::io::JoinPath(tensorflow::testing::TmpDir(),
+                                           "dot_autotune_results.pbtxt");
+  tensorflow::Env* env = tensorflow::Env::Default();
+  env->DeleteFile(results_path_).IgnoreError();
+
+  GetOptimizedDotConfig();
+  DotAutotuneResults results;
+  TF_ASSERT_OK(tensorflow::ReadTextProto(env, results_path_, &results));
+  ASSERT_EQ(results.entries_size(), 1);
+  EXPECT_FALSE(results.entries(0).cpu().empty());
+
+  // A fresh process picks up the (edited) results instead of measuring.
+  DotBackendConfig* config = results.mutable_entries(0)->mutable_config();
+  config->set_strategy(DotBackendConfig::TILED_LLVM_IR_GEMM);
+  config->set_tile_size_m(4);
+  config->set_tile_size_k(4);
+  config->set_tile_size_n_in_vector_width(1);
+  TF_ASSERT_OK(tensorflow::WriteTextProto(env, results_path_, results));
+  CpuDotAutotuner::ClearCache();
+
+  DotBackendConfig loaded = GetOptimizedDotConfig();
+  EXPECT_EQ(loaded.strategy(), DotBackendConfig::TILED_LLVM_IR_GEMM);
+  EXPECT_EQ(loaded.tile_size_m(), 4);
+  EXPECT_EQ(loaded.tile_size_k(), 4);
+  EXPECT_TRUE(RunAndCompare(kDotHlo, ErrorSpec{1e-4, 1e-4}));
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
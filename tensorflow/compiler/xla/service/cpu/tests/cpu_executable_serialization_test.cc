@@ -0,0 +1,152 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/compiler/xla/client/local_client.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/compiler/xla/tests/local_client_test_base.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Builds a computation with `num_ops` dependent elementwise ops so that the
+// cost of running the LLVM backend grows with `num_ops`.
+XlaComputation BuildChain(const std::string& name, int num_ops) {
+  XlaBuilder builder(name);
+  auto x = Parameter(&builder, 0, ShapeUtil::MakeShape(F32, {4}), "x");
+  auto y = x;
+  for (int i = 0; i < num_ops; ++i) {
+    y = Add(Mul(y, x), ConstantR1<float>(&builder, {1.0f, 2.0f, 3.0f, 4.0f}));
+  }
+  return builder.Build().ConsumeValueOrDie();
+}
+
+class CpuExecutableSerializationTest : public LocalClientTestBase {
+ protected:
+  ExecutableBuildOptions RetainingBuildOptions() const {
+    ExecutableBuildOptions options = DefaultExecutableBuildOptions();
+    options.mutable_debug_options()->set_xla_cpu_retain_object_files(true);
+    return options;
+  }
+
+  std::unique_ptr<LocalExecutable> Compile(
+      const XlaComputation& computation, const Shape& argument_shape,
+      const ExecutableBuildOptions& options) {
+    auto executables =
+        local_client_->Compile(computation, {&argument_shape}, options);
+    TF_CHECK_OK(executables.status());
+    return std::move(executables.ValueOrDie()[0]);
+  }
+
+  Literal Run(LocalExecutable* executable, const Literal& argument) {
+    ScopedShapedBuffer buffer = LiteralToShapedBuffer(argument);
+    auto result = executable->Run({&buffer}, DefaultExecutableRunOptions());
+    TF_CHECK_OK(result.status());
+    return ShapedBufferToLiteral(result.ValueOrDie());
+  }
+};
+
+TEST_F(CpuExecutableSerializationTest, RoundTrip) {
+  XlaComputation computation = BuildChain(TestName(), /*num_ops=*/3);
+  Literal argument = LiteralUtil::CreateR1<float>({1.0f, -2.0f, 0.5f, 3.0f});
+
+  std::unique_ptr<LocalExecutable> compiled =
+      Compile(computation, argument.shape(), RetainingBuildOptions());
+  TF_ASSERT_OK_AND_ASSIGN(std::string serialized,
+                          local_client_->SerializeExecutable(*compiled));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<LocalExecutable> loaded,
+      local_client_->Load(serialized, DefaultExecutableBuildOptions()));
+
+  EXPECT_TRUE(LiteralTestUtil::Equal(Run(compiled.get(), argument),
+                                     Run(loaded.get(), argument)));
+
+  // A reloaded executable can itself be exported again.
+  TF_ASSERT_OK_AND_ASSIGN(std::string reserialized,
+                          local_client_->SerializeExecutable(*loaded));
+  EXPECT_FALSE(reserialized.empty());
+}
+
+TEST_F(CpuExecutableSerializationTest, ExportRequiresRetainedObjectFiles) {
+  XlaComputation computation = BuildChain(TestName(), /*num_ops=*/1);
+  std::unique_ptr<LocalExecutable> compiled =
+      Compile(computation, ShapeUtil::MakeShape(F32, {4}),
+              DefaultExecutableBuildOptions());
+  EXPECT_FALSE(local_client_->SerializeExecutable(*compiled).ok());
+}
+
+TEST_F(CpuExecutableSerializationTest, RejectsCorruptExecutable) {
+  EXPECT_FALSE(
+      local_client_->Load("not an executable", DefaultExecutableBuildOptions())
+          .ok());
+}
+
+// Measures time to the first result of a freshly built executable, either by
+// compiling it (state.range(0) == 0, a cold persistent cache) or by loading a
+// serialized copy (state.range(0) == 1, a warm persistent cache).
+void BM_TimeToFirstRun(::testing::benchmark::State& state) {
+  const bool warm = state.range(0) == 1;
+  const int num_ops = state.range(1);
+  LocalClient* client = ClientLibrary::LocalClientOrDie();
+  XlaComputation computation = BuildChain("chain", num_ops);
+  const Shape argument_shape = ShapeUtil::MakeShape(F32, {4});
+  Literal argument = LiteralUtil::CreateR1<float>({1.0f, 2.0f, 3.0f, 4.0f});
+  ScopedShapedBuffer buffer =
+      client->LiteralToShapedBuffer(argument, client->default_device_ordinal())
+          .ConsumeValueOrDie();
+
+  ExecutableBuildOptions options;
+  options.mutable_debug_options()->set_xla_cpu_retain_object_files(true);
+  std::string serialized =
+      client
+          ->SerializeExecutable(
+              *client->Compile(computation, {&argument_shape}, options)
+                   .ConsumeValueOrDie()[0])
+          .ConsumeValueOrDie();
+
+  ExecutableRunOptions run_options;
+  run_options.set_allocator(client->backend().memory_allocator());
+  for (auto s : state) {
+    std::unique_ptr<LocalExecutable> executable;
+    if (warm) {
+      executable = client->Load(serialized, options).ConsumeValueOrDie();
+    } else {
+      executable = std::move(
+          client->Compile(computation, {&argument_shape}, options)
+              .ConsumeValueOrDie()[0]);
+    }
+    CHECK(executable->Run({&buffer}, run_options).ok());
+  }
+}
+BENCHMARK(BM_TimeToFirstRun)
+    ->ArgPair(0, 10)
+    ->ArgPair(1, 10)
+    ->ArgPair(0, 100)
+    ->ArgPair(1, 100)
+    ->ArgPair(0, 1000)
+    ->ArgPair(1, 1000);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,187 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+#include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/compiler/xla/client/local_client.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/test_utils.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Normalizes every row of a [$rows,$cols] matrix.  The row sum and the row sum
+// of squares read the same input and are fused into a multi-output fusion.
+const char* const kLayerNormHlo = R"(
+HloModule layer_norm
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT sum = f32[] add(a, b)
+}
+
+ENTRY layer_norm {
+  x = f32[$rows,$cols] parameter(0)
+  zero = f32[] constant(0)
+  sum = f32[$rows] reduce(x, zero), dimensions={1}, to_apply=add
+  square = f32[$rows,$cols] multiply(x, x)
+  square_sum = f32[$rows] reduce(square, zero), dimensions={1}, to_apply=add
+  inv_cols = f32[] constant($inv_cols)
+  inv_cols_b = f32[$rows] broadcast(inv_cols), dimensions={}
+  mean = f32[$rows] multiply(sum, inv_cols_b)
+  mean_square = f32[$rows] multiply(square_sum, inv_cols_b)
+  square_mean = f32[$rows] multiply(mean, mean)
+  variance = f32[$rows] subtract(mean_square, square_mean)
+  epsilon = f32[] constant(1e-5)
+  epsilon_b = f32[$rows] broadcast(epsilon), dimensions={}
+  variance_epsilon = f32[$rows] add(variance, epsilon_b)
+  rsqrt = f32[$rows] rsqrt(variance_epsilon)
+  mean_b = f32[$rows,$cols] broadcast(mean), dimensions={0}
+  rsqrt_b = f32[$rows,$cols] broadcast(rsqrt), dimensions={0}
+  centered = f32[$rows,$cols] subtract(x, mean_b)
+  ROOT normalized = f32[$rows,$cols] multiply(centered, rsqrt_b)
+})";
+
+// Row-wise softmax of a [$rows,$cols] matrix.
+const char* const kSoftmaxHlo = R"(
+HloModule softmax
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT sum = f32[] add(a, b)
+}
+
+max {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT max = f32[] maximum(a, b)
+}
+
+ENTRY softmax {
+  x = f32[$rows,$cols] parameter(0)
+  neg_inf = f32[] constant(-inf)
+  row_max = f32[$rows] reduce(x, neg_inf), dimensions={1}, to_apply=max
+  row_max_b = f32[$rows,$cols] broadcast(row_max), dimensions={0}
+  shifted = f32[$rows,$cols] subtract(x, row_max_b)
+  exp = f32[$rows,$cols] exponential(shifted)
+  zero = f32[] constant(0)
+  row_sum = f32[$rows] reduce(exp, zero), dimensions={1}, to_apply=add
+  row_sum_b = f32[$rows,$cols] broadcast(row_sum), dimensions={0}
+  ROOT softmax = f32[$rows,$cols] divide(exp, row_sum_b)
+})";
+
+std::string MakeHlo(const char* hlo_template, int64_t rows, int64_t cols) {
+  return absl::StrReplaceAll(hlo_template,
+                             {{"$rows", absl::StrCat(rows)},
+                              {"$cols", absl::StrCat(cols)},
+                              {"$inv_cols", absl::StrCat(1.0 / cols)}});
+}
+
+class CpuMultiOutputFusionTest : public HloTestBase {};
+
+TEST_F(CpuMultiOutputFusionTest, LayerNorm) {
+  EXPECT_TRUE(RunAndCompare(MakeHlo(kLayerNormHlo, 256, 1024),
+                            ErrorSpec{1e-4, 1e-4}));
+}
+
+TEST_F(CpuMultiOutputFusionTest, LayerNormLargeRows) {
+  // Large enough for the fusion to be split across threads.
+  EXPECT_TRUE(RunAndCompare(MakeHlo(kLayerNormHlo, 4096, 2048),
+                            ErrorSpec{1e-4, 1e-4}));
+}
+
+TEST_F(CpuMultiOutputFusionTest, Softmax) {
+  EXPECT_TRUE(
+      RunAndCompare(MakeHlo(kSoftmaxHlo, 256, 1024), ErrorSpec{1e-5, 1e-5}));
+}
+
+// Runs the HLO built from `hlo_template` with state.range(0) rows of 1024
+// columns, with (state.range(1) == 1) or without multi-output fusion.
+void BenchmarkHlo(::testing::benchmark::State& state,
+                  const char* hlo_template) {
+  const int64_t rows = state.range(0);
+  const bool multi_output_fusion = state.range(1) == 1;
+  LocalClient* client = ClientLibrary::LocalClientOrDie();
+
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnUnverifiedModule(MakeHlo(hlo_template, rows, 1024))
+          .ConsumeValueOrDie();
+  XlaComputation computation(module->ToProto());
+  const Shape& argument_shape =
+      module->entry_computation()->parameter_instruction(0)->shape();
+
+  ExecutableBuildOptions options;
+  if (!multi_output_fusion) {
+    options.mutable_debug_options()->add_xla_disable_hlo_passes(
+        "cpu_multi_output_fusion");
+  }
+  std::unique_ptr<LocalExecutable> executable = std::move(
+      client->Compile(computation, {&argument_shape}, options)
+          .ConsumeValueOrDie()[0]);
+
+  Literal argument = MakeFakeLiteral(argument_shape).ConsumeValueOrDie();
+  ScopedShapedBuffer buffer =
+      client->LiteralToShapedBuffer(argument, client->default_device_ordinal())
+          .ConsumeValueOrDie();
+  ExecutableRunOptions run_options;
+  run_options.set_allocator(client->backend().memory_allocator());
+  run_options.set_intra_op_thread_pool(
+      client->backend().eigen_intra_op_thread_pool_device());
+
+  for (auto s : state) {
+    CHECK(executable->Run({&buffer}, run_options).ok());
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          ShapeUtil::ByteSizeOf(argument_shape));
+}
+
+void BM_LayerNorm(::testing::benchmark::State& state) {
+  BenchmarkHlo(state, kLayerNormHlo);
+}
+BENCHMARK(BM_LayerNorm)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 1)
+    ->ArgPair(1024, 0)
+    ->ArgPair(1024, 1)
+    ->ArgPair(8192, 0)
+    ->ArgPair(8192, 1);
+
+void BM_Softmax(::testing::benchmark::State& state) {
+  BenchmarkHlo(state, kSoftmaxHlo);
+}
+BENCHMARK(BM_Softmax)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 1)
+    ->ArgPair(1024, 0)
+    ->ArgPair(1024, 1)
+    ->ArgPair(8192, 0)
+    ->ArgPair(8192, 1);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,247 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/compiler/xla/client/lib/arithmetic.h"
+#include "tensorflow/compiler/xla/client/lib/comparators.h"
+#include "tensorflow/compiler/xla/client/local_client.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/compiler/xla/tests/local_client_test_base.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Computes the next value of the data carried by loop `i`.
+using LoopBodyFn = std::function<XlaOp(XlaBuilder*, XlaOp, int)>;
+
+// Builds a computation with `num_loops` while loops in sequence over an
+// F32[`size`] parameter.  Every loop has its own condition and body
+// computation, each of which is emitted as a separate LLVM function, so the
+// module grows with `num_loops`.
+XlaComputation BuildLoops(const std::string& name, int num_loops, int size,
+                          const LoopBodyFn& body_fn) {
+  XlaBuilder builder(name);
+  const Shape data_shape = ShapeUtil::MakeShape(F32, {size});
+  const Shape loop_shape = ShapeUtil::MakeTupleShape(
+      {ShapeUtil::MakeShape(S32, {}), data_shape});
+  XlaOp y = Parameter(&builder, 0, data_shape, "x");
+  for (int i = 0; i < num_loops; ++i) {
+    std::unique_ptr<XlaBuilder> condition_builder =
+        builder.CreateSubBuilder(absl::StrCat("condition_", i));
+    {
+      XlaOp state = Parameter(condition_builder.get(), 0, loop_shape, "state");
+      Lt(GetTupleElement(state, 0),
+         ConstantR0<int32_t>(condition_builder.get(), 10));
+    }
+    XlaComputation condition = condition_builder->Build().ConsumeValueOrDie();
+
+    std::unique_ptr<XlaBuilder> body_builder =
+        builder.CreateSubBuilder(absl::StrCat("body_", i));
+    {
+      XlaOp state = Parameter(body_builder.get(), 0, loop_shape, "state");
+      XlaOp counter = GetTupleElement(state, 0);
+      XlaOp data = GetTupleElement(state, 1);
+      Tuple(body_builder.get(),
+            {Add(counter, ConstantR0<int32_t>(body_builder.get(), 1)),
+             body_fn(body_builder.get(), data, i)});
+    }
+    XlaComputation body = body_builder->Build().ConsumeValueOrDie();
+
+    y = GetTupleElement(
+        While(condition, body,
+              Tuple(&builder, {ConstantR0<int32_t>(&builder, 0), y})),
+        1);
+  }
+  return builder.Build().ConsumeValueOrDie();
+}
+
+// Loops that only do elementwise arithmetic.
+XlaComputation BuildElementwiseLoops(const std::string& name, int num_loops) {
+  return BuildLoops(name, num_loops, /*size=*/16,
+                    [](XlaBuilder* b, XlaOp data, int i) {
+                      return Add(Mul(data, ConstantR0<float>(b, 0.5f)),
+                                 ConstantR0<float>(b, i % 7));
+                    });
+}
+
+// Loops that sort and reduce their data, so that most of the time is spent in
+// calls to the comparator and reducer computations.
+XlaComputation BuildReduceAndSortLoops(const std::string& name, int num_loops,
+                                       int size) {
+  return BuildLoops(
+      name, num_loops, size, [](XlaBuilder* b, XlaOp data, int i) {
+        XlaOp sorted =
+            Sort({Rev(data, {0})}, CreateScalarLtComputation({F32}, b));
+        XlaOp sum = Reduce(sorted, ConstantR0<float>(b, 0.0f),
+                           CreateScalarAddComputation(F32, b), {0});
+        return Sub(sorted, Mul(sum, ConstantR0<float>(b, 1e-3f)));
+      });
+}
+
+class CpuParallelCodegenTest : public LocalClientTestBase {
+ protected:
+  ExecutableBuildOptions BuildOptions(int parallelism) const {
+    ExecutableBuildOptions options = DefaultExecutableBuildOptions();
+    options.mutable_debug_options()->set_xla_cpu_force_compilation_parallelism(
+        parallelism);
+    return options;
+  }
+
+  std::unique_ptr<LocalExecutable> Compile(
+      const XlaComputation& computation, const Shape& argument_shape,
+      const ExecutableBuildOptions& options) {
+    auto executables =
+        local_client_->Compile(computation, {&argument_shape}, options);
+    TF_CHECK_OK(executables.status());
+    return std::move(executables.ValueOrDie()[0]);
+  }
+
+  Literal Run(LocalExecutable* executable, const Literal& argument) {
+    ScopedShapedBuffer buffer = LiteralToShapedBuffer(argument);
+    auto result = executable->Run({&buffer}, DefaultExecutableRunOptions());
+    TF_CHECK_OK(result.status());
+    return ShapedBufferToLiteral(result.ValueOrDie());
+  }
+
+  Literal Argument(int size = 16) const {
+    Literal argument(ShapeUtil::MakeShape(F32, {size}));
+    TF_CHECK_OK(argument.Populate<float>([](absl::Span<const int64_t> index) {
+      return static_cast<float>((index[0] * 7919) % 101);
+    }));
+    return argument;
+  }
+};
+
+TEST_F(CpuParallelCodegenTest, MatchesSingleModule) {
+  XlaComputation computation =
+      BuildElementwiseLoops(TestName(), /*num_loops=*/16);
+  Literal argument = Argument();
+
+  std::unique_ptr<LocalExecutable> serial =
+      Compile(computation, argument.shape(), BuildOptions(1));
+  std::unique_ptr<LocalExecutable> parallel =
+      Compile(computation, argument.shape(), BuildOptions(4));
+  EXPECT_TRUE(LiteralTestUtil::Equal(Run(serial.get(), argument),
+                                     Run(parallel.get(), argument)));
+}
+
+TEST_F(CpuParallelCodegenTest, MatchesSingleModuleWithReducersAndComparators) {
+  XlaComputation computation =
+      BuildReduceAndSortLoops(TestName(), /*num_loops=*/16, /*size=*/256);
+  Literal argument = Argument(256);
+
+  std::unique_ptr<LocalExecutable> serial =
+      Compile(computation, argument.shape(), BuildOptions(1));
+  std::unique_ptr<LocalExecutable> parallel =
+      Compile(computation, argument.shape(), BuildOptions(4));
+  EXPECT_TRUE(LiteralTestUtil::Equal(Run(serial.get(), argument),
+                                     Run(parallel.get(), argument)));
+}
+
+TEST_F(CpuParallelCodegenTest, SerializesAllObjectFiles) {
+  XlaComputation computation =
+      BuildElementwiseLoops(TestName(), /*num_loops=*/16);
+  Literal argument = Argument();
+
+  ExecutableBuildOptions options = BuildOptions(4);
+  options.mutable_debug_options()->set_xla_cpu_retain_object_files(true);
+  std::unique_ptr<LocalExecutable> compiled =
+      Compile(computation, argument.shape(), options);
+  TF_ASSERT_OK_AND_ASSIGN(std::string serialized,
+                          local_client_->SerializeExecutable(*compiled));
+  TF_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<LocalExecutable> loaded,
+      local_client_->Load(serialized, DefaultExecutableBuildOptions()));
+  EXPECT_TRUE(LiteralTestUtil::Equal(Run(compiled.get(), argument),
+                                     Run(loaded.get(), argument)));
+}
+
+// Measures the time to compile a module with state.range(1) loops using
+// state.range(0) code generation threads.
+void BM_CompileLoops(::testing::benchmark::State& state) {
+  const int parallelism = state.range(0);
+  const int num_loops = state.range(1);
+  LocalClient* client = ClientLibrary::LocalClientOrDie();
+  XlaComputation computation = BuildElementwiseLoops("loops", num_loops);
+  const Shape argument_shape = ShapeUtil::MakeShape(F32, {16});
+
+  ExecutableBuildOptions options;
+  options.mutable_debug_options()->set_xla_cpu_force_compilation_parallelism(
+      parallelism);
+  for (auto s : state) {
+    CHECK(client->Compile(computation, {&argument_shape}, options).ok());
+  }
+}
+BENCHMARK(BM_CompileLoops)
+    ->ArgPair(1, 10)
+    ->ArgPair(8, 10)
+    ->ArgPair(1, 100)
+    ->ArgPair(8, 100)
+    ->ArgPair(1, 1000)
+    ->ArgPair(8, 1000);
+
+// Measures the time to run a module with state.range(1) loops that sort and
+// reduce, compiled with state.range(0) code generation threads.  Splitting the
+// module must not cost the inlining of the comparators and reducers, so both
+// should run equally fast.
+void BM_RunReduceAndSortLoops(::testing::benchmark::State& state) {
+  const int parallelism = state.range(0);
+  const int num_loops = state.range(1);
+  constexpr int kSize = 4096;
+  LocalClient* client = ClientLibrary::LocalClientOrDie();
+  XlaComputation computation =
+      BuildReduceAndSortLoops("reduce_and_sort", num_loops, kSize);
+  const Shape argument_shape = ShapeUtil::MakeShape(F32, {kSize});
+
+  ExecutableBuildOptions options;
+  options.mutable_debug_options()->set_xla_cpu_force_compilation_parallelism(
+      parallelism);
+  auto executables = client->Compile(computation, {&argument_shape}, options);
+  TF_CHECK_OK(executables.status());
+  std::unique_ptr<LocalExecutable> executable =
+      std::move(executables.ValueOrDie()[0]);
+
+  Literal argument(argument_shape);
+  argument.PopulateWithValue(1.0f);
+  auto buffer = client->LiteralToShapedBuffer(argument,
+                                              client->default_device_ordinal());
+  TF_CHECK_OK(buffer.status());
+  ExecutableRunOptions run_options;
+  run_options.set_allocator(client->backend().memory_allocator());
+  for (auto s : state) {
+    TF_CHECK_OK(executable->Run({&buffer.ValueOrDie()}, run_options).status());
+  }
+  state.SetItemsProcessed(state.iterations() * num_loops * 10 * kSize);
+}
+BENCHMARK(BM_RunReduceAndSortLoops)
+    ->ArgPair(1, 8)
+    ->ArgPair(8, 8)
+    ->ArgPair(1, 64)
+    ->ArgPair(8, 64);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
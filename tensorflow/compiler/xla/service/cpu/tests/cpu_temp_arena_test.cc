@@ -0,0 +1,107 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <utility>
+
+#include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/compiler/xla/client/local_client.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/test_utils.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// A tiny computation whose dots are not fused, so that their results live in
+// temporary buffers.
+const char* const kTinyHlo = R"(
+HloModule tiny
+
+ENTRY tiny {
+  x = f32[8,8] parameter(0)
+  y = f32[8,8] parameter(1)
+  xy = f32[8,8] dot(x, y), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  tanh = f32[8,8] tanh(xy)
+  yx = f32[8,8] dot(y, tanh), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  ROOT add = f32[8,8] add(yx, x)
+})";
+
+class CpuTempArenaTest : public HloTestBase,
+                         public ::testing::WithParamInterface<bool> {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = HloTestBase::GetDebugOptionsForTest();
+    if (!GetParam()) {
+      debug_options.set_xla_cpu_max_retained_temp_buffer_bytes(0);
+    }
+    return debug_options;
+  }
+};
+
+TEST_P(CpuTempArenaTest, RepeatedRunsAreCorrect) {
+  // The second and later runs reuse the arena of the first one.
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(RunAndCompare(kTinyHlo, ErrorSpec{1e-5, 1e-5}));
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(CpuTempArenaTestInstantiation, CpuTempArenaTest,
+                         ::testing::Bool());
+
+// Measures the per-call overhead of running kTinyHlo, with (state.range(0) ==
+// 1) or without temp buffers being kept across runs.
+void BM_TinyExecutable(::testing::benchmark::State& state) {
+  const bool reuse_temp_buffers = state.range(0) == 1;
+  LocalClient* client = ClientLibrary::LocalClientOrDie();
+
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnUnverifiedModule(kTinyHlo).ConsumeValueOrDie();
+  XlaComputation computation(module->ToProto());
+  const Shape& argument_shape =
+      module->entry_computation()->parameter_instruction(0)->shape();
+
+  ExecutableBuildOptions options;
+  if (!reuse_temp_buffers) {
+    options.mutable_debug_options()->set_xla_cpu_max_retained_temp_buffer_bytes(
+        0);
+  }
+  std::unique_ptr<LocalExecutable> executable = std::move(
+      client->Compile(computation, {&argument_shape, &argument_shape}, options)
+          .ConsumeValueOrDie()[0]);
+
+  Literal argument = MakeFakeLiteral(argument_shape).ConsumeValueOrDie();
+  ScopedShapedBuffer buffer =
+      client->LiteralToShapedBuffer(argument, client->default_device_ordinal())
+          .ConsumeValueOrDie();
+  ExecutableRunOptions run_options;
+  run_options.set_allocator(client->backend().memory_allocator());
+  run_options.set_intra_op_thread_pool(
+      client->backend().eigen_intra_op_thread_pool_device());
+
+  for (auto s : state) {
+    CHECK(executable->Run({&buffer, &buffer}, run_options).ok());
+  }
+}
+BENCHMARK(BM_TinyExecutable)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -51,11 +51,14 @@ limitations under the License.
 #include "tensorflow/core/lib/core/bitmap.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/status.h"
 #include "tensorflow/core/platform/statusor.h"
+#include "tensorflow/core/platform/threadpool.h"
 #include "tensorflow/stream_executor/lib/statusor.h"
 
 namespace xla {
@@ -173,8 +176,92 @@ StatusOr<Literal> Compare<complex128>(const Shape& shape,
   return std::move(result);
 }
 
+// Returns the thread pool used by HloEvaluator::ParallelFor, or nullptr if the
+// host has a single core.
+tensorflow::thread::ThreadPool* GetEvaluatorThreadPool() {
+  static tensorflow::thread::ThreadPool* pool =
+      []() -> tensorflow::thread::ThreadPool* {
+    const int num_threads = tensorflow::port::MaxParallelism();
+    if (num_threads <= 1) {
+      return nullptr;
+    }
+    return new tensorflow::thread::ThreadPool(tensorflow::Env::Default(),
+                                              "hlo_evaluator", num_threads);
+  }();
+  return pool;
+}
+
+// Writes the transpose of the dense array `src` with shape `src_shape` to
+// `dest` with shape `dest_shape`, honoring both layouts.  `dest` is written
+// in memory order, one run along its most minor dimension at a time.
+template <typename T>
+void TransposeArray(const Shape& src_shape, const Shape& dest_shape,
+                    absl::Span<const int64_t> permutation, const T* src,
+                    T* dest) {
+  const int64_t rank = dest_shape.rank();
+  DimensionVector src_dim_strides(rank);
+  int64_t stride = 1;
+  for (int64_t dim : LayoutUtil::MinorToMajor(src_shape)) {
+    src_dim_strides[dim] = stride;
+    stride *= src_shape.dimensions(dim);
+  }
+  // Sizes of the destination dimensions and the matching source strides, from
+  // minor to major in the destination layout.
+  DimensionVector sizes(rank);
+  DimensionVector src_strides(rank);
+  for (int64_t i = 0; i < rank; ++i) {
+    const int64_t dim = LayoutUtil::Minor(dest_shape.layout(), i);
+    sizes[i] = dest_shape.dimensions(dim);
+    src_strides[i] = src_dim_strides[permutation[dim]];
+  }
+  const int64_t run_length = sizes[0];
+  const int64_t num_runs = ShapeUtil::ElementsIn(dest_shape) / run_length;
+  HloEvaluator::ParallelFor(
+      num_runs, run_length, [&](int64_t begin, int64_t end) {
+        DimensionVector index(rank, 0);
+        int64_t src_offset = 0;
+        for (int64_t i = 1, run = begin; i < rank; ++i) {
+          index[i] = run % sizes[i];
+          run /= sizes[i];
+          src_offset += index[i] * src_strides[i];
+        }
+        for (int64_t run = begin; run < end; ++run) {
+          T* out = dest + run * run_length;
+          const T* in = src + src_offset;
+          for (int64_t j = 0; j < run_length; ++j) {
+            out[j] = in[j * src_strides[0]];
+          }
+          for (int64_t i = 1; i < rank; ++i) {
+            src_offset += src_strides[i];
+            if (++index[i] < sizes[i]) {
+              break;
+            }
+            src_offset -= sizes[i] * src_strides[i];
+            index[i] = 0;
+          }
+        }
+      });
+}
+
 }  // namespace
 
+/*static*/ void HloEvaluator::ParallelFor(
+    int64_t n, int64_t cost_per_element,
+    const std::function<void(int64_t, int64_t)>& fn) {
+  // Roughly the amount of work below which sharding costs more than it saves.
+  constexpr int64_t kMinParallelCost = 1 << 16;
+  tensorflow::thread::ThreadPool* pool = GetEvaluatorThreadPool();
+  // Nested calls from a worker run inline so that they can't deadlock the pool.
+  if (pool == nullptr || pool->CurrentThreadId() != -1 ||
+      n * cost_per_element < kMinParallelCost) {
+    if (n > 0) {
+      fn(0, n);
+    }
+    return;
+  }
+  pool->ParallelFor(n, cost_per_element, fn);
+}
+
 // Note that unsupported types by the typed visitor does not necessarily imply
 // the non-typed HloEvaluator (parent evaluator) would not support them either
 // in the type-agnostic handler. For e.g., HandleGetTupleElement in the parent
@@ -597,8 +684,51 @@ Status HloEvaluator::HandleReshape(HloInstruction* reshape) {
 }
 
 Status HloEvaluator::HandleTranspose(HloInstruction* transpose) {
-  evaluated_[transpose] = GetEvaluatedLiteralFor(transpose->operand(0))
-                              .Transpose(transpose->dimensions());
+  const Literal& operand = GetEvaluatedLiteralFor(transpose->operand(0));
+  const Shape& shape = transpose->shape();
+  // Literal::Transpose only permutes the layout, which leaves an element by
+  // element relayout to Postprocess unless the transpose is a bitcast.  Copy
+  // straight into the layout of the result instead.
+  if (!LayoutUtil::IsDenseArray(shape) || shape.is_dynamic() ||
+      operand.shape().is_dynamic() || ShapeUtil::IsZeroElementArray(shape) ||
+      shape.rank() == 0) {
+    evaluated_[transpose] = operand.Transpose(transpose->dimensions());
+    return Status::OK();
+  }
+  Literal result(shape);
+  const void* src = operand.untyped_data();
+  void* dest = result.untyped_data();
+  switch (primitive_util::ByteWidth(shape.element_type())) {
+    case 1:
+      TransposeArray(operand.shape(), shape, transpose->dimensions(),
+                     static_cast<const uint8_t*>(src),
+                     static_cast<uint8_t*>(dest));
+      break;
+    case 2:
+      TransposeArray(operand.shape(), shape, transpose->dimensions(),
+                     static_cast<const uint16_t*>(src),
+                     static_cast<uint16_t*>(dest));
+      break;
+    case 4:
+      TransposeArray(operand.shape(), shape, transpose->dimensions(),
+                     static_cast<const uint32_t*>(src),
+                     static_cast<uint32_t*>(dest));
+      break;
+    case 8:
+      TransposeArray(operand.shape(), shape, transpose->dimensions(),
+                     static_cast<const uint64_t*>(src),
+                     static_cast<uint64_t*>(dest));
+      break;
+    case 16:
+      TransposeArray(operand.shape(), shape, transpose->dimensions(),
+                     static_cast<const complex128*>(src),
+                     static_cast<complex128*>(dest));
+      break;
+    default:
+      result = operand.Transpose(transpose->dimensions());
+      break;
+  }
+  evaluated_[transpose] = std::move(result);
   return Status::OK();
 }
 
@@ -2583,6 +2713,62 @@ static StatusOr<bool> GenerateReduceOutputElement(
   return true;
 }
 
+// Returns true if `dimensions` are the most minor dimensions of the dense
+// array `shape`, so that each output element of a reduction over them reduces
+// a contiguous run of elements.
+static bool ReducesMinorMostDimensions(const Shape& shape,
+                                       absl::Span<const int64_t> dimensions) {
+  if (!LayoutUtil::IsDenseArray(shape) || shape.is_dynamic() ||
+      dimensions.size() > shape.rank()) {
+    return false;
+  }
+  absl::Span<const int64_t> minor_to_major = LayoutUtil::MinorToMajor(shape);
+  for (int64_t i = 0; i < dimensions.size(); ++i) {
+    if (!absl::c_linear_search(dimensions, minor_to_major[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Fast path of GenerateReduceOutputElement's floating-point add for reductions
+// over the most minor dimensions: sums each contiguous run of `arg` in memory
+// order, accumulating in double exactly like the general path does.
+template <typename T>
+static void SumContiguousRuns(const Literal& arg, double init,
+                              absl::Span<const int64_t> result_to_arg_index,
+                              Literal* result) {
+  const Shape& arg_shape = arg.shape();
+  const Shape& result_shape = result->shape();
+  const int64_t num_outputs = ShapeUtil::ElementsIn(result_shape);
+  if (num_outputs == 0) {
+    return;
+  }
+  const int64_t run_length = ShapeUtil::ElementsIn(arg_shape) / num_outputs;
+  absl::Span<const T> in = arg.data<T>();
+  absl::Span<T> out = result->data<T>();
+  HloEvaluator::ParallelFor(
+      num_outputs, run_length, [&](int64_t begin, int64_t end) {
+        DimensionVector arg_index(arg_shape.rank(), 0);
+        for (int64_t i = begin; i < end; ++i) {
+          std::vector<int64_t> output_index =
+              IndexUtil::LinearIndexToMultidimensionalIndex(result_shape, i);
+          for (int64_t j = 0; j < output_index.size(); ++j) {
+            arg_index[result_to_arg_index[j]] = output_index[j];
+          }
+          const T* run =
+              in.data() +
+              IndexUtil::MultidimensionalIndexToLinearIndex(arg_shape,
+                                                            arg_index);
+          double sum = init;
+          for (int64_t k = 0; k < run_length; ++k) {
+            sum += static_cast<double>(run[k]);
+          }
+          out[i] = static_cast<T>(sum);
+        }
+      });
+}
+
 Status HloEvaluator::HandleReduce(HloInstruction* instr) {
   HloReduceInstruction* reduce = Cast<HloReduceInstruction>(instr);
   int64_t num_args = reduce->inputs().size();
@@ -2652,13 +2838,44 @@ Status HloEvaluator::HandleReduce(HloInstruction* instr) {
     results[i] = Literal(is_tuple ? out_shape.tuple_shapes(i) : out_shape);
   }
 
-  TF_RETURN_IF_ERROR(ShapeUtil::ForEachIndexWithStatus(
-      output_shape, [&](absl::Span<const int64_t> output_index) {
-        return GenerateReduceOutputElement(
-            is_tuple, output_index, init_values, input_args,
-            absl::Span<Literal>(results), function, &embedded_evaluator,
-            arg_dim_steps, arg_dim_counts, result_to_arg_index);
-      }));
+  const bool sums_contiguous_runs =
+      !is_tuple && ShapeUtil::ElementIsFloating(init_values[0]->shape()) &&
+      IsScalarAdd(function) &&
+      ReducesMinorMostDimensions(arg_shape, dimensions_to_reduce) &&
+      LayoutUtil::IsDenseArray(results[0].shape()) &&
+      !results[0].shape().is_dynamic();
+  if (sums_contiguous_runs) {
+    const double init = *init_values[0]->GetAsDouble({});
+    switch (arg_shape.element_type()) {
+      case F16:
+        SumContiguousRuns<half>(*input_args[0], init, result_to_arg_index,
+                                &results[0]);
+        break;
+      case BF16:
+        SumContiguousRuns<bfloat16>(*input_args[0], init, result_to_arg_index,
+                                    &results[0]);
+        break;
+      case F32:
+        SumContiguousRuns<float>(*input_args[0], init, result_to_arg_index,
+                                 &results[0]);
+        break;
+      case F64:
+        SumContiguousRuns<double>(*input_args[0], init, result_to_arg_index,
+                                  &results[0]);
+        break;
+      default:
+        return InternalError("Unexpected element type %s for reduce",
+                             PrimitiveType_Name(arg_shape.element_type()));
+    }
+  } else {
+    TF_RETURN_IF_ERROR(ShapeUtil::ForEachIndexWithStatus(
+        output_shape, [&](absl::Span<const int64_t> output_index) {
+          return GenerateReduceOutputElement(
+              is_tuple, output_index, init_values, input_args,
+              absl::Span<Literal>(results), function, &embedded_evaluator,
+              arg_dim_steps, arg_dim_counts, result_to_arg_index);
+        }));
+  }
 
   if (is_tuple) {
     Literal tuple_result(inferred_return_shape);
@@ -190,6 +190,12 @@ class HloEvaluator : public DfsHloVisitorWithDefault {
   static std::unique_ptr<Array2D<int32_t>> MatmulArray2D(
       const Array2D<int32_t>& lhs, const Array2D<int32_t>& rhs);
 
+  // Calls `fn(begin, end)` on disjoint ranges that cover [0, n).  The ranges
+  // run on a process-wide thread pool if `n * cost_per_element` (in cycles) is
+  // large enough to pay for it, so `fn` must not depend on how [0, n) is split.
+  static void ParallelFor(int64_t n, int64_t cost_per_element,
+                          const std::function<void(int64_t, int64_t)>& fn);
+
  protected:
   // Evaluates the given instruction, and stores the evaluation result in the
   // evaluated_ map.
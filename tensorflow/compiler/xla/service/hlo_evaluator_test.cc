@@ -22,14 +22,19 @@ limitations under the License.
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_replace.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/literal.h"
 #include "tensorflow/compiler/xla/permutation_util.h"
 #include "tensorflow/compiler/xla/reference_util.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
 #include "tensorflow/compiler/xla/service/hlo_element_type_converter.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/status.h"
 #include "tensorflow/compiler/xla/status_macros.h"
@@ -2571,6 +2576,110 @@ TEST_F(HloEvaluatorPreciseReduceTest, AddReductionPrecisionTest) {
   LiteralTestUtil::ExpectR0Equal<float>(kNumElements, result);
 }
 
+// The tests below exercise the flat-array fast paths with layouts other than
+// the default one.
+
+TEST_F(HloEvaluatorTest, TransposeIntoNonDefaultLayout) {
+  const char* hlo_text = R"(
+HloModule Transpose
+
+ENTRY main {
+  operand = f32[2,3,4]{2,1,0} parameter(0)
+  ROOT transpose = f32[4,2,3]{1,2,0} transpose(operand), dimensions={2,0,1}
+}
+)";
+  Literal input(ShapeUtil::MakeShapeWithLayout(F32, {2, 3, 4}, {2, 1, 0}));
+  TF_ASSERT_OK(input.Populate<float>([](absl::Span<const int64_t> index) {
+    return index[0] * 100 + index[1] * 10 + index[2];
+  }));
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  TF_ASSERT_OK_AND_ASSIGN(Literal result, Evaluate({&input}));
+  EXPECT_TRUE(LayoutUtil::Equal(result.shape().layout(),
+                                LayoutUtil::MakeLayout({1, 2, 0})));
+  result.EachCell<float>([&](absl::Span<const int64_t> index, float value) {
+    EXPECT_EQ(value, input.Get<float>({index[1], index[2], index[0]}));
+  });
+}
+
+TEST_F(HloEvaluatorTest, ElementwiseOpsWithMixedLayouts) {
+  const char* hlo_text = R"(
+HloModule Elementwise
+
+ENTRY main {
+  lhs = f32[2,3]{1,0} parameter(0)
+  rhs = f32[2,3]{0,1} parameter(1)
+  same_layout = f32[2,3]{1,0} multiply(lhs, lhs)
+  mixed_layout = f32[2,3]{1,0} subtract(same_layout, rhs)
+  ROOT negate = f32[2,3]{1,0} negate(mixed_layout)
+}
+)";
+  Literal lhs = LiteralUtil::CreateR2<float>({{1, 2, 3}, {4, 5, 6}});
+  Literal rhs = LiteralUtil::CreateR2WithLayout<float>(
+      {{2, 1, 1}, {2, 2, 2}}, LayoutUtil::MakeLayout({0, 1}));
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  TF_ASSERT_OK_AND_ASSIGN(Literal result, Evaluate({&lhs, &rhs}));
+  EXPECT_TRUE(LiteralTestUtil::Equal(
+      LiteralUtil::CreateR2<float>({{1, -3, -8}, {-14, -23, -34}}), result));
+}
+
+TEST_F(HloEvaluatorTest, ReduceSumOverMinorDimensions) {
+  const char* hlo_text = R"(
+HloModule Reduce
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT add = f32[] add(a, b)
+}
+
+ENTRY main {
+  operand = f32[2,3,4]{1,2,0} parameter(0)
+  one = f32[] constant(1)
+  ROOT reduce = f32[2]{0} reduce(operand, one), dimensions={2,1}, to_apply=add
+}
+)";
+  Literal input(ShapeUtil::MakeShapeWithLayout(F32, {2, 3, 4}, {1, 2, 0}));
+  TF_ASSERT_OK(input.Populate<float>([](absl::Span<const int64_t> index) {
+    return index[0] * 100 + index[1] * 10 + index[2];
+  }));
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  TF_ASSERT_OK_AND_ASSIGN(Literal result, Evaluate({&input}));
+  // 1 + sum of (i * 100 + j * 10 + k) over j < 3, k < 4.
+  EXPECT_TRUE(LiteralTestUtil::Equal(LiteralUtil::CreateR1<float>({139, 1339}),
+                                     result));
+}
+
+TEST_F(HloEvaluatorTest, BatchDotWithNonDefaultLayouts) {
+  const char* hlo_text = R"(
+HloModule Dot
+
+ENTRY main {
+  lhs = f32[2,2,3]{1,2,0} parameter(0)
+  rhs = f32[2,3,2]{2,0,1} parameter(1)
+  ROOT dot = f32[2,2,2]{0,1,2} dot(lhs, rhs), lhs_batch_dims={0},
+      rhs_batch_dims={0}, lhs_contracting_dims={2}, rhs_contracting_dims={1}
+}
+)";
+  Literal lhs(ShapeUtil::MakeShapeWithLayout(F32, {2, 2, 3}, {1, 2, 0}));
+  TF_ASSERT_OK(lhs.Populate<float>([](absl::Span<const int64_t> index) {
+    return index[0] * 6 + index[1] * 3 + index[2];
+  }));
+  Literal rhs(ShapeUtil::MakeShapeWithLayout(F32, {2, 3, 2}, {2, 0, 1}));
+  TF_ASSERT_OK(rhs.Populate<float>([](absl::Span<const int64_t> index) {
+    return index[0] - index[1] + index[2];
+  }));
+  TF_ASSERT_OK_AND_ASSIGN(m_, ParseAndReturnVerifiedModule(hlo_text));
+  TF_ASSERT_OK_AND_ASSIGN(Literal result, Evaluate({&lhs, &rhs}));
+  result.EachCell<float>([&](absl::Span<const int64_t> index, float value) {
+    float expected = 0;
+    for (int64_t k = 0; k < 3; ++k) {
+      expected += lhs.Get<float>({index[0], index[1], k}) *
+                  rhs.Get<float>({index[0], k, index[2]});
+    }
+    EXPECT_EQ(value, expected) << absl::StrJoin(index, ",");
+  });
+}
+
 // Reducing many numbers should be fast because it doesn't create
 // intermediate Literals; the microbenchmark should finish in < 1 msec.
 void BM_ReducePrecisely(::testing::benchmark::State& state) {
@@ -2610,6 +2719,99 @@ void BM_ReducePrecisely(::testing::benchmark::State& state) {
 
 BENCHMARK(BM_ReducePrecisely);
 
+// Workloads typical of constant folding, on arrays with state.range(0)
+// elements along each dimension.
+const char* const kElementwiseBenchmarkHlo = R"(
+HloModule elementwise
+
+ENTRY main {
+  x = f32[$n,$n] parameter(0)
+  y = f32[$n,$n] parameter(1)
+  multiply = f32[$n,$n] multiply(x, y)
+  add = f32[$n,$n] add(multiply, x)
+  ROOT maximum = f32[$n,$n] maximum(add, y)
+}
+)";
+
+const char* const kReduceBenchmarkHlo = R"(
+HloModule reduce
+
+add {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT add = f32[] add(a, b)
+}
+
+ENTRY main {
+  x = f32[$n,$n] parameter(0)
+  y = f32[$n,$n] parameter(1)
+  zero = f32[] constant(0)
+  rows = f32[$n] reduce(x, zero), dimensions={1}, to_apply=add
+  ROOT all = f32[] reduce(y, zero), dimensions={0,1}, to_apply=add
+}
+)";
+
+const char* const kTransposeBenchmarkHlo = R"(
+HloModule transpose
+
+ENTRY main {
+  x = f32[$n,$n] parameter(0)
+  y = f32[$n,$n] parameter(1)
+  ROOT transpose = f32[$n,$n] transpose(x), dimensions={1,0}
+}
+)";
+
+const char* const kDotBenchmarkHlo = R"(
+HloModule dot
+
+ENTRY main {
+  x = f32[$n,$n] parameter(0)
+  y = f32[$n,$n] parameter(1)
+  ROOT dot = f32[$n,$n] dot(x, y), lhs_contracting_dims={1},
+                                    rhs_contracting_dims={0}
+}
+)";
+
+void BenchmarkEvaluate(::testing::benchmark::State& state,
+                       const char* hlo_template) {
+  const int64_t n = state.range(0);
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnUnverifiedModule(
+          absl::StrReplaceAll(hlo_template, {{"$n", absl::StrCat(n)}}))
+          .ConsumeValueOrDie();
+  const HloComputation& computation = *module->entry_computation();
+  Literal x = MakeFakeLiteral(computation.parameter_instruction(0)->shape())
+                  .ConsumeValueOrDie();
+  Literal y = MakeFakeLiteral(computation.parameter_instruction(1)->shape())
+                  .ConsumeValueOrDie();
+
+  for (auto s : state) {
+    HloEvaluator evaluator;
+    evaluator.Evaluate(computation, {&x, &y}).ConsumeValueOrDie();
+  }
+  state.SetItemsProcessed(state.iterations() * n * n);
+}
+
+void BM_EvaluateElementwise(::testing::benchmark::State& state) {
+  BenchmarkEvaluate(state, kElementwiseBenchmarkHlo);
+}
+BENCHMARK(BM_EvaluateElementwise)->Arg(64)->Arg(512)->Arg(2048);
+
+void BM_EvaluateReduce(::testing::benchmark::State& state) {
+  BenchmarkEvaluate(state, kReduceBenchmarkHlo);
+}
+BENCHMARK(BM_EvaluateReduce)->Arg(64)->Arg(512)->Arg(2048);
+
+void BM_EvaluateTranspose(::testing::benchmark::State& state) {
+  BenchmarkEvaluate(state, kTransposeBenchmarkHlo);
+}
+BENCHMARK(BM_EvaluateTranspose)->Arg(64)->Arg(512)->Arg(2048);
+
+void BM_EvaluateDot(::testing::benchmark::State& state) {
+  BenchmarkEvaluate(state, kDotBenchmarkHlo);
+}
+BENCHMARK(BM_EvaluateDot)->Arg(64)->Arg(256);
+
 TEST_P(HloEvaluatorBf16Test, ReduceAdd) {
   HloComputation::Builder b(TestName());
 
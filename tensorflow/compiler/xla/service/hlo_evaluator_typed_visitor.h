@@ -19,6 +19,7 @@ limitations under the License.
 #include <bitset>
 #include <cmath>
 #include <type_traits>
+#include <vector>
 
 #include "absl/algorithm/container.h"
 #include "absl/base/casts.h"
@@ -28,6 +29,8 @@ limitations under the License.
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/array2d.h"
+#include "tensorflow/compiler/xla/index_util.h"
+#include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/literal.h"
 #include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
@@ -1413,10 +1416,117 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
     return HandleDotSlowPath(dot);
   }
 
+  // Returns the distance in elements between neighbors along each dimension
+  // of the dense array `shape`.
+  static DimensionVector ElementStrides(const Shape& shape) {
+    DimensionVector strides(shape.rank());
+    int64_t stride = 1;
+    for (int64_t dim : LayoutUtil::MinorToMajor(shape)) {
+      strides[dim] = stride;
+      stride *= shape.dimensions(dim);
+    }
+    return strides;
+  }
+
+  // Computes the same sums in the same order as the general path below, but
+  // walks the operand arrays with precomputed strides instead of looking up
+  // every element by its multi-index.
+  Status HandleDotWithStrides(HloInstruction* dot, const Literal& lhs_literal,
+                              const Literal& rhs_literal) {
+    const auto& dnums = dot->dot_dimension_numbers();
+    const Shape& lhs_shape = lhs_literal.shape();
+    const Shape& rhs_shape = rhs_literal.shape();
+    const DimensionVector lhs_strides = ElementStrides(lhs_shape);
+    const DimensionVector rhs_strides = ElementStrides(rhs_shape);
+
+    // The strides in lhs and rhs of each result dimension: batch dimensions
+    // first, then the non-contracting dimensions of lhs and of rhs.
+    DimensionVector result_lhs_strides;
+    DimensionVector result_rhs_strides;
+    for (int64_t i = 0; i < dnums.lhs_batch_dimensions_size(); ++i) {
+      result_lhs_strides.push_back(lhs_strides[dnums.lhs_batch_dimensions(i)]);
+      result_rhs_strides.push_back(rhs_strides[dnums.rhs_batch_dimensions(i)]);
+    }
+    for (int64_t i = 0; i < lhs_shape.rank(); ++i) {
+      if (!absl::c_linear_search(dnums.lhs_contracting_dimensions(), i) &&
+          !absl::c_linear_search(dnums.lhs_batch_dimensions(), i)) {
+        result_lhs_strides.push_back(lhs_strides[i]);
+        result_rhs_strides.push_back(0);
+      }
+    }
+    for (int64_t i = 0; i < rhs_shape.rank(); ++i) {
+      if (!absl::c_linear_search(dnums.rhs_contracting_dimensions(), i) &&
+          !absl::c_linear_search(dnums.rhs_batch_dimensions(), i)) {
+        result_lhs_strides.push_back(0);
+        result_rhs_strides.push_back(rhs_strides[i]);
+      }
+    }
+
+    // The offsets in lhs and rhs of every step of the contraction, with the
+    // last contracting dimension varying fastest.
+    std::vector<int64_t> lhs_offsets = {0};
+    std::vector<int64_t> rhs_offsets = {0};
+    for (int64_t i = 0; i < dnums.lhs_contracting_dimensions_size(); ++i) {
+      const int64_t lhs_dnum = dnums.lhs_contracting_dimensions(i);
+      const int64_t rhs_dnum = dnums.rhs_contracting_dimensions(i);
+      const int64_t dim_size = lhs_shape.dimensions(lhs_dnum);
+      std::vector<int64_t> new_lhs_offsets;
+      std::vector<int64_t> new_rhs_offsets;
+      new_lhs_offsets.reserve(lhs_offsets.size() * dim_size);
+      new_rhs_offsets.reserve(rhs_offsets.size() * dim_size);
+      for (int64_t k = 0; k < lhs_offsets.size(); ++k) {
+        for (int64_t j = 0; j < dim_size; ++j) {
+          new_lhs_offsets.push_back(lhs_offsets[k] + j * lhs_strides[lhs_dnum]);
+          new_rhs_offsets.push_back(rhs_offsets[k] + j * rhs_strides[rhs_dnum]);
+        }
+      }
+      lhs_offsets = std::move(new_lhs_offsets);
+      rhs_offsets = std::move(new_rhs_offsets);
+    }
+
+    Literal result(dot->shape());
+    const Shape& result_shape = result.shape();
+    absl::Span<const ReturnT> lhs_data = lhs_literal.data<ReturnT>();
+    absl::Span<const ReturnT> rhs_data = rhs_literal.data<ReturnT>();
+    absl::Span<ReturnT> out = result.data<ReturnT>();
+    const int64_t contraction_size = lhs_offsets.size();
+    HloEvaluator::ParallelFor(
+        out.size(), contraction_size + 1, [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            std::vector<int64_t> result_index =
+                IndexUtil::LinearIndexToMultidimensionalIndex(result_shape, i);
+            int64_t lhs_base = 0;
+            int64_t rhs_base = 0;
+            for (int64_t d = 0; d < result_index.size(); ++d) {
+              lhs_base += result_index[d] * result_lhs_strides[d];
+              rhs_base += result_index[d] * result_rhs_strides[d];
+            }
+            const ReturnT* lhs_elems = lhs_data.data() + lhs_base;
+            const ReturnT* rhs_elems = rhs_data.data() + rhs_base;
+            ElementwiseT result_val = static_cast<ElementwiseT>(0);
+            for (int64_t k = 0; k < contraction_size; ++k) {
+              ElementwiseT lhs_val(lhs_elems[lhs_offsets[k]]);
+              ElementwiseT rhs_val(rhs_elems[rhs_offsets[k]]);
+              result_val +=
+                  ToArithmeticSafeType(lhs_val) * ToArithmeticSafeType(rhs_val);
+            }
+            out[i] = static_cast<ReturnT>(result_val);
+          }
+        });
+
+    parent_->evaluated_[dot] = std::move(result);
+    return Status::OK();
+  }
+
   Status HandleDotSlowPathWithLiterals(HloInstruction* dot,
                                        const Literal& lhs_literal,
                                        const Literal& rhs_literal) {
     const auto& dnums = dot->dot_dimension_numbers();
+    if (IsDenseStaticArray(lhs_literal.shape()) &&
+        IsDenseStaticArray(rhs_literal.shape()) &&
+        IsDenseStaticArray(dot->shape())) {
+      return HandleDotWithStrides(dot, lhs_literal, rhs_literal);
+    }
 
     const auto lhs_rank = lhs_literal.shape().rank();
     const auto rhs_rank = rhs_literal.shape().rank();
@@ -2973,23 +3083,54 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
     return std::move(result);
   }
 
-  StatusOr<Literal> ElementWiseUnaryOp(
-      HloInstruction* instruction,
-      const std::function<ElementwiseT(ElementwiseT)>& unary_op) {
+  static bool IsDenseStaticArray(const Shape& shape) {
+    return LayoutUtil::IsDenseArray(shape) && !shape.is_dynamic();
+  }
+
+  // Returns true if `literal` is laid out like `shape`, so that the elements
+  // of both at the same multi-index are at the same linear index.
+  static bool HasLayoutOf(const Literal& literal, const Shape& shape) {
+    return IsDenseStaticArray(literal.shape()) && IsDenseStaticArray(shape) &&
+           LayoutUtil::Equal(literal.shape().layout(), shape.layout());
+  }
+
+  // The elementwise ops below take the op as a template argument so that when
+  // the operands are laid out like the result, the op is inlined into a flat
+  // loop over the element arrays.
+  template <typename UnaryOp>
+  StatusOr<Literal> ElementWiseUnaryOp(HloInstruction* instruction,
+                                       const UnaryOp& unary_op) {
     const Literal& operand_literal =
         parent_->GetEvaluatedLiteralFor(instruction->operand(0));
+    const Shape& shape = instruction->shape();
+    if (HasLayoutOf(operand_literal, shape)) {
+      TF_RET_CHECK(
+          ShapeUtil::SameDimensions(shape, instruction->operand(0)->shape()));
+      Literal result(shape);
+      absl::Span<const ReturnT> in = operand_literal.data<ReturnT>();
+      absl::Span<ReturnT> out = result.data<ReturnT>();
+      HloEvaluator::ParallelFor(
+          out.size(), /*cost_per_element=*/8, [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              out[i] = static_cast<ReturnT>(static_cast<ElementwiseT>(
+                  unary_op(static_cast<ElementwiseT>(in[i]))));
+            }
+          });
+      return std::move(result);
+    }
+
+    const std::function<ElementwiseT(ElementwiseT)> unary_fn = unary_op;
     TF_ASSIGN_OR_RETURN(
         auto result_literal,
         (HloEvaluator::ElementWiseUnaryOpImpl<ReturnT, ReturnT>(
-            instruction, ConvertUnaryFunction(unary_op), operand_literal)));
+            instruction, ConvertUnaryFunction(unary_fn), operand_literal)));
 
     return std::move(result_literal);
   }
 
-  StatusOr<Literal> ElementWiseBinaryOp(
-      HloInstruction* instruction,
-      const std::function<ElementwiseT(ElementwiseT, ElementwiseT)>&
-          binary_op) {
+  template <typename BinaryOp>
+  StatusOr<Literal> ElementWiseBinaryOp(HloInstruction* instruction,
+                                        const BinaryOp& binary_op) {
     const auto shape = instruction->shape();
     const auto* lhs = instruction->operand(0);
     const auto* rhs = instruction->operand(1);
@@ -3001,9 +3142,26 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
 
     Literal result(shape);
 
+    if (HasLayoutOf(lhs_literal, shape) && HasLayoutOf(rhs_literal, shape)) {
+      absl::Span<const ReturnT> lhs_data = lhs_literal.data<ReturnT>();
+      absl::Span<const ReturnT> rhs_data = rhs_literal.data<ReturnT>();
+      absl::Span<ReturnT> out = result.data<ReturnT>();
+      HloEvaluator::ParallelFor(
+          out.size(), /*cost_per_element=*/8, [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              out[i] = static_cast<ReturnT>(static_cast<ElementwiseT>(
+                  binary_op(static_cast<ElementwiseT>(lhs_data[i]),
+                            static_cast<ElementwiseT>(rhs_data[i]))));
+            }
+          });
+      return std::move(result);
+    }
+
+    const std::function<ElementwiseT(ElementwiseT, ElementwiseT)> binary_fn =
+        binary_op;
     TF_RETURN_IF_ERROR(
         result.Populate<ReturnT>([&](absl::Span<const int64_t> multi_index) {
-          return ConvertBinaryFunction(binary_op)(
+          return ConvertBinaryFunction(binary_fn)(
               lhs_literal.Get<ReturnT>(multi_index),
               rhs_literal.Get<ReturnT>(multi_index));
         }));
@@ -3028,6 +3186,21 @@ class HloEvaluatorTypedVisitor : public DfsHloVisitorWithDefault {
 
     Literal result(shape);
 
+    if (HasLayoutOf(lhs_literal, shape) && HasLayoutOf(rhs_literal, shape) &&
+        HasLayoutOf(ehs_literal, shape)) {
+      absl::Span<const LhsType> lhs_data = lhs_literal.data<LhsType>();
+      absl::Span<const RhsType> rhs_data = rhs_literal.data<RhsType>();
+      absl::Span<const EhsType> ehs_data = ehs_literal.data<EhsType>();
+      absl::Span<ReturnT> out = result.data<ReturnT>();
+      HloEvaluator::ParallelFor(
+          out.size(), /*cost_per_element=*/16, [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              out[i] = ternary_op(lhs_data[i], rhs_data[i], ehs_data[i]);
+            }
+          });
+      return std::move(result);
+    }
+
     TF_RETURN_IF_ERROR(
         result.Populate<ReturnT>([&](absl::Span<const int64_t> multi_index) {
           return ternary_op(lhs_literal.Get<LhsType>(multi_index),
@@ -15,6 +15,10 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/hlo_pass_pipeline.h"
 
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
 #include <functional>
 #include <string>
 
@@ -35,12 +39,34 @@ namespace xla {
 
 namespace {
 
+// Returns the peak resident set size of this process in bytes, or 0 if it is
+// not available on this platform.
+int64_t PeakMemoryBytes() {
+#if defined(__linux__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return usage.ru_maxrss;
+#else
+  return static_cast<int64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
 void RecordPassStartMetadata(HloModule& module, const std::string& pass_name,
                              const std::string& pipeline_name) {
   module.metadata()->RecordPassStart();
   // An HloPassMetadata was just created so Status should always be OK.
   TF_CHECK_OK(module.metadata()->set_current_pass_name(pass_name));
   TF_CHECK_OK(module.metadata()->set_current_pass_pipeline_name(pipeline_name));
+  TF_CHECK_OK(module.metadata()->set_current_pass_instruction_count_before(
+      module.instruction_count()));
+  TF_CHECK_OK(module.metadata()->set_current_pass_peak_memory_bytes_before(
+      PeakMemoryBytes()));
 }
 
 void RecordPassStartMetadata(HloModuleGroup& module_group,
@@ -60,6 +86,12 @@ Status AttemptRecordPassEndMetadata(HloModule& module,
       module.metadata()->set_current_pass_module_id(module.unique_id()));
   TF_RETURN_IF_ERROR(
       module.metadata()->set_current_pass_module_changed(module_changed));
+  TF_RETURN_IF_ERROR(
+      module.metadata()->set_current_pass_instruction_count_after(
+          module.instruction_count()));
+  TF_RETURN_IF_ERROR(
+      module.metadata()->set_current_pass_peak_memory_bytes_after(
+          PeakMemoryBytes()));
   TF_RETURN_IF_ERROR(module.metadata()->RecordPassEnd());
   return Status::OK();
 }
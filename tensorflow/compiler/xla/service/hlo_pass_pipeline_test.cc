@@ -99,6 +99,19 @@ class BarBlowerUpper : public HloModulePass {
   }
 };
 
+// A module pass which negates the root of the entry computation.
+class NegateRootModulePass : public HloModulePass {
+  absl::string_view name() const override { return "negate-root"; }
+
+  StatusOr<bool> Run(HloModule* module) override {
+    HloComputation* entry = module->entry_computation();
+    HloInstruction* root = entry->root_instruction();
+    entry->set_root_instruction(entry->AddInstruction(
+        HloInstruction::CreateUnary(root->shape(), HloOpcode::kNegate, root)));
+    return true;
+  }
+};
+
 TEST_F(HloPassPipelineTest, ModulePassChanged) {
   // Test an HLO module pass which changes a module.
   const std::string module_str = R"(
@@ -297,5 +310,39 @@ TEST_F(HloPassPipelineTest, SetHloModuleMetadata) {
   }
 }
 
+// Test that per-pass profiling data is recorded in the module metadata.
+TEST_F(HloPassPipelineTest, RecordPassProfile) {
+  const std::string module_str = R"(
+HloModule RecordPassProfile
+
+ENTRY main {
+  a = f32[] parameter(0)
+  b = f32[] parameter(1)
+  ROOT foo = f32[] multiply(a, b)
+}
+)";
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<VerifiedHloModule> module,
+                          ParseAndReturnVerifiedModule(module_str));
+  HloPassPipeline pipeline(TestName());
+  pipeline.AddPass<FooToBarModulePass>();
+  pipeline.AddPass<NegateRootModulePass>();
+  TF_ASSERT_OK(pipeline.Run(module.get()).status());
+
+  const HloModuleMetadataProto& metadata = module->metadata()->proto();
+  ASSERT_THAT(metadata.pass_metadata(), SizeIs(3));
+  const HloPassMetadata& foo2bar = metadata.pass_metadata(1);
+  EXPECT_THAT(foo2bar.pass_name(), StrEq("foo2bar"));
+  EXPECT_EQ(foo2bar.instruction_count_before(), 3);
+  EXPECT_EQ(foo2bar.instruction_count_after(), 3);
+  const HloPassMetadata& negate_root = metadata.pass_metadata(2);
+  EXPECT_THAT(negate_root.pass_name(), StrEq("negate-root"));
+  EXPECT_EQ(negate_root.instruction_count_before(), 3);
+  EXPECT_EQ(negate_root.instruction_count_after(), 4);
+  for (const HloPassMetadata& pass_metadata : metadata.pass_metadata()) {
+    EXPECT_LE(pass_metadata.peak_memory_bytes_before(),
+              pass_metadata.peak_memory_bytes_after());
+  }
+}
+
 }  // namespace
 }  // namespace xla
@@ -0,0 +1,238 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// A tool for compiling a corpus of HLO modules and reporting how much compile
+// time each HLO pass takes. See kUsage for details.
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/service/backend.h"
+#include "tensorflow/compiler/xla/service/compiler.h"
+#include "tensorflow/compiler/xla/service/executable.h"
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/status_macros.h"
+#include "tensorflow/compiler/xla/tools/hlo_module_loader.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+namespace xla {
+namespace {
+
+const char* const kUsage = R"(
+This tool compiles a corpus of HLO modules and reports, for each HLO pass, how
+often it ran, how much wall time it took, how much it changed the number of
+instructions, and how much it grew the peak memory of the process.
+
+The inputs are HLO text files in HloModule::ToString() format, or globs
+matching such files. Every module is parsed and compiled from scratch
+--iterations times. Nested pass pipelines are reported as a pass of their
+parent pipeline too, so their time includes the time of their own passes.
+
+If --metadata_dir is set, the HloModuleMetadataProto of the last compilation
+of each module is written there as a text proto.
+
+You can also pass in debug option flags for the HloModules.
+
+Usage:
+
+  bazel run hlo_compile_time_benchmark -- \
+    --iterations=3 --metadata_dir=/tmp/metadata \
+    path/to/corpus/*.hlo [path/to/module.hlo ...]
+)";
+
+struct Options {
+  std::string platform = "cpu";
+  int32_t iterations = 1;
+  std::string metadata_dir;
+};
+
+struct PassProfile {
+  std::string pipeline_name;
+  std::string pass_name;
+  int64_t num_runs = 0;
+  int64_t total_usec = 0;
+  int64_t instruction_count_delta = 0;
+  int64_t peak_memory_growth_bytes = 0;
+};
+
+// Per-pass profiles, keyed by pipeline and pass name.
+using PassProfiles =
+    absl::flat_hash_map<std::pair<std::string, std::string>, PassProfile>;
+
+void AccumulatePassProfiles(const HloModuleMetadataProto& metadata,
+                            PassProfiles* profiles) {
+  for (const HloPassMetadata& pass_metadata : metadata.pass_metadata()) {
+    // The pipeline-start entries only mark where a pipeline began.
+    if (pass_metadata.pass_name() == "pipeline-start") {
+      continue;
+    }
+    PassProfile& profile = (*profiles)[std::make_pair(
+        pass_metadata.pipeline_name(), pass_metadata.pass_name())];
+    profile.pipeline_name = pass_metadata.pipeline_name();
+    profile.pass_name = pass_metadata.pass_name();
+    ++profile.num_runs;
+    profile.total_usec += pass_metadata.end_timestamp_usec() -
+                          pass_metadata.start_timestamp_usec();
+    profile.instruction_count_delta +=
+        pass_metadata.instruction_count_after() -
+        pass_metadata.instruction_count_before();
+    profile.peak_memory_growth_bytes +=
+        pass_metadata.peak_memory_bytes_after() -
+        pass_metadata.peak_memory_bytes_before();
+  }
+}
+
+// Compiles the module in `path` `options.iterations` times and adds the
+// per-pass profiles of every compilation to `profiles`.
+Status CompileModule(const std::string& path, const Options& options,
+                     Backend* backend, PassProfiles* profiles,
+                     int64_t* compile_usec) {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  se::StreamExecutor* executor = backend->default_stream_executor();
+  HloModuleMetadataProto metadata;
+  for (int i = 0; i < options.iterations; ++i) {
+    TF_ASSIGN_OR_RETURN(
+        std::unique_ptr<HloModule> module,
+        LoadModuleFromFile(path, hlo_module_loader_details::Config(),
+                           /*format=*/"hlo"));
+    uint64_t start_micros = env->NowMicros();
+    TF_ASSIGN_OR_RETURN(module, backend->compiler()->RunHloPasses(
+                                    std::move(module), executor,
+                                    /*device_allocator=*/nullptr));
+    TF_ASSIGN_OR_RETURN(std::unique_ptr<Executable> executable,
+                        backend->compiler()->RunBackend(
+                            std::move(module), executor,
+                            /*device_allocator=*/nullptr));
+    *compile_usec += env->NowMicros() - start_micros;
+    TF_RET_CHECK(executable->has_module());
+    metadata = executable->module().metadata()->proto();
+    AccumulatePassProfiles(metadata, profiles);
+  }
+  if (!options.metadata_dir.empty()) {
+    std::string filename = tensorflow::io::JoinPath(
+        options.metadata_dir,
+        absl::StrCat(tensorflow::io::Basename(path), ".metadata.txt"));
+    TF_RETURN_IF_ERROR(tensorflow::WriteTextProto(env, filename, metadata));
+  }
+  return Status::OK();
+}
+
+void PrintReport(const PassProfiles& profiles, int64_t compile_usec) {
+  std::vector<PassProfile> sorted_profiles;
+  sorted_profiles.reserve(profiles.size());
+  for (const auto& it : profiles) {
+    sorted_profiles.push_back(it.second);
+  }
+  absl::c_sort(sorted_profiles,
+               [](const PassProfile& a, const PassProfile& b) {
+                 // Slowest passes first, break ties using the names.
+                 return std::tie(b.total_usec, a.pipeline_name, a.pass_name) <
+                        std::tie(a.total_usec, b.pipeline_name, b.pass_name);
+               });
+  std::cout << absl::StrFormat("Total compile time: %.3f ms\n",
+                               compile_usec / 1000.0);
+  std::cout << "pipeline, pass, num runs, time (ms), instruction delta, "
+               "peak memory growth (bytes)\n";
+  for (const PassProfile& profile : sorted_profiles) {
+    std::cout << absl::StrFormat(
+        "%s, %s, %d, %.3f, %d, %d\n", profile.pipeline_name, profile.pass_name,
+        profile.num_runs, profile.total_usec / 1000.0,
+        profile.instruction_count_delta, profile.peak_memory_growth_bytes);
+  }
+}
+
+Status RealMain(const Options& options, absl::Span<char* const> args) {
+  TF_ASSIGN_OR_RETURN(se::Platform * platform,
+                      PlatformUtil::GetPlatform(options.platform));
+  TF_ASSIGN_OR_RETURN(
+      std::unique_ptr<Backend> backend,
+      Backend::CreateBackend(BackendOptions().set_platform(platform)));
+
+  tensorflow::Env* env = tensorflow::Env::Default();
+  std::vector<std::string> paths;
+  for (const char* arg : args) {
+    std::vector<std::string> matches;
+    TF_RETURN_IF_ERROR(env->GetMatchingPaths(arg, &matches));
+    if (matches.empty()) {
+      return NotFound("No HLO files match %s", arg);
+    }
+    absl::c_sort(matches);
+    paths.insert(paths.end(), matches.begin(), matches.end());
+  }
+  if (!options.metadata_dir.empty()) {
+    TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(options.metadata_dir));
+  }
+
+  PassProfiles profiles;
+  int64_t compile_usec = 0;
+  for (const std::string& path : paths) {
+    LOG(INFO) << "Compiling " << path;
+    TF_RETURN_IF_ERROR(
+        CompileModule(path, options, backend.get(), &profiles, &compile_usec));
+  }
+  PrintReport(profiles, compile_usec);
+  return Status::OK();
+}
+
+}  // namespace
+}  // namespace xla
+
+int main(int argc, char** argv) {
+  xla::Options options;
+  std::vector<tensorflow::Flag> flag_list = {
+      tensorflow::Flag("platform", &options.platform,
+                       "The platform whose compiler compiles the modules."),
+      tensorflow::Flag("iterations", &options.iterations,
+                       "The number of times each module is compiled."),
+      tensorflow::Flag("metadata_dir", &options.metadata_dir,
+                       "If set, the directory the HloModuleMetadataProto of "
+                       "each module is written to."),
+  };
+  xla::AppendDebugOptionsFlags(&flag_list);
+  // The usage string includes the message at the top of the file, the
+  // DebugOptions flags and the flags defined above.
+  const std::string kUsageString = absl::StrCat(
+      xla::kUsage, "\n\n", tensorflow::Flags::Usage(argv[0], flag_list));
+  bool parse_ok = tensorflow::Flags::Parse(&argc, argv, flag_list);
+  tensorflow::port::InitMain(kUsageString.c_str(), &argc, &argv);
+  if (!parse_ok || argc < 2 || options.iterations < 1) {
+    LOG(QFATAL) << kUsageString;
+  }
+
+  xla::Status status =
+      xla::RealMain(options, absl::MakeSpan(argv + 1, argc - 1));
+  if (!status.ok()) {
+    LOG(ERROR) << status;
+    return 1;
+  }
+  return 0;
+}
@@ -227,6 +227,27 @@ CollectiveAdapter* MakeCollectiveAdapter(Tensor* output, int num_chunks,
   }
 }
 
+BaseCollectiveExecutor::BaseCollectiveExecutor(
+    CollectiveExecutorMgrInterface* cem, CollectiveRemoteAccess* remote_access,
+    int64_t step_id, const DeviceMgr* dev_mgr,
+    std::shared_ptr<UnboundedWorkQueue> work_queue,
+    const CollectiveFuser::Options& fusion_options)
+    : CollectiveExecutor(cem),
+      step_id_(step_id),
+      dev_mgr_(dev_mgr),
+      remote_access_(remote_access),
+      work_queue_(std::move(work_queue)) {
+  if (fusion_options.cycle_micros > 0) {
+    fuser_.reset(new CollectiveFuser(
+        fusion_options, this, dev_mgr_,
+        [this](OpKernelContext* ctx, const CollectiveParams* col_params,
+               const string& exec_key, const Tensor* input, Tensor* output,
+               const StatusCallback& done) {
+          Launch(ctx, col_params, exec_key, input, output, done);
+        }));
+  }
+}
+
 BaseCollectiveExecutor::~BaseCollectiveExecutor() {}
 
 void BaseCollectiveExecutor::StartAbort(const Status& s) {
@@ -252,6 +273,15 @@ void BaseCollectiveExecutor::StartAbort(const Status& s) {
   if (cem_->GetNcclCommunicator() != nullptr) {
     cem_->GetNcclCommunicator()->StartAbort(status);
   }
+  if (fuser_ != nullptr) {
+    fuser_->Abort(status);
+  }
+}
+
+void BaseCollectiveExecutor::FlushFusedCollectives() {
+  if (fuser_ != nullptr) {
+    fuser_->FlushAll();
+  }
 }
 
 Status BaseCollectiveExecutor::GetStatus(const Status& s) {
@@ -302,6 +332,10 @@ void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
         });
   }
 
+  if (fuser_ != nullptr && CollectiveFuser::CanFuse(*col_params)) {
+    fuser_->Enqueue(ctx, col_params, exec_key, done_safe);
+    return;
+  }
   Tensor* output = ctx->mutable_output(0);
   const Tensor* input = (col_params->instance.type == REDUCTION_COLLECTIVE ||
                          col_params->instance.type == GATHER_COLLECTIVE ||
@@ -311,6 +345,14 @@ void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
                           col_params->is_source))
                             ? &ctx->input(0)
                             : nullptr;
+  Launch(ctx, col_params, exec_key, input, output, done_safe);
+}
+
+void BaseCollectiveExecutor::Launch(OpKernelContext* ctx,
+                                    const CollectiveParams* col_params,
+                                    const string& exec_key,
+                                    const Tensor* input, Tensor* output,
+                                    const StatusCallback& done_safe) {
   CollectiveImplementationInterface* col_impl = nullptr;
   Status status = CreateCollective(*col_params, &col_impl);
   if (!status.ok()) {
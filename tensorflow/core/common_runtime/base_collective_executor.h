@@ -19,6 +19,7 @@ limitations under the License.
 #include <string>
 
 #include "tensorflow/core/common_runtime/buf_rendezvous.h"
+#include "tensorflow/core/common_runtime/collective_fuser.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
 #include "tensorflow/core/platform/unbounded_work_queue.h"
@@ -93,22 +94,26 @@ CollectiveAdapter* MakeCollectiveAdapter(Tensor* output, int num_chunks,
 // Default implementation of CollectiveExecutor.  Delegates the actual
 // work of moving data to a class specialized for the operation type,
 // arguments and device+interconnect topology.
+//
+// Reductions that are eligible are fused at runtime when `fusion_options`
+// enable it, see CollectiveFuser.
 class BaseCollectiveExecutor : public CollectiveExecutor {
  public:
   BaseCollectiveExecutor(CollectiveExecutorMgrInterface* cem,
                          CollectiveRemoteAccess* remote_access, int64_t step_id,
                          const DeviceMgr* dev_mgr,
-                         std::shared_ptr<UnboundedWorkQueue> work_queue)
-      : CollectiveExecutor(cem),
-        step_id_(step_id),
-        dev_mgr_(dev_mgr),
-        remote_access_(remote_access),
-        work_queue_(std::move(work_queue)) {}
+                         std::shared_ptr<UnboundedWorkQueue> work_queue,
+                         const CollectiveFuser::Options& fusion_options =
+                             CollectiveFuser::Options::FromEnv());
 
   ~BaseCollectiveExecutor() override;
 
   void StartAbort(const Status& s) override TF_LOCKS_EXCLUDED(status_mu_);
 
+  // Launches the reductions held for fusion without waiting for the end of
+  // the fusion cycle.
+  void FlushFusedCollectives();
+
   void ExecuteAsync(OpKernelContext* ctx, const CollectiveParams* col_params,
                     const string& exec_key, StatusCallback done) override;
 
@@ -152,12 +157,21 @@ class BaseCollectiveExecutor : public CollectiveExecutor {
  private:
   Status CreateCollective(const CollectiveParams& col_params,
                           CollectiveImplementationInterface** col_impl);
+  // Runs the collective described by `col_params` from `input` into `output`
+  // on the work queue.
+  void Launch(OpKernelContext* ctx, const CollectiveParams* col_params,
+              const string& exec_key, const Tensor* input, Tensor* output,
+              const StatusCallback& done);
   // Check if all ops on which this collective depends on have launched.
   bool CheckDependencies(const CollectiveParams& col_params)
       TF_EXCLUSIVE_LOCKS_REQUIRED(launch_mu_);
   // Tries to return the status that is the original error. It returns the
   // aborted status if the collective executor is aborted.
   Status GetStatus(const Status& s) TF_LOCKS_EXCLUDED(status_mu_);
+
+  // Null unless fusion is enabled. Declared last so that it is destroyed
+  // before the members that held collectives use.
+  std::unique_ptr<CollectiveFuser> fuser_;
 };
 
 }  // namespace tensorflow
@@ -0,0 +1,470 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_fuser.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+// Upper bound on the number of reductions in one fused reduction, which fixes
+// the size of the plans sent by the group leader.
+constexpr int kMaxFusedEntries = 128;
+
+// Returns the key of the plan number `plan` for the device at `rank`.
+string PlanKey(const string& bucket_name, int64 plan, int rank) {
+  return strings::StrCat("fusion_plan:", bucket_name, ":", plan, ":", rank);
+}
+
+}  // namespace
+
+/*static*/
+CollectiveFuser::Options CollectiveFuser::Options::FromEnv() {
+  static const Options options = [] {
+    Options options;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_COLLECTIVE_FUSION_CYCLE_MICROS",
+                                    options.cycle_micros,
+                                    &options.cycle_micros));
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_COLLECTIVE_FUSION_THRESHOLD_BYTES",
+                                    options.threshold_bytes,
+                                    &options.threshold_bytes));
+    return options;
+  }();
+  return options;
+}
+
+void CollectiveFuser::Actions::Run() {
+  for (auto& closure : closures) {
+    closure();
+  }
+  closures.clear();
+}
+
+CollectiveFuser::CollectiveFuser(const Options& options,
+                                 CollectiveExecutor* col_exec,
+                                 const DeviceMgr* dev_mgr,
+                                 LaunchCallback launch)
+    : options_(options),
+      col_exec_(col_exec),
+      dev_mgr_(dev_mgr),
+      launch_(std::move(launch)),
+      liveness_(std::make_shared<Liveness>()) {
+  mutex_lock l(liveness_->mu);
+  liveness_->fuser = this;
+}
+
+CollectiveFuser::~CollectiveFuser() {
+  {
+    // Waits for a flush in progress.
+    mutex_lock l(liveness_->mu);
+    liveness_->fuser = nullptr;
+  }
+  Actions actions;
+  {
+    mutex_lock l(mu_);
+    for (const auto& it : buckets_) {
+      if (!it.second.entries.empty()) {
+        LOG(WARNING) << it.second.entries.size()
+                     << " collectives still held for fusion in " << it.first;
+      }
+    }
+    FailAllLocked(errors::Cancelled("Collective executor was destroyed while "
+                                    "the collective was held for fusion"),
+                  &actions);
+  }
+  actions.Run();
+}
+
+/*static*/
+bool CollectiveFuser::CanFuse(const CollectiveParams& col_params) {
+  // CompressedRingReduce keeps state per instance, which fusion would mix up.
+  return col_params.instance.type == REDUCTION_COLLECTIVE &&
+         col_params.group.device_type == DEVICE_CPU &&
+         col_params.group.group_size > 1 && col_params.merge_op != nullptr &&
+         col_params.instance.impl_details.dependencies.empty() &&
+         col_params.instance.impl_details.collective_name !=
+             "CompressedRingReduce" &&
+         col_params.instance.shape.num_elements() > 0;
+}
+
+void CollectiveFuser::Enqueue(OpKernelContext* ctx,
+                              const CollectiveParams* col_params,
+                              const string& exec_key,
+                              const StatusCallback& done) {
+  const CollectiveParams& cp = *col_params;
+  const string& device_name = cp.group.members[cp.default_rank].device.name();
+  Device* device = nullptr;
+  Status status = dev_mgr_->LookupDevice(device_name, &device);
+  if (!status.ok()) {
+    done(status);
+    return;
+  }
+  // All members of the group compute the same bucket name.
+  const string bucket_name = strings::StrCat(
+      cp.group.group_key, ":", DataTypeString(cp.instance.data_type), ":",
+      cp.instance.impl_details.collective_name, ":",
+      cp.merge_op->type_string(), ":",
+      cp.final_op ? cp.final_op->type_string() : "");
+  const string bucket_key = strings::StrCat(device_name, "/", bucket_name);
+  Entry entry{ctx,
+              col_params,
+              exec_key,
+              Fingerprint64(exec_key),
+              cp.instance.shape.num_elements() *
+                  DataTypeSize(cp.instance.data_type),
+              done};
+
+  Actions actions;
+  {
+    mutex_lock l(mu_);
+    if (!abort_status_.ok()) {
+      // Nothing would launch the reduction.
+      actions.closures.push_back(
+          [done, status = abort_status_] { done(status); });
+    } else {
+      Bucket& bucket = buckets_[bucket_key];
+      bucket.name = bucket_name;
+      bucket.device = device;
+      bucket.entry_bytes += entry.bytes;
+      bucket.entries.push_back(std::move(entry));
+      if (cp.default_rank == 0) {
+        while (!bucket.entries.empty() &&
+               bucket.entry_bytes >= options_.threshold_bytes) {
+          PlanBatch(&bucket, &actions);
+        }
+        if (!bucket.entries.empty() && !bucket.timer_scheduled) {
+          bucket.timer_scheduled = true;
+          SchedNonBlockingClosureAfter(
+              options_.cycle_micros, [liveness = liveness_, bucket_key] {
+                mutex_lock l(liveness->mu);
+                if (liveness->fuser != nullptr) {
+                  liveness->fuser->Flush(bucket_key);
+                }
+              });
+        }
+      } else {
+        RunPlans(bucket_key, &bucket, &actions);
+      }
+    }
+  }
+  actions.Run();
+}
+
+void CollectiveFuser::Flush(const string& bucket_key) {
+  Actions actions;
+  {
+    mutex_lock l(mu_);
+    Bucket& bucket = buckets_[bucket_key];
+    bucket.timer_scheduled = false;
+    while (!bucket.entries.empty()) {
+      PlanBatch(&bucket, &actions);
+    }
+  }
+  actions.Run();
+}
+
+void CollectiveFuser::FlushAll() {
+  Actions actions;
+  {
+    mutex_lock l(mu_);
+    for (auto& it : buckets_) {
+      Bucket& bucket = it.second;
+      // Only the group leader plans.
+      while (!bucket.entries.empty() &&
+             bucket.entries.front().col_params->default_rank == 0) {
+        PlanBatch(&bucket, &actions);
+      }
+    }
+  }
+  actions.Run();
+}
+
+void CollectiveFuser::Abort(const Status& status) {
+  Actions actions;
+  {
+    mutex_lock l(mu_);
+    if (abort_status_.ok()) {
+      abort_status_ = status;
+    }
+    FailAllLocked(status, &actions);
+  }
+  actions.Run();
+}
+
+void CollectiveFuser::FailAllLocked(const Status& status, Actions* actions) {
+  for (auto& it : buckets_) {
+    Bucket& bucket = it.second;
+    for (Entry& entry : bucket.entries) {
+      actions->closures.push_back(
+          [done = std::move(entry.done), status] { done(status); });
+    }
+    bucket.entries.clear();
+    bucket.entry_bytes = 0;
+    bucket.plans.clear();
+  }
+}
+
+void CollectiveFuser::PlanBatch(Bucket* bucket, Actions* actions) {
+  DCHECK(!bucket->entries.empty());
+  auto batch = std::make_shared<std::vector<Entry>>();
+  int64 batch_bytes = 0;
+  auto it = bucket->entries.begin();
+  while (it != bucket->entries.end() && batch->size() < kMaxFusedEntries &&
+         (batch->empty() ||
+          batch_bytes + it->bytes <= options_.threshold_bytes)) {
+    batch_bytes += it->bytes;
+    batch->push_back(std::move(*it));
+    ++it;
+  }
+  bucket->entries.erase(bucket->entries.begin(), it);
+  bucket->entry_bytes -= batch_bytes;
+  const int64 plan = bucket->next_plan++;
+
+  auto plan_tensor = std::make_shared<Tensor>(
+      DT_INT64, TensorShape({kMaxFusedEntries + 1}));
+  auto plan_flat = plan_tensor->flat<int64>();
+  plan_flat.setZero();
+  plan_flat(0) = batch->size();
+  for (int i = 0; i < batch->size(); ++i) {
+    plan_flat(i + 1) = static_cast<int64>((*batch)[i].fingerprint);
+  }
+  VLOG(1) << "Fusing " << batch->size() << " collectives of " << batch_bytes
+          << " bytes as plan " << plan << " of " << bucket->name;
+
+  const CollectiveParams& cp = *batch->front().col_params;
+  OpKernelContext* ctx = batch->front().ctx;
+  Device* device = bucket->device;
+  for (int rank = 0; rank < cp.group.group_size; ++rank) {
+    if (rank == cp.default_rank) continue;
+    const CollGroupMember& member = cp.group.members[rank];
+    actions->closures.push_back([this, plan_tensor, ctx, device,
+                                 peer_device = member.device.name(),
+                                 peer_task = member.task,
+                                 key = PlanKey(bucket->name, plan, rank)] {
+      col_exec_->remote_access()->PostToPeer(
+          peer_device, peer_task, key, device, ctx->op_device_context(),
+          ctx->output_alloc_attr(0), plan_tensor.get(),
+          device->attributes().locality(), ctx->cancellation_manager(),
+          [this, plan_tensor](const Status& s) {
+            // The other members cannot launch the reduction without the plan.
+            if (!s.ok()) col_exec_->StartAbort(s);
+          });
+    });
+  }
+  actions->closures.push_back([this, name = bucket->name, plan, batch] {
+    LaunchBatch(name, plan, std::move(*batch));
+  });
+}
+
+void CollectiveFuser::RunPlans(const string& bucket_key, Bucket* bucket,
+                               Actions* actions) {
+  int64 plan = bucket->next_plan - bucket->plans.size();
+  while (!bucket->plans.empty()) {
+    const std::vector<uint64>& fingerprints = bucket->plans.front();
+    std::vector<int> indices;
+    for (uint64 fingerprint : fingerprints) {
+      for (int i = 0; i < bucket->entries.size(); ++i) {
+        if (bucket->entries[i].fingerprint == fingerprint) {
+          indices.push_back(i);
+          break;
+        }
+      }
+    }
+    // Wait for the collectives of the plan that were not issued yet.
+    if (indices.size() < fingerprints.size()) break;
+
+    auto batch = std::make_shared<std::vector<Entry>>();
+    for (int i : indices) {
+      bucket->entry_bytes -= bucket->entries[i].bytes;
+      batch->push_back(std::move(bucket->entries[i]));
+    }
+    std::sort(indices.begin(), indices.end());
+    for (auto i = indices.rbegin(); i != indices.rend(); ++i) {
+      bucket->entries.erase(bucket->entries.begin() + *i);
+    }
+    bucket->plans.pop_front();
+    actions->closures.push_back([this, name = bucket->name, plan, batch] {
+      LaunchBatch(name, plan, std::move(*batch));
+    });
+    ++plan;
+  }
+
+  // Only receive another plan when it is due to cover a held collective, so
+  // that no receive is left pending at the end of the step.
+  if (bucket->plan_recv_pending) return;
+  std::unordered_set<uint64> planned;
+  for (const auto& fingerprints : bucket->plans) {
+    planned.insert(fingerprints.begin(), fingerprints.end());
+  }
+  for (const Entry& entry : bucket->entries) {
+    if (planned.find(entry.fingerprint) == planned.end()) {
+      RecvPlan(bucket_key, entry, bucket, actions);
+      return;
+    }
+  }
+}
+
+void CollectiveFuser::RecvPlan(const string& bucket_key, const Entry& entry,
+                               Bucket* bucket, Actions* actions) {
+  bucket->plan_recv_pending = true;
+  // `entry` is held until this plan or a later one arrives, so its context
+  // outlives the receive.
+  const CollGroupMember& leader = entry.col_params->group.members[0];
+  OpKernelContext* ctx = entry.ctx;
+  Device* device = bucket->device;
+  auto plan_tensor = std::make_shared<Tensor>(
+      DT_INT64, TensorShape({kMaxFusedEntries + 1}));
+  actions->closures.push_back([this, bucket_key, plan_tensor, ctx, device,
+                               peer_device = leader.device.name(),
+                               peer_task = leader.task,
+                               peer_is_local = leader.is_local,
+                               key = PlanKey(bucket->name, bucket->next_plan,
+                                             entry.col_params->default_rank)] {
+    col_exec_->remote_access()->RecvFromPeer(
+        peer_device, peer_task, peer_is_local, key, device,
+        ctx->op_device_context(), ctx->output_alloc_attr(0), plan_tensor.get(),
+        device->attributes().locality(), /*dev_to_dev_stream_index=*/0,
+        ctx->cancellation_manager(),
+        [this, bucket_key, plan_tensor](const Status& s) {
+          OnPlan(bucket_key, s, *plan_tensor);
+        });
+  });
+}
+
+void CollectiveFuser::OnPlan(const string& bucket_key, Status status,
+                             const Tensor& plan_tensor) {
+  auto plan_flat = plan_tensor.flat<int64>();
+  if (status.ok() && (plan_flat(0) < 1 || plan_flat(0) > kMaxFusedEntries)) {
+    status = errors::Internal("Invalid collective fusion plan of size ",
+                              plan_flat(0), " for ", bucket_key);
+  }
+  Actions actions;
+  {
+    mutex_lock l(mu_);
+    Bucket& bucket = buckets_[bucket_key];
+    bucket.plan_recv_pending = false;
+    if (status.ok()) {
+      std::vector<uint64> fingerprints;
+      for (int i = 1; i <= plan_flat(0); ++i) {
+        fingerprints.push_back(static_cast<uint64>(plan_flat(i)));
+      }
+      bucket.plans.push_back(std::move(fingerprints));
+      ++bucket.next_plan;
+      RunPlans(bucket_key, &bucket, &actions);
+    } else {
+      // Without the plan, none of the held collectives can be launched.
+      for (Entry& entry : bucket.entries) {
+        actions.closures.push_back(
+            [done = std::move(entry.done), status] { done(status); });
+      }
+      bucket.entries.clear();
+      bucket.entry_bytes = 0;
+      bucket.plans.clear();
+    }
+  }
+  actions.Run();
+}
+
+void CollectiveFuser::LaunchBatch(const string& bucket_name, int64 plan,
+                                  std::vector<Entry> batch) {
+  if (batch.size() == 1) {
+    Entry& entry = batch.front();
+    launch_(entry.ctx, entry.col_params, entry.exec_key, &entry.ctx->input(0),
+            entry.ctx->mutable_output(0), entry.done);
+    return;
+  }
+
+  const Entry& first = batch.front();
+  const CollectiveParams& cp = *first.col_params;
+  int64 num_elements = 0;
+  for (const Entry& entry : batch) {
+    num_elements += entry.col_params->instance.shape.num_elements();
+  }
+  auto fused = std::make_shared<Tensor>(
+      first.ctx->device()->GetAllocator(first.ctx->output_alloc_attr(0)),
+      cp.instance.data_type, TensorShape({num_elements}));
+  if (!fused->IsInitialized()) {
+    Status status = errors::ResourceExhausted(
+        "Failed to allocate ", num_elements, " elements for collective ",
+        "fusion in ", bucket_name);
+    for (Entry& entry : batch) {
+      entry.done(status);
+    }
+    return;
+  }
+  char* fused_base = static_cast<char*>(DMAHelper::base(fused.get()));
+  int64 offset = 0;
+  for (const Entry& entry : batch) {
+    const Tensor& input = entry.ctx->input(0);
+    memcpy(fused_base + offset, DMAHelper::base(&input), entry.bytes);
+    offset += entry.bytes;
+  }
+
+  // The fused reduction takes over the resolved params of the first one.
+  // CollInstanceParams::operator= leaves out the implementation details.
+  CollectiveParams* fused_params = new CollectiveParams();
+  fused_params->group = cp.group;
+  fused_params->instance = cp.instance;
+  fused_params->instance.impl_details = cp.instance.impl_details;
+  fused_params->instance.shape = fused->shape();
+  fused_params->name = strings::StrCat("fused/", cp.name);
+  fused_params->default_rank = cp.default_rank;
+  fused_params->subdiv_rank = cp.subdiv_rank;
+  fused_params->merge_op = cp.merge_op;
+  fused_params->final_op = cp.final_op;
+  // The fused reduction unblocks the dependencies of the first one only.
+  for (int i = 1; i < batch.size(); ++i) {
+    col_exec_->UnblockDependencies(*batch[i].col_params);
+  }
+
+  OpKernelContext* ctx = first.ctx;
+  auto entries = std::make_shared<std::vector<Entry>>(std::move(batch));
+  launch_(ctx, fused_params,
+          strings::StrCat("fused:", bucket_name, ":", plan), fused.get(),
+          fused.get(),
+          [fused, fused_params, entries](const Status& s) {
+            core::ScopedUnref unref(fused_params);
+            if (s.ok()) {
+              const char* fused_base =
+                  static_cast<const char*>(DMAHelper::base(fused.get()));
+              int64 offset = 0;
+              for (const Entry& entry : *entries) {
+                memcpy(DMAHelper::base(entry.ctx->mutable_output(0)),
+                       fused_base + offset, entry.bytes);
+                offset += entry.bytes;
+              }
+            }
+            for (Entry& entry : *entries) {
+              entry.done(s);
+            }
+          });
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,165 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_FUSER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_FUSER_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+
+class DeviceMgr;
+
+// Fuses all-reduces that are issued independently, e.g. as gradients become
+// ready, into fewer and larger collectives at runtime.
+//
+// Reductions of the same group, data type and ops are held on each device for
+// up to a cycle time, or until a byte threshold is reached. The device with
+// rank 0 in the group then picks the held reductions to fuse, in order, and
+// posts that plan to the other members, so that all of them pack the same
+// inputs into one contiguous buffer. A single collective reduces the buffer,
+// and its result is unpacked into the outputs of the fused reductions.
+class CollectiveFuser {
+ public:
+  struct Options {
+    // How long to hold a reduction for others to fuse it with. Zero disables
+    // fusion.
+    int64 cycle_micros = 0;
+    // Launches the held reductions as soon as they add up to this many bytes.
+    // Also bounds the size of a fused reduction.
+    int64 threshold_bytes = 64 << 20;
+
+    // Reads TF_COLLECTIVE_FUSION_CYCLE_MICROS and
+    // TF_COLLECTIVE_FUSION_THRESHOLD_BYTES.
+    static Options FromEnv();
+  };
+
+  // Launches a collective with the given params on the given buffers.
+  typedef std::function<void(OpKernelContext* ctx,
+                             const CollectiveParams* col_params,
+                             const string& exec_key, const Tensor* input,
+                             Tensor* output, const StatusCallback& done)>
+      LaunchCallback;
+
+  CollectiveFuser(const Options& options, CollectiveExecutor* col_exec,
+                  const DeviceMgr* dev_mgr, LaunchCallback launch);
+  ~CollectiveFuser();
+
+  // Returns true if `col_params` describes a collective that may be fused.
+  // Only CPU reductions without ordering dependencies are.
+  static bool CanFuse(const CollectiveParams& col_params);
+
+  // Holds the reduction of `ctx->input(0)` into `ctx->mutable_output(0)` for
+  // fusion. Calls `done` once the output is ready.
+  void Enqueue(OpKernelContext* ctx, const CollectiveParams* col_params,
+               const string& exec_key, const StatusCallback& done);
+
+  // Plans and launches everything held on the group leaders now, as if the
+  // cycle time had passed.
+  void FlushAll() TF_LOCKS_EXCLUDED(mu_);
+
+  // Fails every held reduction with `status`, and the reductions enqueued
+  // later too. Called when the collective executor aborts, since the held
+  // reductions were not launched and nothing else would complete them.
+  void Abort(const Status& status) TF_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // A reduction held for fusion.
+  struct Entry {
+    OpKernelContext* ctx;
+    const CollectiveParams* col_params;
+    string exec_key;
+    uint64 fingerprint;  // of exec_key, to name the entry in plans
+    int64 bytes;
+    StatusCallback done;
+  };
+
+  // The reductions held on one device that may be fused with each other.
+  struct Bucket {
+    string name;  // The same on all members of the group.
+    Device* device;
+    // Fused reductions are launched in plan order. Received plans wait here
+    // until all of their entries are held.
+    std::vector<Entry> entries;
+    int64 entry_bytes = 0;
+    std::deque<std::vector<uint64>> plans;
+    int64 next_plan = 0;
+    bool timer_scheduled = false;
+    bool plan_recv_pending = false;
+  };
+
+  // Work that must run without holding `mu_`.
+  struct Actions {
+    std::vector<std::function<void()>> closures;
+    void Run();
+  };
+
+  // As the group leader, picks the entries of the next fused reduction and
+  // posts the plan to the other members.
+  void PlanBatch(Bucket* bucket, Actions* actions)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Plans everything held in the bucket, once the cycle time has passed.
+  void Flush(const string& bucket_key) TF_LOCKS_EXCLUDED(mu_);
+  // As a follower, launches the received plans whose entries are all held,
+  // and receives the next plan if some entries are not covered yet.
+  void RunPlans(const string& bucket_key, Bucket* bucket, Actions* actions)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void RecvPlan(const string& bucket_key, const Entry& entry, Bucket* bucket,
+                Actions* actions) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void OnPlan(const string& bucket_key, Status status,
+              const Tensor& plan_tensor) TF_LOCKS_EXCLUDED(mu_);
+  // Launches `batch` as the fused reduction number `plan` of the bucket.
+  void LaunchBatch(const string& bucket_name, int64 plan,
+                   std::vector<Entry> batch);
+  // Fails and drops all held reductions.
+  void FailAllLocked(const Status& status, Actions* actions)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const Options options_;
+  CollectiveExecutor* col_exec_;  // Not owned.
+  const DeviceMgr* dev_mgr_;      // Not owned.
+  const LaunchCallback launch_;
+
+  // Shared with the scheduled flushes, which do nothing once the fuser is
+  // gone.
+  struct Liveness {
+    mutex mu;
+    CollectiveFuser* fuser TF_GUARDED_BY(mu);
+  };
+  std::shared_ptr<Liveness> liveness_;
+
+  mutex mu_;
+  // Keyed by device name and bucket name.
+  std::unordered_map<string, Bucket> buckets_ TF_GUARDED_BY(mu_);
+  // Set by Abort().
+  Status abort_status_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(CollectiveFuser);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_FUSER_H_
@@ -0,0 +1,317 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_fuser.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_test_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/halving_doubling_reducer.h"
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/refcount.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+// Records the number of elements of every reduction that is launched.
+mutex launched_mu(LINKER_INITIALIZED);
+std::vector<int64> launched_sizes TF_GUARDED_BY(launched_mu);
+
+class CountingReducer : public HalvingDoublingReducer {
+ public:
+  void Run(StatusCallback done) override {
+    {
+      mutex_lock l(launched_mu);
+      launched_sizes.push_back(col_params_->instance.shape.num_elements());
+    }
+    HalvingDoublingReducer::Run(std::move(done));
+  }
+
+ protected:
+  const char* CollectiveName() const override { return "CountingReduce"; }
+};
+
+REGISTER_COLLECTIVE(CountingReduce, CountingReducer);
+
+std::unique_ptr<OpKernel> GetKernel(const string& op, DataType dtype,
+                                    DeviceBase* device) {
+  NodeDef node_def;
+  TF_CHECK_OK(NodeDefBuilder("merge_node", op)
+                  .Attr("T", dtype)
+                  .Input(FakeInput(dtype))
+                  .Input(FakeInput(dtype))
+                  .Finalize(&node_def));
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()),
+      node_def, TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+class CollectiveFuserTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumWorkers = 2;
+  static constexpr int kNumDevices = 2;
+  static constexpr int kGroupSize = kNumWorkers * kNumDevices;
+
+  // One all-reduce on one device, issued through the executor.
+  struct Call {
+    Tensor input;
+    Tensor output;
+    core::RefCountPtr<CollectiveParams> col_params;
+    CancellationManager cancellation_manager;
+    gtl::InlinedVector<TensorValue, 4> inputs;
+    gtl::InlinedVector<AllocatorAttributes, 4> input_alloc_attrs;
+    AllocatorAttributes output_alloc_attr;
+    int forward_from = 0;
+    core::RefCountPtr<DeviceContext> device_context;
+    OpKernelContext::Params op_params;
+    std::unique_ptr<OpKernelContext> ctx;
+    Notification done;
+    Status status;
+  };
+
+  void Init(const CollectiveFuser::Options& options) {
+    test_env_ = CreateCollectiveTestEnv(kNumWorkers, kNumDevices, DEVICE_CPU);
+    col_exec_ = new BaseCollectiveExecutor(
+        test_env_->col_exec_mgr.get(),
+        new CollectiveRemoteAccessLocal(test_env_->device_mgr.get(),
+                                        test_env_->device_resolver.get(),
+                                        /*step_id=*/0),
+        /*step_id=*/0, test_env_->device_mgr.get(), test_env_->work_queue,
+        options);
+    test_env_->col_exec.reset(col_exec_);
+    for (int rank = 0; rank < kGroupSize; ++rank) {
+      auto cp = CreateCollectiveParams(*test_env_, rank, "CountingReduce",
+                                       REDUCTION_COLLECTIVE, DT_FLOAT,
+                                       TensorShape({1}));
+      Device* device;
+      TF_CHECK_OK(test_env_->device_mgr->LookupDevice(
+          cp->group.members[rank].device.name(), &device));
+      devices_.push_back(device);
+      merge_ops_.push_back(GetKernel("Add", DT_FLOAT, device));
+      final_ops_.push_back(GetKernel("Div", DT_FLOAT, device));
+    }
+    mutex_lock l(launched_mu);
+    launched_sizes.clear();
+  }
+
+  // Issues the all-reduce with `instance_key` of `len` elements on the device
+  // at `rank`, with values that depend on both.
+  Call* Issue(int rank, int instance_key, int64 len) {
+    calls_.push_back(absl::make_unique<Call>());
+    Call* call = calls_.back().get();
+    Device* device = devices_[rank];
+    call->input = Tensor(DT_FLOAT, TensorShape({len}));
+    call->output = Tensor(DT_FLOAT, TensorShape({len}));
+    for (int64 i = 0; i < len; ++i) {
+      call->input.flat<float>()(i) = rank * 10 + instance_key + i % 7;
+    }
+
+    call->col_params = CreateCollectiveParams(
+        *test_env_, rank, "CountingReduce", REDUCTION_COLLECTIVE, DT_FLOAT,
+        call->input.shape());
+    call->col_params->instance.instance_key = instance_key;
+    call->col_params->merge_op = merge_ops_[rank].get();
+    call->col_params->final_op = final_ops_[rank].get();
+
+    call->inputs.push_back(TensorValue(&call->input));
+    call->input_alloc_attrs.push_back(AllocatorAttributes());
+    call->device_context.reset(new DeviceContext);
+    OpKernelContext::Params& op_params = call->op_params;
+    op_params.step_id = 0;
+    op_params.device = device;
+    // Any kernel with an output of the right type will do.
+    op_params.op_kernel = merge_ops_[rank].get();
+    op_params.cancellation_manager = &call->cancellation_manager;
+    op_params.inputs = &call->inputs;
+    op_params.input_alloc_attrs = &call->input_alloc_attrs;
+    op_params.op_device_context = call->device_context.get();
+    op_params.forward_from_array = &call->forward_from;
+    op_params.output_attr_array = &call->output_alloc_attr;
+    op_params.resource_manager = device->resource_manager();
+    call->ctx = absl::make_unique<OpKernelContext>(&op_params, 1);
+    call->ctx->set_output(0, call->output);
+
+    test_env_->col_exec->ExecuteAsync(
+        call->ctx.get(), call->col_params.get(),
+        strings::StrCat(instance_key, ":0:0"), [call](const Status& s) {
+          call->status = s;
+          call->done.Notify();
+        });
+    return call;
+  }
+
+  // Waits for all issued all-reduces, and checks their results.
+  void ExpectMeans() {
+    for (const auto& call : calls_) {
+      call->done.WaitForNotification();
+      TF_EXPECT_OK(call->status);
+      // The mean of rank * 10 over all ranks.
+      const float rank_mean = 10 * (kGroupSize - 1) / 2.0;
+      const float instance_key = call->col_params->instance.instance_key;
+      const Tensor& output = *call->ctx->mutable_output(0);
+      std::vector<float> expected(output.NumElements());
+      for (int64 i = 0; i < expected.size(); ++i) {
+        expected[i] = rank_mean + instance_key + i % 7;
+      }
+      test::ExpectTensorEqual<float>(test::AsTensor<float>(expected), output);
+    }
+  }
+
+  std::vector<int64> LaunchedSizes() {
+    mutex_lock l(launched_mu);
+    std::vector<int64> sizes = launched_sizes;
+    std::sort(sizes.begin(), sizes.end());
+    return sizes;
+  }
+
+  std::unique_ptr<CollectiveTestEnv> test_env_;
+  BaseCollectiveExecutor* col_exec_;  // Owned by test_env_.
+  std::vector<Device*> devices_;
+  std::vector<std::unique_ptr<OpKernel>> merge_ops_;
+  std::vector<std::unique_ptr<OpKernel>> final_ops_;
+  std::vector<std::unique_ptr<Call>> calls_;
+};
+
+// Long enough for the test to time out if a reduction waited for the end of
+// the cycle.
+constexpr int64 kLongCycleMicros = 3600LL * 1000 * 1000;
+
+TEST_F(CollectiveFuserTest, FusesWithinCycle) {
+  CollectiveFuser::Options options;
+  options.cycle_micros = kLongCycleMicros;
+  Init(options);
+  const std::vector<int64> lens = {1, 7, 16, 100, 1001, 3};
+  // The devices issue the reductions in different orders.
+  for (int rank = 0; rank < kGroupSize; ++rank) {
+    for (int k = 0; k < lens.size(); ++k) {
+      const int i = rank % 2 == 0 ? k : lens.size() - 1 - k;
+      Issue(rank, 100 + i, lens[i]);
+    }
+  }
+  // All of them are held until the end of the cycle.
+  for (const auto& call : calls_) {
+    EXPECT_FALSE(call->done.HasBeenNotified());
+  }
+  col_exec_->FlushFusedCollectives();
+  ExpectMeans();
+  EXPECT_EQ(std::vector<int64>(kGroupSize, 1128), LaunchedSizes());
+}
+
+TEST_F(CollectiveFuserTest, LaunchesAtThreshold) {
+  CollectiveFuser::Options options;
+  options.cycle_micros = kLongCycleMicros;
+  options.threshold_bytes = 64 * sizeof(float);
+  Init(options);
+  for (int rank = 0; rank < kGroupSize; ++rank) {
+    for (int i = 0; i < 4; ++i) {
+      Issue(rank, 100 + i, 32);
+    }
+  }
+  ExpectMeans();
+  EXPECT_EQ(std::vector<int64>(2 * kGroupSize, 64), LaunchedSizes());
+}
+
+TEST_F(CollectiveFuserTest, OversizedReductionsRunAlone) {
+  CollectiveFuser::Options options;
+  options.cycle_micros = kLongCycleMicros;
+  options.threshold_bytes = 16 * sizeof(float);
+  Init(options);
+  for (int rank = 0; rank < kGroupSize; ++rank) {
+    Issue(rank, 100, 1000);
+  }
+  ExpectMeans();
+  EXPECT_EQ(std::vector<int64>(kGroupSize, 1000), LaunchedSizes());
+}
+
+TEST_F(CollectiveFuserTest, AbortFailsHeldReductions) {
+  CollectiveFuser::Options options;
+  options.cycle_micros = kLongCycleMicros;
+  Init(options);
+  for (int rank = 0; rank < kGroupSize; ++rank) {
+    Issue(rank, 100, 8);
+    Issue(rank, 101, 8);
+  }
+  col_exec_->StartAbort(errors::Internal("test abort"));
+  for (const auto& call : calls_) {
+    call->done.WaitForNotification();
+    EXPECT_FALSE(call->status.ok());
+  }
+  // Later reductions fail right away rather than being held.
+  Call* call = Issue(0, 102, 8);
+  call->done.WaitForNotification();
+  EXPECT_FALSE(call->status.ok());
+  EXPECT_TRUE(LaunchedSizes().empty());
+}
+
+TEST_F(CollectiveFuserTest, DestructionFailsHeldReductions) {
+  CollectiveFuser::Options options;
+  options.cycle_micros = kLongCycleMicros;
+  Init(options);
+  // The group leader holds the reduction until the end of the cycle.
+  Call* call = Issue(0, 100, 8);
+  EXPECT_FALSE(call->done.HasBeenNotified());
+  test_env_->col_exec.reset();
+  call->done.WaitForNotification();
+  EXPECT_FALSE(call->status.ok());
+  EXPECT_TRUE(LaunchedSizes().empty());
+}
+
+TEST(CollectiveFuserCanFuseTest, OnlyCpuReductions) {
+  auto test_env = CreateCollectiveTestEnv(1, 2, DEVICE_CPU);
+  auto cp = CreateCollectiveParams(*test_env, /*rank*/ 0, "RingReduce",
+                                   REDUCTION_COLLECTIVE, DT_FLOAT,
+                                   TensorShape({16}));
+  Device* device;
+  TF_CHECK_OK(test_env->device_mgr->LookupDevice(
+      cp->group.members[0].device.name(), &device));
+  std::unique_ptr<OpKernel> merge_op = GetKernel("Add", DT_FLOAT, device);
+  cp->merge_op = merge_op.get();
+  EXPECT_TRUE(CollectiveFuser::CanFuse(*cp));
+
+  cp->instance.impl_details.dependencies = {3};
+  EXPECT_FALSE(CollectiveFuser::CanFuse(*cp));
+  cp->instance.impl_details.dependencies.clear();
+
+  cp->group.device_type = DEVICE_GPU;
+  EXPECT_FALSE(CollectiveFuser::CanFuse(*cp));
+  cp->group.device_type = DEVICE_CPU;
+
+  cp->instance.type = GATHER_COLLECTIVE;
+  EXPECT_FALSE(CollectiveFuser::CanFuse(*cp));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -22,6 +22,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_join.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/framework/cancellation.h"
@@ -83,6 +84,12 @@ const char* GetCollectiveName(const CollectiveParams* cp, bool nccl) {
   }
 }
 
+// CPU reductions of at most this many bytes over more than two devices use an
+// algorithm with fewer sequential steps than the ring, since their latency
+// dominates the transfer time. A constant rather than a flag, so that all
+// members of an instance, which share its shape, make the same choice.
+constexpr int64 kSmallReductionBytes = 64 << 10;
+
 string TaskNameFromDeviceName(const string& device_name) {
   DeviceNameUtils::ParsedName parsed_device;
   CHECK(DeviceNameUtils::ParseFullName(device_name, &parsed_device));
@@ -693,6 +700,29 @@ void CollectiveParamResolverLocal::AssignCollectiveType(CollectiveParams* cp) {
       CollectiveRegistry::LookupParamResolverInstance("NcclReduce", &col_impl)
           .ok();
   cp->instance.impl_details.collective_name = GetCollectiveName(cp, use_nccl);
+  // A "compressed" or "compressed:<options>" hint selects the ring reduction
+  // that compresses gradients, which is implemented only for CPU.
+  const string& hint = cp->instance.impl_details.communication_hint;
+  if (cp->instance.type == REDUCTION_COLLECTIVE &&
+      cp->group.device_type == DEVICE_CPU &&
+      (hint == "compressed" || absl::StartsWith(hint, "compressed:"))) {
+    cp->instance.impl_details.collective_name = "CompressedRingReduce";
+  } else if (cp->instance.impl_details.collective_name == "RingReduce" &&
+             cp->group.device_type == DEVICE_CPU && hint != "ring" &&
+             cp->group.group_size > 2 &&
+             (hint == "latency" ||
+              cp->instance.shape.num_elements() *
+                      DataTypeSize(cp->instance.data_type) <=
+                  kSmallReductionBytes)) {
+    // Small tensors, or any tensor with a "latency" hint, are reduced with
+    // fewer sequential steps than the ring; a "ring" hint keeps the ring.
+    // When every task has a single device, or all devices are on one task,
+    // there is no cheaper level to reduce on first.
+    const bool two_level = cp->group.num_tasks > 1 &&
+                           cp->group.num_tasks < cp->group.group_size;
+    cp->instance.impl_details.collective_name =
+        two_level ? "TwoLevelReduce" : "HalvingDoublingReduce";
+  }
   VLOG(1) << "AssignCollectiveType "
           << cp->instance.impl_details.collective_name;
 }
@@ -208,6 +208,65 @@ TEST_F(CollectiveParamResolverLocalTest, CompleteParamsReduction1Task) {
   }
 }
 
+TEST_F(CollectiveParamResolverLocalTest, CompleteParamsReductionBySize) {
+  // Small CPU reductions use fewer sequential steps than the ring, unless
+  // the hint asks for the ring. The "latency" hint selects them for any size.
+  struct Case {
+    string hint;
+    int64 num_elements;
+    string collective_name;
+  };
+  const Case cases[] = {
+      {"auto", 5, "HalvingDoublingReduce"},
+      {"auto", 16 << 10, "HalvingDoublingReduce"},
+      {"auto", (16 << 10) + 1, "RingReduce"},
+      {"ring", 5, "RingReduce"},
+      {"latency", 1 << 20, "HalvingDoublingReduce"},
+  };
+  int instance_key = 8;
+  for (const Case& test_case : cases) {
+    CollectiveParams* cps[NUM_DEVS];
+    Status statuses[NUM_DEVS];
+    Notification note[NUM_DEVS];
+    for (int i = 0; i < NUM_DEVS; ++i) {
+      cps[i] = new CollectiveParams();
+      CollectiveParams* cp = cps[i];
+      cp->group.group_key = 1;
+      cp->group.group_size = 3;
+      cp->group.device_type = DeviceType("CPU");
+      cp->group.num_tasks = 1;
+      cp->instance.instance_key = instance_key;
+      cp->instance.type = REDUCTION_COLLECTIVE;
+      cp->instance.data_type = DataType(DT_FLOAT);
+      cp->instance.shape = TensorShape({test_case.num_elements});
+      cp->instance.impl_details.subdiv_offsets.push_back(0);
+      cp->instance.impl_details.communication_hint = test_case.hint;
+      cp->is_source = false;
+      Env::Default()->SchedClosure([this, i, cp, &note, &statuses]() {
+        string device =
+            strings::StrCat("/job:localhost/replica:0/task:0/device:CPU:", i);
+        prl_->CompleteParamsAsync(GetDeviceAttributes(device), cp,
+                                  nullptr /*CancellationManager*/,
+                                  [&statuses, &note, i](const Status& s) {
+                                    statuses[i] = s;
+                                    note[i].Notify();
+                                  });
+      });
+    }
+    for (int i = 0; i < NUM_DEVS; ++i) {
+      note[i].WaitForNotification();
+    }
+    for (int i = 0; i < NUM_DEVS; ++i) {
+      TF_ASSERT_OK(statuses[i]);
+      EXPECT_EQ(test_case.collective_name,
+                cps[i]->instance.impl_details.collective_name)
+          << test_case.hint << " " << test_case.num_elements;
+      cps[i]->Unref();
+    }
+    ++instance_key;
+  }
+}
+
 void InitializeCollectiveParamsForBroadcast(int instance_key, int device_idx,
                                             bool is_source,
                                             CollectiveParams* cp) {
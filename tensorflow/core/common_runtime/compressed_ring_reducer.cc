@@ -0,0 +1,321 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/compressed_ring_reducer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/framework/numeric_types.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kHint[] = "compressed";
+constexpr char kResidualContainer[] = "collective_compression";
+// Every value is sent as a 16 bit float.
+constexpr int64 kWireValueBytes = 2;
+// Top-k indices are sent as int32.
+constexpr int64 kWireIndexBytes = sizeof(int32);
+
+int64 TopKCount(float fraction, int64 n) {
+  if (n == 0) return 0;
+  return std::min<int64>(
+      n, std::max<int64>(1, static_cast<int64>(std::ceil(fraction * n))));
+}
+
+// Encodes `values` into `wire`, and rounds them to what the receiver
+// decodes.
+template <typename W>
+void EncodeValues(float* values, int64 n, W* wire) {
+  for (int64 i = 0; i < n; ++i) {
+    wire[i] = static_cast<W>(values[i]);
+    values[i] = static_cast<float>(wire[i]);
+  }
+}
+
+template <typename W>
+void DecodeValues(const W* wire, int64 n, float* values) {
+  for (int64 i = 0; i < n; ++i) {
+    values[i] = static_cast<float>(wire[i]);
+  }
+}
+
+// Adds `values` to `residual`, encodes the `k` sums with the largest
+// magnitude into `indices` and `wire`, and leaves what was not sent in
+// `residual`.
+template <typename W>
+void EncodeTopK(const float* values, int64 n, int64 k, float* residual,
+                int32* indices, W* wire) {
+  for (int64 i = 0; i < n; ++i) {
+    residual[i] += values[i];
+  }
+  std::vector<int32> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::nth_element(order.begin(), order.begin() + k, order.end(),
+                   [residual](int32 a, int32 b) {
+                     return std::abs(residual[a]) > std::abs(residual[b]);
+                   });
+  // Sorted indices make the scatter on the receiver sequential.
+  std::sort(order.begin(), order.begin() + k);
+  for (int64 j = 0; j < k; ++j) {
+    const int32 i = order[j];
+    indices[j] = i;
+    wire[j] = static_cast<W>(residual[i]);
+    residual[i] -= static_cast<float>(wire[j]);
+  }
+}
+
+template <typename W>
+Status DecodeTopK(const int32* indices, const W* wire, int64 k, int64 n,
+                  float* values) {
+  std::fill(values, values + n, 0.0f);
+  for (int64 j = 0; j < k; ++j) {
+    if (indices[j] < 0 || indices[j] >= n) {
+      return errors::Internal("Top-k index ", indices[j],
+                              " out of range for a chunk of ", n, " values");
+    }
+    values[indices[j]] = static_cast<float>(wire[j]);
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+CompressedRingReducer::~CompressedRingReducer() {
+  // Instances that fail to initialize never run, and RingReducer waits in its
+  // destructor for Run() to finish with the group size tensor.
+  if (!started_) {
+    group_size_tensor_ready_.Notify();
+  }
+}
+
+/*static*/ bool CompressedRingReducer::IsCompressionHint(const string& hint) {
+  return hint == kHint || absl::StartsWith(hint, strings::StrCat(kHint, ":"));
+}
+
+/*static*/ Status CompressedRingReducer::ParseCompressionHint(
+    const string& hint, Options* options) {
+  if (!IsCompressionHint(hint)) {
+    return errors::InvalidArgument("Not a compression hint: ", hint);
+  }
+  *options = Options();
+  if (hint.size() == strlen(kHint)) {
+    return Status::OK();
+  }
+  for (const string& option :
+       str_util::Split(hint.substr(strlen(kHint) + 1), ',')) {
+    StringPiece fraction = option;
+    if (option == "bf16") {
+      options->wire_dtype = DT_BFLOAT16;
+    } else if (option == "fp16") {
+      options->wire_dtype = DT_HALF;
+    } else if (str_util::ConsumePrefix(&fraction, "topk=") &&
+               strings::safe_strtof(fraction, &options->topk_fraction) &&
+               options->topk_fraction > 0 && options->topk_fraction <= 1) {
+      continue;
+    } else {
+      return errors::InvalidArgument("Invalid option \"", option,
+                                     "\" in communication hint ", hint);
+    }
+  }
+  return Status::OK();
+}
+
+Status CompressedRingReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  if (col_params->instance.type != REDUCTION_COLLECTIVE ||
+      col_params->instance.impl_details.collective_name !=
+          "CompressedRingReduce") {
+    return errors::Internal("Unexpected collective ",
+                            col_params->instance.impl_details.collective_name,
+                            " for CompressedRingReducer");
+  }
+  Options options;
+  TF_RETURN_IF_ERROR(ParseCompressionHint(
+      col_params->instance.impl_details.communication_hint, &options));
+  if (col_params->instance.data_type != DT_FLOAT ||
+      col_params->group.device_type != DEVICE_CPU) {
+    return errors::InvalidArgument(
+        "Compressed all-reduce supports only float tensors on CPU, got ",
+        DataTypeString(col_params->instance.data_type), " on ",
+        col_params->group.device_type.type_string());
+  }
+  if (options.topk_fraction > 0 && col_params->merge_op != nullptr &&
+      col_params->merge_op->type_string() != "Add" &&
+      col_params->merge_op->type_string() != "AddV2") {
+    return errors::InvalidArgument(
+        "Top-k compression requires an Add merge op, got ",
+        col_params->merge_op->type_string());
+  }
+  return RingAlg::InitializeCollectiveParams(col_params);
+}
+
+Status CompressedRingReducer::InitializeCollectiveContext(
+    std::shared_ptr<CollectiveContext> col_ctx) {
+  TF_RETURN_IF_ERROR(RingReducer::InitializeCollectiveContext(col_ctx));
+  TF_RETURN_IF_ERROR(ParseCompressionHint(
+      col_params_->instance.impl_details.communication_hint, &options_));
+  if (options_.topk_fraction == 0) {
+    return Status::OK();
+  }
+  // The residual outlives this instance, so that what was not sent is added
+  // to the next reduction of the same collective instance on this device.
+  Residual* residual;
+  TF_RETURN_IF_ERROR(
+      col_ctx_->device->resource_manager()->LookupOrCreate<Residual>(
+          kResidualContainer,
+          strings::StrCat(col_params_->instance.instance_key), &residual,
+          [](Residual** ret) {
+            *ret = new Residual;
+            return Status::OK();
+          }));
+  residual_.reset(residual);
+  mutex_lock l(residual_->mu);
+  const int64 num_elements = col_ctx_->output->NumElements();
+  if (residual_->values.NumElements() != num_elements) {
+    residual_->values = Tensor(DT_FLOAT, TensorShape({num_elements}));
+    residual_->values.flat<float>().setZero();
+  }
+  return Status::OK();
+}
+
+void CompressedRingReducer::Run(StatusCallback done) {
+  started_ = true;
+  RingReducer::Run(std::move(done));
+}
+
+void CompressedRingReducer::InitRingField(RingField* rf, int chunk_idx,
+                                          int subdiv_idx, int field_idx) {
+  RingReducer::InitRingField(rf, chunk_idx, subdiv_idx, field_idx);
+  wire_chunks_.resize(rfv_.size());
+}
+
+bool CompressedRingReducer::SendsTopK(const RingField& rf) const {
+  // Dropping values of the all-gather pass would lose them for good.
+  if (options_.topk_fraction == 0 || rf.second_pass) {
+    return false;
+  }
+  const int64 n = rf.chunk.NumElements();
+  return n <= kint32max &&
+         TopKCount(options_.topk_fraction, n) *
+                 (kWireIndexBytes + kWireValueBytes) <
+             n * kWireValueBytes;
+}
+
+int64 CompressedRingReducer::WireBytes(const RingField& rf) const {
+  const int64 n = rf.chunk.NumElements();
+  if (SendsTopK(rf)) {
+    return TopKCount(options_.topk_fraction, n) *
+           (kWireIndexBytes + kWireValueBytes);
+  }
+  return n * kWireValueBytes;
+}
+
+void CompressedRingReducer::Encode(RingField* rf, Tensor* wire) {
+  float* values = rf->chunk.flat<float>().data();
+  const int64 n = rf->chunk.NumElements();
+  uint8* data = wire->flat<uint8>().data();
+  if (!SendsTopK(*rf)) {
+    if (options_.wire_dtype == DT_HALF) {
+      EncodeValues(values, n, reinterpret_cast<Eigen::half*>(data));
+    } else {
+      EncodeValues(values, n, reinterpret_cast<bfloat16*>(data));
+    }
+    return;
+  }
+  // The wire holds the k indices followed by the k values.
+  const int64 k = TopKCount(options_.topk_fraction, n);
+  int32* indices = reinterpret_cast<int32*>(data);
+  uint8* wire_values = data + k * kWireIndexBytes;
+  mutex_lock l(residual_->mu);
+  float* residual = residual_->values.flat<float>().data() +
+                    (values - ca_->Value().flat<float>().data());
+  if (options_.wire_dtype == DT_HALF) {
+    EncodeTopK(values, n, k, residual, indices,
+               reinterpret_cast<Eigen::half*>(wire_values));
+  } else {
+    EncodeTopK(values, n, k, residual, indices,
+               reinterpret_cast<bfloat16*>(wire_values));
+  }
+}
+
+Status CompressedRingReducer::Decode(const RingField& rf, const Tensor& wire,
+                                     Tensor* dst) {
+  float* values = dst->flat<float>().data();
+  const int64 n = dst->NumElements();
+  const uint8* data = wire.flat<uint8>().data();
+  if (!SendsTopK(rf)) {
+    if (options_.wire_dtype == DT_HALF) {
+      DecodeValues(reinterpret_cast<const Eigen::half*>(data), n, values);
+    } else {
+      DecodeValues(reinterpret_cast<const bfloat16*>(data), n, values);
+    }
+    return Status::OK();
+  }
+  const int64 k = TopKCount(options_.topk_fraction, n);
+  const int32* indices = reinterpret_cast<const int32*>(data);
+  const uint8* wire_values = data + k * kWireIndexBytes;
+  if (options_.wire_dtype == DT_HALF) {
+    return DecodeTopK(indices,
+                      reinterpret_cast<const Eigen::half*>(wire_values), k, n,
+                      values);
+  }
+  return DecodeTopK(indices, reinterpret_cast<const bfloat16*>(wire_values), k,
+                    n, values);
+}
+
+void CompressedRingReducer::DispatchSend(RingField* rf,
+                                         const StatusCallback& done) {
+  // The wire tensor must live until the send is done, and this RingField
+  // does nothing else until then.
+  Tensor* wire = &wire_chunks_[rf - rfv_.data()];
+  *wire = Tensor(col_ctx_->device->GetAllocator(
+                     col_ctx_->op_ctx->output_alloc_attr(0)),
+                 DT_UINT8, TensorShape({WireBytes(*rf)}));
+  Encode(rf, wire);
+  SendFieldTensor(rf, wire, done);
+}
+
+void CompressedRingReducer::DispatchRecv(RingField* rf,
+                                         const StatusCallback& done) {
+  Tensor* wire = &wire_chunks_[rf - rfv_.data()];
+  *wire = Tensor(col_ctx_->device->GetAllocator(
+                     col_ctx_->op_ctx->output_alloc_attr(0)),
+                 DT_UINT8, TensorShape({WireBytes(*rf)}));
+  Tensor* dst = RecvDestination(rf);
+  RecvFieldTensor(rf, wire, [this, rf, wire, dst, done](const Status& s) {
+    if (!s.ok()) {
+      done(s);
+      return;
+    }
+    done(Decode(*rf, *wire, dst));
+  });
+}
+
+namespace {
+REGISTER_COLLECTIVE(CompressedRingReduce, CompressedRingReducer);
+}  // namespace
+
+}  // namespace tensorflow
@@ -0,0 +1,106 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_COMPRESSED_RING_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_COMPRESSED_RING_REDUCER_H_
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/ring_reducer.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/refcount.h"
+
+namespace tensorflow {
+
+// Ring all-reduce of float gradients that compresses the values it sends.
+//
+// Selected by setting the communication hint of a CPU reduction to
+// "compressed", optionally followed by a colon and a comma-separated list of
+// options:
+//   bf16        Sends values as bfloat16 (the default).
+//   fp16        Sends values as IEEE half.
+//   topk=<f>    In the reduce-scatter pass, sends only the fraction `f` of
+//               the values with the largest magnitude, as (index, value)
+//               pairs. The values that were not sent are kept in a residual
+//               and added to the next reduction of the same instance (error
+//               feedback), so no gradient is lost, only delayed.
+// For example "compressed:fp16,topk=0.01".
+//
+// The all-gather pass always sends every value, and every rank rounds the
+// values it forwards the same way, so all ranks end with the same result.
+// Top-k requires that the merge op is an addition.
+class CompressedRingReducer : public RingReducer {
+ public:
+  struct Options {
+    DataType wire_dtype = DT_BFLOAT16;
+    // 0 disables top-k.
+    float topk_fraction = 0;
+  };
+
+  CompressedRingReducer() = default;
+  ~CompressedRingReducer() override;
+
+  // Returns true if `hint` selects this implementation.
+  static bool IsCompressionHint(const string& hint);
+
+  // Parses the options in a communication hint for which IsCompressionHint
+  // is true.
+  static Status ParseCompressionHint(const string& hint, Options* options);
+
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  Status InitializeCollectiveContext(
+      std::shared_ptr<CollectiveContext> col_ctx) override;
+
+  void Run(StatusCallback done) override;
+
+ protected:
+  void InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
+                     int field_idx) override;
+  void DispatchSend(RingField* rf, const StatusCallback& done) override;
+  void DispatchRecv(RingField* rf, const StatusCallback& done) override;
+
+ private:
+  // The values that top-k did not send yet, for all of the output tensor.
+  class Residual : public ResourceBase {
+   public:
+    string DebugString() const override { return "CompressionResidual"; }
+
+    mutex mu;
+    Tensor values TF_GUARDED_BY(mu);
+  };
+
+  // Returns whether the value of `rf` is sent as top-k (index, value) pairs.
+  bool SendsTopK(const RingField& rf) const;
+  // Returns the size of the encoded value of `rf`.
+  int64 WireBytes(const RingField& rf) const;
+  // Encodes the value of `rf` into `wire`, updating the residual.
+  void Encode(RingField* rf, Tensor* wire);
+  // Decodes the value of `rf` in `wire` into `dst`.
+  Status Decode(const RingField& rf, const Tensor& wire, Tensor* dst);
+
+  Options options_;
+  bool started_ = false;
+  core::RefCountPtr<Residual> residual_;
+  // The encoded value of each RingField that is being sent or received.
+  std::vector<Tensor> wire_chunks_;
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_COMPRESSED_RING_REDUCER_H_
@@ -0,0 +1,284 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/compressed_ring_reducer.h"
+
+#include <atomic>
+#include <cmath>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/collective_test_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/metrics.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/refcount.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+std::unique_ptr<OpKernel> GetKernel(const string& op, DataType dtype,
+                                    DeviceBase* device) {
+  NodeDef node_def;
+  TF_CHECK_OK(NodeDefBuilder("merge_node", op)
+                  .Attr("T", dtype)
+                  .Input(FakeInput(dtype))
+                  .Input(FakeInput(dtype))
+                  .Finalize(&node_def));
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()),
+      node_def, TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+TEST(CompressedRingReducerHintTest, Parse) {
+  CompressedRingReducer::Options options;
+  EXPECT_TRUE(CompressedRingReducer::IsCompressionHint("compressed"));
+  EXPECT_TRUE(CompressedRingReducer::IsCompressionHint("compressed:fp16"));
+  EXPECT_FALSE(CompressedRingReducer::IsCompressionHint("nccl"));
+  EXPECT_FALSE(CompressedRingReducer::IsCompressionHint("compressedfp16"));
+
+  TF_ASSERT_OK(
+      CompressedRingReducer::ParseCompressionHint("compressed", &options));
+  EXPECT_EQ(DT_BFLOAT16, options.wire_dtype);
+  EXPECT_EQ(0, options.topk_fraction);
+
+  TF_ASSERT_OK(CompressedRingReducer::ParseCompressionHint(
+      "compressed:fp16,topk=0.05", &options));
+  EXPECT_EQ(DT_HALF, options.wire_dtype);
+  EXPECT_FLOAT_EQ(0.05, options.topk_fraction);
+
+  for (const char* hint :
+       {"nccl", "compressed:", "compressed:int8", "compressed:topk=0",
+        "compressed:topk=2", "compressed:topk=x"}) {
+    EXPECT_TRUE(errors::IsInvalidArgument(
+        CompressedRingReducer::ParseCompressionHint(hint, &options)))
+        << hint;
+  }
+}
+
+class CompressedRingReducerTest : public ::testing::Test {
+ protected:
+  class DeviceInstance {
+   public:
+    DeviceInstance(int rank, const string& collective_name,
+                   const string& hint, int64 tensor_len,
+                   CollectiveTestEnv* test_env)
+        : test_env_(test_env), tensor_(DT_FLOAT, TensorShape({tensor_len})) {
+      col_params_ = CreateCollectiveParams(*test_env_, rank, collective_name,
+                                           REDUCTION_COLLECTIVE, DT_FLOAT,
+                                           tensor_.shape());
+      col_params_->instance.impl_details.communication_hint = hint;
+      string dev_name = col_params_->group.members[rank].device.name();
+      TF_CHECK_OK(test_env_->device_mgr->LookupDevice(dev_name, &device_));
+      merge_op_ = GetKernel("Add", DT_FLOAT, device_);
+      final_op_ = GetKernel("Div", DT_FLOAT, device_);
+      col_params_->merge_op = merge_op_.get();
+      col_params_->final_op = final_op_.get();
+    }
+
+    void DoReduce() {
+      // RunCollective initializes the params again for every reduction.
+      col_params_->instance.impl_details.subdiv_permutations.clear();
+      col_params_->subdiv_rank.clear();
+      status_ = RunCollective(test_env_, col_params_.get(), device_, &tensor_,
+                              &tensor_);
+    }
+
+    CollectiveTestEnv* test_env_;
+    Tensor tensor_;
+    Device* device_;
+    core::RefCountPtr<CollectiveParams> col_params_;
+    std::unique_ptr<OpKernel> merge_op_;
+    std::unique_ptr<OpKernel> final_op_;
+    Status status_;
+  };
+
+  void Init(const string& collective_name, const string& hint,
+            int64 tensor_len) {
+    if (test_env_ == nullptr) {
+      test_env_ = CreateCollectiveTestEnv(kNumWorkers, kNumDevices,
+                                          DEVICE_CPU);
+    }
+    instances_.clear();
+    for (int rank = 0; rank < kNumWorkers * kNumDevices; ++rank) {
+      instances_.push_back(absl::make_unique<DeviceInstance>(
+          rank, collective_name, hint, tensor_len, test_env_.get()));
+    }
+  }
+
+  // Runs one all-reduce of the tensors of all instances, and returns the
+  // number of bytes that were sent.
+  int64 Reduce() {
+    const string& name =
+        instances_[0]->col_params_->instance.impl_details.collective_name;
+    const int64 bytes_before =
+        metrics::GetCollectiveBytesSentCounter(name)->value();
+    std::atomic<int> done(0);
+    for (auto& di : instances_) {
+      SchedClosure([&di, &done] {
+        di->DoReduce();
+        ++done;
+      });
+    }
+    while (done < static_cast<int>(instances_.size())) {
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+    for (auto& di : instances_) {
+      TF_EXPECT_OK(di->status_);
+    }
+    return metrics::GetCollectiveBytesSentCounter(name)->value() -
+           bytes_before;
+  }
+
+  // Checks that every rank computed the same value.
+  void ExpectSameOnAllRanks() {
+    for (auto& di : instances_) {
+      test::ExpectTensorEqual<float>(instances_[0]->tensor_, di->tensor_);
+    }
+  }
+
+  static constexpr int kNumWorkers = 2;
+  static constexpr int kNumDevices = 2;
+
+  std::unique_ptr<CollectiveTestEnv> test_env_;
+  std::vector<std::unique_ptr<DeviceInstance>> instances_;
+};
+
+TEST_F(CompressedRingReducerTest, CastMatchesMean) {
+  const int64 kTensorLen = 1001;
+  for (const char* hint : {"compressed", "compressed:fp16"}) {
+    Init("CompressedRingReduce", hint, kTensorLen);
+    std::vector<float> expected(kTensorLen, 0.0f);
+    for (int rank = 0; rank < instances_.size(); ++rank) {
+      auto values = instances_[rank]->tensor_.flat<float>();
+      for (int64 i = 0; i < kTensorLen; ++i) {
+        values(i) = std::sin(i + rank) * (rank + 1);
+        expected[i] += values(i) / instances_.size();
+      }
+    }
+    Reduce();
+    ExpectSameOnAllRanks();
+    // Three 16 bit roundings of values of magnitude at most 4.
+    test::ExpectClose(test::AsTensor<float>(expected),
+                      instances_[0]->tensor_, /*atol=*/0.1, /*rtol=*/0.02);
+  }
+}
+
+TEST_F(CompressedRingReducerTest, SendsFewerBytes) {
+  const int64 kTensorLen = 4096;
+  Init("RingReduce", "", kTensorLen);
+  const int64 uncompressed_bytes = Reduce();
+  EXPECT_GT(uncompressed_bytes, 0);
+
+  Init("CompressedRingReduce", "compressed", kTensorLen);
+  EXPECT_EQ(uncompressed_bytes / 2, Reduce());
+
+  // 10 values per 100 as (int32 index, value) pairs in the reduce-scatter
+  // pass, and half of the bytes in the all-gather pass.
+  Init("CompressedRingReduce", "compressed:topk=0.1", kTensorLen);
+  const int64 topk_bytes = Reduce();
+  EXPECT_LT(topk_bytes, uncompressed_bytes / 3);
+  ExpectSameOnAllRanks();
+}
+
+TEST_F(CompressedRingReducerTest, TopKConverges) {
+  // Gradient descent on a least-squares problem whose examples are split
+  // across the ranks. Every rank weighs the coordinates differently, but all
+  // of them share the optimum.
+  const int64 kTensorLen = 1024;
+  const int kNumSteps = 100;
+  const float kLearningRate = 0.2;
+  const int num_ranks = kNumWorkers * kNumDevices;
+  std::vector<float> optimum(kTensorLen);
+  for (int64 i = 0; i < kTensorLen; ++i) {
+    optimum[i] = 3 * std::sin(i);
+  }
+  auto weight = [](int rank, int64 i) {
+    return 1 + 0.5 * std::sin(7 * i + rank);
+  };
+
+  Init("RingReduce", "", kTensorLen);
+  const int64 uncompressed_bytes = Reduce() * kNumSteps;
+
+  Init("CompressedRingReduce", "compressed:topk=0.1", kTensorLen);
+  std::vector<std::vector<float>> params(num_ranks,
+                                         std::vector<float>(kTensorLen, 0));
+  int64 compressed_bytes = 0;
+  for (int step = 0; step < kNumSteps; ++step) {
+    for (int rank = 0; rank < num_ranks; ++rank) {
+      auto gradient = instances_[rank]->tensor_.flat<float>();
+      for (int64 i = 0; i < kTensorLen; ++i) {
+        gradient(i) = weight(rank, i) * (params[rank][i] - optimum[i]);
+      }
+    }
+    compressed_bytes += Reduce();
+    for (int rank = 0; rank < num_ranks; ++rank) {
+      auto gradient = instances_[rank]->tensor_.flat<float>();
+      for (int64 i = 0; i < kTensorLen; ++i) {
+        params[rank][i] -= kLearningRate * gradient(i);
+      }
+    }
+  }
+
+  double error = 0;
+  double norm = 0;
+  for (int64 i = 0; i < kTensorLen; ++i) {
+    error += std::pow(params[0][i] - optimum[i], 2);
+    norm += std::pow(optimum[i], 2);
+  }
+  const double relative_error = std::sqrt(error / norm);
+  LOG(INFO) << "Relative error after " << kNumSteps << " steps "
+            << relative_error << ", sent " << compressed_bytes
+            << " bytes instead of " << uncompressed_bytes;
+  for (int rank = 1; rank < num_ranks; ++rank) {
+    EXPECT_EQ(params[0], params[rank]);
+  }
+  EXPECT_LT(relative_error, 1e-3);
+  EXPECT_LT(compressed_bytes, uncompressed_bytes / 5);
+}
+
+TEST_F(CompressedRingReducerTest, InvalidParams) {
+  Init("CompressedRingReduce", "compressed:topk=0.1", 16);
+  CollectiveParams* cp = instances_[0]->col_params_.get();
+  std::unique_ptr<OpKernel> max_op =
+      GetKernel("Maximum", DT_FLOAT, instances_[0]->device_);
+  cp->merge_op = max_op.get();
+  core::RefCountPtr<CompressedRingReducer> reducer(
+      new CompressedRingReducer());
+  EXPECT_TRUE(
+      errors::IsInvalidArgument(reducer->InitializeCollectiveParams(cp)));
+
+  cp->merge_op = instances_[0]->merge_op_.get();
+  cp->instance.data_type = DT_INT32;
+  EXPECT_TRUE(
+      errors::IsInvalidArgument(reducer->InitializeCollectiveParams(cp)));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -1003,6 +1003,7 @@ Status EagerContext::SyncExecutors() {
           delete response;
           counter.DecrementCount();
         });
+    eager_client->FlushPendingEnqueues();
   }
   counter.Wait();
   for (const Status& s : statuses) {
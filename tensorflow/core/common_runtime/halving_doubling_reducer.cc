@@ -0,0 +1,327 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/halving_doubling_reducer.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns the point at which the halving step splits the elements in
+// [lo, hi). Kernels require aligned tensors, so the split is rounded up to a
+// multiple of `align_elts` and one of the halves may be empty.
+int64 SplitPoint(int64 lo, int64 hi, int64 align_elts) {
+  const int64 half = (hi - lo + 1) / 2;
+  return std::min(hi, lo + (half + align_elts - 1) / align_elts * align_elts);
+}
+
+}  // namespace
+
+HalvingDoublingReducer::HalvingDoublingReducer()
+    : col_ctx_(nullptr), col_params_(nullptr) {}
+
+const char* HalvingDoublingReducer::CollectiveName() const {
+  return "HalvingDoublingReduce";
+}
+
+Status HalvingDoublingReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  if (col_params->instance.type != REDUCTION_COLLECTIVE ||
+      col_params->instance.impl_details.collective_name != CollectiveName()) {
+    return errors::Internal("Unexpected collective ",
+                            col_params->instance.impl_details.collective_name,
+                            " for ", CollectiveName());
+  }
+  if (col_params->group.device_type != DEVICE_CPU) {
+    return errors::InvalidArgument(CollectiveName(),
+                                   " is only implemented for CPU, got ",
+                                   col_params->group.device_type.type_string());
+  }
+  return Status::OK();
+}
+
+Status HalvingDoublingReducer::InitializeCollectiveContext(
+    std::shared_ptr<CollectiveContext> col_ctx) {
+  DCHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = col_ctx->col_params.get();
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+void HalvingDoublingReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  // Like RingReducer, this doesn't require non-overlapping collectives.
+  col_ctx_->col_exec->UnblockDependencies(*col_params_);
+
+  Tensor* output = col_ctx_->output;
+  if ((col_ctx_->input != output) &&
+      (DMAHelper::base(col_ctx_->input) != DMAHelper::base(output))) {
+    Notification note;
+    Status status;
+    profiler::TraceMe activity("MemCpyAsync", profiler::TraceMeLevel::kInfo);
+    CollectiveRemoteAccessLocal::MemCpyAsync(
+        col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+        col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+        col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input, output,
+        0 /*dev_to_dev_stream_index*/, [&note, &status](const Status& s) {
+          status.Update(s);
+          note.Notify();
+        });
+    note.WaitForNotification();
+    if (!status.ok()) {
+      done(status);
+      return;
+    }
+  }
+  if (output->NumElements() == 0) {
+    done(Status::OK());
+    return;
+  }
+
+  Status s = RunAllReduce(output);
+  if (s.ok() && col_params_->final_op) {
+    // The adapter takes over the tensor it is given, so give it an alias.
+    Tensor alias = *output;
+    Allocator* allocator =
+        col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0));
+    std::unique_ptr<CollectiveAdapter> ca(
+        MakeCollectiveAdapter(&alias, 1, allocator));
+    Tensor group_size = ca->Scalar(col_params_->group.group_size);
+    s = collective_util::ComputeBinOp(col_ctx_->op_ctx, col_ctx_->op_params,
+                                      col_ctx_->device, col_params_->final_op,
+                                      output, &group_size);
+  }
+  done(s);
+}
+
+Status HalvingDoublingReducer::RunAllReduce(Tensor* output) {
+  std::vector<int> ranks(col_params_->group.group_size);
+  for (int i = 0; i < ranks.size(); ++i) {
+    ranks[i] = i;
+  }
+  return AllReduceAmong(ranks, "hd", output);
+}
+
+Status HalvingDoublingReducer::AllReduceAmong(const std::vector<int>& ranks,
+                                              const string& phase,
+                                              Tensor* value) {
+  const int size = ranks.size();
+  const int pos = std::find(ranks.begin(), ranks.end(),
+                            col_params_->default_rank) -
+                  ranks.begin();
+  DCHECK_LT(pos, size);
+  if (size == 1) {
+    return Status::OK();
+  }
+  const int64 num_elements = value->NumElements();
+  Tensor flat;
+  if (!flat.CopyFrom(*value, TensorShape({num_elements}))) {
+    return errors::Internal("Cannot flatten ", value->DebugString());
+  }
+  const int64 align_elts =
+      std::max<int64>(1, EIGEN_MAX_ALIGN_BYTES / DataTypeSize(value->dtype()));
+
+  // The largest power of two that is no larger than the group, and the
+  // number of ranks beyond it.
+  int pof2 = 1;
+  while (pof2 * 2 <= size) {
+    pof2 *= 2;
+  }
+  const int rem = size - pof2;
+
+  // The first 2 * rem ranks fold their values pairwise into the odd one of
+  // each pair, which takes part in the halving and doubling for both.
+  int vrank;
+  if (pos < 2 * rem) {
+    const string key = strings::StrCat(phase, ":fold");
+    if (pos % 2 == 0) {
+      TF_RETURN_IF_ERROR(Exchange(ranks[pos + 1], key, &flat, nullptr));
+      vrank = -1;
+    } else {
+      Tensor tmp = TempTensor(flat.shape());
+      TF_RETURN_IF_ERROR(Exchange(ranks[pos - 1], key, nullptr, &tmp));
+      TF_RETURN_IF_ERROR(Merge(&flat, &tmp));
+      vrank = pos / 2;
+    }
+  } else {
+    vrank = pos - rem;
+  }
+  auto rank_of = [&ranks, rem](int v) {
+    return v < rem ? ranks[2 * v + 1] : ranks[v + rem];
+  };
+
+  if (vrank >= 0) {
+    // The ranges [lo, mid) and [mid, hi) split at each halving step, for the
+    // doubling steps to undo them in reverse.
+    struct Split {
+      int64 lo;
+      int64 mid;
+      int64 hi;
+    };
+    std::vector<Split> splits;
+    int64 lo = 0;
+    int64 hi = num_elements;
+    int step = 0;
+    // Reduce-scatter: keep one half of the range, and send the other half to
+    // the peer that keeps it.
+    for (int mask = pof2 / 2; mask > 0; mask /= 2, ++step) {
+      const Split split = {lo, SplitPoint(lo, hi, align_elts), hi};
+      splits.push_back(split);
+      const bool keep_upper = (vrank & mask) != 0;
+      const int64 keep_lo = keep_upper ? split.mid : split.lo;
+      const int64 keep_hi = keep_upper ? split.hi : split.mid;
+      const int64 give_lo = keep_upper ? split.lo : split.mid;
+      const int64 give_hi = keep_upper ? split.mid : split.hi;
+      Tensor give = flat.Slice(give_lo, give_hi);
+      Tensor keep = flat.Slice(keep_lo, keep_hi);
+      Tensor tmp;
+      if (keep_hi > keep_lo) {
+        tmp = TempTensor(keep.shape());
+      }
+      TF_RETURN_IF_ERROR(Exchange(rank_of(vrank ^ mask),
+                                  strings::StrCat(phase, ":rs", step),
+                                  give_hi > give_lo ? &give : nullptr,
+                                  keep_hi > keep_lo ? &tmp : nullptr));
+      if (keep_hi > keep_lo) {
+        TF_RETURN_IF_ERROR(Merge(&keep, &tmp));
+      }
+      lo = keep_lo;
+      hi = keep_hi;
+    }
+    // All-gather: send the reduced range to the peer, and receive the other
+    // half of the range split at the same step.
+    for (int mask = 1; mask < pof2; mask *= 2) {
+      --step;
+      const Split split = splits.back();
+      splits.pop_back();
+      const bool own_upper = (vrank & mask) != 0;
+      const int64 other_lo = own_upper ? split.lo : split.mid;
+      const int64 other_hi = own_upper ? split.mid : split.hi;
+      Tensor own = flat.Slice(lo, hi);
+      Tensor other = flat.Slice(other_lo, other_hi);
+      TF_RETURN_IF_ERROR(Exchange(rank_of(vrank ^ mask),
+                                  strings::StrCat(phase, ":ag", step),
+                                  hi > lo ? &own : nullptr,
+                                  other_hi > other_lo ? &other : nullptr));
+      lo = split.lo;
+      hi = split.hi;
+    }
+  }
+
+  // Unfold the result to the ranks that folded their values.
+  if (pos < 2 * rem) {
+    const string key = strings::StrCat(phase, ":unfold");
+    if (pos % 2 == 0) {
+      TF_RETURN_IF_ERROR(Exchange(ranks[pos + 1], key, nullptr, &flat));
+    } else {
+      TF_RETURN_IF_ERROR(Exchange(ranks[pos - 1], key, &flat, nullptr));
+    }
+  }
+  return Status::OK();
+}
+
+Status HalvingDoublingReducer::Exchange(int peer_rank, const string& key,
+                                        const Tensor* tensor,
+                                        Tensor* dst_tensor) {
+  BlockingCounter pending((tensor != nullptr) + (dst_tensor != nullptr));
+  mutex mu;
+  Status status;
+  auto done = [&pending, &mu, &status](const Status& s) {
+    {
+      mutex_lock l(mu);
+      status.Update(s);
+    }
+    pending.DecrementCount();
+  };
+  if (tensor != nullptr) {
+    DispatchSend(peer_rank, key, tensor, done);
+  }
+  if (dst_tensor != nullptr) {
+    DispatchRecv(peer_rank, key, dst_tensor, done);
+  }
+  pending.Wait();
+  mutex_lock l(mu);
+  return status;
+}
+
+string HalvingDoublingReducer::BufKey(const string& key, int src_rank,
+                                      int dst_rank) const {
+  return strings::StrCat(col_ctx_->exec_key, ":", key, ":", src_rank, ":",
+                         dst_rank);
+}
+
+void HalvingDoublingReducer::DispatchSend(int dst_rank, const string& key,
+                                          const Tensor* tensor,
+                                          const StatusCallback& done) {
+  const CollGroupMember& peer = col_params_->group.members[dst_rank];
+  col_ctx_->col_exec->remote_access()->PostToPeer(
+      peer.device.name(), peer.task,
+      BufKey(key, col_params_->default_rank, dst_rank), col_ctx_->device,
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), tensor, col_ctx_->device_locality,
+      col_ctx_->op_ctx->cancellation_manager(), done);
+}
+
+void HalvingDoublingReducer::DispatchRecv(int src_rank, const string& key,
+                                          Tensor* dst_tensor,
+                                          const StatusCallback& done) {
+  const CollGroupMember& peer = col_params_->group.members[src_rank];
+  col_ctx_->col_exec->remote_access()->RecvFromPeer(
+      peer.device.name(), peer.task, peer.is_local,
+      BufKey(key, src_rank, col_params_->default_rank), col_ctx_->device,
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), dst_tensor,
+      col_ctx_->device_locality, 0 /*dev_to_dev_stream_index*/,
+      col_ctx_->op_ctx->cancellation_manager(), done);
+}
+
+Tensor HalvingDoublingReducer::TempTensor(const TensorShape& shape) {
+  return Tensor(
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0)),
+      col_ctx_->output->dtype(), shape);
+}
+
+Status HalvingDoublingReducer::Merge(Tensor* output, Tensor* input) {
+  return collective_util::ComputeBinOp(col_ctx_->op_ctx, col_ctx_->op_params,
+                                       col_ctx_->device, col_params_->merge_op,
+                                       output, input);
+}
+
+namespace {
+REGISTER_COLLECTIVE(HalvingDoublingReduce, HalvingDoublingReducer);
+}  // namespace
+
+}  // namespace tensorflow
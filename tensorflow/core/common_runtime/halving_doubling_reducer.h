@@ -0,0 +1,97 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HALVING_DOUBLING_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HALVING_DOUBLING_REDUCER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+
+namespace tensorflow {
+
+// Recursive halving-doubling implementation of collective all-reduce.
+//
+// A reduce-scatter by recursive halving is followed by an all-gather by
+// recursive doubling, for 2 * log2(N) sequential steps instead of the
+// 2 * (N - 1) of RingReducer. This makes it the better choice for small
+// tensors in large groups, where the latency of each step dominates. When N
+// is not a power of two, the first 2 * (N - P) ranks, for the largest power
+// of two P < N, fold their values pairwise before and unfold them after.
+//
+// Unlike RingReducer, Run() waits for each step on the calling thread, which
+// is short for the small tensors it is selected for by default.
+class HalvingDoublingReducer : public CollectiveImplementationInterface {
+ public:
+  HalvingDoublingReducer();
+  ~HalvingDoublingReducer() override = default;
+
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object.
+  Status InitializeCollectiveContext(
+      std::shared_ptr<CollectiveContext> col_ctx) override;
+
+  // Begins execution of the all-reduce.
+  // Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+ protected:
+  // Returns the name that this implementation is registered under.
+  virtual const char* CollectiveName() const;
+
+  // Reduces `value` in place across the devices at `ranks` with the merge op,
+  // which must include this device. All of them call this with the same
+  // `ranks` and `phase`, which keeps the messages of different calls apart.
+  Status AllReduceAmong(const std::vector<int>& ranks, const string& phase,
+                        Tensor* value);
+
+  // Sends `tensor` to, and / or receives `dst_tensor` from, the device at
+  // `peer_rank` and waits for both. Either of them may be nullptr.
+  Status Exchange(int peer_rank, const string& key, const Tensor* tensor,
+                  Tensor* dst_tensor);
+
+  // Sends `tensor` to the device at `dst_rank` under `key`. Calls `done`
+  // upon completion.
+  void DispatchSend(int dst_rank, const string& key, const Tensor* tensor,
+                    const StatusCallback& done);
+
+  // Receives `dst_tensor` from the device at `src_rank` under `key`. Calls
+  // `done` upon completion.
+  void DispatchRecv(int src_rank, const string& key, Tensor* dst_tensor,
+                    const StatusCallback& done);
+
+  // Returns a tensor like the output, with its own buffer.
+  Tensor TempTensor(const TensorShape& shape);
+
+  // Merges `input` into `output` with the merge op.
+  Status Merge(Tensor* output, Tensor* input);
+
+  // Executes the all-reduce of `output`, which holds the input already.
+  virtual Status RunAllReduce(Tensor* output);
+
+  std::shared_ptr<CollectiveContext> col_ctx_;
+  const CollectiveParams* col_params_;  // Not owned
+
+ private:
+  // Returns the key of the message from `src_rank` to `dst_rank`.
+  string BufKey(const string& key, int src_rank, int dst_rank) const;
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HALVING_DOUBLING_REDUCER_H_
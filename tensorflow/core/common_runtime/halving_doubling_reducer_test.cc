@@ -0,0 +1,239 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/halving_doubling_reducer.h"
+
+#include <atomic>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/collective_test_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/two_level_reducer.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/refcount.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+std::unique_ptr<OpKernel> GetKernel(const string& op, DataType dtype,
+                                    DeviceBase* device) {
+  NodeDef node_def;
+  TF_CHECK_OK(NodeDefBuilder("merge_node", op)
+                  .Attr("T", dtype)
+                  .Input(FakeInput(dtype))
+                  .Input(FakeInput(dtype))
+                  .Finalize(&node_def));
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()),
+      node_def, TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+// Runs an all-reduce implementation on all devices of a CollectiveTestEnv.
+class AllReduceRunner {
+ public:
+  AllReduceRunner(const string& collective_name, int num_workers,
+                  int num_devices, DataType dtype, int64 tensor_len)
+      : test_env_(
+            CreateCollectiveTestEnv(num_workers, num_devices, DEVICE_CPU)) {
+    for (int rank = 0; rank < num_workers * num_devices; ++rank) {
+      instances_.push_back(absl::make_unique<DeviceInstance>(
+          rank, collective_name, dtype, tensor_len, test_env_.get()));
+    }
+  }
+
+  // Runs one all-reduce of the tensors of all devices.
+  void Reduce() {
+    std::atomic<int> done(0);
+    for (auto& di : instances_) {
+      SchedClosure([&di, &done] {
+        di->DoReduce();
+        ++done;
+      });
+    }
+    while (done < static_cast<int>(instances_.size())) {
+      Env::Default()->SleepForMicroseconds(10);
+    }
+  }
+
+  int group_size() const { return instances_.size(); }
+  Tensor* tensor(int rank) { return &instances_[rank]->tensor_; }
+  const Status& status(int rank) { return instances_[rank]->status_; }
+
+ private:
+  class DeviceInstance {
+   public:
+    DeviceInstance(int rank, const string& collective_name, DataType dtype,
+                   int64 tensor_len, CollectiveTestEnv* test_env)
+        : test_env_(test_env), tensor_(dtype, TensorShape({tensor_len})) {
+      col_params_ =
+          CreateCollectiveParams(*test_env_, rank, collective_name,
+                                 REDUCTION_COLLECTIVE, dtype, tensor_.shape());
+      string dev_name = col_params_->group.members[rank].device.name();
+      TF_CHECK_OK(test_env_->device_mgr->LookupDevice(dev_name, &device_));
+      merge_op_ = GetKernel("Add", dtype, device_);
+      final_op_ = GetKernel("Div", dtype, device_);
+      col_params_->merge_op = merge_op_.get();
+      col_params_->final_op = final_op_.get();
+    }
+
+    void DoReduce() {
+      // RunCollective initializes the params again for every reduction.
+      col_params_->instance.impl_details.subdiv_permutations.clear();
+      col_params_->subdiv_rank.clear();
+      status_ = RunCollective(test_env_, col_params_.get(), device_, &tensor_,
+                              &tensor_);
+    }
+
+    CollectiveTestEnv* test_env_;
+    Tensor tensor_;
+    Device* device_;
+    core::RefCountPtr<CollectiveParams> col_params_;
+    std::unique_ptr<OpKernel> merge_op_;
+    std::unique_ptr<OpKernel> final_op_;
+    Status status_;
+  };
+
+  std::unique_ptr<CollectiveTestEnv> test_env_;
+  std::vector<std::unique_ptr<DeviceInstance>> instances_;
+};
+
+template <typename T>
+void RunTest(const string& collective_name, DataType dtype, int num_workers,
+             int num_devices, int64 tensor_len) {
+  SCOPED_TRACE(strings::StrCat(collective_name, " workers ", num_workers,
+                               " devices ", num_devices, " len ",
+                               tensor_len));
+  AllReduceRunner runner(collective_name, num_workers, num_devices, dtype,
+                         tensor_len);
+  std::vector<T> expected(tensor_len, 0);
+  for (int rank = 0; rank < runner.group_size(); ++rank) {
+    auto values = runner.tensor(rank)->flat<T>();
+    for (int64 i = 0; i < tensor_len; ++i) {
+      values(i) = static_cast<T>(rank * 10 + i % 7);
+      expected[i] += values(i);
+    }
+  }
+  for (int64 i = 0; i < tensor_len; ++i) {
+    expected[i] /= static_cast<T>(runner.group_size());
+  }
+  runner.Reduce();
+  for (int rank = 0; rank < runner.group_size(); ++rank) {
+    TF_EXPECT_OK(runner.status(rank));
+    test::ExpectTensorEqual<T>(test::AsTensor<T>(expected),
+                               *runner.tensor(rank));
+  }
+}
+
+TEST(HalvingDoublingReducerTest, PowersOfTwo) {
+  for (int num_devices : {1, 2, 4, 8}) {
+    for (int64 tensor_len : {1, 16, 1001}) {
+      RunTest<float>("HalvingDoublingReduce", DT_FLOAT, 1, num_devices,
+                     tensor_len);
+    }
+  }
+}
+
+TEST(HalvingDoublingReducerTest, OtherGroupSizes) {
+  // Some ranks fold their values into their neighbors'.
+  for (int num_devices : {3, 5, 6, 7}) {
+    for (int64 tensor_len : {1, 16, 1001}) {
+      RunTest<float>("HalvingDoublingReduce", DT_FLOAT, 1, num_devices,
+                     tensor_len);
+    }
+  }
+  RunTest<float>("HalvingDoublingReduce", DT_FLOAT, 3, 4, 100);
+}
+
+TEST(HalvingDoublingReducerTest, Int32) {
+  RunTest<int32>("HalvingDoublingReduce", DT_INT32, 2, 3, 257);
+}
+
+TEST(TwoLevelReducerTest, SeveralDevicesPerTask) {
+  for (int num_workers : {2, 3, 4}) {
+    for (int num_devices : {1, 2, 3}) {
+      RunTest<float>("TwoLevelReduce", DT_FLOAT, num_workers, num_devices,
+                     1001);
+    }
+  }
+  RunTest<int32>("TwoLevelReduce", DT_INT32, 3, 2, 16);
+}
+
+TEST(HalvingDoublingReducerTest, OnlyCpu) {
+  auto test_env = CreateCollectiveTestEnv(1, 4, DEVICE_CPU);
+  auto cp = CreateCollectiveParams(*test_env, /*rank*/ 0,
+                                   "HalvingDoublingReduce",
+                                   REDUCTION_COLLECTIVE, DT_FLOAT,
+                                   TensorShape({1}));
+  core::RefCountPtr<HalvingDoublingReducer> reducer(
+      new HalvingDoublingReducer());
+  TF_EXPECT_OK(reducer->InitializeCollectiveParams(cp.get()));
+  cp->group.device_type = DEVICE_GPU;
+  EXPECT_FALSE(reducer->InitializeCollectiveParams(cp.get()).ok());
+}
+
+// Benchmarks an all-reduce of `state.range(2)` floats over
+// `state.range(0)` workers with `state.range(1)` devices each.
+void BM_AllReduce(::testing::benchmark::State& state,
+                  const string& collective_name) {
+  AllReduceRunner runner(collective_name, state.range(0), state.range(1),
+                         DT_FLOAT, state.range(2));
+  for (auto s : state) {
+    runner.Reduce();
+  }
+  state.SetBytesProcessed(static_cast<int64>(state.iterations()) *
+                          state.range(2) * sizeof(float));
+}
+
+void BM_RingReduce(::testing::benchmark::State& state) {
+  BM_AllReduce(state, "RingReduce");
+}
+void BM_HalvingDoublingReduce(::testing::benchmark::State& state) {
+  BM_AllReduce(state, "HalvingDoublingReduce");
+}
+void BM_TwoLevelReduce(::testing::benchmark::State& state) {
+  BM_AllReduce(state, "TwoLevelReduce");
+}
+
+#define BM_ALL_REDUCE_ARGS(b) \
+  b->UseRealTime()            \
+      ->Args({1, 4, 256})     \
+      ->Args({1, 16, 256})    \
+      ->Args({4, 4, 256})     \
+      ->Args({8, 8, 256})     \
+      ->Args({8, 8, 16384})   \
+      ->Args({8, 8, 1 << 20})
+
+BM_ALL_REDUCE_ARGS(BENCHMARK(BM_RingReduce));
+BM_ALL_REDUCE_ARGS(BENCHMARK(BM_HalvingDoublingReduce));
+BM_ALL_REDUCE_ARGS(BENCHMARK(BM_TwoLevelReduce));
+
+}  // namespace
+}  // namespace tensorflow
@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
@@ -260,6 +261,8 @@ Status RingAlg::InitializeCollectiveContext(
   DCHECK(col_ctx->dev_mgr);
   col_ctx_ = col_ctx;
   col_params_ = col_ctx->col_params.get();
+  bytes_sent_counter_ = metrics::GetCollectiveBytesSentCounter(
+      col_params_->instance.impl_details.collective_name);
   return collective_util::InitializeDeviceAndLocality(
       col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
       &col_ctx->device_locality);
@@ -394,6 +397,15 @@ string RingAlg::RingField::DebugString() const {
 }
 
 void RingAlg::DispatchSend(RingField* rf, const StatusCallback& done) {
+  SendFieldTensor(rf, &rf->chunk, done);
+}
+
+void RingAlg::DispatchRecv(RingField* rf, const StatusCallback& done) {
+  RecvFieldTensor(rf, RecvDestination(rf), done);
+}
+
+void RingAlg::SendFieldTensor(RingField* rf, const Tensor* tensor,
+                              const StatusCallback& done) {
   DCHECK(rf->do_send);
   string send_buf_key = RingAlgBufKey(name_, col_ctx_->exec_key,
                                       rf->second_pass, rf->sc_idx, rf->rank);
@@ -403,16 +415,20 @@ void RingAlg::DispatchSend(RingField* rf, const StatusCallback& done) {
   int send_to_rank = (rf->rank + 1) % group_size_;
   int send_to_dev_idx = col_params_->instance.impl_details
                             .subdiv_permutations[rf->subdiv_idx][send_to_rank];
+  if (bytes_sent_counter_ != nullptr) {
+    bytes_sent_counter_->IncrementBy(tensor->TotalBytes());
+  }
   col_ctx_->col_exec->remote_access()->PostToPeer(
       col_params_->group.members[send_to_dev_idx].device.name(),
       col_params_->group.members[send_to_dev_idx].task, send_buf_key,
       col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
-      col_ctx_->op_ctx->output_alloc_attr(0), &rf->chunk,
+      col_ctx_->op_ctx->output_alloc_attr(0), tensor,
       col_ctx_->device_locality, col_ctx_->op_ctx->cancellation_manager(),
       done);
 }
 
-void RingAlg::DispatchRecv(RingField* rf, const StatusCallback& done) {
+void RingAlg::RecvFieldTensor(RingField* rf, Tensor* dst_tensor,
+                              const StatusCallback& done) {
   DCHECK(rf->do_recv);
   string recv_buf_key =
       RingAlgBufKey(name_, col_ctx_->exec_key, rf->second_pass, rf->sc_idx,
@@ -420,9 +436,6 @@ void RingAlg::DispatchRecv(RingField* rf, const StatusCallback& done) {
   VLOG(3) << "DispatchRecv rank=" << col_params_->default_rank << " recv key "
           << recv_buf_key << " chunk " << ca_->TBounds(rf->chunk) << " into "
           << ((col_params_->merge_op != nullptr) ? "tmp_chunk" : "chunk");
-  Tensor* dst_tensor = (!rf->second_pass && (col_params_->merge_op != nullptr))
-                           ? &rf->tmp_chunk
-                           : &rf->chunk;
   col_ctx_->col_exec->remote_access()->RecvFromPeer(
       col_params_->group.members[rf->recv_dev_idx].device.name(),
       col_params_->group.members[rf->recv_dev_idx].task,
@@ -433,6 +446,12 @@ void RingAlg::DispatchRecv(RingField* rf, const StatusCallback& done) {
       col_ctx_->op_ctx->cancellation_manager(), done);
 }
 
+Tensor* RingAlg::RecvDestination(RingField* rf) {
+  return (!rf->second_pass && (col_params_->merge_op != nullptr))
+             ? &rf->tmp_chunk
+             : &rf->chunk;
+}
+
 string RingAlg::FieldState() {
   string s = strings::StrCat(
       "Ring", name_, " ", strings::Hex(reinterpret_cast<uint64>(this)),
@@ -22,6 +22,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/base_collective_executor.h"
 #include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
 
 namespace tensorflow {
 class Device;
@@ -81,8 +82,18 @@ class RingAlg : public CollectiveImplementationInterface {
   virtual void InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
                              int field_idx);
   void AdvanceToSecondPass(RingField* rf);
-  void DispatchSend(RingField* rf, const StatusCallback& done);
-  void DispatchRecv(RingField* rf, const StatusCallback& done);
+  // Sends the value of `rf` to the next rank of the ring, or receives it from
+  // the previous one. Subclasses can override these to change the encoding
+  // of values on the wire.
+  virtual void DispatchSend(RingField* rf, const StatusCallback& done);
+  virtual void DispatchRecv(RingField* rf, const StatusCallback& done);
+  // Sends `tensor` / receives `dst_tensor` in place of the value of `rf`.
+  void SendFieldTensor(RingField* rf, const Tensor* tensor,
+                       const StatusCallback& done);
+  void RecvFieldTensor(RingField* rf, Tensor* dst_tensor,
+                       const StatusCallback& done);
+  // Returns the tensor that the value received for `rf` belongs in.
+  Tensor* RecvDestination(RingField* rf);
 
   // For constructing log messages for debugging.
   string FieldState();
@@ -114,6 +125,7 @@ class RingAlg : public CollectiveImplementationInterface {
   mutex status_mu_;
   Status status_ TF_GUARDED_BY(status_mu_);
   std::vector<RingField> rfv_;
+  monitoring::CounterCell* bytes_sent_counter_ = nullptr;
 };
 
 }  // namespace tensorflow
@@ -45,13 +45,15 @@ class RingReducer : public RingAlg {
   void InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
                      int field_idx) override;
 
+  Tensor group_size_tensor_;
+  // Notified once Run() no longer needs group_size_tensor_. The destructor
+  // waits for it.
+  Notification group_size_tensor_ready_;
+
  private:
   void ContinueAfterInputCopy();
   bool RunAsyncParts();
 
-  Tensor group_size_tensor_;
-  Notification group_size_tensor_ready_;
-
   friend class RingReducerTest;
   friend class RingReducerInitParamsTest;
 };
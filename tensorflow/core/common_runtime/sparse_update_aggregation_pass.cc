@@ -0,0 +1,150 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/sparse_update_aggregation_pass.h"
+
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device_set.h"
+#include "tensorflow/core/common_runtime/optimization_registry.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+// Read on every run, so that benchmarks can compare both settings in one
+// process.
+bool AggregationEnabled() {
+  bool enabled;
+  TF_CHECK_OK(ReadBoolFromEnvVar("TF_AGGREGATE_SPARSE_UPDATES",
+                                 /*default_val=*/true, &enabled));
+  return enabled;
+}
+
+// Returns the name of the attr that holds the type of the updates, if `node`
+// adds its updates into a variable.
+const char* UpdatesTypeAttr(const Node* node) {
+  const string& op = node->type_string();
+  if (op == "ScatterAdd" || op == "ScatterSub") return "T";
+  if (op == "ResourceScatterAdd" || op == "ResourceScatterSub") {
+    return "dtype";
+  }
+  return nullptr;
+}
+
+// Returns true if `a` and `b` are placed on fully specified devices of
+// different tasks.
+bool OnDifferentTasks(const string& a, const string& b) {
+  DeviceNameUtils::ParsedName parsed_a, parsed_b;
+  return DeviceNameUtils::ParseFullName(a, &parsed_a) &&
+         DeviceNameUtils::ParseFullName(b, &parsed_b) &&
+         DeviceNameUtils::IsDifferentAddressSpace(parsed_a, parsed_b);
+}
+
+// Returns the first CPU of the task that holds `device`, or an empty string
+// if `device` is not fully specified.
+string HostDevice(const string& device) {
+  DeviceNameUtils::ParsedName parsed;
+  if (!DeviceNameUtils::ParseFullName(device, &parsed) || !parsed.has_job ||
+      !parsed.has_replica || !parsed.has_task) {
+    return "";
+  }
+  return DeviceNameUtils::FullName(parsed.job, parsed.replica, parsed.task,
+                                   DEVICE_CPU, 0);
+}
+
+// Inserts the aggregation of the indices and updates of `scatter`, if they
+// are produced on one task and applied on another. The aggregation runs on
+// the CPU of the producing task, since _AggregateSparseUpdates only has CPU
+// kernels.
+Status MaybeAggregate(Graph* graph, const DeviceSet* device_set,
+                      Node* scatter, const char* type_attr) {
+  const Edge* indices_edge;
+  const Edge* updates_edge;
+  TF_RETURN_IF_ERROR(scatter->input_edge(1, &indices_edge));
+  TF_RETURN_IF_ERROR(scatter->input_edge(2, &updates_edge));
+  Node* updates_src = updates_edge->src();
+  const string& updates_device = updates_src->assigned_device_name();
+  if (!DeviceNameUtils::IsSameAddressSpace(
+          indices_edge->src()->assigned_device_name(), updates_device) ||
+      !OnDifferentTasks(updates_device, scatter->assigned_device_name())) {
+    return Status::OK();
+  }
+  const string device = HostDevice(updates_device);
+  if (device.empty() ||
+      (device_set != nullptr &&
+       device_set->FindDeviceByName(device) == nullptr)) {
+    VLOG(2) << "Not aggregating the updates of " << scatter->name()
+            << ", since there is no CPU on the task of " << updates_device;
+    return Status::OK();
+  }
+
+  DataType type, index_type;
+  TF_RETURN_IF_ERROR(GetNodeAttr(scatter->attrs(), type_attr, &type));
+  TF_RETURN_IF_ERROR(GetNodeAttr(scatter->attrs(), "Tindices", &index_type));
+  Node* aggregate;
+  TF_RETURN_IF_ERROR(
+      NodeBuilder(graph->NewName(strings::StrCat(scatter->name(),
+                                                 "/AggregateSparseUpdates")),
+                  "_AggregateSparseUpdates")
+          .Input(indices_edge->src(), indices_edge->src_output())
+          .Input(updates_src, updates_edge->src_output())
+          .Attr("T", type)
+          .Attr("Tindices", index_type)
+          .Device(device)
+          .Finalize(graph, &aggregate));
+  aggregate->set_assigned_device_name(device);
+  TF_RETURN_IF_ERROR(graph->UpdateEdge(aggregate, 0, scatter, 1));
+  TF_RETURN_IF_ERROR(graph->UpdateEdge(aggregate, 1, scatter, 2));
+  VLOG(2) << "Aggregating the updates of " << scatter->name() << " on "
+          << device;
+  return Status::OK();
+}
+
+}  // namespace
+
+Status SparseUpdateAggregationPass::Run(
+    const GraphOptimizationPassOptions& options) {
+  if (options.graph == nullptr || !AggregationEnabled()) {
+    return Status::OK();
+  }
+  Graph* graph = options.graph->get();
+  std::vector<std::pair<Node*, const char*>> scatters;
+  for (Node* node : graph->op_nodes()) {
+    if (const char* type_attr = UpdatesTypeAttr(node)) {
+      scatters.emplace_back(node, type_attr);
+    }
+  }
+  for (const auto& scatter : scatters) {
+    TF_RETURN_IF_ERROR(MaybeAggregate(graph, options.device_set,
+                                      scatter.first, scatter.second));
+  }
+  return Status::OK();
+}
+
+// Runs after placement, so that the devices of the producers and the
+// variables are known, and before partitioning adds the sends and receives.
+REGISTER_OPTIMIZATION(OptimizationPassRegistry::POST_PLACEMENT, 5,
+                      SparseUpdateAggregationPass);
+
+}  // namespace tensorflow
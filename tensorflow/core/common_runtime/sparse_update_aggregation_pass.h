@@ -0,0 +1,52 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_SPARSE_UPDATE_AGGREGATION_PASS_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_SPARSE_UPDATE_AGGREGATION_PASS_H_
+
+#include "tensorflow/core/common_runtime/optimization_registry.h"
+
+namespace tensorflow {
+
+// Sums sparse updates that hit the same row of a variable before they are
+// sent to the task that holds the variable.
+//
+// In parameter server training, the sparse gradients of an embedding are
+// computed on the workers and scatter-added into the variable on a parameter
+// server. The same rows are often updated many times per step, and each
+// duplicate is sent and applied separately. For every ScatterAdd, ScatterSub,
+// ResourceScatterAdd and ResourceScatterSub whose indices and updates are
+// produced on one task and applied on another, this pass inserts an
+// _AggregateSparseUpdates node on the CPU of the producing task:
+//
+//    indices   updates                 indices   updates
+//        \       /                         \       /
+//         \     /         becomes     _AggregateSparseUpdates
+//          \   /                           /       \
+//        ScatterAdd                         ScatterAdd
+//
+// so that only one row per unique index crosses the network.
+//
+// Other sparse updates, e.g. the sparse apply ops of the optimizers, are left
+// alone, since they are not linear in the updates.
+//
+// Setting TF_AGGREGATE_SPARSE_UPDATES=0 disables the pass.
+class SparseUpdateAggregationPass : public GraphOptimizationPass {
+ public:
+  Status Run(const GraphOptimizationPassOptions& options) override;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_SPARSE_UPDATE_AGGREGATION_PASS_H_
@@ -0,0 +1,177 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/sparse_update_aggregation_pass.h"
+
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_set.h"
+#include "tensorflow/core/common_runtime/graph_constructor.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+namespace {
+
+using ::tensorflow::test::function::GDef;
+using ::tensorflow::test::function::NDef;
+
+constexpr char kWorker[] = "/job:worker/replica:0/task:0/device:CPU:0";
+constexpr char kWorkerGpu[] = "/job:worker/replica:0/task:0/device:GPU:0";
+constexpr char kPs[] = "/job:ps/replica:0/task:0/device:CPU:0";
+
+// Builds a graph that scatters the indices and updates produced on
+// `indices_device` and `updates_device` into a variable on `ps` with
+// `scatter_op`, places it as requested, and runs the pass with the devices in
+// `device_set`, if any.
+std::unique_ptr<Graph> RunPass(const string& scatter_op,
+                               const string& indices_device,
+                               const string& updates_device,
+                               const string& ps,
+                               const DeviceSet* device_set = nullptr) {
+  const bool resource = scatter_op.find("Resource") == 0;
+  GraphDef graph_def = GDef({
+      resource ? NDef("var", "VarHandleOp", {},
+                      {{"dtype", DT_FLOAT}, {"shape", TensorShape({10, 2})}},
+                      ps)
+               : NDef("var", "VariableV2", {},
+                      {{"dtype", DT_FLOAT}, {"shape", TensorShape({10, 2})}},
+                      ps),
+      NDef("indices", "Placeholder", {}, {{"dtype", DT_INT64}},
+           indices_device),
+      NDef("updates", "Placeholder", {}, {{"dtype", DT_FLOAT}},
+           updates_device),
+      resource ? NDef("scatter", scatter_op, {"var", "indices", "updates"},
+                      {{"dtype", DT_FLOAT}, {"Tindices", DT_INT64}}, ps)
+               : NDef("scatter", scatter_op, {"var", "indices", "updates"},
+                      {{"T", DT_FLOAT}, {"Tindices", DT_INT64}}, ps),
+  });
+  auto graph = absl::make_unique<Graph>(OpRegistry::Global());
+  TF_CHECK_OK(ConvertGraphDefToGraph(GraphConstructorOptions(), graph_def,
+                                     graph.get()));
+  for (Node* node : graph->op_nodes()) {
+    node->set_assigned_device_name(node->requested_device());
+  }
+  GraphOptimizationPassOptions options;
+  options.graph = &graph;
+  options.device_set = device_set;
+  SparseUpdateAggregationPass pass;
+  TF_CHECK_OK(pass.Run(options));
+  return graph;
+}
+
+class FakeDevice : public Device {
+ public:
+  explicit FakeDevice(const DeviceAttributes& attr) : Device(nullptr, attr) {}
+  Status Sync() override { return Status::OK(); }
+  Allocator* GetAllocator(AllocatorAttributes) override { return nullptr; }
+};
+
+std::unique_ptr<Device> Dev(const string& type, const string& name) {
+  DeviceAttributes attr;
+  attr.set_name(name);
+  attr.set_device_type(type);
+  return absl::make_unique<FakeDevice>(attr);
+}
+
+Node* FindNode(const Graph& graph, const string& name) {
+  for (Node* node : graph.op_nodes()) {
+    if (node->name() == name) return node;
+  }
+  return nullptr;
+}
+
+// Checks that the scatter applies updates aggregated on `device`, by a node
+// which has a kernel there.
+void ExpectAggregated(const Graph& graph, const string& device) {
+  Node* scatter = FindNode(graph, "scatter");
+  ASSERT_NE(scatter, nullptr);
+  const Edge* indices_edge;
+  const Edge* updates_edge;
+  TF_ASSERT_OK(scatter->input_edge(1, &indices_edge));
+  TF_ASSERT_OK(scatter->input_edge(2, &updates_edge));
+  Node* aggregate = indices_edge->src();
+  EXPECT_EQ("_AggregateSparseUpdates", aggregate->type_string());
+  EXPECT_EQ(0, indices_edge->src_output());
+  EXPECT_EQ(aggregate, updates_edge->src());
+  EXPECT_EQ(1, updates_edge->src_output());
+  EXPECT_EQ(device, aggregate->assigned_device_name());
+  EXPECT_EQ(device, aggregate->requested_device());
+  DeviceNameUtils::ParsedName parsed;
+  ASSERT_TRUE(DeviceNameUtils::ParseFullName(device, &parsed));
+  TF_EXPECT_OK(FindKernelDef(DeviceType(parsed.type), aggregate->def(),
+                             nullptr, nullptr));
+
+  Node* indices;
+  Node* updates;
+  TF_ASSERT_OK(aggregate->input_node(0, &indices));
+  TF_ASSERT_OK(aggregate->input_node(1, &updates));
+  EXPECT_EQ("indices", indices->name());
+  EXPECT_EQ("updates", updates->name());
+}
+
+void ExpectNotAggregated(const Graph& graph) {
+  for (Node* node : graph.op_nodes()) {
+    EXPECT_NE("_AggregateSparseUpdates", node->type_string());
+  }
+}
+
+TEST(SparseUpdateAggregationPassTest, AggregatesRemoteScatterAdd) {
+  ExpectAggregated(*RunPass("ScatterAdd", kWorker, kWorker, kPs), kWorker);
+}
+
+TEST(SparseUpdateAggregationPassTest, AggregatesRemoteResourceScatterSub) {
+  ExpectAggregated(*RunPass("ResourceScatterSub", kWorker, kWorker, kPs),
+                   kWorker);
+}
+
+TEST(SparseUpdateAggregationPassTest, AggregatesGpuUpdatesOnTheHostCpu) {
+  ExpectAggregated(*RunPass("ScatterAdd", kWorker, kWorkerGpu, kPs), kWorker);
+  ExpectAggregated(*RunPass("ScatterAdd", kWorkerGpu, kWorkerGpu, kPs),
+                   kWorker);
+}
+
+TEST(SparseUpdateAggregationPassTest, IgnoresUpdatesFromTasksWithoutCpu) {
+  std::unique_ptr<Device> gpu = Dev(DEVICE_GPU, kWorkerGpu);
+  std::unique_ptr<Device> ps = Dev(DEVICE_CPU, kPs);
+  DeviceSet device_set;
+  device_set.AddDevice(gpu.get());
+  device_set.AddDevice(ps.get());
+  ExpectNotAggregated(
+      *RunPass("ScatterAdd", kWorkerGpu, kWorkerGpu, kPs, &device_set));
+}
+
+TEST(SparseUpdateAggregationPassTest, IgnoresLocalUpdates) {
+  ExpectNotAggregated(*RunPass("ScatterAdd", kWorker, kWorker, kWorker));
+}
+
+TEST(SparseUpdateAggregationPassTest, IgnoresUpdatesFromDifferentTasks) {
+  ExpectNotAggregated(*RunPass("ScatterAdd", kPs, kWorker, kPs));
+}
+
+TEST(SparseUpdateAggregationPassTest, IgnoresNonAdditiveUpdates) {
+  ExpectNotAggregated(*RunPass("ScatterUpdate", kWorker, kWorker, kPs));
+  ExpectNotAggregated(*RunPass("ResourceScatterMax", kWorker, kWorker, kPs));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,101 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/two_level_reducer.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+
+const char* TwoLevelReducer::CollectiveName() const { return "TwoLevelReduce"; }
+
+Status TwoLevelReducer::RunAllReduce(Tensor* output) {
+  // Group the ranks by task, in the order in which the tasks first appear.
+  std::vector<std::vector<int>> task_ranks;
+  std::unordered_map<string, int> task_index;
+  for (int rank = 0; rank < col_params_->group.group_size; ++rank) {
+    auto it = task_index.emplace(col_params_->group.members[rank].task,
+                                 task_ranks.size());
+    if (it.second) {
+      task_ranks.emplace_back();
+    }
+    task_ranks[it.first->second].push_back(rank);
+  }
+  const int rank = col_params_->default_rank;
+  const std::vector<int>& local_ranks =
+      task_ranks[task_index[col_params_->group.members[rank].task]];
+  const int leader = local_ranks[0];
+
+  if (rank != leader) {
+    TF_RETURN_IF_ERROR(Exchange(leader, "up", output, nullptr));
+    return Exchange(leader, "down", nullptr, output);
+  }
+
+  // Receives the values of the other local devices concurrently, or sends
+  // them the result.
+  auto run_local = [this, &local_ranks](
+                       const string& key, std::vector<Tensor>* values,
+                       const Tensor* result) {
+    BlockingCounter pending(local_ranks.size() - 1);
+    mutex mu;
+    Status status;
+    auto done = [&pending, &mu, &status](const Status& s) {
+      {
+        mutex_lock l(mu);
+        status.Update(s);
+      }
+      pending.DecrementCount();
+    };
+    for (int i = 1; i < local_ranks.size(); ++i) {
+      if (result != nullptr) {
+        DispatchSend(local_ranks[i], key, result, done);
+      } else {
+        DispatchRecv(local_ranks[i], key, &(*values)[i - 1], done);
+      }
+    }
+    pending.Wait();
+    mutex_lock l(mu);
+    return status;
+  };
+
+  std::vector<Tensor> values;
+  for (int i = 1; i < local_ranks.size(); ++i) {
+    values.push_back(TempTensor(output->shape()));
+  }
+  TF_RETURN_IF_ERROR(run_local("up", &values, nullptr));
+  for (Tensor& value : values) {
+    TF_RETURN_IF_ERROR(Merge(output, &value));
+  }
+
+  std::vector<int> leaders;
+  for (const std::vector<int>& ranks : task_ranks) {
+    leaders.push_back(ranks[0]);
+  }
+  TF_RETURN_IF_ERROR(AllReduceAmong(leaders, "inter", output));
+
+  return run_local("down", nullptr, output);
+}
+
+namespace {
+REGISTER_COLLECTIVE(TwoLevelReduce, TwoLevelReducer);
+}  // namespace
+
+}  // namespace tensorflow
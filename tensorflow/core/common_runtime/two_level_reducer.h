@@ -0,0 +1,42 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_TWO_LEVEL_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_TWO_LEVEL_REDUCER_H_
+
+#include "tensorflow/core/common_runtime/halving_doubling_reducer.h"
+
+namespace tensorflow {
+
+// Two-level implementation of collective all-reduce for groups that span
+// several tasks with several devices each.
+//
+// The devices of each task first reduce their values into the first device
+// of the task, the task leader. The leaders then all-reduce across tasks by
+// recursive halving-doubling, and each leader broadcasts the result to the
+// other devices of its task. Only the leaders communicate across tasks, for
+// 2 + 2 * log2(number of tasks) sequential steps.
+class TwoLevelReducer : public HalvingDoublingReducer {
+ public:
+  TwoLevelReducer() = default;
+  ~TwoLevelReducer() override = default;
+
+ protected:
+  const char* CollectiveName() const override;
+
+  Status RunAllReduce(Tensor* output) override;
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_TWO_LEVEL_REDUCER_H_
@@ -22,6 +22,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/notification.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/distributed_runtime/coordination/coordination_client.h"
@@ -95,6 +96,9 @@ class CoordinationServiceStandaloneImpl : public CoordinationServiceInterface {
   void GetKeyValueAsync(const std::string& key,
                         StatusOrValueCallback done) override;
   Status DeleteKeyValue(const std::string& key) override;
+  void BarrierAsync(const std::string& barrier_id, absl::Duration timeout,
+                    const std::vector<CoordinatedTask>& arrived_tasks,
+                    StatusCallback done) override;
 
  private:
   const CoordinationServiceDeviceInfo& ListClusterDevices() override
@@ -105,6 +109,23 @@ class CoordinationServiceStandaloneImpl : public CoordinationServiceInterface {
       TF_LOCKS_EXCLUDED(state_mu_);
   void DoneClusterRegistration(Status s) TF_EXCLUSIVE_LOCKS_REQUIRED(state_mu_);
 
+  struct BarrierState {
+    bool passed = false;
+    Status result;
+    int64 deadline_us;
+    absl::flat_hash_set<std::string> arrived_tasks;
+    std::vector<StatusCallback> done_callbacks;
+  };
+  // Completes a barrier with `result`. Its callbacks are moved to `done`, to
+  // be invoked without holding `state_mu_`.
+  void PassBarrier(BarrierState* barrier, Status result,
+                   std::vector<std::function<void()>>* done)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(state_mu_);
+  // Fails the barriers that are past their deadline.
+  void CheckBarrierTimeouts() TF_LOCKS_EXCLUDED(state_mu_);
+  // Fails all barriers that are not passed yet with `error`.
+  void FailPendingBarriers(const Status& error) TF_LOCKS_EXCLUDED(state_mu_);
+
   class TaskState {
    public:
     // Task state maintained on the coordination service side.
@@ -158,6 +179,10 @@ class CoordinationServiceStandaloneImpl : public CoordinationServiceInterface {
       TF_GUARDED_BY(state_mu_);
   CoordinationServiceDeviceInfo cluster_devices_ TF_GUARDED_BY(state_mu_);
   int cluster_pending_workers_ TF_GUARDED_BY(state_mu_);
+  // Keyed by barrier id. Completed barriers are kept, so that the tasks that
+  // arrive late get their result.
+  absl::flat_hash_map<std::string, BarrierState> barriers_
+      TF_GUARDED_BY(state_mu_);
 
   mutex kv_mu_;
   // Ordered map to store config key-values
@@ -297,6 +322,7 @@ void CoordinationServiceStandaloneImpl::StartCheckStaleness() {
           if (!status.ok()) {
             PropagateError(parsed.job, parsed.task, status);
           }
+          CheckBarrierTimeouts();
         }
       }));
 }
@@ -306,6 +332,8 @@ void CoordinationServiceStandaloneImpl::Stop() {
     mutex_lock l(kv_mu_);
     get_cb_.clear();
   }
+  FailPendingBarriers(
+      errors::Aborted("The coordination service is shutting down."));
   {
     mutex_lock l(state_mu_);
     cluster_state_.clear();
@@ -433,6 +461,7 @@ Status CoordinationServiceStandaloneImpl::RecordHeartbeat(
 void CoordinationServiceStandaloneImpl::PropagateError(
     const std::string& job_name, int task_id, Status error) {
   assert(!error.ok());
+  FailPendingBarriers(error);
   ReportErrorToAgentRequest request;
   request.set_source_job(job_name);
   request.set_source_task(task_id);
@@ -570,6 +599,101 @@ Status CoordinationServiceStandaloneImpl::DeleteKeyValue(
   return Status::OK();
 }
 
+void CoordinationServiceStandaloneImpl::BarrierAsync(
+    const std::string& barrier_id, absl::Duration timeout,
+    const std::vector<CoordinatedTask>& arrived_tasks, StatusCallback done) {
+  std::vector<std::function<void()>> callbacks;
+  {
+    mutex_lock l(state_mu_);
+    for (const CoordinatedTask& task : arrived_tasks) {
+      if (!cluster_state_.contains(GetTaskName(task.job(), task.task()))) {
+        done(errors::InvalidArgument("Unexpected worker at barrier ",
+                                     barrier_id, " with job_name=", task.job(),
+                                     ", task_id=", task.task()));
+        return;
+      }
+    }
+    auto it = barriers_.find(barrier_id);
+    if (it == barriers_.end()) {
+      it = barriers_.emplace(barrier_id, BarrierState()).first;
+      it->second.deadline_us =
+          env_.NowMicros() + absl::ToInt64Microseconds(timeout);
+    }
+    BarrierState& barrier = it->second;
+    if (barrier.passed) {
+      callbacks.push_back(
+          [done = std::move(done), result = barrier.result]() {
+            done(result);
+          });
+    } else {
+      for (const CoordinatedTask& task : arrived_tasks) {
+        barrier.arrived_tasks.insert(GetTaskName(task.job(), task.task()));
+      }
+      barrier.done_callbacks.push_back(std::move(done));
+      if (barrier.arrived_tasks.size() == cluster_state_.size()) {
+        PassBarrier(&barrier, Status::OK(), &callbacks);
+      }
+    }
+  }
+  for (const auto& callback : callbacks) {
+    callback();
+  }
+}
+
+void CoordinationServiceStandaloneImpl::PassBarrier(
+    BarrierState* barrier, Status result,
+    std::vector<std::function<void()>>* done) {
+  barrier->passed = true;
+  barrier->result = result;
+  for (StatusCallback& callback : barrier->done_callbacks) {
+    done->push_back(
+        [callback = std::move(callback), result]() { callback(result); });
+  }
+  barrier->done_callbacks.clear();
+  barrier->arrived_tasks.clear();
+}
+
+void CoordinationServiceStandaloneImpl::CheckBarrierTimeouts() {
+  std::vector<std::function<void()>> callbacks;
+  {
+    mutex_lock l(state_mu_);
+    const int64 now_us = env_.NowMicros();
+    for (auto& entry : barriers_) {
+      BarrierState& barrier = entry.second;
+      if (barrier.passed || now_us < barrier.deadline_us) continue;
+      PassBarrier(&barrier,
+                  errors::DeadlineExceeded(
+                      "Barrier ", entry.first, " timed out: ",
+                      barrier.arrived_tasks.size(), " of ",
+                      cluster_state_.size(), " tasks have arrived."),
+                  &callbacks);
+    }
+  }
+  for (const auto& callback : callbacks) {
+    callback();
+  }
+}
+
+void CoordinationServiceStandaloneImpl::FailPendingBarriers(
+    const Status& error) {
+  std::vector<std::function<void()>> callbacks;
+  {
+    mutex_lock l(state_mu_);
+    for (auto& entry : barriers_) {
+      BarrierState& barrier = entry.second;
+      if (barrier.passed) continue;
+      PassBarrier(&barrier,
+                  Status(error.code(),
+                         strings::StrCat("Barrier ", entry.first, " failed: ",
+                                         error.error_message())),
+                  &callbacks);
+    }
+  }
+  for (const auto& callback : callbacks) {
+    callback();
+  }
+}
+
 }  // namespace
 
 std::unique_ptr<CoordinationServiceInterface> EnableCoordinationService(
@@ -21,11 +21,13 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/time/time.h"
 #include "tensorflow/core/distributed_runtime/coordination/coordination_client.h"
 #include "tensorflow/core/platform/status.h"
 #include "tensorflow/core/platform/statusor.h"
 
 namespace tensorflow {
+class CoordinatedTask;
 class CoordinationServiceDeviceInfo;
 class ServerDef;
 class Env;
@@ -141,6 +143,16 @@ class CoordinationServiceInterface {
   // up all key-values under the directory.
   virtual Status DeleteKeyValue(const std::string& key) = 0;
 
+  // Wait at a barrier until all tasks in the cluster have arrived at it.
+  // `arrived_tasks` are the tasks that arrive with this call. `done` is invoked
+  // when the last task arrives, or with an error if not all tasks arrive within
+  // `timeout` of the first arrival, or if a task fails before. A barrier that
+  // has completed keeps its result for the tasks that arrive later.
+  virtual void BarrierAsync(const std::string& barrier_id,
+                            absl::Duration timeout,
+                            const std::vector<CoordinatedTask>& arrived_tasks,
+                            StatusCallback done) = 0;
+
  private:
   friend class CoordinationServiceRpcHandler;
   friend class CoordinationServiceTest_ListClusterDevices_TfDevice_Test;
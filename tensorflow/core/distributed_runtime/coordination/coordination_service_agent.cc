@@ -15,10 +15,14 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/coordination/coordination_service_agent.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
@@ -33,6 +37,7 @@ limitations under the License.
 #include "tensorflow/core/protobuf/coordination_config.pb.h"
 #include "tensorflow/core/protobuf/coordination_service.pb.h"
 #include "tensorflow/core/protobuf/tensorflow_server.pb.h"
+#include "tensorflow/core/util/device_name_utils.h"
 
 namespace tensorflow {
 namespace {
@@ -41,6 +46,76 @@ constexpr int kDefaultClusterRegisterTimeoutMs = 3600 * 1000;  // 3600 seconds
 constexpr int kDefaultHeartbeatTimeoutMs = 10 * 1000;          // 10 seconds
 constexpr char kHeartbeatThread[] = "CoordinationServiceHeartbeatLoop";
 
+std::string GetTaskName(const std::string& job_name, int task_id) {
+  return strings::StrCat("/job:", job_name, "/replica:", 0, "/task:", task_id);
+}
+
+// The position of a task in the tree of tasks rooted at the leader.
+struct TreeLayout {
+  // Empty for the leader and its children, which talk to the leader directly.
+  std::string parent;
+  // The tasks that send their heartbeats and barrier arrivals to this one.
+  int num_children = 0;
+  // Of the whole tree, i.e. the number of hops from the deepest task to the
+  // leader.
+  int depth = 0;
+};
+
+// Arranges the coordinated tasks in a tree with the given fan-out, in
+// breadth-first order: the leader first, then the other tasks ordered by job
+// name and task id. Every task computes the same tree from the ServerDef.
+Status GetTreeLayout(const ServerDef& server_def,
+                     const CoordinationServiceConfig& configs,
+                     const std::string& task_name, TreeLayout* layout) {
+  DeviceNameUtils::ParsedName leader;
+  if (!DeviceNameUtils::ParseFullName(configs.service_leader(), &leader) ||
+      !leader.has_job || !leader.has_task) {
+    return errors::InvalidArgument("Invalid coordination service leader ",
+                                   configs.service_leader());
+  }
+  const std::string leader_name = GetTaskName(leader.job, leader.task);
+  const std::unordered_set<std::string> coordinated_jobs(
+      configs.coordinated_jobs().cbegin(), configs.coordinated_jobs().cend());
+  std::vector<std::pair<std::string, int>> tasks;
+  for (const auto& job : server_def.cluster().job()) {
+    if (!coordinated_jobs.empty() &&
+        coordinated_jobs.find(job.name()) == coordinated_jobs.end()) {
+      continue;
+    }
+    for (const auto& task : job.tasks()) {
+      if (GetTaskName(job.name(), task.first) != leader_name) {
+        tasks.emplace_back(job.name(), task.first);
+      }
+    }
+  }
+  std::sort(tasks.begin(), tasks.end());
+  std::vector<std::string> order = {leader_name};
+  for (const auto& task : tasks) {
+    order.push_back(GetTaskName(task.first, task.second));
+  }
+
+  const auto it = std::find(order.begin(), order.end(), task_name);
+  if (it == order.end()) {
+    return errors::InvalidArgument("Task ", task_name,
+                                   " is not coordinated by the service.");
+  }
+  const int fanout = configs.tree_fanout();
+  const int num_tasks = order.size();
+  const int position = it - order.begin();
+  const int parent = position == 0 ? 0 : (position - 1) / fanout;
+  layout->parent = parent == 0 ? "" : order[parent];
+  // The children of the leader talk to the service rather than to its agent.
+  const int first_child = fanout * position + 1;
+  layout->num_children =
+      position == 0 ? 0
+                    : std::max(0, std::min(fanout, num_tasks - first_child));
+  layout->depth = 0;
+  for (int p = num_tasks - 1; p > 0; p = (p - 1) / fanout) {
+    ++layout->depth;
+  }
+  return Status::OK();
+}
+
 class CoordinationServiceAgentImpl : public CoordinationServiceAgent {
  public:
   CoordinationServiceAgentImpl() = default;
@@ -77,11 +152,17 @@ class CoordinationServiceAgentImpl : public CoordinationServiceAgent {
   Status StartWatchKey(const std::string& key,
                        ChangedKeyValuesCallback on_change) override;
   Status StopWatchKey(const std::string& key) override;
+  Status WaitAtBarrier(const std::string& barrier_id,
+                       absl::Duration timeout) override;
 
  protected:
   void SetError(const Status& error) override;
   Status ActivateWatch(const std::string& key,
                        const std::map<std::string, std::string>&) override;
+  Status RecordSubtreeHeartbeat(const HeartbeatRequest& request,
+                                uint64* leader_incarnation) override;
+  void ArriveAtBarrier(const BarrierRequest& request,
+                       StatusCallback done) override;
   void Stop();
 
  private:
@@ -103,9 +184,35 @@ class CoordinationServiceAgentImpl : public CoordinationServiceAgent {
   State state_ TF_GUARDED_BY(state_mu_) = State::UNINITIALIZED;
   Status status_ TF_GUARDED_BY(state_mu_) = Status::OK();
 
-  uint64 leader_incarnation_;
+  uint64 leader_incarnation_ TF_GUARDED_BY(state_mu_) = 0;
   CoordinationServiceDeviceInfo cluster_devices_;
 
+  // Heartbeats and barrier arrivals are sent to the parent of this task if the
+  // tasks are arranged in a tree, and to the leader otherwise.
+  std::unique_ptr<CoordinationClientCache> client_cache_;
+  CoordinationClient* parent_client_ = nullptr;  // Not owned.
+  int num_children_ = 0;
+  int tree_depth_ = 1;
+
+  // A barrier that tasks in the subtree of this task have arrived at.
+  struct SubtreeBarrier {
+    // This task and those of its children that have not arrived yet.
+    int pending_arrivals;
+    int64 deadline_us;
+    BarrierRequest request;
+    std::vector<StatusCallback> done_callbacks;
+  };
+  // Fails the subtree barriers that are past their deadline.
+  void CheckSubtreeBarrierTimeouts() TF_LOCKS_EXCLUDED(subtree_mu_);
+
+  mutex subtree_mu_;
+  // The latest heartbeats received from the subtree, keyed by task name.
+  absl::flat_hash_map<std::string, HeartbeatRequest> subtree_heartbeats_
+      TF_GUARDED_BY(subtree_mu_);
+  // Keyed by barrier id.
+  absl::flat_hash_map<std::string, SubtreeBarrier> subtree_barriers_
+      TF_GUARDED_BY(subtree_mu_);
+
   mutex heartbeat_thread_shutdown_mu_;
   condition_variable heartbeat_thread_cv_;
   bool shutting_down_ TF_GUARDED_BY(heartbeat_thread_shutdown_mu_) = false;
@@ -136,9 +243,24 @@ Status CoordinationServiceAgentImpl::Initialize(
                 << default_leader;
     }
   }
-  return Initialize(
+  TreeLayout layout;
+  if (configs.tree_fanout() > 0) {
+    TF_RETURN_IF_ERROR(GetTreeLayout(
+        server_def, configs,
+        GetTaskName(server_def.job_name(), server_def.task_index()), &layout));
+  }
+  TF_RETURN_IF_ERROR(Initialize(
       env, server_def.job_name(), server_def.task_index(), configs,
-      client_cache->GetOwnedClient(configs.service_leader()), error_fn);
+      client_cache->GetOwnedClient(configs.service_leader()), error_fn));
+  if (configs.tree_fanout() > 0) {
+    if (!layout.parent.empty()) {
+      parent_client_ = client_cache->GetClient(layout.parent);
+    }
+    num_children_ = layout.num_children;
+    tree_depth_ = std::max(layout.depth, 1);
+    client_cache_ = std::move(client_cache);
+  }
+  return Status::OK();
 }
 
 Status CoordinationServiceAgentImpl::Initialize(
@@ -165,6 +287,7 @@ Status CoordinationServiceAgentImpl::Initialize(
     return errors::InvalidArgument(
         "CoordinationServiceAgent must have a valid leader client.");
   }
+  parent_client_ = leader_client_.get();
   error_fn_ = error_fn;
   state_ = State::DISCONNECTED;
   return Status::OK();
@@ -186,6 +309,19 @@ void CoordinationServiceAgentImpl::Stop() {
     heartbeat_thread_cv_.notify_all();
   }
   heartbeat_thread_.reset();
+  std::vector<StatusCallback> barrier_callbacks;
+  {
+    mutex_lock l(subtree_mu_);
+    for (auto& barrier : subtree_barriers_) {
+      for (StatusCallback& done : barrier.second.done_callbacks) {
+        barrier_callbacks.push_back(std::move(done));
+      }
+    }
+    subtree_barriers_.clear();
+  }
+  for (const auto& done : barrier_callbacks) {
+    done(errors::Aborted("The coordination service agent is stopping."));
+  }
 }
 
 Status CoordinationServiceAgentImpl::Connect() {
@@ -215,11 +351,9 @@ Status CoordinationServiceAgentImpl::Connect() {
         if (!s.ok()) {
           SetError(s);
         } else {
+          mutex_lock l(state_mu_);
           leader_incarnation_ = response.leader_incarnation();
-          {
-            mutex_lock l(state_mu_);
-            state_ = State::RUNNING;
-          }
+          state_ = State::RUNNING;
         }
         n.Notify();
       });
@@ -238,10 +372,19 @@ Status CoordinationServiceAgentImpl::Connect() {
         request.set_task(task_id_);
         request.set_incarnation(incarnation_id_);
         HeartbeatResponse response;
+        // In a tree, a heartbeat may wait at every hop for the next heartbeat
+        // of the parent, so the interval shrinks with the depth of the tree
+        // for the leader to still hear from every task within the timeout.
         const uint64 heartbeat_interval =
-            configs_.heartbeat_timeout_in_ms() > 0
-                ? configs_.heartbeat_timeout_in_ms() / 2
-                : kDefaultHeartbeatTimeoutMs / 2;
+            (configs_.heartbeat_timeout_in_ms() > 0
+                 ? configs_.heartbeat_timeout_in_ms() / 2
+                 : kDefaultHeartbeatTimeoutMs / 2) /
+            tree_depth_;
+        uint64 leader_incarnation;
+        {
+          mutex_lock l(state_mu_);
+          leader_incarnation = leader_incarnation_;
+        }
 
         while (true) {
           {
@@ -252,22 +395,34 @@ Status CoordinationServiceAgentImpl::Connect() {
               return;
             }
           }
+          request.clear_subtree_heartbeats();
+          {
+            mutex_lock l(subtree_mu_);
+            for (auto& heartbeat : subtree_heartbeats_) {
+              *request.add_subtree_heartbeats() = std::move(heartbeat.second);
+            }
+            subtree_heartbeats_.clear();
+          }
           Status status;
           absl::Notification n;
           // Heartbeat RPC implementation automatically retries to tolerate
           // transient network failures.
-          leader_client_->HeartbeatAsync(&request, &response, [&](Status s) {
+          parent_client_->HeartbeatAsync(&request, &response, [&](Status s) {
             status = s;
             n.Notify();
           });
           n.WaitForNotification();
+          // A parent that has not connected yet does not know the leader
+          // incarnation, and responds with 0.
           if (!status.ok()) {
             SetError(status);
-          } else if (response.leader_incarnation() != leader_incarnation_) {
+          } else if (response.leader_incarnation() != leader_incarnation &&
+                     response.leader_incarnation() != 0) {
             SetError(
                 errors::Aborted("Leader incarnation ID mismatch: the "
                                 "coordination leader has restarted."));
           }
+          CheckSubtreeBarrierTimeouts();
         }
       }));
   return Status::OK();
@@ -460,6 +615,112 @@ Status CoordinationServiceAgentImpl::ActivateWatch(
       "CoordinationServviceAgent::ActivateWatch is not implemented.");
 }
 
+Status CoordinationServiceAgentImpl::WaitAtBarrier(
+    const std::string& barrier_id, absl::Duration timeout) {
+  {
+    mutex_lock l(state_mu_);
+    if (state_ != State::RUNNING) {
+      return errors::FailedPrecondition(
+          "CoordinationServiceAgentImpl::WaitAtBarrier must be called when "
+          "the coordination service agent is in RUNNING state.");
+    }
+  }
+  BarrierRequest request;
+  request.set_barrier_id(barrier_id);
+  request.set_barrier_timeout_in_ms(absl::ToInt64Milliseconds(timeout));
+  CoordinatedTask* task = request.add_arrived_tasks();
+  task->set_job(job_name_);
+  task->set_task(task_id_);
+  Status status;
+  absl::Notification n;
+  ArriveAtBarrier(request, [&](Status s) {
+    status = s;
+    n.Notify();
+  });
+  n.WaitForNotification();
+  return status;
+}
+
+Status CoordinationServiceAgentImpl::RecordSubtreeHeartbeat(
+    const HeartbeatRequest& request, uint64* leader_incarnation) {
+  {
+    mutex_lock l(state_mu_);
+    if (state_ == State::ERROR) return status_;
+    *leader_incarnation = state_ == State::RUNNING ? leader_incarnation_ : 0;
+  }
+  mutex_lock l(subtree_mu_);
+  for (const HeartbeatRequest& heartbeat : request.subtree_heartbeats()) {
+    subtree_heartbeats_[GetTaskName(heartbeat.job(), heartbeat.task())] =
+        heartbeat;
+  }
+  HeartbeatRequest& heartbeat =
+      subtree_heartbeats_[GetTaskName(request.job(), request.task())];
+  heartbeat.set_job(request.job());
+  heartbeat.set_task(request.task());
+  heartbeat.set_incarnation(request.incarnation());
+  return Status::OK();
+}
+
+void CoordinationServiceAgentImpl::ArriveAtBarrier(
+    const BarrierRequest& request, StatusCallback done) {
+  auto barrier = std::make_shared<SubtreeBarrier>();
+  {
+    mutex_lock l(subtree_mu_);
+    auto it = subtree_barriers_.find(request.barrier_id());
+    if (it == subtree_barriers_.end()) {
+      it = subtree_barriers_.emplace(request.barrier_id(), SubtreeBarrier())
+               .first;
+      it->second.pending_arrivals = 1 + num_children_;
+      it->second.deadline_us =
+          env_->NowMicros() + request.barrier_timeout_in_ms() * 1000;
+      it->second.request.set_barrier_id(request.barrier_id());
+      it->second.request.set_barrier_timeout_in_ms(
+          request.barrier_timeout_in_ms());
+    }
+    SubtreeBarrier& subtree_barrier = it->second;
+    for (const CoordinatedTask& task : request.arrived_tasks()) {
+      *subtree_barrier.request.add_arrived_tasks() = task;
+    }
+    subtree_barrier.done_callbacks.push_back(std::move(done));
+    if (--subtree_barrier.pending_arrivals > 0) return;
+    *barrier = std::move(subtree_barrier);
+    subtree_barriers_.erase(it);
+  }
+  // The whole subtree has arrived.
+  auto response = std::make_shared<BarrierResponse>();
+  parent_client_->BarrierAsync(&barrier->request, response.get(),
+                               [barrier, response](Status s) {
+                                 for (const auto& done :
+                                      barrier->done_callbacks) {
+                                   done(s);
+                                 }
+                               });
+}
+
+void CoordinationServiceAgentImpl::CheckSubtreeBarrierTimeouts() {
+  std::vector<std::pair<std::string, std::vector<StatusCallback>>> expired;
+  {
+    mutex_lock l(subtree_mu_);
+    const int64 now_us = env_->NowMicros();
+    for (auto it = subtree_barriers_.begin(); it != subtree_barriers_.end();) {
+      if (now_us < it->second.deadline_us) {
+        ++it;
+        continue;
+      }
+      expired.emplace_back(it->first, std::move(it->second.done_callbacks));
+      subtree_barriers_.erase(it++);
+    }
+  }
+  for (const auto& barrier : expired) {
+    const Status status = errors::DeadlineExceeded(
+        "Barrier ", barrier.first, " timed out while waiting for tasks in the "
+        "subtree of /job:", job_name_, "/task:", task_id_);
+    for (const auto& done : barrier.second) {
+      done(status);
+    }
+  }
+}
+
 }  // namespace
 
 std::unique_ptr<CoordinationServiceAgent> CreateCoordinationServiceAgent() {
@@ -123,6 +123,11 @@ class CoordinationServiceAgent {
                                ChangedKeyValuesCallback on_change) = 0;
   virtual Status StopWatchKey(const std::string& key) = 0;
 
+  // Wait at a barrier until all tasks in the cluster have arrived at it. Fails
+  // if that does not happen within `timeout` of the first arrival.
+  virtual Status WaitAtBarrier(const std::string& barrier_id,
+                               absl::Duration timeout) = 0;
+
  protected:
   // Set the service agent to error status and invoke the error callback.
   // Note: different from ReportError, this does not report the error status to
@@ -133,6 +138,20 @@ class CoordinationServiceAgent {
   virtual Status ActivateWatch(const std::string& key,
                                const std::map<std::string, std::string>&) = 0;
 
+  // If the tasks are arranged in a tree, records a heartbeat from a child of
+  // this task, to be forwarded to the parent with the next heartbeat of this
+  // task. Sets `leader_incarnation` to the incarnation of the leader, or to 0
+  // if this task has not connected yet.
+  virtual Status RecordSubtreeHeartbeat(const HeartbeatRequest& request,
+                                        uint64* leader_incarnation) = 0;
+
+  // If the tasks are arranged in a tree, records that tasks in the subtree of
+  // this task have arrived at a barrier. Arrivals are forwarded to the parent
+  // once the whole subtree has arrived, and `done` is invoked once the barrier
+  // completes.
+  virtual void ArriveAtBarrier(const BarrierRequest& request,
+                               StatusCallback done) = 0;
+
  private:
   friend class CoordinationServiceRpcHandler;
 };
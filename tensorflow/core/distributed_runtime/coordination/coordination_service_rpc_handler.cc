@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/distributed_runtime/coordination/coordination_service.h"
 #include "tensorflow/core/distributed_runtime/coordination/coordination_service_agent.h"
@@ -31,11 +32,22 @@ void CoordinationServiceRpcHandler::SetAgentInstance(
   agent_ = agent;
 }
 
+void CoordinationServiceRpcHandler::SetServiceInstance(
+    CoordinationServiceInterface* service) {
+  service_ = service;
+  service_overridden_ = true;
+}
+
+CoordinationServiceInterface*
+CoordinationServiceRpcHandler::GetServiceInstance() {
+  if (service_overridden_) return service_;
+  return CoordinationServiceInterface::GetCoordinationServiceInstance();
+}
+
 void CoordinationServiceRpcHandler::RegisterWorkerAsync(
     const RegisterWorkerRequest* request, RegisterWorkerResponse* response,
     StatusCallback done) {
-  CoordinationServiceInterface* service =
-      CoordinationServiceInterface::GetCoordinationServiceInstance();
+  CoordinationServiceInterface* service = GetServiceInstance();
   if (service == nullptr) {
     done(errors::Internal("Coordination service is not enabled."));
     return;
@@ -54,10 +66,17 @@ void CoordinationServiceRpcHandler::RegisterWorkerAsync(
 void CoordinationServiceRpcHandler::HeartbeatAsync(
     const HeartbeatRequest* request, HeartbeatResponse* response,
     StatusCallback done) {
-  CoordinationServiceInterface* service =
-      CoordinationServiceInterface::GetCoordinationServiceInstance();
+  CoordinationServiceInterface* service = GetServiceInstance();
   if (service == nullptr) {
-    done(errors::Internal("Coordination service is not enabled."));
+    if (agent_ == nullptr) {
+      done(errors::Internal("Coordination service is not enabled."));
+      return;
+    }
+    // The heartbeat of a child of this task, in a tree of tasks.
+    uint64 leader_incarnation;
+    Status s = agent_->RecordSubtreeHeartbeat(*request, &leader_incarnation);
+    if (s.ok()) response->set_leader_incarnation(leader_incarnation);
+    done(s);
     return;
   }
   const std::string& job_name = request->job();
@@ -68,6 +87,16 @@ void CoordinationServiceRpcHandler::HeartbeatAsync(
     done(s);
     return;
   }
+  // Errors of the tasks that the sender forwards heartbeats for are propagated
+  // to the cluster by the service, and do not fail the sender.
+  for (const HeartbeatRequest& heartbeat : request->subtree_heartbeats()) {
+    Status subtree_status = service->RecordHeartbeat(
+        heartbeat.job(), heartbeat.task(), heartbeat.incarnation());
+    if (!subtree_status.ok()) {
+      VLOG(1) << "Forwarded heartbeat of /job:" << heartbeat.job()
+              << "/task:" << heartbeat.task() << " failed: " << subtree_status;
+    }
+  }
   response->set_leader_incarnation(leader_incarnation_id_);
   done(Status::OK());
 }
@@ -75,8 +104,7 @@ void CoordinationServiceRpcHandler::HeartbeatAsync(
 void CoordinationServiceRpcHandler::WaitForAllTasksAsync(
     const WaitForAllTasksRequest* request, WaitForAllTasksResponse* response,
     StatusCallback done) {
-  CoordinationServiceInterface* service =
-      CoordinationServiceInterface::GetCoordinationServiceInstance();
+  CoordinationServiceInterface* service = GetServiceInstance();
   if (service == nullptr) {
     done(errors::Internal("Coordination service is not enabled."));
     return;
@@ -107,8 +135,7 @@ void CoordinationServiceRpcHandler::ReportErrorToAgentAsync(
 void CoordinationServiceRpcHandler::ReportErrorToServiceAsync(
     const ReportErrorToServiceRequest* request,
     ReportErrorToServiceResponse* response, StatusCallback done) {
-  CoordinationServiceInterface* service =
-      CoordinationServiceInterface::GetCoordinationServiceInstance();
+  CoordinationServiceInterface* service = GetServiceInstance();
   if (service == nullptr) {
     done(errors::Internal("Coordination service is not enabled."));
     return;
@@ -122,8 +149,7 @@ void CoordinationServiceRpcHandler::ReportErrorToServiceAsync(
 void CoordinationServiceRpcHandler::InsertKeyValueAsync(
     const InsertKeyValueRequest* request, InsertKeyValueResponse* response,
     StatusCallback done) {
-  CoordinationServiceInterface* service =
-      CoordinationServiceInterface::GetCoordinationServiceInstance();
+  CoordinationServiceInterface* service = GetServiceInstance();
   if (service == nullptr) {
     done(errors::Internal("Coordination service is not enabled."));
     return;
@@ -134,8 +160,7 @@ void CoordinationServiceRpcHandler::InsertKeyValueAsync(
 void CoordinationServiceRpcHandler::GetKeyValueAsync(
     const GetKeyValueRequest* request, GetKeyValueResponse* response,
     StatusCallback done) {
-  CoordinationServiceInterface* service =
-      CoordinationServiceInterface::GetCoordinationServiceInstance();
+  CoordinationServiceInterface* service = GetServiceInstance();
   if (service == nullptr) {
     done(errors::Internal("Coordination service is not enabled."));
     return;
@@ -154,8 +179,7 @@ void CoordinationServiceRpcHandler::GetKeyValueAsync(
 void CoordinationServiceRpcHandler::DeleteKeyValueAsync(
     const DeleteKeyValueRequest* request, DeleteKeyValueResponse* response,
     StatusCallback done) {
-  CoordinationServiceInterface* service =
-      CoordinationServiceInterface::GetCoordinationServiceInstance();
+  CoordinationServiceInterface* service = GetServiceInstance();
   if (service == nullptr) {
     done(errors::Internal("Coordination service is not enabled."));
     return;
@@ -163,4 +187,24 @@ void CoordinationServiceRpcHandler::DeleteKeyValueAsync(
   done(service->DeleteKeyValue(request->key()));
 }
 
+void CoordinationServiceRpcHandler::BarrierAsync(const BarrierRequest* request,
+                                                 BarrierResponse* response,
+                                                 StatusCallback done) {
+  CoordinationServiceInterface* service = GetServiceInstance();
+  if (service == nullptr) {
+    if (agent_ == nullptr) {
+      done(errors::Internal("Coordination service is not enabled."));
+      return;
+    }
+    // Arrivals from the subtree of a child of this task, in a tree of tasks.
+    agent_->ArriveAtBarrier(*request, std::move(done));
+    return;
+  }
+  const std::vector<CoordinatedTask> arrived_tasks(
+      request->arrived_tasks().begin(), request->arrived_tasks().end());
+  service->BarrierAsync(request->barrier_id(),
+                        absl::Milliseconds(request->barrier_timeout_in_ms()),
+                        arrived_tasks, std::move(done));
+}
+
 }  // namespace tensorflow
@@ -22,6 +22,7 @@ limitations under the License.
 
 namespace tensorflow {
 class CoordinationServiceAgent;
+class CoordinationServiceInterface;
 
 class CoordinationServiceRpcHandler {
  public:
@@ -29,6 +30,11 @@ class CoordinationServiceRpcHandler {
 
   void SetAgentInstance(CoordinationServiceAgent* agent);
 
+  // Serves the requests with `service`, which may be null if this task is not
+  // the leader, instead of the service enabled in this process. Used to run
+  // the tasks of a simulated cluster in one process.
+  void SetServiceInstance(CoordinationServiceInterface* service);
+
   void RegisterWorkerAsync(const RegisterWorkerRequest* request,
                            RegisterWorkerResponse* response,
                            StatusCallback done);
@@ -59,9 +65,16 @@ class CoordinationServiceRpcHandler {
                            DeleteKeyValueResponse* response,
                            StatusCallback done);
 
+  void BarrierAsync(const BarrierRequest* request, BarrierResponse* response,
+                    StatusCallback done);
+
  private:
+  CoordinationServiceInterface* GetServiceInstance();
+
   const int64_t leader_incarnation_id_ = random::New64();
-  CoordinationServiceAgent* agent_;
+  CoordinationServiceAgent* agent_ = nullptr;
+  bool service_overridden_ = false;
+  CoordinationServiceInterface* service_ = nullptr;
 };
 
 }  // namespace tensorflow
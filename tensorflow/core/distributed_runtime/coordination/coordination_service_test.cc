@@ -19,6 +19,7 @@ limitations under the License.
 #include <utility>
 
 #include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
 #include "tensorflow/c/c_api_internal.h"
 #include "tensorflow/c/eager/c_api_test_util.h"
 #include "tensorflow/compiler/xla/pjrt/distributed/protocol.pb.h"
@@ -82,6 +83,7 @@ class TestCoordinationClient : public CoordinationClient {
   UNIMPLEMENTED(InsertKeyValue);
   UNIMPLEMENTED(GetKeyValue);
   UNIMPLEMENTED(DeleteKeyValue);
+  UNIMPLEMENTED(Barrier);
 
 #undef UNIMPLEMENTED
 
@@ -393,6 +395,108 @@ TEST(CoordinationServiceTest, TestSetGetValues) {
   EXPECT_FALSE(n2.HasBeenNotified());
 }
 
+CoordinatedTask MakeTask(const std::string& job, int task) {
+  CoordinatedTask coordinated_task;
+  coordinated_task.set_job(job);
+  coordinated_task.set_task(task);
+  return coordinated_task;
+}
+
+TEST(CoordinationServiceTest, TestBarrier) {
+  const ServerDef& server_def = GetMultiClientServerDef("worker", 3);
+  auto client_cache = std::make_unique<TestCoordinationClientCache>();
+  std::unique_ptr<CoordinationServiceInterface> coord_service =
+      CoordinationServiceInterface::EnableCoordinationService(
+          kCoordinationServiceType, Env::Default(), server_def,
+          std::move(client_cache));
+
+  Status status0, status12;
+  absl::Notification done0, done12;
+  coord_service->BarrierAsync("barrier", absl::Seconds(30),
+                              {MakeTask("worker", 0)}, [&](Status s) {
+                                status0 = s;
+                                done0.Notify();
+                              });
+  EXPECT_FALSE(done0.HasBeenNotified());
+  // Several tasks may arrive at once, e.g. forwarded by a parent task.
+  coord_service->BarrierAsync(
+      "barrier", absl::Seconds(30),
+      {MakeTask("worker", 1), MakeTask("worker", 2)}, [&](Status s) {
+        status12 = s;
+        done12.Notify();
+      });
+  done0.WaitForNotification();
+  done12.WaitForNotification();
+  TF_EXPECT_OK(status0);
+  TF_EXPECT_OK(status12);
+
+  // Tasks arriving at a passed barrier get its result.
+  Status late_status = errors::Unknown("Not done");
+  coord_service->BarrierAsync("barrier", absl::Seconds(30),
+                              {MakeTask("worker", 0)},
+                              [&](Status s) { late_status = s; });
+  TF_EXPECT_OK(late_status);
+
+  Status unexpected_status;
+  coord_service->BarrierAsync("other_barrier", absl::Seconds(30),
+                              {MakeTask("worker", 3)},
+                              [&](Status s) { unexpected_status = s; });
+  EXPECT_TRUE(errors::IsInvalidArgument(unexpected_status))
+      << unexpected_status;
+}
+
+TEST(CoordinationServiceTest, TestBarrierTimeout) {
+  const ServerDef& server_def = GetMultiClientServerDef("worker", 2);
+  auto client_cache = std::make_unique<TestCoordinationClientCache>();
+  std::unique_ptr<CoordinationServiceInterface> coord_service =
+      CoordinationServiceInterface::EnableCoordinationService(
+          kCoordinationServiceType, Env::Default(), server_def,
+          std::move(client_cache));
+
+  Status status;
+  absl::Notification done;
+  coord_service->BarrierAsync("barrier", absl::Milliseconds(100),
+                              {MakeTask("worker", 0)}, [&](Status s) {
+                                status = s;
+                                done.Notify();
+                              });
+  done.WaitForNotification();
+  EXPECT_TRUE(errors::IsDeadlineExceeded(status)) << status;
+}
+
+TEST(CoordinationServiceTest, TestBarrierFailsOnTaskError) {
+  const ServerDef& server_def = GetMultiClientServerDef("worker", 2);
+  auto client_cache = std::make_unique<TestCoordinationClientCache>();
+  TestCoordinationClient wi0;
+  client_cache->AddWorker("/job:worker/replica:0/task:0", &wi0);
+  TestCoordinationClient wi1;
+  client_cache->AddWorker("/job:worker/replica:0/task:1", &wi1);
+  std::unique_ptr<CoordinationServiceInterface> coord_service =
+      CoordinationServiceInterface::EnableCoordinationService(
+          kCoordinationServiceType, Env::Default(), server_def,
+          std::move(client_cache));
+  for (int task = 0; task < 2; ++task) {
+    absl::Notification registered;
+    coord_service->RegisterWorker("worker", task, 0, [&](Status s) {
+      TF_ASSERT_OK(s);
+      registered.Notify();
+    });
+    registered.WaitForNotification();
+  }
+
+  Status status;
+  absl::Notification done;
+  coord_service->BarrierAsync("barrier", absl::Seconds(30),
+                              {MakeTask("worker", 0)}, [&](Status s) {
+                                status = s;
+                                done.Notify();
+                              });
+  TF_ASSERT_OK(coord_service->ReportTaskError("worker", 1,
+                                              errors::Internal("Test error")));
+  done.WaitForNotification();
+  EXPECT_TRUE(errors::IsInternal(status)) << status;
+}
+
 }  // namespace
 
 // Verify that coordination service can gather each worker's device info and
@@ -0,0 +1,287 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Simulates a large cluster in one process, to compare the load on the leader
+// and the barrier latency with and without arranging the tasks in a tree.
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "tensorflow/core/distributed_runtime/coordination/coordination_client.h"
+#include "tensorflow/core/distributed_runtime/coordination/coordination_service.h"
+#include "tensorflow/core/distributed_runtime/coordination/coordination_service_agent.h"
+#include "tensorflow/core/distributed_runtime/coordination/coordination_service_rpc_handler.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/threadpool.h"
+#include "tensorflow/core/protobuf/cluster.pb.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/coordination_config.pb.h"
+#include "tensorflow/core/protobuf/coordination_service.pb.h"
+#include "tensorflow/core/protobuf/tensorflow_server.pb.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kJobName[] = "worker";
+constexpr int kHeartbeatTimeoutMs = 2000;
+
+// Requests served by the leader.
+struct LeaderLoad {
+  std::atomic<int64> heartbeats{0};
+  std::atomic<int64> barriers{0};
+};
+
+// Calls the RPC handler of the target task directly.
+class InProcessCoordinationClient : public CoordinationClient {
+ public:
+  InProcessCoordinationClient(CoordinationServiceRpcHandler* handler,
+                              LeaderLoad* leader_load)
+      : handler_(handler), leader_load_(leader_load) {}
+
+  void RegisterWorkerAsync(CallOptions* call_opts,
+                           const RegisterWorkerRequest* request,
+                           RegisterWorkerResponse* response,
+                           StatusCallback done) override {
+    handler_->RegisterWorkerAsync(request, response, std::move(done));
+  }
+
+  void HeartbeatAsync(const HeartbeatRequest* request,
+                      HeartbeatResponse* response,
+                      StatusCallback done) override {
+    if (leader_load_ != nullptr) ++leader_load_->heartbeats;
+    handler_->HeartbeatAsync(request, response, std::move(done));
+  }
+
+  void BarrierAsync(const BarrierRequest* request, BarrierResponse* response,
+                    StatusCallback done) override {
+    if (leader_load_ != nullptr) ++leader_load_->barriers;
+    handler_->BarrierAsync(request, response, std::move(done));
+  }
+
+#define FORWARD(method)                                               \
+  void method##Async(const method##Request* request,                  \
+                     method##Response* response, StatusCallback done) \
+      override {                                                      \
+    handler_->method##Async(request, response, std::move(done));      \
+  }
+
+  FORWARD(WaitForAllTasks);
+  FORWARD(ReportErrorToAgent);
+  FORWARD(ReportErrorToService);
+  FORWARD(InsertKeyValue);
+  FORWARD(GetKeyValue);
+  FORWARD(DeleteKeyValue);
+
+#undef FORWARD
+
+ private:
+  CoordinationServiceRpcHandler* handler_;  // Not owned.
+  LeaderLoad* leader_load_;                 // Not owned, null if not leader.
+};
+
+std::string TaskName(int task_id) {
+  return strings::StrCat("/job:", kJobName, "/replica:0/task:", task_id);
+}
+
+// A cluster of tasks in one process. Task 0 is the leader.
+class SimulatedCluster {
+ public:
+  SimulatedCluster(int num_tasks, int tree_fanout)
+      : handlers_(num_tasks), agents_(num_tasks), errors_(0) {
+    ServerDef server_def;
+    server_def.set_protocol("grpc");
+    server_def.set_job_name(kJobName);
+    JobDef* job_def = server_def.mutable_cluster()->add_job();
+    job_def->set_name(kJobName);
+    for (int i = 0; i < num_tasks; ++i) {
+      job_def->mutable_tasks()->insert({i, "dummy address"});
+    }
+    CoordinationServiceConfig* config =
+        server_def.mutable_default_session_config()
+            ->mutable_experimental()
+            ->mutable_coordination_config();
+    config->set_service_type("standalone");
+    config->set_service_leader(TaskName(0));
+    config->set_heartbeat_timeout_in_ms(kHeartbeatTimeoutMs);
+    config->set_tree_fanout(tree_fanout);
+
+    for (int i = 0; i < num_tasks; ++i) {
+      handlers_[i] = std::make_unique<CoordinationServiceRpcHandler>();
+    }
+    server_def.set_task_index(0);
+    service_ = CoordinationServiceInterface::EnableCoordinationService(
+        "standalone", Env::Default(), server_def, NewClientCache());
+    for (int i = 0; i < num_tasks; ++i) {
+      agents_[i] = CreateCoordinationServiceAgent();
+      handlers_[i]->SetAgentInstance(agents_[i].get());
+      handlers_[i]->SetServiceInstance(i == 0 ? service_.get() : nullptr);
+      server_def.set_task_index(i);
+      TF_CHECK_OK(agents_[i]->Initialize(Env::Default(), server_def,
+                                         NewClientCache(), [this](Status s) {
+                                           LOG(ERROR) << s;
+                                           ++errors_;
+                                         }));
+    }
+  }
+
+  ~SimulatedCluster() {
+    // Stops the heartbeats before the service goes away.
+    agents_.clear();
+    service_.reset();
+  }
+
+  Status Connect() {
+    for (auto& agent : agents_) {
+      TF_RETURN_IF_ERROR(agent->Connect());
+    }
+    return Status::OK();
+  }
+
+  // Has all tasks wait at a barrier, and returns how long it took.
+  absl::Duration RunBarrier(const std::string& barrier_id) {
+    const int num_tasks = agents_.size();
+    thread::ThreadPool pool(Env::Default(), "barrier", num_tasks);
+    BlockingCounter counter(num_tasks);
+    const absl::Time start = absl::Now();
+    for (auto& agent : agents_) {
+      pool.Schedule([&agent, &counter, &barrier_id]() {
+        TF_EXPECT_OK(agent->WaitAtBarrier(barrier_id, absl::Seconds(30)));
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+    return absl::Now() - start;
+  }
+
+  CoordinationServiceAgent* agent(int task_id) {
+    return agents_[task_id].get();
+  }
+  LeaderLoad& leader_load() { return leader_load_; }
+  int errors() const { return errors_; }
+
+ private:
+  class ClientCache : public CoordinationClientCache {
+   public:
+    explicit ClientCache(SimulatedCluster* cluster) : cluster_(cluster) {}
+
+    CoordinationClient* GetClient(const std::string& target) override {
+      mutex_lock l(mu_);
+      auto it = clients_.find(target);
+      if (it == clients_.end()) {
+        it = clients_.emplace(target, GetOwnedClient(target)).first;
+      }
+      return it->second.get();
+    }
+
+    std::unique_ptr<CoordinationClient> GetOwnedClient(
+        const std::string& target) override {
+      for (int i = 0; i < cluster_->handlers_.size(); ++i) {
+        if (TaskName(i) == target) {
+          return std::make_unique<InProcessCoordinationClient>(
+              cluster_->handlers_[i].get(),
+              i == 0 ? &cluster_->leader_load_ : nullptr);
+        }
+      }
+      return nullptr;
+    }
+
+   private:
+    SimulatedCluster* cluster_;
+    mutex mu_;
+    std::unordered_map<std::string, std::unique_ptr<CoordinationClient>>
+        clients_ TF_GUARDED_BY(mu_);
+  };
+
+  std::unique_ptr<CoordinationClientCache> NewClientCache() {
+    return std::make_unique<ClientCache>(this);
+  }
+
+  LeaderLoad leader_load_;
+  std::vector<std::unique_ptr<CoordinationServiceRpcHandler>> handlers_;
+  std::unique_ptr<CoordinationServiceInterface> service_;
+  std::vector<std::unique_ptr<CoordinationServiceAgent>> agents_;
+  std::atomic<int> errors_;
+};
+
+struct ClusterStats {
+  double leader_heartbeats_per_second;
+  int64 leader_barrier_rpcs;
+  absl::Duration barrier_latency;
+};
+
+ClusterStats RunCluster(int num_tasks, int tree_fanout) {
+  SimulatedCluster cluster(num_tasks, tree_fanout);
+  TF_CHECK_OK(cluster.Connect());
+
+  const absl::Duration heartbeat_window = absl::Seconds(3);
+  const int64 heartbeats_before = cluster.leader_load().heartbeats;
+  Env::Default()->SleepForMicroseconds(
+      absl::ToInt64Microseconds(heartbeat_window));
+  ClusterStats stats;
+  stats.leader_heartbeats_per_second =
+      (cluster.leader_load().heartbeats - heartbeats_before) /
+      absl::ToDoubleSeconds(heartbeat_window);
+
+  // The first barrier warms up the threads.
+  cluster.RunBarrier("warmup");
+  const int64 barriers_before = cluster.leader_load().barriers;
+  stats.barrier_latency = cluster.RunBarrier("barrier");
+  stats.leader_barrier_rpcs = cluster.leader_load().barriers - barriers_before;
+  EXPECT_EQ(0, cluster.errors());
+
+  LOG(INFO) << num_tasks << " tasks, tree fan-out " << tree_fanout << ": "
+            << stats.leader_heartbeats_per_second
+            << " heartbeats per second and " << stats.leader_barrier_rpcs
+            << " barrier RPCs at the leader, barrier latency "
+            << stats.barrier_latency;
+  return stats;
+}
+
+TEST(CoordinationServiceTreeTest, TreeReducesLeaderLoad) {
+  constexpr int kNumTasks = 256;
+  constexpr int kFanout = 16;
+  const ClusterStats flat = RunCluster(kNumTasks, /*tree_fanout=*/0);
+  const ClusterStats tree = RunCluster(kNumTasks, kFanout);
+
+  // Every task sends its own barrier arrival to the leader, or only the leader
+  // and its children do.
+  EXPECT_EQ(kNumTasks, flat.leader_barrier_rpcs);
+  EXPECT_EQ(kFanout + 1, tree.leader_barrier_rpcs);
+  // The children of the leader heartbeat twice as often in a tree of depth 2,
+  // but there are 15 times fewer of them.
+  EXPECT_LT(tree.leader_heartbeats_per_second,
+            flat.leader_heartbeats_per_second / 4);
+}
+
+TEST(CoordinationServiceTreeTest, FailsBarrierOfMissingTask) {
+  SimulatedCluster cluster(/*num_tasks=*/8, /*tree_fanout=*/2);
+  TF_ASSERT_OK(cluster.Connect());
+  // Task 0 is the only one to arrive.
+  EXPECT_TRUE(errors::IsDeadlineExceeded(
+      cluster.agent(0)->WaitAtBarrier("barrier", absl::Milliseconds(100))));
+}
+
+}  // namespace
+}  // namespace tensorflow
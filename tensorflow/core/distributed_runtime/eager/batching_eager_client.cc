@@ -0,0 +1,224 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/eager/batching_eager_client.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/distributed_runtime/call_options.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace eager {
+
+struct BatchingEagerClient::Batch {
+  // A StreamingEnqueueAsync call whose items are part of `request`.
+  struct Pending {
+    int num_items;
+    EnqueueResponse* response;
+    StatusCallback done;
+  };
+
+  // An EnqueueAsync call to issue once `request` has been sent.
+  struct Deferred {
+    CallOptions* call_opts;
+    EnqueueRequest request;
+    EnqueueResponse* response;
+    StatusCallback done;
+  };
+
+  // When the batch is sent out even if it is not full.
+  uint64 deadline_micros;
+  CallOptions call_opts;
+  EnqueueRequest request;
+  EnqueueResponse response;
+  std::vector<Pending> pending;
+  std::vector<Deferred> deferred;
+};
+
+namespace {
+
+bool OnlyReleasesHandles(const EnqueueRequest& request) {
+  for (const QueueItem& item : request.queue()) {
+    if (!item.has_handle_to_decref()) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+BatchingEagerClient::Options BatchingEagerClient::OptionsFromEnv() {
+  Options options;
+  int64 max_batch_size;
+  TF_CHECK_OK(ReadInt64FromEnvVar("TF_EAGER_REMOTE_ENQUEUE_BATCH_SIZE", 1,
+                                  &max_batch_size));
+  options.max_batch_size = std::max<int64>(max_batch_size, 1);
+  TF_CHECK_OK(ReadInt64FromEnvVar("TF_EAGER_REMOTE_ENQUEUE_BATCH_DELAY_US",
+                                  options.max_delay_micros,
+                                  &options.max_delay_micros));
+  return options;
+}
+
+BatchingEagerClient::BatchingEagerClient(EagerClient* wrapped,
+                                         const Options& options)
+    : options_(options) {
+  wrapped->Ref();
+  wrapped_.reset(wrapped);
+  flush_thread_.reset(Env::Default()->StartThread(
+      ThreadOptions(), "eager_enqueue_batcher", [this]() { FlushLoop(); }));
+}
+
+BatchingEagerClient::~BatchingEagerClient() {
+  FlushPendingEnqueues();
+  {
+    mutex_lock l(mu_);
+    shutting_down_ = true;
+    batch_opened_.notify_all();
+  }
+  // Joins the thread.
+  flush_thread_.reset();
+}
+
+void BatchingEagerClient::StreamingEnqueueAsync(CallOptions* call_opts,
+                                                const EnqueueRequest* request,
+                                                EnqueueResponse* response,
+                                                StatusCallback done) {
+  {
+    mutex_lock l(mu_);
+    if (open_batch_ != nullptr &&
+        open_batch_->request.context_id() != request->context_id()) {
+      CloseBatchLocked();
+    }
+    if (open_batch_ == nullptr) {
+      open_batch_ = absl::make_unique<Batch>();
+      open_batch_->deadline_micros =
+          Env::Default()->NowMicros() + options_.max_delay_micros;
+      open_batch_->request.set_context_id(request->context_id());
+      batch_opened_.notify_one();
+    }
+    open_batch_->request.mutable_queue()->MergeFrom(request->queue());
+    open_batch_->pending.push_back(
+        {request->queue_size(), response, std::move(done)});
+    if (open_batch_->pending.size() >=
+        static_cast<size_t>(options_.max_batch_size)) {
+      CloseBatchLocked();
+    }
+  }
+  SendOutgoing();
+}
+
+void BatchingEagerClient::EnqueueAsync(CallOptions* call_opts,
+                                       const EnqueueRequest* request,
+                                       EnqueueResponse* response,
+                                       StatusCallback done) {
+  if (OnlyReleasesHandles(*request)) {
+    mutex_lock l(mu_);
+    Batch* last_unsent = open_batch_ != nullptr ? open_batch_.get()
+                         : outgoing_.empty()    ? nullptr
+                                                : outgoing_.back().get();
+    if (last_unsent != nullptr) {
+      last_unsent->deferred.push_back(
+          {call_opts, *request, response, std::move(done)});
+      return;
+    }
+  } else {
+    FlushPendingEnqueues();
+  }
+  wrapped_->EnqueueAsync(call_opts, request, response, std::move(done));
+}
+
+void BatchingEagerClient::FlushPendingEnqueues() {
+  {
+    mutex_lock l(mu_);
+    CloseBatchLocked();
+  }
+  SendOutgoing();
+}
+
+void BatchingEagerClient::CloseBatchLocked() {
+  if (open_batch_ != nullptr) {
+    outgoing_.push_back(std::move(open_batch_));
+  }
+}
+
+void BatchingEagerClient::FlushLoop() {
+  while (true) {
+    {
+      mutex_lock l(mu_);
+      while (true) {
+        if (shutting_down_) return;
+        if (open_batch_ == nullptr) {
+          batch_opened_.wait(l);
+          continue;
+        }
+        const uint64 now = Env::Default()->NowMicros();
+        if (now >= open_batch_->deadline_micros) break;
+        batch_opened_.wait_for(
+            l, std::chrono::microseconds(open_batch_->deadline_micros - now));
+      }
+      CloseBatchLocked();
+    }
+    SendOutgoing();
+  }
+}
+
+void BatchingEagerClient::SendOutgoing() {
+  while (true) {
+    std::shared_ptr<Batch> batch;
+    {
+      mutex_lock l(mu_);
+      if (sending_ || outgoing_.empty()) return;
+      sending_ = true;
+      batch = std::move(outgoing_.front());
+      outgoing_.pop_front();
+    }
+
+    VLOG(3) << "Sending a batch of " << batch->pending.size()
+            << " enqueue requests with " << batch->request.queue_size()
+            << " items.";
+    wrapped_->StreamingEnqueueAsync(
+        &batch->call_opts, &batch->request, &batch->response,
+        [batch](const Status& status) {
+          int offset = 0;
+          for (Batch::Pending& pending : batch->pending) {
+            if (status.ok()) {
+              const int end = std::min(offset + pending.num_items,
+                                       batch->response.queue_response_size());
+              for (int i = offset; i < end; ++i) {
+                pending.response->add_queue_response()->Swap(
+                    batch->response.mutable_queue_response(i));
+              }
+            }
+            offset += pending.num_items;
+            pending.done(status);
+          }
+        });
+    for (Batch::Deferred& deferred : batch->deferred) {
+      wrapped_->EnqueueAsync(deferred.call_opts, &deferred.request,
+                             deferred.response, std::move(deferred.done));
+    }
+
+    mutex_lock l(mu_);
+    sending_ = false;
+  }
+}
+
+}  // namespace eager
+}  // namespace tensorflow
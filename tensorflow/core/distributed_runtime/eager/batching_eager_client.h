@@ -0,0 +1,139 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_EAGER_BATCHING_EAGER_CLIENT_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_EAGER_BATCHING_EAGER_CLIENT_H_
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/distributed_runtime/eager/eager_client.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace eager {
+
+// An EagerClient which coalesces consecutive StreamingEnqueueAsync calls into
+// a single EnqueueRequest on the wrapped client. Loops of small remote ops are
+// otherwise bound by one streaming round trip per op.
+//
+// A batch is sent out when it holds `max_batch_size` requests, when its oldest
+// request has waited `max_delay_micros`, or when FlushPendingEnqueues() is
+// called. Calling any other method also flushes the pending batch first, so
+// requests reach the wrapped client in the order they were issued.
+//
+// The remote service runs the items of a batch in order, so an op may consume
+// the outputs of an earlier op in the same batch through its remote tensor
+// handle. Each caller's `response` receives the queue responses of its own
+// items. If the batch fails, every request in it fails with the same status,
+// just as every later request on a broken stream would.
+class BatchingEagerClient : public EagerClient {
+ public:
+  struct Options {
+    // Maximum number of StreamingEnqueueAsync requests sent as one batch.
+    int max_batch_size = 64;
+    // Maximum time a request is held back waiting for more requests.
+    int64 max_delay_micros = 200;
+  };
+
+  // Reads the options from TF_EAGER_REMOTE_ENQUEUE_BATCH_SIZE and
+  // TF_EAGER_REMOTE_ENQUEUE_BATCH_DELAY_US. Batching is disabled by default,
+  // i.e. the returned `max_batch_size` is 1 unless the variable is set.
+  static Options OptionsFromEnv();
+
+  // Takes a reference on `wrapped`.
+  BatchingEagerClient(EagerClient* wrapped, const Options& options);
+  ~BatchingEagerClient() override;
+
+#define CLIENT_METHOD(method)                                    \
+  void method##Async(const method##Request* request,             \
+                     method##Response* response,                 \
+                     StatusCallback done) override {             \
+    FlushPendingEnqueues();                                      \
+    wrapped_->method##Async(request, response, std::move(done)); \
+  }
+
+  CLIENT_METHOD(CreateContext);
+  CLIENT_METHOD(UpdateContext);
+  CLIENT_METHOD(WaitQueueDone);
+  CLIENT_METHOD(KeepAlive);
+  CLIENT_METHOD(CloseContext);
+
+#undef CLIENT_METHOD
+
+#define CLIENT_CANCELABLE_METHOD(method)                                    \
+  void method##Async(CallOptions* call_opts, const method##Request* request, \
+                     method##Response* response, StatusCallback done)        \
+      override {                                                            \
+    FlushPendingEnqueues();                                                 \
+    wrapped_->method##Async(call_opts, request, response, std::move(done)); \
+  }
+
+  CLIENT_CANCELABLE_METHOD(RunComponentFunction);
+
+#undef CLIENT_CANCELABLE_METHOD
+
+  // Requests which only release remote tensor handles are held back with the
+  // open batch and sent right after it, so that they cannot overtake the ops
+  // using those handles. Other requests flush the open batch first.
+  void EnqueueAsync(CallOptions* call_opts, const EnqueueRequest* request,
+                    EnqueueResponse* response, StatusCallback done) override;
+
+  void StreamingEnqueueAsync(CallOptions* call_opts,
+                             const EnqueueRequest* request,
+                             EnqueueResponse* response,
+                             StatusCallback done) override;
+
+  bool allow_multiple_pending_requests() const override {
+    return wrapped_->allow_multiple_pending_requests();
+  }
+
+  void FlushPendingEnqueues() override;
+
+ private:
+  struct Batch;
+
+  // Moves the open batch, if any, to the back of `outgoing_`.
+  void CloseBatchLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Sends the batches in `outgoing_` in order. Only one thread sends at a time
+  // and the wrapped client is never called with `mu_` held, so completion
+  // callbacks which run inline may issue new requests.
+  void SendOutgoing() TF_LOCKS_EXCLUDED(mu_);
+
+  // Body of `flush_thread_`: sends each batch once its deadline has passed.
+  void FlushLoop();
+
+  core::RefCountPtr<EagerClient> wrapped_;
+  const Options options_;
+
+  mutex mu_;
+  condition_variable batch_opened_;
+  std::unique_ptr<Batch> open_batch_ TF_GUARDED_BY(mu_);
+  std::deque<std::unique_ptr<Batch>> outgoing_ TF_GUARDED_BY(mu_);
+  bool sending_ TF_GUARDED_BY(mu_) = false;
+  bool shutting_down_ TF_GUARDED_BY(mu_) = false;
+
+  std::unique_ptr<Thread> flush_thread_;
+};
+
+}  // namespace eager
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_EAGER_BATCHING_EAGER_CLIENT_H_
@@ -0,0 +1,261 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/eager/batching_eager_client.h"
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/eager_service.pb.h"
+
+namespace tensorflow {
+namespace eager {
+namespace {
+
+// Records the calls it receives and completes streaming enqueues only when the
+// test asks it to. Each queue response carries the id of its operation as the
+// first dimension of its shape.
+class FakeEagerClient : public EagerClient {
+ public:
+#define CLIENT_METHOD(method)                                          \
+  void method##Async(const method##Request* request,                   \
+                     method##Response* response, StatusCallback done)  \
+      override {                                                       \
+    Record(#method);                                                   \
+    done(Status::OK());                                                \
+  }
+
+  CLIENT_METHOD(CreateContext);
+  CLIENT_METHOD(UpdateContext);
+  CLIENT_METHOD(WaitQueueDone);
+  CLIENT_METHOD(KeepAlive);
+  CLIENT_METHOD(CloseContext);
+
+#undef CLIENT_METHOD
+
+#define CLIENT_CANCELABLE_METHOD(method)                                      \
+  void method##Async(CallOptions* call_opts, const method##Request* request,  \
+                     method##Response* response, StatusCallback done)         \
+      override {                                                              \
+    Record(#method);                                                          \
+    done(Status::OK());                                                       \
+  }
+
+  CLIENT_CANCELABLE_METHOD(Enqueue);
+  CLIENT_CANCELABLE_METHOD(RunComponentFunction);
+
+#undef CLIENT_CANCELABLE_METHOD
+
+  void StreamingEnqueueAsync(CallOptions* call_opts,
+                             const EnqueueRequest* request,
+                             EnqueueResponse* response,
+                             StatusCallback done) override {
+    mutex_lock l(mu_);
+    calls_.push_back("StreamingEnqueue");
+    requests_.push_back(*request);
+    responses_.push_back(response);
+    callbacks_.push_back(std::move(done));
+  }
+
+  bool allow_multiple_pending_requests() const override { return true; }
+
+  // Completes the `i`-th streaming enqueue with `status`.
+  void Complete(int i, const Status& status) {
+    StatusCallback done;
+    {
+      mutex_lock l(mu_);
+      if (status.ok()) {
+        for (const QueueItem& item : requests_[i].queue()) {
+          TensorShapeProto* shape =
+              responses_[i]->add_queue_response()->add_shape();
+          shape->add_dim()->set_size(item.operation().id());
+        }
+      }
+      done = std::move(callbacks_[i]);
+    }
+    done(status);
+  }
+
+  std::vector<EnqueueRequest> requests() {
+    mutex_lock l(mu_);
+    return requests_;
+  }
+
+  std::vector<string> calls() {
+    mutex_lock l(mu_);
+    return calls_;
+  }
+
+ private:
+  void Record(const string& call) {
+    mutex_lock l(mu_);
+    calls_.push_back(call);
+  }
+
+  mutex mu_;
+  std::vector<string> calls_ TF_GUARDED_BY(mu_);
+  std::vector<EnqueueRequest> requests_ TF_GUARDED_BY(mu_);
+  std::vector<EnqueueResponse*> responses_ TF_GUARDED_BY(mu_);
+  std::vector<StatusCallback> callbacks_ TF_GUARDED_BY(mu_);
+};
+
+class BatchingEagerClientTest : public ::testing::Test {
+ protected:
+  void CreateClient(int max_batch_size, int64 max_delay_micros) {
+    fake_ = new FakeEagerClient;
+    BatchingEagerClient::Options options;
+    options.max_batch_size = max_batch_size;
+    options.max_delay_micros = max_delay_micros;
+    client_.reset(new BatchingEagerClient(fake_, options));
+    // `client_` holds its own reference.
+    fake_->Unref();
+  }
+
+  // Issues a streaming enqueue of one op with `op_id` in `context_id`.
+  void Enqueue(int64 op_id, uint64 context_id = 1) {
+    EnqueueRequest request;
+    request.set_context_id(context_id);
+    request.add_queue()->mutable_operation()->set_id(op_id);
+    responses_.emplace_back(new EnqueueResponse);
+    statuses_.emplace_back(new Status(errors::Unknown("Not done.")));
+    Status* status = statuses_.back().get();
+    client_->StreamingEnqueueAsync(
+        /*call_opts=*/nullptr, &request, responses_.back().get(),
+        [status](const Status& s) { *status = s; });
+  }
+
+  FakeEagerClient* fake_;
+  core::RefCountPtr<BatchingEagerClient> client_;
+  std::vector<std::unique_ptr<EnqueueResponse>> responses_;
+  std::vector<std::unique_ptr<Status>> statuses_;
+};
+
+constexpr int64 kNoDelayedFlush = 3600 * 1000 * 1000LL;
+
+TEST_F(BatchingEagerClientTest, CoalescesUpToMaxBatchSize) {
+  CreateClient(/*max_batch_size=*/3, kNoDelayedFlush);
+  for (int i = 0; i < 4; ++i) {
+    Enqueue(/*op_id=*/i);
+  }
+
+  std::vector<EnqueueRequest> requests = fake_->requests();
+  ASSERT_EQ(1, requests.size());
+  ASSERT_EQ(3, requests[0].queue_size());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(i, requests[0].queue(i).operation().id());
+  }
+
+  fake_->Complete(0, Status::OK());
+  for (int i = 0; i < 3; ++i) {
+    TF_EXPECT_OK(*statuses_[i]);
+    ASSERT_EQ(1, responses_[i]->queue_response_size());
+    EXPECT_EQ(i, responses_[i]->queue_response(0).shape(0).dim(0).size());
+  }
+  EXPECT_EQ(error::UNKNOWN, statuses_[3]->code());
+
+  client_->FlushPendingEnqueues();
+  requests = fake_->requests();
+  ASSERT_EQ(2, requests.size());
+  ASSERT_EQ(1, requests[1].queue_size());
+  EXPECT_EQ(3, requests[1].queue(0).operation().id());
+  fake_->Complete(1, Status::OK());
+  TF_EXPECT_OK(*statuses_[3]);
+}
+
+TEST_F(BatchingEagerClientTest, FailedBatchFailsEveryRequest) {
+  CreateClient(/*max_batch_size=*/2, kNoDelayedFlush);
+  Enqueue(/*op_id=*/0);
+  Enqueue(/*op_id=*/1);
+  fake_->Complete(0, errors::Unavailable("Stream broken."));
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(error::UNAVAILABLE, statuses_[i]->code());
+    EXPECT_EQ(0, responses_[i]->queue_response_size());
+  }
+}
+
+TEST_F(BatchingEagerClientTest, DoesNotMixContexts) {
+  CreateClient(/*max_batch_size=*/8, kNoDelayedFlush);
+  Enqueue(/*op_id=*/0, /*context_id=*/1);
+  Enqueue(/*op_id=*/1, /*context_id=*/1);
+  Enqueue(/*op_id=*/2, /*context_id=*/2);
+  client_->FlushPendingEnqueues();
+
+  std::vector<EnqueueRequest> requests = fake_->requests();
+  ASSERT_EQ(2, requests.size());
+  EXPECT_EQ(1, requests[0].context_id());
+  EXPECT_EQ(2, requests[0].queue_size());
+  EXPECT_EQ(2, requests[1].context_id());
+  EXPECT_EQ(1, requests[1].queue_size());
+}
+
+TEST_F(BatchingEagerClientTest, OtherCallsFlushFirst) {
+  CreateClient(/*max_batch_size=*/8, kNoDelayedFlush);
+  Enqueue(/*op_id=*/0);
+  WaitQueueDoneRequest request;
+  WaitQueueDoneResponse response;
+  Status status;
+  client_->WaitQueueDoneAsync(&request, &response,
+                              [&status](const Status& s) { status = s; });
+  TF_EXPECT_OK(status);
+
+  std::vector<string> calls = fake_->calls();
+  ASSERT_EQ(2, calls.size());
+  EXPECT_EQ("StreamingEnqueue", calls[0]);
+  EXPECT_EQ("WaitQueueDone", calls[1]);
+}
+
+TEST_F(BatchingEagerClientTest, HandleReleasesFollowTheirBatch) {
+  CreateClient(/*max_batch_size=*/8, kNoDelayedFlush);
+  Enqueue(/*op_id=*/0);
+  EnqueueRequest request;
+  request.set_context_id(1);
+  request.add_queue()->mutable_handle_to_decref()->set_op_id(0);
+  EnqueueResponse response;
+  Status status = errors::Unknown("Not done.");
+  client_->EnqueueAsync(/*call_opts=*/nullptr, &request, &response,
+                        [&status](const Status& s) { status = s; });
+  EXPECT_TRUE(fake_->calls().empty());
+
+  client_->FlushPendingEnqueues();
+  TF_EXPECT_OK(status);
+  std::vector<string> calls = fake_->calls();
+  ASSERT_EQ(2, calls.size());
+  EXPECT_EQ("StreamingEnqueue", calls[0]);
+  EXPECT_EQ("Enqueue", calls[1]);
+}
+
+TEST_F(BatchingEagerClientTest, FlushesAfterDelay) {
+  CreateClient(/*max_batch_size=*/8, /*max_delay_micros=*/1000);
+  Enqueue(/*op_id=*/0);
+  Enqueue(/*op_id=*/1);
+  for (int i = 0; i < 1000 && fake_->requests().empty(); ++i) {
+    Env::Default()->SleepForMicroseconds(10 * 1000);
+  }
+  std::vector<EnqueueRequest> requests = fake_->requests();
+  ASSERT_EQ(1, requests.size());
+  EXPECT_EQ(2, requests[0].queue_size());
+  fake_->Complete(0, Status::OK());
+  TF_EXPECT_OK(*statuses_[0]);
+  TF_EXPECT_OK(*statuses_[1]);
+}
+
+}  // namespace
+}  // namespace eager
+}  // namespace tensorflow
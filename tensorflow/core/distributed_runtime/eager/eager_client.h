@@ -70,6 +70,12 @@ class EagerClient : public core::RefCounted {
                                      StatusCallback done) = 0;
 
   virtual bool allow_multiple_pending_requests() const = 0;
+
+  // Sends out any StreamingEnqueueAsync requests the client is holding back in
+  // order to batch them with later ones. Callers that are about to block on
+  // the result of a request should call this first. A no-op for clients that
+  // do not batch.
+  virtual void FlushPendingEnqueues() {}
 };
 
 // Simple wrapper class that can be used to retrieve EagerClients.
@@ -185,6 +185,8 @@ void RemoteCopyNode::StartSend() {
           }
           delete response;
         });
+    // The local recv blocks on this send, so don't let it sit in a batch.
+    eager_client->FlushPendingEnqueues();
   }
 }
 
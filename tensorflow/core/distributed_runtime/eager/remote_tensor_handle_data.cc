@@ -215,6 +215,20 @@ Status RemoteTensorHandleData::OpIdAndOutputNum(const bool wait_util_ready,
 }
 
 Status RemoteTensorHandleData::WaitReady(const char* caller) const {
+  if (ctx_ != nullptr && !IsReady()) {
+    // The op producing this tensor may be held back in a batch of enqueue
+    // requests. Send it out now that its result is awaited.
+    string remote_task;
+    {
+      tf_shared_lock l(mu_);
+      remote_task = remote_task_;
+    }
+    core::RefCountPtr<eager::EagerClient> eager_client;
+    if (ctx_->GetClient(remote_task, &eager_client).ok()) {
+      eager_client->FlushPendingEnqueues();
+    }
+  }
+
   tf_shared_lock l(mu_);
   if (!is_ready_) {
     profiler::TraceMe activity(
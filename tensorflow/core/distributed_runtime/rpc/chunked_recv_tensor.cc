@@ -0,0 +1,252 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/chunked_recv_tensor.h"
+
+#include <algorithm>
+
+#include "grpcpp/support/slice.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/proto_encode_helper.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/platform/coding.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+/*static*/ int64 ChunkedRecvTensor::ChunkBytes() {
+  static const int64 chunk_bytes = [] {
+    int64 chunk_bytes;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_GRPC_RECV_TENSOR_CHUNK_BYTES",
+                                    /*default_val=*/0, &chunk_bytes));
+    if (chunk_bytes > kMaxChunkBytes) {
+      LOG(WARNING) << "TF_GRPC_RECV_TENSOR_CHUNK_BYTES is too large, using "
+                   << kMaxChunkBytes << " bytes instead";
+      chunk_bytes = kMaxChunkBytes;
+    }
+    return std::max<int64>(chunk_bytes, 0);
+  }();
+  return chunk_bytes;
+}
+
+/*static*/ int64 ChunkedRecvTensor::ChunksInFlight() {
+  static const int64 chunks_in_flight = [] {
+    int64 chunks_in_flight;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_GRPC_RECV_TENSOR_CHUNKS_IN_FLIGHT",
+                                    /*default_val=*/4, &chunks_in_flight));
+    return std::max<int64>(chunks_in_flight, 1);
+  }();
+  return chunks_in_flight;
+}
+
+/*static*/ bool ChunkedRecvTensor::MaybeAddRecvOptions(
+    RecvTensorRequest* request) {
+  if (ChunkBytes() == 0 || request->has_transport_options()) {
+    return false;
+  }
+  ChunkedRecvOptions options;
+  options.set_chunk_bytes(ChunkBytes());
+  request->mutable_transport_options()->PackFrom(options);
+  return true;
+}
+
+bool ChunkedTensorTable::MaybeEncodeTensorToByteBuffer(
+    const RecvTensorRequest& request, bool is_dead, const Tensor& val,
+    bool require_ack, ::grpc::ByteBuffer* result) {
+  ChunkedRecvOptions options;
+  if (is_dead || !request.transport_options().UnpackTo(&options) ||
+      options.chunk_bytes() <= 0 ||
+      options.chunk_bytes() > ChunkedRecvTensor::kMaxChunkBytes ||
+      !DataTypeCanUseMemcpy(val.dtype()) ||
+      val.TotalBytes() <= options.chunk_bytes()) {
+    return false;
+  }
+  const int64 now_micros = Env::Default()->NowMicros();
+  const int64 num_chunks =
+      (val.TotalBytes() + options.chunk_bytes() - 1) / options.chunk_bytes();
+  int64 stream_id;
+  {
+    mutex_lock l(mu_);
+    // Usually done by CleanEntriesForStep(), but not every caller cleans up
+    // its steps.
+    DropAbandonedLocked(now_micros);
+    do {
+      stream_id = random::New64() & kint64max;
+    } while (entries_.contains(stream_id));
+    Entry& entry = entries_[stream_id];
+    entry.tensor = val;
+    entry.chunk_bytes = options.chunk_bytes();
+    entry.request_id = request.request_id();
+    entry.step_id = request.step_id();
+    entry.fetched.resize(num_chunks, false);
+    entry.num_unfetched = num_chunks;
+    entry.last_access_micros = now_micros;
+  }
+
+  ChunkedTensorInfo info;
+  info.set_stream_id(stream_id);
+  info.set_chunk_bytes(options.chunk_bytes());
+  RecvTensorResponse response;
+  response.set_require_ack(require_ack);
+  response.set_send_start_micros(now_micros);
+  // The tensor proto has no content, so the receiver allocates a tensor of
+  // the right dtype and shape that the chunks are parsed into.
+  response.mutable_tensor()->set_dtype(val.dtype());
+  val.shape().AsProto(response.mutable_tensor()->mutable_tensor_shape());
+  response.mutable_transport_options()->PackFrom(info);
+  GrpcMaybeUnparseProto(response, result);
+  return true;
+}
+
+Status ChunkedTensorTable::EncodeChunk(const RecvTensorChunkRequest& request,
+                                       ::grpc::ByteBuffer* result) {
+  Tensor tensor;
+  StringPiece data;
+  {
+    mutex_lock l(mu_);
+    auto it = entries_.find(request.stream_id());
+    if (it == entries_.end()) {
+      return errors::NotFound("Chunked tensor ", request.stream_id(),
+                              " was fully fetched or abandoned");
+    }
+    Entry& entry = it->second;
+    const int64 total_bytes = entry.tensor.TotalBytes();
+    if (request.offset() < 0 || request.offset() >= total_bytes ||
+        request.offset() % entry.chunk_bytes != 0) {
+      return errors::InvalidArgument("Invalid offset ", request.offset(),
+                                     " for a chunked tensor of ", total_bytes,
+                                     " bytes in chunks of ", entry.chunk_bytes,
+                                     " bytes");
+    }
+    tensor = entry.tensor;
+    data = tensor.tensor_data().substr(request.offset(), entry.chunk_bytes);
+    const int64 index = request.offset() / entry.chunk_bytes;
+    if (!entry.fetched[index]) {
+      entry.fetched[index] = true;
+      --entry.num_unfetched;
+    }
+    // The entry stays until the receiver acknowledges it, in case this call
+    // is retried.
+    entry.last_access_micros = Env::Default()->NowMicros();
+  }
+
+  // Encode the tag and length of RecvTensorChunkResponse.tensor_content, and
+  // share the backing store of the tensor for the content itself.
+  char header[1 + core::kMaxVarint32Bytes];
+  io::ProtoEncodeHelper e(header, sizeof(header));
+  e.WriteVarlengthBeginning(RecvTensorChunkResponse::kTensorContentFieldNumber,
+                            data.size());
+  ::grpc::Slice slices[2];
+  slices[0] = ::grpc::Slice(e.data(), e.size());
+  const TensorBuffer* buf = DMAHelper::buffer(&tensor);
+  buf->Ref();
+  slices[1] = ::grpc::Slice(
+      const_cast<void*>(static_cast<const void*>(data.data())), data.size(),
+      [](void* backing) { static_cast<TensorBuffer*>(backing)->Unref(); },
+      const_cast<TensorBuffer*>(buf));
+  ::grpc::ByteBuffer tmp(&slices[0], 2);
+  result->Swap(&tmp);
+  return Status::OK();
+}
+
+void ChunkedTensorTable::MarkRecvFinished(int64 request_id) {
+  if (request_id == 0) return;
+  mutex_lock l(mu_);
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->second.request_id == request_id) {
+      entries_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ChunkedTensorTable::CleanEntriesForStep(int64 step_id) {
+  mutex_lock l(mu_);
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->second.step_id == step_id) {
+      entries_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  DropAbandonedLocked(Env::Default()->NowMicros());
+}
+
+int64 ChunkedTensorTable::size() {
+  mutex_lock l(mu_);
+  return entries_.size();
+}
+
+void ChunkedTensorTable::DropAbandonedLocked(int64 now_micros) {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (now_micros - it->second.last_access_micros > kAbandonedTensorMicros) {
+      if (it->second.num_unfetched > 0) {
+        LOG(WARNING) << "Dropping chunked tensor of "
+                     << it->second.tensor.TotalBytes()
+                     << " bytes that was never fully fetched";
+      }
+      entries_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+Status TensorChunkResponse::ParseFrom(TensorResponse::Source* source) {
+  protobuf::io::CodedInputStream input(source->contents());
+  const uint32 content_tag =
+      (RecvTensorChunkResponse::kTensorContentFieldNumber << 3) |
+      2;  // Length-delimited.
+  bool seen_content = false;
+  while (true) {
+    const uint32 tag = input.ReadTag();
+    if (tag == 0) {
+      break;
+    }
+    uint32 length;
+    if (tag != content_tag || !input.ReadVarint32(&length)) {
+      return errors::DataLoss("Cannot parse tensor chunk");
+    }
+    if (length != size_) {
+      return errors::Internal("Tensor chunk has ", length,
+                              " bytes, expected ", size_);
+    }
+    if (!input.ReadRaw(dst_, length)) {
+      return errors::DataLoss("Truncated tensor chunk");
+    }
+    seen_content = true;
+  }
+  if (!seen_content && size_ > 0) {
+    return errors::DataLoss("Tensor chunk has no content");
+  }
+  return Status::OK();
+}
+
+bool GrpcMaybeParseProto(::grpc::ByteBuffer* src, TensorChunkResponse* dst) {
+  GrpcByteSource byte_source(src);
+  Status s = dst->ParseFrom(&byte_source);
+  if (!s.ok()) {
+    VLOG(1) << "Cannot parse RecvTensorChunkResponse: " << s;
+  }
+  return s.ok();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,153 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_CHUNKED_RECV_TENSOR_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_CHUNKED_RECV_TENSOR_H_
+
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "grpcpp/support/byte_buffer.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+
+// Sends the content of large tensors in fixed-size chunks instead of a single
+// RecvTensorResponse.
+//
+// The receiver tags its RecvTensorRequest with a ChunkedRecvOptions. If the
+// tensor has more than one chunk of content, the sender keeps it in a
+// ChunkedTensorTable and replies with only the tensor metadata and a
+// ChunkedTensorInfo. The receiver then fetches the content with several
+// RecvTensorChunk calls in flight at once, and parses every chunk straight
+// into the tensor it allocated for the response. This keeps every message
+// well below the gRPC and protobuf size limits, and overlaps copying the
+// first chunks with transferring the following ones.
+//
+// Chunking is enabled by setting TF_GRPC_RECV_TENSOR_CHUNK_BYTES to the chunk
+// size in the environment of the receiver.
+// TF_GRPC_RECV_TENSOR_CHUNKS_IN_FLIGHT sets how many RecvTensorChunk calls
+// the receiver keeps in flight for each tensor (4 by default).
+class ChunkedRecvTensor {
+ public:
+  // Chunks are encoded as protobuf bytes fields, whose size must fit in an
+  // int.
+  static constexpr int64 kMaxChunkBytes = 1LL << 30;
+
+  // Returns the size of the chunks to request, or 0 if chunking is disabled.
+  static int64 ChunkBytes();
+
+  // Returns the number of RecvTensorChunk calls to keep in flight for each
+  // tensor.
+  static int64 ChunksInFlight();
+
+  // Receiver side: adds ChunkedRecvOptions to `request` if chunking is
+  // enabled and the request has no other transport options. Returns true if
+  // it did.
+  static bool MaybeAddRecvOptions(RecvTensorRequest* request);
+};
+
+// Sender side: the tensors whose content receivers are fetching in chunks.
+//
+// A tensor is kept after all of its chunks were fetched, so that a retried
+// call for one of them still succeeds, until the receiver acknowledges it with
+// MarkRecvFinished, or until its step is cleaned up.
+class ChunkedTensorTable {
+ public:
+  // Tensors that nobody asks for a chunk of within this long, e.g. because the
+  // receiver was cancelled or never acknowledged them, are dropped.
+  static constexpr int64 kAbandonedTensorMicros = 60 * 1000 * 1000;
+
+  ChunkedTensorTable() = default;
+
+  // If `request` asks for chunks and `val` has more than one chunk of
+  // content, keeps `val` until the receiver is done with it, encodes a
+  // RecvTensorResponse with the tensor metadata and a ChunkedTensorInfo into
+  // `*result` and returns true. Otherwise returns false, and the tensor
+  // should be sent in a single response.
+  bool MaybeEncodeTensorToByteBuffer(const RecvTensorRequest& request,
+                                     bool is_dead, const Tensor& val,
+                                     bool require_ack,
+                                     ::grpc::ByteBuffer* result);
+
+  // Encodes the RecvTensorChunkResponse for `request` into `*result`, sharing
+  // the backing store of the tensor.
+  Status EncodeChunk(const RecvTensorChunkRequest& request,
+                     ::grpc::ByteBuffer* result);
+
+  // Drops the tensor requested by the RecvTensorRequest with `request_id`,
+  // whose receiver fetched all of its chunks.
+  void MarkRecvFinished(int64 request_id);
+
+  // Drops the tensors of `step_id`, and the tensors that were abandoned.
+  void CleanEntriesForStep(int64 step_id);
+
+  // Returns the number of tensors that are kept for receivers.
+  int64 size();
+
+ private:
+  struct Entry {
+    Tensor tensor;
+    int64 chunk_bytes;
+    // The RecvTensorRequest that the tensor was sent for.
+    int64 request_id;
+    int64 step_id;
+    // Which chunks were fetched, so that retried calls are not counted twice.
+    std::vector<bool> fetched;
+    int64 num_unfetched;
+    int64 last_access_micros;
+  };
+
+  void DropAbandonedLocked(int64 now_micros) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  mutex mu_;
+  // Keyed by stream id. There are few entries at a time, as receivers fetch
+  // chunks right after they got the response.
+  absl::flat_hash_map<int64, Entry> entries_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ChunkedTensorTable);
+};
+
+// Receiver side: the response of a RecvTensorChunk call, parsed straight into
+// the content of the destination tensor.
+class TensorChunkResponse {
+ public:
+  // `dst` must have room for `size` bytes, the expected size of the chunk.
+  TensorChunkResponse(char* dst, int64 size) : dst_(dst), size_(size) {}
+
+  // Parses the RecvTensorChunkResponse encoded in `source`.
+  Status ParseFrom(TensorResponse::Source* source);
+
+ private:
+  char* const dst_;
+  const int64 size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(TensorChunkResponse);
+};
+
+// Specialization of GrpcMaybeParseProto for TensorChunkResponse, for use with
+// RPCState.
+bool GrpcMaybeParseProto(::grpc::ByteBuffer* src, TensorChunkResponse* dst);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_CHUNKED_RECV_TENSOR_H_
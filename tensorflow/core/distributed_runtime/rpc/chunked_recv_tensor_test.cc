@@ -0,0 +1,250 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/chunked_recv_tensor.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "tensorflow/core/distributed_runtime/rpc/grpc_testlib.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+RecvTensorRequest ChunkedRequest(int64 chunk_bytes, int64 request_id = 1,
+                                 int64 step_id = 1) {
+  RecvTensorRequest request;
+  request.set_request_id(request_id);
+  request.set_step_id(step_id);
+  ChunkedRecvOptions options;
+  options.set_chunk_bytes(chunk_bytes);
+  request.mutable_transport_options()->PackFrom(options);
+  return request;
+}
+
+Tensor FloatTensor(int64 num_elements) {
+  Tensor tensor(DT_FLOAT, TensorShape({num_elements}));
+  test::FillFn<float>(&tensor, [](int i) { return i * 0.25f; });
+  return tensor;
+}
+
+// Fetches the chunk of `stream_id` at `offset` from `table` into `dst`.
+Status FetchChunk(ChunkedTensorTable* table, int64 stream_id, int64 offset,
+                  char* dst, int64 size) {
+  RecvTensorChunkRequest request;
+  request.set_stream_id(stream_id);
+  request.set_offset(offset);
+  ::grpc::ByteBuffer buffer;
+  TF_RETURN_IF_ERROR(table->EncodeChunk(request, &buffer));
+  TensorChunkResponse response(dst, size);
+  GrpcByteSource source(&buffer);
+  return response.ParseFrom(&source);
+}
+
+TEST(ChunkedTensorTableTest, SendsLargeTensorsInChunks) {
+  ChunkedTensorTable table;
+  const int64 chunk_bytes = 4096;
+  // 9 full chunks and a partial one.
+  Tensor val = FloatTensor(10000);
+
+  ::grpc::ByteBuffer buffer;
+  ASSERT_TRUE(table.MaybeEncodeTensorToByteBuffer(
+      ChunkedRequest(chunk_bytes), /*is_dead=*/false, val,
+      /*require_ack=*/true, &buffer));
+  EXPECT_EQ(1, table.size());
+
+  RecvTensorResponse response;
+  ASSERT_TRUE(GrpcMaybeParseProto(&buffer, &response));
+  EXPECT_TRUE(response.require_ack());
+  EXPECT_EQ(DT_FLOAT, response.tensor().dtype());
+  EXPECT_EQ(val.shape(), TensorShape(response.tensor().tensor_shape()));
+  EXPECT_TRUE(response.tensor().tensor_content().empty());
+  ChunkedTensorInfo info;
+  ASSERT_TRUE(response.transport_options().UnpackTo(&info));
+  EXPECT_EQ(chunk_bytes, info.chunk_bytes());
+
+  Tensor received(DT_FLOAT, val.shape());
+  char* base = const_cast<char*>(received.tensor_data().data());
+  const int64 total_bytes = val.TotalBytes();
+  // Fetch the chunks out of order.
+  for (int64 offset = total_bytes / chunk_bytes * chunk_bytes; offset >= 0;
+       offset -= chunk_bytes) {
+    TF_ASSERT_OK(FetchChunk(&table, info.stream_id(), offset, base + offset,
+                            std::min(chunk_bytes, total_bytes - offset)));
+  }
+  test::ExpectTensorEqual<float>(received, val);
+
+  // The tensor is kept until the receiver acknowledges it.
+  EXPECT_EQ(1, table.size());
+  table.MarkRecvFinished(/*request_id=*/2);
+  EXPECT_EQ(1, table.size());
+  table.MarkRecvFinished(/*request_id=*/1);
+  EXPECT_EQ(0, table.size());
+  EXPECT_TRUE(errors::IsNotFound(
+      FetchChunk(&table, info.stream_id(), 0, base, chunk_bytes)));
+}
+
+TEST(ChunkedTensorTableTest, SendsSmallTensorsWhole) {
+  ChunkedTensorTable table;
+  ::grpc::ByteBuffer buffer;
+  // No more than one chunk.
+  EXPECT_FALSE(table.MaybeEncodeTensorToByteBuffer(
+      ChunkedRequest(4096), /*is_dead=*/false, FloatTensor(1024),
+      /*require_ack=*/false, &buffer));
+  // Not requested.
+  EXPECT_FALSE(table.MaybeEncodeTensorToByteBuffer(
+      RecvTensorRequest(), /*is_dead=*/false, FloatTensor(10000),
+      /*require_ack=*/false, &buffer));
+  // Dead.
+  EXPECT_FALSE(table.MaybeEncodeTensorToByteBuffer(
+      ChunkedRequest(4096), /*is_dead=*/true, FloatTensor(10000),
+      /*require_ack=*/false, &buffer));
+  // Not memcpy-able.
+  Tensor strings(DT_STRING, TensorShape({10000}));
+  EXPECT_FALSE(table.MaybeEncodeTensorToByteBuffer(
+      ChunkedRequest(4096), /*is_dead=*/false, strings,
+      /*require_ack=*/false, &buffer));
+  EXPECT_EQ(0, table.size());
+}
+
+TEST(ChunkedTensorTableTest, RetriedChunks) {
+  ChunkedTensorTable table;
+  const int64 chunk_bytes = 4096;
+  Tensor val = FloatTensor(2048);
+
+  ::grpc::ByteBuffer buffer;
+  ASSERT_TRUE(table.MaybeEncodeTensorToByteBuffer(
+      ChunkedRequest(chunk_bytes), /*is_dead=*/false, val,
+      /*require_ack=*/false, &buffer));
+  RecvTensorResponse response;
+  ASSERT_TRUE(GrpcMaybeParseProto(&buffer, &response));
+  ChunkedTensorInfo info;
+  ASSERT_TRUE(response.transport_options().UnpackTo(&info));
+
+  Tensor received(DT_FLOAT, val.shape());
+  char* base = const_cast<char*>(received.tensor_data().data());
+  TF_ASSERT_OK(FetchChunk(&table, info.stream_id(), 0, base, chunk_bytes));
+  TF_ASSERT_OK(FetchChunk(&table, info.stream_id(), 0, base, chunk_bytes));
+  EXPECT_EQ(1, table.size());
+  TF_ASSERT_OK(FetchChunk(&table, info.stream_id(), chunk_bytes,
+                          base + chunk_bytes, chunk_bytes));
+  // The last chunk can be retried as well.
+  TF_ASSERT_OK(FetchChunk(&table, info.stream_id(), chunk_bytes,
+                          base + chunk_bytes, chunk_bytes));
+  EXPECT_EQ(1, table.size());
+  test::ExpectTensorEqual<float>(received, val);
+}
+
+TEST(ChunkedTensorTableTest, CleanEntriesForStep) {
+  ChunkedTensorTable table;
+  ::grpc::ByteBuffer buffer;
+  for (int64 step_id : {1, 1, 2}) {
+    ASSERT_TRUE(table.MaybeEncodeTensorToByteBuffer(
+        ChunkedRequest(4096, /*request_id=*/table.size() + 1, step_id),
+        /*is_dead=*/false, FloatTensor(10000), /*require_ack=*/false,
+        &buffer));
+  }
+  EXPECT_EQ(3, table.size());
+  // Whether or not their chunks were fetched.
+  table.CleanEntriesForStep(1);
+  EXPECT_EQ(1, table.size());
+  table.CleanEntriesForStep(3);
+  EXPECT_EQ(1, table.size());
+  table.CleanEntriesForStep(2);
+  EXPECT_EQ(0, table.size());
+}
+
+TEST(ChunkedTensorTableTest, InvalidChunks) {
+  ChunkedTensorTable table;
+  const int64 chunk_bytes = 4096;
+  Tensor val = FloatTensor(10000);
+
+  ::grpc::ByteBuffer buffer;
+  ASSERT_TRUE(table.MaybeEncodeTensorToByteBuffer(
+      ChunkedRequest(chunk_bytes), /*is_dead=*/false, val,
+      /*require_ack=*/false, &buffer));
+  RecvTensorResponse response;
+  ASSERT_TRUE(GrpcMaybeParseProto(&buffer, &response));
+  ChunkedTensorInfo info;
+  ASSERT_TRUE(response.transport_options().UnpackTo(&info));
+
+  std::vector<char> dst(chunk_bytes);
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      FetchChunk(&table, info.stream_id(), 100, dst.data(), chunk_bytes)));
+  EXPECT_TRUE(errors::IsInvalidArgument(FetchChunk(
+      &table, info.stream_id(), 10 * chunk_bytes, dst.data(), chunk_bytes)));
+  EXPECT_TRUE(errors::IsNotFound(
+      FetchChunk(&table, info.stream_id() + 1, 0, dst.data(), chunk_bytes)));
+  // The receiver expects a chunk of a different size.
+  EXPECT_FALSE(
+      FetchChunk(&table, info.stream_id(), 0, dst.data(), chunk_bytes - 1)
+          .ok());
+}
+
+TEST(ChunkedRecvTensorTest, RecvTensorBetweenWorkers) {
+  // The workers inherit the environment of the test.
+  setenv("TF_GRPC_RECV_TENSOR_CHUNK_BYTES", "65536", /*overwrite=*/1);
+  setenv("TF_GRPC_RECV_TENSOR_CHUNKS_IN_FLIGHT", "3", /*overwrite=*/1);
+
+  Graph graph(OpRegistry::Global());
+  // Large enough to be sent in chunks, with a partial last chunk.
+  Tensor large = FloatTensor(1000 * 1000 + 7);
+  Node* a = test::graph::Constant(&graph, large);
+  a->set_requested_device("/job:localhost/replica:0/task:0/cpu:0");
+  // Small enough to be sent whole.
+  Tensor small = FloatTensor(4);
+  Node* b = test::graph::Constant(&graph, small);
+  b->set_requested_device("/job:localhost/replica:0/task:0/cpu:0");
+  Node* c = test::graph::Identity(&graph, a);
+  c->set_requested_device("/job:localhost/replica:0/task:1/cpu:0");
+  Node* d = test::graph::Identity(&graph, b);
+  d->set_requested_device("/job:localhost/replica:0/task:1/cpu:0");
+  GraphDef graph_def;
+  test::graph::ToGraphDef(&graph, &graph_def);
+
+  SessionOptions devices;
+  (*devices.config.mutable_device_count())["CPU"] = 1;
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_ASSERT_OK(test::TestCluster::MakeTestCluster(devices, 2, &cluster));
+
+  SessionOptions options;
+  options.target = strings::StrCat("grpc://", cluster->targets()[0]);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(graph_def));
+  for (int i = 0; i < 5; ++i) {
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({}, {c->name() + ":0", d->name() + ":0"}, {},
+                              &outputs));
+    ASSERT_EQ(2, outputs.size());
+    test::ExpectTensorEqual<float>(outputs[0], large);
+    test::ExpectTensorEqual<float>(outputs[1], small);
+  }
+  TF_ASSERT_OK(session->Close());
+}
+
+}  // namespace
+}  // namespace tensorflow
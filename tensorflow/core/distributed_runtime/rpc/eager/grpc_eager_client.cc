@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "grpcpp/generic/generic_stub.h"
 #include "tensorflow/core/distributed_runtime/call_options.h"
+#include "tensorflow/core/distributed_runtime/eager/batching_eager_client.h"
 #include "tensorflow/core/distributed_runtime/rpc/eager/grpc_eager_service.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_client_cq_tag.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_state.h"
@@ -233,7 +234,10 @@ class GrpcEagerClientCache : public EagerClientCache {
  public:
   explicit GrpcEagerClientCache(
       std::shared_ptr<tensorflow::GrpcChannelCache> cache)
-      : next_round_robin_assignment_(0), cache_(cache), threads_(4) {
+      : next_round_robin_assignment_(0),
+        cache_(cache),
+        threads_(4),
+        batching_options_(BatchingEagerClient::OptionsFromEnv()) {
     for (int i = 0, end = threads_.size(); i < end; i++) {
       threads_[i].reset(new GrpcEagerClientThread());
     }
@@ -256,6 +260,11 @@ class GrpcEagerClientCache : public EagerClientCache {
       GrpcEagerClientThread* thread = threads_[assigned_index].get();
       core::RefCountPtr<EagerClient> worker(
           new GrpcEagerClient(shared, thread, target));
+      // Batching only pays off when requests are streamed without waiting for
+      // the previous response.
+      if (batching_options_.max_batch_size > 1 && EnableStreaming()) {
+        worker.reset(new BatchingEagerClient(worker.get(), batching_options_));
+      }
       it = clients_.emplace(target, std::move(worker)).first;
     }
 
@@ -289,6 +298,7 @@ class GrpcEagerClientCache : public EagerClientCache {
   std::unordered_map<string, core::RefCountPtr<EagerClient>> clients_
       TF_GUARDED_BY(clients_mu_);
   std::vector<core::RefCountPtr<GrpcEagerClientThread>> threads_;
+  const BatchingEagerClient::Options batching_options_;
 };
 
 }  // namespace
@@ -15,16 +15,21 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_remote_worker.h"
 
+#include <algorithm>
+#include <memory>
 #include <utility>
 
 #include "grpcpp/generic/generic_stub.h"
 #include "grpcpp/grpcpp.h"
 #include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/distributed_runtime/call_options.h"
+#include "tensorflow/core/distributed_runtime/rpc/chunked_recv_tensor.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_client_cq_tag.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_state.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service_impl.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_transport.h"
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
 #include "tensorflow/core/distributed_runtime/worker_cache_logger.h"
 #include "tensorflow/core/distributed_runtime/worker_interface.h"
@@ -33,6 +38,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/protobuf/transport_options.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
@@ -66,6 +72,7 @@ class GrpcRemoteWorker : public WorkerInterface {
         instancesource_(Method(GrpcWorkerMethod::kCompleteInstance)),
         getstepsequence_(Method(GrpcWorkerMethod::kGetStepSequence)),
         markrecvfinished_(Method(GrpcWorkerMethod::kMarkRecvFinished)),
+        recvtensorchunk_(Method(GrpcWorkerMethod::kRecvTensorChunk)),
         logger_(logger),
         target_(target) {}
 
@@ -202,8 +209,22 @@ class GrpcRemoteWorker : public WorkerInterface {
     // Type-specialized logging for this method.
     bool logging_active = logger_->LoggingActive() || VLOG_IS_ON(2);
 
-    auto callback = [this, request, response, done, start_usec,
-                     logging_active](Status s) {
+    // Offer to receive the tensor content through shared memory, in case the
+    // remote worker runs on the same host, or else in chunks.
+    std::shared_ptr<RecvTensorRequest> transport_request;
+    if ((SharedMemoryTransport::Enabled() || ChunkedRecvTensor::ChunkBytes()) &&
+        response->on_host()) {
+      transport_request = std::make_shared<RecvTensorRequest>(*request);
+      if (SharedMemoryTransport::MaybeAddRecvOptions(transport_request.get()) ||
+          ChunkedRecvTensor::MaybeAddRecvOptions(transport_request.get())) {
+        request = transport_request.get();
+      } else {
+        transport_request.reset();
+      }
+    }
+
+    auto finish = [this, request, response, done, start_usec, logging_active,
+                   transport_request](Status s) {
       if (logging_active) {
         if (logger_->LoggingActive()) {
           int64_t end_usec = Env::Default()->NowMicros();
@@ -246,13 +267,31 @@ class GrpcRemoteWorker : public WorkerInterface {
       }
 
       // Note done() can delete this worker object, so we need to call done()
-      // last.
-      if (response->metadata().require_ack()) {
+      // last. A tensor sent in chunks is also kept by the sender until it is
+      // acknowledged.
+      if (response->metadata().require_ack() ||
+          (request->request_id() != 0 &&
+           response->metadata().transport_options().Is<ChunkedTensorInfo>())) {
         IssueMarkRecvFinishedRequest(request->request_id());
       }
       done(s);
     };
 
+    auto callback = [this, response, finish,
+                     transport_request](const Status& s) {
+      if (!s.ok() || transport_request == nullptr) {
+        finish(s);
+        return;
+      }
+      ChunkedTensorInfo chunked_info;
+      if (response->metadata().transport_options().UnpackTo(&chunked_info)) {
+        RecvTensorChunks(chunked_info, response->mutable_tensor(), finish);
+        return;
+      }
+      finish(SharedMemoryTransport::MaybeReadTensorContent(
+          response->metadata(), response->mutable_tensor()));
+    };
+
     IssueRequest(request, response, recvtensor_, callback, call_opts);
   }
 
@@ -287,6 +326,92 @@ class GrpcRemoteWorker : public WorkerInterface {
                                  /*fail_fast=*/true, &target_);
   }
 
+  void IssueRequest(const protobuf::Message* request,
+                    TensorChunkResponse* response, const ::grpc::string& method,
+                    StatusCallback done) {
+    new RPCState<TensorChunkResponse>(&stub_, cq_, method, *request, response,
+                                      std::move(done), /*call_opts=*/nullptr,
+                                      callback_threadpool_, MaxRetries(),
+                                      /*fail_fast=*/true, &target_);
+  }
+
+  // The state of fetching the content of a tensor in chunks.
+  struct ChunkedRecvState {
+    int64_t stream_id;
+    int64_t chunk_bytes;
+    Tensor* tensor;
+    StatusCallback done;
+
+    mutex mu;
+    int64_t next_offset TF_GUARDED_BY(mu) = 0;
+    int64_t num_in_flight TF_GUARDED_BY(mu) = 0;
+    Status status TF_GUARDED_BY(mu);
+  };
+
+  // Fetches the content of `tensor` with RecvTensorChunk calls, keeping up to
+  // ChunkedRecvTensor::ChunksInFlight() of them in flight. The calls are not
+  // cancellable, but they do not block on the remote worker either.
+  void RecvTensorChunks(const ChunkedTensorInfo& info, Tensor* tensor,
+                        StatusCallback done) {
+    if (info.chunk_bytes() <= 0) {
+      done(errors::Internal("Invalid chunk size ", info.chunk_bytes()));
+      return;
+    }
+    auto state = std::make_shared<ChunkedRecvState>();
+    state->stream_id = info.stream_id();
+    state->chunk_bytes = info.chunk_bytes();
+    state->tensor = tensor;
+    state->done = std::move(done);
+    for (int64_t i = 0; i < ChunkedRecvTensor::ChunksInFlight(); ++i) {
+      if (!IssueNextRecvTensorChunk(state)) {
+        break;
+      }
+    }
+  }
+
+  // Issues the RecvTensorChunk call for the next chunk of `state`, if any.
+  // Returns false if there was none left to fetch.
+  bool IssueNextRecvTensorChunk(std::shared_ptr<ChunkedRecvState> state) {
+    const int64_t total_bytes = state->tensor->TotalBytes();
+    RecvTensorChunkRequest request;
+    {
+      mutex_lock l(state->mu);
+      if (!state->status.ok() || state->next_offset >= total_bytes) {
+        return false;
+      }
+      request.set_offset(state->next_offset);
+      state->next_offset += state->chunk_bytes;
+      ++state->num_in_flight;
+    }
+    request.set_stream_id(state->stream_id);
+    char* base = static_cast<char*>(DMAHelper::base(state->tensor));
+    TensorChunkResponse* response = new TensorChunkResponse(
+        base + request.offset(),
+        std::min(state->chunk_bytes, total_bytes - request.offset()));
+    IssueRequest(&request, response, recvtensorchunk_,
+                 [this, state, response](const Status& s) {
+                   delete response;
+                   bool finished;
+                   Status status;
+                   {
+                     mutex_lock l(state->mu);
+                     state->status.Update(s);
+                     --state->num_in_flight;
+                     finished = state->num_in_flight == 0 &&
+                                (!state->status.ok() ||
+                                 state->next_offset >=
+                                     state->tensor->TotalBytes());
+                     status = state->status;
+                   }
+                   if (finished) {
+                     state->done(status);
+                   } else {
+                     IssueNextRecvTensorChunk(state);
+                   }
+                 });
+    return true;
+  }
+
   void IssueMarkRecvFinishedRequest(int64_t request_id) {
     VLOG(2) << "Send MarkRecvFinishedRequest for request " << request_id;
     MarkRecvFinishedRequest request;
@@ -329,6 +454,7 @@ class GrpcRemoteWorker : public WorkerInterface {
   const ::grpc::string instancesource_;
   const ::grpc::string getstepsequence_;
   const ::grpc::string markrecvfinished_;
+  const ::grpc::string recvtensorchunk_;
 
   // Support for logging.
   WorkerCacheLogger* logger_;
@@ -15,14 +15,34 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include "grpcpp/support/byte_buffer.h"
 #include "grpcpp/support/slice.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
+#include "tensorflow/core/distributed_runtime/server_lib.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/framework/device_attributes.pb.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+#include "tensorflow/core/protobuf/tensorflow_server.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
+#include "tensorflow/core/public/session.h"
 
 namespace tensorflow {
 
@@ -100,4 +120,229 @@ TEST_F(GrpcTensorCodingTest, Simple) {
 
 TEST_F(GrpcTensorCodingTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+class DummyDevice : public DeviceBase {
+ public:
+  explicit DummyDevice(Env* env) : DeviceBase(env) {
+    attr_.set_device_type("CPU");
+  }
+
+  const DeviceAttributes& attributes() const override { return attr_; }
+
+  Allocator* GetAllocator(AllocatorAttributes attr) override {
+    return cpu_allocator();
+  }
+
+ private:
+  DeviceAttributes attr_;
+};
+
+// Reads the same bytes as GrpcByteSource, but never shares them, so that
+// TensorResponse copies the tensor content.
+class CopyingByteSource : public TensorResponse::Source {
+ public:
+  explicit CopyingByteSource(::grpc::ByteBuffer* buffer) : source_(buffer) {}
+
+  protobuf::io::ZeroCopyInputStream* contents() override {
+    return source_.contents();
+  }
+
+ private:
+  GrpcByteSource source_;
+};
+
+Tensor MakeFloatTensor(int64_t num_elems) {
+  Tensor t(DT_FLOAT, TensorShape({num_elems}));
+  auto flat = t.flat<float>();
+  for (int64_t i = 0; i < num_elems; ++i) {
+    flat(i) = static_cast<float>(i);
+  }
+  return t;
+}
+
+TEST(GrpcTensorDecodingTest, SharesLargeTensorSlices) {
+  DummyDevice cpu_device(Env::Default());
+  for (int64_t num_elems : {10, 1000, 10000, 1 << 20}) {
+    Tensor src = MakeFloatTensor(num_elems);
+    ::grpc::ByteBuffer buf;
+    grpc::EncodeTensorToByteBuffer(/*is_dead=*/false, src, false, &buf);
+
+    TensorResponse response;
+    response.InitAlloc(&cpu_device, AllocatorAttributes());
+    GrpcByteSource source(&buf);
+    TF_ASSERT_OK(response.ParseFrom(&source));
+    test::ExpectTensorEqual<float>(src, response.tensor());
+
+    // The encoder puts the content of tensors over 1KB in its own slice that
+    // points at the source tensor. Tensors of at least 4KB decode from that
+    // slice without a copy.
+    const bool shared = src.TotalBytes() >= 4096;
+    EXPECT_EQ(shared, src.tensor_data().data() ==
+                          response.tensor().tensor_data().data())
+        << num_elems;
+  }
+}
+
+TEST(GrpcTensorDecodingTest, SharedTensorOutlivesByteBuffer) {
+  DummyDevice cpu_device(Env::Default());
+  Tensor result;
+  {
+    Tensor src = MakeFloatTensor(10000);
+    ::grpc::ByteBuffer buf;
+    grpc::EncodeTensorToByteBuffer(/*is_dead=*/false, src, false, &buf);
+    TensorResponse response;
+    response.InitAlloc(&cpu_device, AllocatorAttributes());
+    GrpcByteSource source(&buf);
+    TF_ASSERT_OK(response.ParseFrom(&source));
+    result = response.tensor();
+  }
+  test::ExpectTensorEqual<float>(MakeFloatTensor(10000), result);
+}
+
+TEST(GrpcTensorDecodingTest, DoesNotShareDmaMemory) {
+  DummyDevice cpu_device(Env::Default());
+  Tensor src = MakeFloatTensor(10000);
+  ::grpc::ByteBuffer buf;
+  grpc::EncodeTensorToByteBuffer(/*is_dead=*/false, src, false, &buf);
+
+  AllocatorAttributes attr;
+  attr.set_gpu_compatible(true);
+  TensorResponse response;
+  response.InitAlloc(&cpu_device, attr);
+  GrpcByteSource source(&buf);
+  TF_ASSERT_OK(response.ParseFrom(&source));
+  test::ExpectTensorEqual<float>(src, response.tensor());
+  EXPECT_NE(src.tensor_data().data(), response.tensor().tensor_data().data());
+}
+
+// Decodes buffers built in this process, whose content slice is the source
+// tensor itself, so BM_DecodeTensorShared is an upper bound on what sharing
+// saves. See BM_RecvTensorBetweenWorkers for a real channel.
+template <typename Source>
+void BM_DecodeTensor(::testing::benchmark::State& state) {
+  const int64_t num_elems = state.range(0);
+  Tensor src = MakeFloatTensor(num_elems);
+  ::grpc::ByteBuffer buf;
+  grpc::EncodeTensorToByteBuffer(/*is_dead=*/false, src, false, &buf);
+  DummyDevice cpu_device(Env::Default());
+  for (auto s : state) {
+    TensorResponse response;
+    response.InitAlloc(&cpu_device, AllocatorAttributes());
+    Source source(&buf);
+    TF_CHECK_OK(response.ParseFrom(&source));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          src.TotalBytes());
+}
+
+void BM_DecodeTensorShared(::testing::benchmark::State& state) {
+  BM_DecodeTensor<GrpcByteSource>(state);
+}
+BENCHMARK(BM_DecodeTensorShared)->Arg(1000)->Arg(10000)->Arg(1 << 20);
+
+void BM_DecodeTensorCopied(::testing::benchmark::State& state) {
+  BM_DecodeTensor<CopyingByteSource>(state);
+}
+BENCHMARK(BM_DecodeTensorCopied)->Arg(1000)->Arg(10000)->Arg(1 << 20);
+
+// Returns the target of two in-process servers, whose workers exchange
+// tensors over a real gRPC channel. The servers are started on first use and
+// never stopped, since they cannot be.
+const string& TwoTaskTarget() {
+  static const string* target = [] {
+    ServerDef server_def;
+    server_def.set_protocol("grpc");
+    server_def.set_job_name("localhost");
+    auto* job_def = server_def.mutable_cluster()->add_job();
+    job_def->set_name("localhost");
+    for (int i = 0; i < 2; ++i) {
+      (*job_def->mutable_tasks())[i] =
+          strings::StrCat("localhost:", testing::PickUnusedPortOrDie());
+    }
+    (*server_def.mutable_default_session_config()->mutable_device_count())
+        ["CPU"] = 1;
+    string* target = nullptr;
+    for (int i = 0; i < 2; ++i) {
+      server_def.set_task_index(i);
+      std::unique_ptr<ServerInterface> server;
+      TF_CHECK_OK(NewServer(server_def, &server));
+      TF_CHECK_OK(server->Start());
+      if (i == 0) target = new string(server->target());
+      server.release();
+    }
+    return target;
+  }();
+  return *target;
+}
+
+// Creates a session in which task 1 receives `t` from task 0, and returns the
+// name of the tensor to fetch in `*fetch`.
+std::unique_ptr<Session> NewRecvTensorSession(const Tensor& t, string* fetch) {
+  Graph graph(OpRegistry::Global());
+  Node* a = test::graph::Constant(&graph, t);
+  a->set_requested_device("/job:localhost/replica:0/task:0/cpu:0");
+  Node* b = test::graph::Identity(&graph, a);
+  b->set_requested_device("/job:localhost/replica:0/task:1/cpu:0");
+  *fetch = strings::StrCat(b->name(), ":0");
+  GraphDef graph_def;
+  test::graph::ToGraphDef(&graph, &graph_def);
+
+  SessionOptions options;
+  options.target = TwoTaskTarget();
+  // Keep the constant from being folded into task 1.
+  options.config.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_opt_level(OptimizerOptions::L0);
+  options.config.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_constant_folding(RewriterConfig::OFF);
+  std::unique_ptr<Session> session(NewSession(options));
+  CHECK(session != nullptr);
+  TF_CHECK_OK(session->Create(graph_def));
+  return session;
+}
+
+TEST(GrpcTensorDecodingTest, RecvTensorBetweenWorkers) {
+  for (int64_t num_elems : {10, 1000, 10000, 1 << 20}) {
+    Tensor src = MakeFloatTensor(num_elems);
+    string fetch;
+    std::unique_ptr<Session> session = NewRecvTensorSession(src, &fetch);
+    const int kNumRuns = 10;
+    const int64 num_shared = GrpcByteSource::NumSharedContents();
+    for (int i = 0; i < kNumRuns; ++i) {
+      std::vector<Tensor> outputs;
+      TF_ASSERT_OK(session->Run({}, {fetch}, {}, &outputs));
+      ASSERT_EQ(1, outputs.size());
+      test::ExpectTensorEqual<float>(src, outputs[0]);
+    }
+    const int64 shared = GrpcByteSource::NumSharedContents() - num_shared;
+    // Whether larger tensors land aligned within one transport read slice
+    // depends on how gRPC splits the stream, so only report it.
+    LOG(INFO) << num_elems << " floats: shared " << shared << " of "
+              << kNumRuns << " received tensors";
+    if (src.TotalBytes() < 4096) EXPECT_EQ(0, shared) << num_elems;
+    TF_ASSERT_OK(session->Close());
+  }
+}
+
+// Reports the fraction of received tensors whose content was shared with the
+// transport read slices as "shared_fraction".
+void BM_RecvTensorBetweenWorkers(::testing::benchmark::State& state) {
+  const int64_t num_elems = state.range(0);
+  Tensor src = MakeFloatTensor(num_elems);
+  string fetch;
+  std::unique_ptr<Session> session = NewRecvTensorSession(src, &fetch);
+  const int64 num_shared = GrpcByteSource::NumSharedContents();
+  for (auto s : state) {
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run({}, {fetch}, {}, &outputs));
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          src.TotalBytes());
+  state.counters["shared_fraction"] =
+      static_cast<double>(GrpcByteSource::NumSharedContents() - num_shared) /
+      std::max<int64_t>(state.iterations(), 1);
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_RecvTensorBetweenWorkers)->Arg(1000)->Arg(10000)->Arg(1 << 20);
+
 }  // namespace tensorflow
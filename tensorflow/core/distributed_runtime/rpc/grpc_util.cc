@@ -14,7 +14,13 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
+
+#include <atomic>
+#include <vector>
+
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
+#include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/random/random.h"
 
 namespace tensorflow {
@@ -31,8 +37,53 @@ double GenerateUniformRandomNumberBetween(double a, double b) {
   return a + GenerateUniformRandomNumber() * (b - a);
 }
 
+// A TensorBuffer over part of a received grpc::Slice, which it keeps alive.
+class GrpcSliceBuffer : public TensorBuffer {
+ public:
+  GrpcSliceBuffer(::grpc::Slice slice, const char* data, size_t size)
+      : TensorBuffer(const_cast<char*>(data)),
+        slice_(std::move(slice)),
+        size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocated_bytes(slice_.size());
+    proto->set_allocator_name("grpc_slice");
+  }
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const ::grpc::Slice slice_;
+  const size_t size_;
+};
+
+// Number of tensor contents that this process shared with a received buffer.
+std::atomic<int64> num_shared_contents{0};
+
 }  // namespace
 
+TensorBuffer* GrpcByteSource::ShareContents(const char* data, size_t size) {
+  // Compressed buffers are decompressed into memory owned by the reader, in
+  // which case `data` is not found in any of the slices below.
+  std::vector<::grpc::Slice> slices;
+  if (!buffer_->Dump(&slices).ok()) return nullptr;
+  for (::grpc::Slice& slice : slices) {
+    const char* begin = reinterpret_cast<const char*>(slice.begin());
+    if (data >= begin && data + size <= begin + slice.size()) {
+      if (size < slice.size() / 2) return nullptr;
+      num_shared_contents.fetch_add(1, std::memory_order_relaxed);
+      return new GrpcSliceBuffer(std::move(slice), data, size);
+    }
+  }
+  return nullptr;
+}
+
+/*static*/ int64 GrpcByteSource::NumSharedContents() {
+  return num_shared_contents.load(std::memory_order_relaxed);
+}
+
 int64_t ComputeBackoffMicroseconds(int current_retry_attempt, int64_t min_delay,
                                    int64_t max_delay) {
   DCHECK_GE(current_retry_attempt, 0);
@@ -57,6 +57,19 @@ class GrpcByteSource : public TensorResponse::Source {
     return stream_;
   }
 
+  // Shares `data` if it lies within one slice of the buffer that the tensor
+  // content makes up at least half of, so that small tensors do not pin large
+  // slices.
+  //
+  // This pays off for buffers built in this process, whose content slice is
+  // the sender's own tensor. Buffers received over a channel are split into
+  // transport read slices, in which the content neither starts aligned nor
+  // fits into one slice once it is large, so they are mostly copied.
+  TensorBuffer* ShareContents(const char* data, size_t size) override;
+
+  // Returns the number of times ShareContents() shared memory in this process.
+  static int64 NumSharedContents();
+
  private:
   void DeleteStream() {
     if (stream_) {
@@ -39,6 +39,7 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service_impl.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_transport.h"
 #include "tensorflow/core/distributed_runtime/worker.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/distributed_runtime/worker_session.h"
@@ -158,6 +159,13 @@ class GrpcWorkerServiceThread {
          ++i) {
       EnqueueRecvTensorRequestRaw();
     }
+    for (int i = 0;
+         i < gtl::FindWithDefault(
+                 queue_depth_,
+                 static_cast<int>(GrpcWorkerMethod::kRecvTensorChunk), 100);
+         ++i) {
+      EnqueueRecvTensorChunkRequestRaw();
+    }
 
     void* tag;
     bool ok;
@@ -284,6 +292,18 @@ class GrpcWorkerServiceThread {
     EnqueueRecvTensorRequestRaw();
   }
 
+  void RecvTensorChunkHandlerRaw(
+      WorkerCall<RecvTensorChunkRequest, ::grpc::ByteBuffer>* call) {
+    Schedule([this, call]() {
+      Status s = worker_->GrpcRecvTensorChunk(&call->request, &call->response);
+      if (!s.ok()) {
+        VLOG(3) << "Bad response from RecvTensorChunk:" << s;
+      }
+      call->SendResponse(ToGrpcStatus(s));
+    });
+    EnqueueRecvTensorChunkRequestRaw();
+  }
+
   void RecvBufHandler(WorkerCall<RecvBufRequest, RecvBufResponse>* call) {
     Schedule([this, call]() {
       CallOptions* call_opts = new CallOptions;
@@ -353,6 +373,19 @@ class GrpcWorkerServiceThread {
     }
   }
 
+  void EnqueueRecvTensorChunkRequestRaw() {
+    mutex_lock l(shutdown_mu_);
+    if (!is_shutdown_) {
+      Call<GrpcWorkerServiceThread, grpc::WorkerService::AsyncService,
+           RecvTensorChunkRequest, ::grpc::ByteBuffer>::
+          EnqueueRequestForMethod(
+              worker_service_, cq_.get(),
+              static_cast<int>(GrpcWorkerMethod::kRecvTensorChunk),
+              &GrpcWorkerServiceThread::RecvTensorChunkHandlerRaw,
+              false /* supports cancel*/);
+    }
+  }
+
   GrpcWorker* const worker_ = nullptr;  // Not owned.
   std::unique_ptr<::grpc::ServerCompletionQueue> cq_;
   std::unique_ptr<Thread> thread_;
@@ -430,6 +463,25 @@ GrpcWorker::GrpcWorker(WorkerEnv* worker_env, const ConfigProto& config)
   }
 }
 
+SharedMemoryRing* GrpcWorker::GetSharedMemoryRing() {
+  mutex_lock l(shared_memory_mu_);
+  if (!shared_memory_ring_initialized_) {
+    shared_memory_ring_initialized_ = true;
+    Status s = SharedMemoryRing::Create(SharedMemoryTransport::RingBytes(),
+                                        &shared_memory_ring_);
+    if (!s.ok()) {
+      LOG(WARNING) << "Sending tensors through gRPC instead of shared memory: "
+                   << s;
+    }
+  }
+  return shared_memory_ring_.get();
+}
+
+Status GrpcWorker::GrpcRecvTensorChunk(const RecvTensorChunkRequest* request,
+                                       ::grpc::ByteBuffer* response) {
+  return chunked_tensors_.EncodeChunk(*request, response);
+}
+
 void GrpcWorker::EnableResponseCache() {
   VLOG(3) << "Enabling gRPC tensor response cache.";
   response_cache_ = absl::make_unique<GrpcResponseCache>();
@@ -447,11 +499,18 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
   const int64_t step_id = request->step_id();
 
   bool cache_enabled = (response_cache_ != nullptr && request_id != 0);
-
-  auto do_response = [response, done, cache_enabled](const Tensor& tensor,
-                                                     bool is_dead,
-                                                     const Status& status) {
-    if (status.ok()) {
+  SharedMemoryRing* shared_memory_ring =
+      SharedMemoryTransport::CanSendTo(*request) ? GetSharedMemoryRing()
+                                                 : nullptr;
+
+  auto do_response = [this, request, response, done, cache_enabled,
+                      shared_memory_ring](const Tensor& tensor, bool is_dead,
+                                          const Status& status) {
+    if (status.ok() &&
+        !SharedMemoryTransport::MaybeEncodeTensorToByteBuffer(
+            is_dead, tensor, cache_enabled, shared_memory_ring, response) &&
+        !chunked_tensors_.MaybeEncodeTensorToByteBuffer(
+            *request, is_dead, tensor, cache_enabled, response)) {
       grpc::EncodeTensorToByteBuffer(is_dead, tensor, cache_enabled, response);
     }
     done(status);
@@ -741,6 +800,7 @@ void GrpcWorker::CleanupGraphAsync(const CleanupGraphRequest* request,
     // a worker crashes before acking a request.
     response_cache_->CleanEntriesForStep(request->step_id());
   }
+  chunked_tensors_.CleanEntriesForStep(request->step_id());
   Worker::CleanupGraphAsync(request, response, done);
 }
 
@@ -750,6 +810,7 @@ void GrpcWorker::RemoveCacheEntryForId(int64_t request_id) {
   if (response_cache_) {
     response_cache_->EraseRequestId(request_id);
   }
+  chunked_tensors_.MarkRecvFinished(request_id);
 }
 
 std::unique_ptr<GrpcWorker> NewGrpcWorker(WorkerEnv* env,
@@ -19,9 +19,12 @@ limitations under the License.
 #include <memory>
 #include <unordered_map>
 #include "grpcpp/server_builder.h"
+#include "tensorflow/core/distributed_runtime/rpc/chunked_recv_tensor.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_response_cache.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service_impl.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_transport.h"
 #include "tensorflow/core/distributed_runtime/worker.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 namespace grpc {
@@ -46,6 +49,11 @@ class GrpcWorker : public Worker {
                                    ::grpc::ByteBuffer* response,
                                    StatusCallback done);
 
+  // Returns a chunk of a tensor that GrpcRecvTensorAsync() returned in
+  // chunks.
+  virtual Status GrpcRecvTensorChunk(const RecvTensorChunkRequest* request,
+                                     ::grpc::ByteBuffer* response);
+
   void LoggingAsync(const LoggingRequest* request, LoggingResponse* response,
                     StatusCallback done) override;
 
@@ -63,8 +71,21 @@ class GrpcWorker : public Worker {
   void RemoveCacheEntryForId(int64_t request_id);
 
  private:
+  // Returns the ring that tensors are sent through to receivers on the same
+  // host, creating it on first use, or nullptr if it cannot be created.
+  SharedMemoryRing* GetSharedMemoryRing();
+
   std::unique_ptr<GrpcResponseCache> response_cache_;
   const int32 recv_buf_max_chunk_;
+
+  // The tensors that receivers are fetching in chunks.
+  ChunkedTensorTable chunked_tensors_;
+
+  mutex shared_memory_mu_;
+  bool shared_memory_ring_initialized_ TF_GUARDED_BY(shared_memory_mu_) =
+      false;
+  std::unique_ptr<SharedMemoryRing> shared_memory_ring_
+      TF_GUARDED_BY(shared_memory_mu_);
 };
 
 std::unique_ptr<GrpcWorker> NewGrpcWorker(WorkerEnv* worker_env,
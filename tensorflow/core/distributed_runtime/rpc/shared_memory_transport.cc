@@ -0,0 +1,476 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_transport.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+namespace {
+
+constexpr int64 kSlotAlignment = 64;
+
+// The header in front of the content of every slot of a SharedMemoryRing.
+// Slots start at multiples of kSlotAlignment, and so does their content.
+struct SlotHeader {
+  enum State : uint64 { kFree = 0, kWriting = 1, kWritten = 2, kReading = 3 };
+
+  // The SharedMemoryTensorLocation.position of the slot, which is a multiple
+  // of kSlotAlignment, ORed with its State. Accessed by the writer and by
+  // readers in other processes. Since positions are never reused, a reader
+  // holding a stale location can only claim the slot it was given: once the
+  // memory is reused, its compare-and-swap fails without writing, whether the
+  // location now points at the header of another slot or into its content.
+  std::atomic<uint64> tag;
+  // The remaining fields are only accessed by the writer.
+  // Size of the slot, including this header.
+  uint64 bytes;
+  // When the slot was written, used to reclaim abandoned slots.
+  int64 write_micros;
+
+  static uint64 Tag(uint64 position, State state) { return position | state; }
+};
+
+static_assert(sizeof(SlotHeader) <= kSlotAlignment, "SlotHeader too large");
+static_assert(SlotHeader::kReading < kSlotAlignment,
+              "Slot states must fit below the alignment of positions");
+static_assert(std::atomic<uint64>::is_always_lock_free,
+              "Slot tags must be lock-free to be shared between processes");
+
+int64 RoundUpToSlotAlignment(int64 bytes) {
+  return (bytes + kSlotAlignment - 1) / kSlotAlignment * kSlotAlignment;
+}
+
+#if defined(__linux__)
+
+string ComputeHostId() {
+  // Two processes can open each other's segments if they run on the same
+  // boot of the same machine and see the same /dev/shm.
+  string boot_id;
+  if (!ReadFileToString(Env::Default(), "/proc/sys/kernel/random/boot_id",
+                        &boot_id)
+           .ok()) {
+    return "";
+  }
+  char mount_namespace[64];
+  ssize_t length = readlink("/proc/self/ns/mnt", mount_namespace,
+                            sizeof(mount_namespace));
+  if (length <= 0) {
+    return "";
+  }
+  return strings::StrCat(absl::StripAsciiWhitespace(boot_id), "/",
+                         StringPiece(mount_namespace, length));
+}
+
+// The names of ring segments start with this, in /dev/shm.
+constexpr char kSegmentPrefix[] = "tf_shm_ring_";
+
+// The writer of a segment holds a shared flock() on it for as long as it is
+// alive, so that other processes can tell when it died, even in another pid
+// namespace.
+bool WriterIsAlive(int fd) {
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    return true;
+  }
+  flock(fd, LOCK_UN);
+  return false;
+}
+
+// Unlinks the ring segments of writers that died without unlinking them.
+// Segments are only locked before they are allocated, so that a segment that
+// is still empty may belong to a writer that is creating it.
+void RemoveAbandonedSegments() {
+  std::vector<string> names;
+  if (!Env::Default()->GetChildren("/dev/shm", &names).ok()) {
+    return;
+  }
+  for (const string& name : names) {
+    if (!absl::StartsWith(name, kSegmentPrefix)) continue;
+    const string segment = strings::StrCat("/", name);
+    int fd = shm_open(segment.c_str(), O_RDWR, 0);
+    if (fd < 0) continue;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && !WriterIsAlive(fd)) {
+      LOG(INFO) << "Removing shared memory segment " << segment
+                << " of a dead process";
+      shm_unlink(segment.c_str());
+    }
+    close(fd);
+  }
+}
+
+// The segments of other processes mapped by this process. A segment stays
+// mapped until its writer is gone.
+class MappedSegments {
+ public:
+  static MappedSegments* Global() {
+    static MappedSegments* segments = new MappedSegments;
+    return segments;
+  }
+
+  // Maps `segment` if it is not mapped yet and returns its mapping.
+  Status Get(const string& segment, char** base, int64* size) {
+    mutex_lock l(mu_);
+    auto it = mappings_.find(segment);
+    if (it == mappings_.end()) {
+      // A new segment usually means that a peer was restarted, so this is a
+      // good time to release the segments of the peers that are gone.
+      ReleaseSegmentsOfDeadWritersLocked();
+      int fd = shm_open(segment.c_str(), O_RDWR, 0);
+      if (fd < 0) {
+        return errors::Unavailable("Cannot open shared memory segment ",
+                                   segment, ": ", strerror(errno));
+      }
+      struct stat st;
+      void* mapping = MAP_FAILED;
+      if (fstat(fd, &st) == 0) {
+        mapping = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0);
+      }
+      if (mapping == MAP_FAILED) {
+        close(fd);
+        return errors::Unavailable("Cannot map shared memory segment ",
+                                   segment, ": ", strerror(errno));
+      }
+      // Keep the file descriptor to check on the writer later.
+      it = mappings_
+               .emplace(segment, Mapping{static_cast<char*>(mapping),
+                                         int64{st.st_size}, fd})
+               .first;
+    }
+    *base = it->second.base;
+    *size = it->second.size;
+    return Status::OK();
+  }
+
+ private:
+  struct Mapping {
+    char* base;
+    int64 size;
+    int fd;
+  };
+
+  // Unmaps the segments whose writer exited, and unlinks them in case it
+  // crashed before it could.
+  void ReleaseSegmentsOfDeadWritersLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    for (auto it = mappings_.begin(); it != mappings_.end();) {
+      const Mapping& mapping = it->second;
+      if (WriterIsAlive(mapping.fd)) {
+        ++it;
+        continue;
+      }
+      VLOG(1) << "Unmapping shared memory segment " << it->first;
+      munmap(mapping.base, mapping.size);
+      shm_unlink(it->first.c_str());
+      close(mapping.fd);
+      it = mappings_.erase(it);
+    }
+  }
+
+  mutex mu_;
+  std::unordered_map<string, Mapping> mappings_ TF_GUARDED_BY(mu_);
+};
+
+#endif  // defined(__linux__)
+
+// Number of tensors whose content this process read from shared memory.
+std::atomic<int64> num_tensors_read{0};
+
+}  // namespace
+
+/*static*/ bool SharedMemoryTransport::Enabled() {
+  static const bool enabled = [] {
+    bool enabled = false;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_GRPC_SHARED_MEMORY_TRANSPORT",
+                                   /*default_val=*/false, &enabled));
+    return enabled && !HostId().empty();
+  }();
+  return enabled;
+}
+
+/*static*/ int64 SharedMemoryTransport::RingBytes() {
+  static const int64 ring_bytes = [] {
+    int64 ring_bytes;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_GRPC_SHARED_MEMORY_RING_BYTES",
+                                    /*default_val=*/64 << 20, &ring_bytes));
+    return ring_bytes;
+  }();
+  return ring_bytes;
+}
+
+/*static*/ const string& SharedMemoryTransport::HostId() {
+#if defined(__linux__)
+  static const string* host_id = new string(ComputeHostId());
+#else
+  static const string* host_id = new string;
+#endif
+  return *host_id;
+}
+
+/*static*/ bool SharedMemoryTransport::MaybeAddRecvOptions(
+    RecvTensorRequest* request) {
+  if (!Enabled() || request->has_transport_options()) {
+    return false;
+  }
+  SharedMemoryRecvOptions options;
+  options.set_host_id(HostId());
+  request->mutable_transport_options()->PackFrom(options);
+  return true;
+}
+
+/*static*/ bool SharedMemoryTransport::CanSendTo(
+    const RecvTensorRequest& request) {
+  SharedMemoryRecvOptions options;
+  return Enabled() && request.transport_options().UnpackTo(&options) &&
+         options.host_id() == HostId();
+}
+
+/*static*/ bool SharedMemoryTransport::MaybeEncodeTensorToByteBuffer(
+    bool is_dead, const Tensor& val, bool require_ack, SharedMemoryRing* ring,
+    ::grpc::ByteBuffer* result) {
+  if (ring == nullptr || is_dead || !DataTypeCanUseMemcpy(val.dtype()) ||
+      val.TotalBytes() < kMinTensorBytes) {
+    return false;
+  }
+  SharedMemoryTensorLocation location;
+  if (!ring->Write(val.tensor_data(), &location)) {
+    VLOG(2) << "Shared memory ring is full, sending "
+            << val.TotalBytes() << " bytes through gRPC";
+    return false;
+  }
+  RecvTensorResponse response;
+  response.set_require_ack(require_ack);
+  response.set_send_start_micros(Env::Default()->NowMicros());
+  // The tensor proto has no content, so the receiver allocates a tensor of
+  // the right dtype and shape that MaybeReadTensorContent() fills in.
+  response.mutable_tensor()->set_dtype(val.dtype());
+  val.shape().AsProto(response.mutable_tensor()->mutable_tensor_shape());
+  response.mutable_transport_options()->PackFrom(location);
+  GrpcMaybeUnparseProto(response, result);
+  return true;
+}
+
+/*static*/ Status SharedMemoryTransport::MaybeReadTensorContent(
+    const RecvTensorResponse& response, Tensor* tensor) {
+  SharedMemoryTensorLocation location;
+  if (!response.transport_options().UnpackTo(&location)) {
+    return Status::OK();
+  }
+  if (location.size() != tensor->TotalBytes()) {
+    return errors::Internal("Shared memory tensor content has ",
+                            location.size(), " bytes, expected ",
+                            tensor->TotalBytes());
+  }
+  TF_RETURN_IF_ERROR(SharedMemoryRing::Read(
+      location, static_cast<char*>(DMAHelper::base(tensor))));
+  num_tensors_read.fetch_add(1, std::memory_order_relaxed);
+  return Status::OK();
+}
+
+/*static*/ int64 SharedMemoryTransport::NumTensorsRead() {
+  return num_tensors_read.load(std::memory_order_relaxed);
+}
+
+/*static*/ Status SharedMemoryRing::Create(
+    int64 capacity, std::unique_ptr<SharedMemoryRing>* ring,
+    int64 abandoned_slot_micros) {
+#if defined(__linux__)
+  capacity = capacity / kSlotAlignment * kSlotAlignment;
+  if (capacity <= 0) {
+    return errors::InvalidArgument("Invalid shared memory ring capacity ",
+                                   capacity);
+  }
+  RemoveAbandonedSegments();
+  string segment = strings::StrCat("/", kSegmentPrefix, getpid(), "_",
+                                   strings::Hex(random::New64()));
+  int fd = shm_open(segment.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    return errors::Unavailable("Cannot create shared memory segment ", segment,
+                               ": ", strerror(errno));
+  }
+  // Lock the segment before allocating it, see RemoveAbandonedSegments().
+  // Then reserve the memory up front: touching pages that /dev/shm has no
+  // room for would raise SIGBUS instead of an error.
+  int error = flock(fd, LOCK_SH) == 0 ? 0 : errno;
+  if (error == 0) {
+    error = posix_fallocate(fd, 0, capacity);
+  }
+  void* base = MAP_FAILED;
+  if (error == 0) {
+    base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+      error = errno;
+    }
+  }
+  if (base == MAP_FAILED) {
+    shm_unlink(segment.c_str());
+    close(fd);
+    return errors::Unavailable("Cannot allocate ", capacity,
+                               " bytes of shared memory: ", strerror(error));
+  }
+  ring->reset(new SharedMemoryRing(std::move(segment), fd,
+                                   static_cast<char*>(base), capacity,
+                                   abandoned_slot_micros));
+  return Status::OK();
+#else
+  return errors::Unimplemented(
+      "Shared memory transport is not supported on this platform");
+#endif
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+#if defined(__linux__)
+  munmap(base_, capacity_);
+  shm_unlink(segment_.c_str());
+  // Releases the lock, so that readers unmap the segment too.
+  close(fd_);
+#endif
+}
+
+void SharedMemoryRing::ReclaimLocked(int64 now_micros) {
+  while (tail_ < head_) {
+    SlotHeader* slot = reinterpret_cast<SlotHeader*>(base_ + tail_ % capacity_);
+    const uint64 free_tag = SlotHeader::Tag(tail_, SlotHeader::kFree);
+    uint64 tag = slot->tag.load(std::memory_order_acquire);
+    if (tag == SlotHeader::Tag(tail_, SlotHeader::kWritten) &&
+        now_micros - slot->write_micros > abandoned_slot_micros_) {
+      // Nobody claimed the slot in time. A reader that shows up later fails to
+      // claim it.
+      if (slot->tag.compare_exchange_strong(tag, free_tag,
+                                            std::memory_order_acquire)) {
+        LOG(WARNING) << "Reclaiming shared memory slot of " << slot->bytes
+                     << " bytes that was never read";
+        tag = free_tag;
+      }
+    }
+    if (tag != free_tag) {
+      break;
+    }
+    tail_ += slot->bytes;
+  }
+}
+
+bool SharedMemoryRing::Write(StringPiece data,
+                             SharedMemoryTensorLocation* location) {
+  const uint64 capacity = capacity_;
+  const uint64 slot_bytes =
+      RoundUpToSlotAlignment(kSlotAlignment + data.size());
+  if (slot_bytes > capacity) {
+    return false;
+  }
+  SlotHeader* slot;
+  uint64 offset;
+  uint64 position;
+  {
+    mutex_lock l(mu_);
+    ReclaimLocked(Env::Default()->NowMicros());
+    offset = head_ % capacity;
+    // Slots do not wrap around; skip the end of the segment if needed.
+    const uint64 padding_bytes =
+        offset + slot_bytes > capacity ? capacity - offset : 0;
+    if (capacity - (head_ - tail_) < padding_bytes + slot_bytes) {
+      return false;
+    }
+    if (padding_bytes > 0) {
+      SlotHeader* padding = new (base_ + offset) SlotHeader;
+      padding->bytes = padding_bytes;
+      padding->tag.store(SlotHeader::Tag(head_, SlotHeader::kFree),
+                         std::memory_order_relaxed);
+      head_ += padding_bytes;
+      offset = 0;
+    }
+    position = head_;
+    slot = new (base_ + offset) SlotHeader;
+    slot->bytes = slot_bytes;
+    slot->tag.store(SlotHeader::Tag(position, SlotHeader::kWriting),
+                    std::memory_order_relaxed);
+    head_ += slot_bytes;
+  }
+  // Copy outside of the lock so that concurrent RecvTensor calls can fill
+  // their slots in parallel.
+  std::memcpy(base_ + offset + kSlotAlignment, data.data(), data.size());
+  slot->write_micros = Env::Default()->NowMicros();
+  // The slot may be read and reused as soon as it is marked written.
+  slot->tag.store(SlotHeader::Tag(position, SlotHeader::kWritten),
+                  std::memory_order_release);
+
+  location->set_segment(segment_);
+  location->set_offset(offset);
+  location->set_size(data.size());
+  location->set_position(position);
+  return true;
+}
+
+/*static*/ Status SharedMemoryRing::Read(
+    const SharedMemoryTensorLocation& location, char* dst) {
+#if defined(__linux__)
+  char* base;
+  int64 segment_bytes;
+  TF_RETURN_IF_ERROR(MappedSegments::Global()->Get(location.segment(), &base,
+                                                   &segment_bytes));
+  if (location.offset() < 0 || location.size() < 0 ||
+      location.position() < 0 ||
+      location.position() % kSlotAlignment != 0 ||
+      location.position() % segment_bytes != location.offset() ||
+      location.offset() + kSlotAlignment + location.size() > segment_bytes) {
+    return errors::Internal("Invalid shared memory location ",
+                            location.ShortDebugString());
+  }
+  // The slot is only written to once it is claimed, so a stale location
+  // never changes memory that was reused.
+  SlotHeader* slot = reinterpret_cast<SlotHeader*>(base + location.offset());
+  const uint64 position = location.position();
+  uint64 tag = SlotHeader::Tag(position, SlotHeader::kWritten);
+  if (!slot->tag.compare_exchange_strong(
+          tag, SlotHeader::Tag(position, SlotHeader::kReading),
+          std::memory_order_acquire)) {
+    return errors::DataLoss("Shared memory slot ", location.ShortDebugString(),
+                            " was reclaimed before it was read");
+  }
+  std::memcpy(dst, base + location.offset() + kSlotAlignment, location.size());
+  slot->tag.store(SlotHeader::Tag(position, SlotHeader::kFree),
+                  std::memory_order_release);
+  return Status::OK();
+#else
+  return errors::Unimplemented(
+      "Shared memory transport is not supported on this platform");
+#endif
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,161 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_TRANSPORT_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_TRANSPORT_H_
+
+#include <memory>
+#include <string>
+
+#include "grpcpp/support/byte_buffer.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+
+class SharedMemoryRing;
+
+// Moves RecvTensor payloads between worker processes on the same host through
+// shared memory instead of the gRPC response.
+//
+// The receiver tags its RecvTensorRequest with a SharedMemoryRecvOptions. If
+// the sender sees the same shared memory namespace, it copies the tensor
+// content into a SharedMemoryRing and replies with only the tensor metadata
+// and a SharedMemoryTensorLocation. The receiver then copies the content from
+// there into the tensor it allocated for the response.
+//
+// The transport is enabled by setting TF_GRPC_SHARED_MEMORY_TRANSPORT=1 in the
+// environment of all workers, and is only available on Linux.
+// TF_GRPC_SHARED_MEMORY_RING_BYTES sets the size of the ring of each sender
+// (64MiB by default). Tensors that do not fit are sent through gRPC.
+class SharedMemoryTransport {
+ public:
+  // Tensors smaller than this are cheaper to send through gRPC.
+  static constexpr int64 kMinTensorBytes = 64 * 1024;
+
+  // Returns true if the transport is enabled in this process.
+  static bool Enabled();
+
+  // Returns the size of the ring to create for sending tensors.
+  static int64 RingBytes();
+
+  // Returns a string that is equal for two processes iff they can open each
+  // other's shared memory segments, or an empty string if that cannot be
+  // determined.
+  static const string& HostId();
+
+  // Receiver side: adds SharedMemoryRecvOptions to `request` if the transport
+  // is enabled and the request has no other transport options. Returns true
+  // if it did.
+  static bool MaybeAddRecvOptions(RecvTensorRequest* request);
+
+  // Sender side: returns true if `request` comes from a receiver that can
+  // read from the shared memory of this process.
+  static bool CanSendTo(const RecvTensorRequest& request);
+
+  // Sender side: if `val` is worth sending through shared memory and fits in
+  // `ring`, copies its content into `ring`, encodes a RecvTensorResponse
+  // referring to it into `*result` and returns true. Otherwise returns false,
+  // and the tensor should be sent through gRPC.
+  static bool MaybeEncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
+                                            bool require_ack,
+                                            SharedMemoryRing* ring,
+                                            ::grpc::ByteBuffer* result);
+
+  // Receiver side: if `response` refers to tensor content in shared memory,
+  // copies it into `tensor`, which must already have the response's dtype and
+  // shape.
+  static Status MaybeReadTensorContent(const RecvTensorResponse& response,
+                                       Tensor* tensor);
+
+  // Returns the number of tensors that MaybeReadTensorContent() read from
+  // shared memory in this process.
+  static int64 NumTensorsRead();
+};
+
+// A ring buffer of variable-sized slots in a POSIX shared memory segment,
+// written by the process that created it and read by other processes.
+//
+// Readers claim a slot, copy its content out and mark it free, all with
+// atomic operations on the slot header in shared memory. The writer reuses
+// slots in FIFO order once they are free. A slot that is not read within
+// kAbandonedSlotMicros (e.g. because the RecvTensor call was cancelled) is
+// reclaimed by the writer, and a late reader gets an error instead of reading
+// or writing reused memory.
+//
+// The writer holds a lock on the segment while it is alive. Readers unmap the
+// segments of writers that are gone, and segments left behind by writers that
+// crashed are unlinked by the readers and by the next ring created on the
+// host.
+class SharedMemoryRing {
+ public:
+  static constexpr int64 kAbandonedSlotMicros = 60 * 1000 * 1000;
+
+  // Creates a ring with room for `capacity` bytes of slots in a new segment,
+  // which reclaims the slots that are not read within
+  // `abandoned_slot_micros`.
+  static Status Create(int64 capacity, std::unique_ptr<SharedMemoryRing>* ring,
+                       int64 abandoned_slot_micros = kAbandonedSlotMicros);
+
+  // Unmaps and unlinks the segment, and releases its lock.
+  ~SharedMemoryRing();
+
+  const string& segment() const { return segment_; }
+
+  // Copies `data` into a new slot and describes it in `*location`. Returns
+  // false if the ring does not have room for it.
+  bool Write(StringPiece data, SharedMemoryTensorLocation* location);
+
+  // Copies the content of the slot at `location` into `dst`, which must have
+  // room for location.size() bytes, and frees the slot. May be called from any
+  // process on the same host.
+  static Status Read(const SharedMemoryTensorLocation& location, char* dst);
+
+ private:
+  SharedMemoryRing(string segment, int fd, char* base, int64 capacity,
+                   int64 abandoned_slot_micros)
+      : segment_(std::move(segment)),
+        fd_(fd),
+        base_(base),
+        capacity_(capacity),
+        abandoned_slot_micros_(abandoned_slot_micros) {}
+
+  // Advances tail_ past the slots that readers are done with.
+  void ReclaimLocked(int64 now_micros) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const string segment_;
+  // Open for as long as the ring exists, to hold the lock on the segment.
+  const int fd_;
+  char* const base_;
+  const int64 capacity_;
+  const int64 abandoned_slot_micros_;
+
+  mutex mu_;
+  // Monotonic byte positions of the next slot to write and of the oldest slot
+  // that is still in use.
+  uint64 head_ TF_GUARDED_BY(mu_) = 0;
+  uint64 tail_ TF_GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedMemoryRing);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_TRANSPORT_H_
@@ -0,0 +1,280 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_transport.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "tensorflow/core/distributed_runtime/server_lib.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/tensorflow_server.pb.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+string Pattern(int64 size, char seed) {
+  string data(size, '\0');
+  for (int64 i = 0; i < size; ++i) {
+    data[i] = static_cast<char>(seed + i % 251);
+  }
+  return data;
+}
+
+TEST(SharedMemoryRingTest, WriteAndRead) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(1 << 20, &ring));
+
+  const string data = Pattern(100000, 'a');
+  SharedMemoryTensorLocation location;
+  ASSERT_TRUE(ring->Write(data, &location));
+  EXPECT_EQ(location.segment(), ring->segment());
+  EXPECT_EQ(location.size(), data.size());
+
+  string read(data.size(), '\0');
+  TF_ASSERT_OK(SharedMemoryRing::Read(location, &read[0]));
+  EXPECT_EQ(read, data);
+
+  // The slot is free once it was read.
+  EXPECT_TRUE(
+      errors::IsDataLoss(SharedMemoryRing::Read(location, &read[0])));
+}
+
+TEST(SharedMemoryRingTest, FullRing) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4096, &ring));
+
+  const string data = Pattern(1000, 'b');
+  std::vector<SharedMemoryTensorLocation> locations(4);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(ring->Write(data, &locations[i]));
+  }
+  EXPECT_FALSE(ring->Write(data, &locations[3]));
+  // Data larger than the ring never fits.
+  EXPECT_FALSE(ring->Write(Pattern(8192, 'c'), &locations[3]));
+
+  // Reading the oldest slot makes room for a new one.
+  string read(data.size(), '\0');
+  TF_ASSERT_OK(SharedMemoryRing::Read(locations[0], &read[0]));
+  EXPECT_TRUE(ring->Write(data, &locations[3]));
+}
+
+TEST(SharedMemoryRingTest, WrapAround) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4096, &ring));
+
+  // Slots of different sizes eventually leave a gap at the end of the
+  // segment that the writer has to skip.
+  for (int i = 0; i < 100; ++i) {
+    const string data = Pattern(500 + 37 * (i % 20), 'a' + i % 26);
+    SharedMemoryTensorLocation location;
+    ASSERT_TRUE(ring->Write(data, &location)) << i;
+    string read(data.size(), '\0');
+    TF_ASSERT_OK(SharedMemoryRing::Read(location, &read[0]));
+    EXPECT_EQ(read, data) << i;
+  }
+}
+
+TEST(SharedMemoryRingTest, OutOfOrderReads) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4096, &ring));
+
+  const string first = Pattern(1000, 'd');
+  const string second = Pattern(1000, 'e');
+  SharedMemoryTensorLocation first_location, second_location;
+  ASSERT_TRUE(ring->Write(first, &first_location));
+  ASSERT_TRUE(ring->Write(second, &second_location));
+
+  string read(1000, '\0');
+  TF_ASSERT_OK(SharedMemoryRing::Read(second_location, &read[0]));
+  EXPECT_EQ(read, second);
+  // The first slot is still in use, so the second one cannot be reused yet.
+  SharedMemoryTensorLocation location;
+  ASSERT_TRUE(ring->Write(first, &location));
+  EXPECT_FALSE(ring->Write(first, &location));
+
+  TF_ASSERT_OK(SharedMemoryRing::Read(first_location, &read[0]));
+  EXPECT_EQ(read, first);
+  EXPECT_TRUE(ring->Write(first, &location));
+}
+
+TEST(SharedMemoryRingTest, LateReadOfReusedSlot) {
+  // Reclaims every slot that is not read before the next write.
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4096, &ring,
+                                        /*abandoned_slot_micros=*/0));
+  // Slots of 1024 and 2048 bytes, including their headers.
+  const int64 small_bytes = 960;
+  const int64 large_bytes = 1984;
+
+  SharedMemoryTensorLocation first, abandoned;
+  string read(large_bytes, '\0');
+  ASSERT_TRUE(ring->Write(Pattern(small_bytes, 'a'), &first));
+  ASSERT_TRUE(ring->Write(Pattern(small_bytes, 'b'), &abandoned));
+  EXPECT_EQ(1024, abandoned.offset());
+  TF_ASSERT_OK(SharedMemoryRing::Read(first, &read[0]));
+  Env::Default()->SleepForMicroseconds(1000);
+
+  // Fills the rest of the ring, so that the next slots reuse the memory of
+  // the abandoned one.
+  SharedMemoryTensorLocation filler;
+  ASSERT_TRUE(ring->Write(Pattern(large_bytes, 'c'), &filler));
+  TF_ASSERT_OK(SharedMemoryRing::Read(filler, &read[0]));
+
+  // A slot whose header is where the abandoned one was.
+  const string header_data = Pattern(small_bytes, 'd');
+  SharedMemoryTensorLocation before, at_header;
+  ASSERT_TRUE(ring->Write(Pattern(small_bytes, 'e'), &before));
+  TF_ASSERT_OK(SharedMemoryRing::Read(before, &read[0]));
+  ASSERT_TRUE(ring->Write(header_data, &at_header));
+  ASSERT_EQ(abandoned.offset(), at_header.offset());
+  EXPECT_TRUE(
+      errors::IsDataLoss(SharedMemoryRing::Read(abandoned, &read[0])));
+  TF_ASSERT_OK(SharedMemoryRing::Read(at_header, &read[0]));
+  EXPECT_EQ(header_data, read.substr(0, small_bytes));
+  ASSERT_TRUE(ring->Write(Pattern(large_bytes, 'f'), &filler));
+  TF_ASSERT_OK(SharedMemoryRing::Read(filler, &read[0]));
+
+  // A slot whose content covers where the abandoned one was.
+  const string content_data = Pattern(large_bytes, 'g');
+  SharedMemoryTensorLocation over_content;
+  ASSERT_TRUE(ring->Write(content_data, &over_content));
+  ASSERT_EQ(0, over_content.offset());
+  EXPECT_TRUE(
+      errors::IsDataLoss(SharedMemoryRing::Read(abandoned, &read[0])));
+  TF_ASSERT_OK(SharedMemoryRing::Read(over_content, &read[0]));
+  EXPECT_EQ(content_data, read);
+}
+
+TEST(SharedMemoryRingTest, InvalidLocation) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4096, &ring));
+
+  SharedMemoryTensorLocation location;
+  ASSERT_TRUE(ring->Write(Pattern(100, 'f'), &location));
+  location.set_size(1 << 20);
+  string read(1 << 20, '\0');
+  EXPECT_FALSE(SharedMemoryRing::Read(location, &read[0]).ok());
+
+  location.set_segment("/tf_shm_ring_does_not_exist");
+  EXPECT_TRUE(
+      errors::IsUnavailable(SharedMemoryRing::Read(location, &read[0])));
+}
+
+TEST(SharedMemoryRingTest, RemovesSegmentsOfDeadWriters) {
+  // A segment that nobody holds a lock on, as left behind by a writer that
+  // crashed.
+  const string abandoned = "/tf_shm_ring_0_abandoned";
+  int fd = shm_open(abandoned.c_str(), O_RDWR | O_CREAT, 0600);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(0, ftruncate(fd, 4096));
+  close(fd);
+
+  std::unique_ptr<SharedMemoryRing> live;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4096, &live));
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(4096, &ring));
+
+  EXPECT_LT(shm_open(abandoned.c_str(), O_RDWR, 0), 0);
+  EXPECT_EQ(ENOENT, errno);
+  // The segment of a live writer is kept.
+  fd = shm_open(live->segment().c_str(), O_RDWR, 0);
+  EXPECT_GE(fd, 0);
+  close(fd);
+}
+
+// Starts the servers of a cluster of `num_tasks` workers in this process, so
+// that the test sees the counters of the receiving worker.
+std::vector<std::unique_ptr<ServerInterface>> StartServers(int num_tasks) {
+  ServerDef server_def;
+  server_def.set_protocol("grpc");
+  server_def.set_job_name("localhost");
+  auto* job_def = server_def.mutable_cluster()->add_job();
+  job_def->set_name("localhost");
+  for (int i = 0; i < num_tasks; ++i) {
+    (*job_def->mutable_tasks())[i] =
+        strings::StrCat("localhost:", testing::PickUnusedPortOrDie());
+  }
+  (*server_def.mutable_default_session_config()->mutable_device_count())
+      ["CPU"] = 1;
+  std::vector<std::unique_ptr<ServerInterface>> servers(num_tasks);
+  for (int i = 0; i < num_tasks; ++i) {
+    server_def.set_task_index(i);
+    TF_CHECK_OK(NewServer(server_def, &servers[i]));
+    TF_CHECK_OK(servers[i]->Start());
+  }
+  return servers;
+}
+
+TEST(SharedMemoryTransportTest, RecvTensorBetweenWorkers) {
+  setenv("TF_GRPC_SHARED_MEMORY_TRANSPORT", "1", /*overwrite=*/1);
+  ASSERT_TRUE(SharedMemoryTransport::Enabled());
+
+  Graph graph(OpRegistry::Global());
+  // Large enough to go through shared memory.
+  Tensor large(DT_FLOAT, TensorShape({512, 1024}));
+  test::FillFn<float>(&large, [](int i) { return i * 0.5f; });
+  Node* a = test::graph::Constant(&graph, large);
+  a->set_requested_device("/job:localhost/replica:0/task:0/cpu:0");
+  // Small enough to go through gRPC.
+  Tensor small(DT_FLOAT, TensorShape({4}));
+  test::FillValues<float>(&small, {1, 2, 3, 4});
+  Node* b = test::graph::Constant(&graph, small);
+  b->set_requested_device("/job:localhost/replica:0/task:0/cpu:0");
+  Node* c = test::graph::Identity(&graph, a);
+  c->set_requested_device("/job:localhost/replica:0/task:1/cpu:0");
+  Node* d = test::graph::Identity(&graph, b);
+  d->set_requested_device("/job:localhost/replica:0/task:1/cpu:0");
+  GraphDef graph_def;
+  test::graph::ToGraphDef(&graph, &graph_def);
+
+  std::vector<std::unique_ptr<ServerInterface>> servers = StartServers(2);
+  SessionOptions options;
+  options.target = servers[0]->target();
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(graph_def));
+  const int64 num_tensors_read = SharedMemoryTransport::NumTensorsRead();
+  for (int i = 0; i < 5; ++i) {
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({}, {c->name() + ":0", d->name() + ":0"}, {},
+                              &outputs));
+    ASSERT_EQ(2, outputs.size());
+    test::ExpectTensorEqual<float>(outputs[0], large);
+    test::ExpectTensorEqual<float>(outputs[1], small);
+  }
+  // Only the large tensor went through shared memory.
+  EXPECT_EQ(5, SharedMemoryTransport::NumTensorsRead() - num_tensors_read);
+  TF_ASSERT_OK(session->Close());
+
+  // Servers cannot be stopped once started.
+  for (auto& server : servers) {
+    server.release();
+  }
+}
+
+}  // namespace
+}  // namespace tensorflow
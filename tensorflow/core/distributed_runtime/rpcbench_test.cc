@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include <cstdio>
+#include <cstdlib>
 #include <functional>
 #include <string>
 #include <vector>
@@ -255,4 +256,57 @@ BENCHMARK(BM_SingleDevice)
     ->ArgPair(4, 10000)
     ->ArgPair(1, 1000000);
 
+// Scatter-adds `num_updates` rows, produced on one task, into an embedding of
+// `kEmbeddingRows` rows held by another task, with or without the
+// aggregation of the duplicate rows by SparseUpdateAggregationPass.
+static void BM_SparseUpdates(::testing::benchmark::State& state) {
+  const bool aggregate = state.range(0);
+  const int num_updates = state.range(1);
+  const int kEmbeddingRows = 1000;
+  const int kEmbeddingDim = 64;
+  const Cluster* cluster = GetCluster();
+
+  using namespace ::tensorflow::ops;  // NOLINT(build/namespaces)
+
+  Scope root = Scope::NewRootScope();
+  Scope worker = root.WithDevice(cluster->devices[0].name());
+  Scope ps = root.WithDevice(cluster->devices[1].name());
+  Output var = Variable(ps.WithOpName("var"),
+                        {kEmbeddingRows, kEmbeddingDim}, DT_FLOAT);
+  Assign(ps.WithOpName("init"), var,
+         Fill(ps, {kEmbeddingRows, kEmbeddingDim}, 0.0f));
+  // Stateful, so that the rows are neither constant folded nor aggregated
+  // ahead of time.
+  Output indices = RandomUniformInt(worker, Const(worker, {num_updates}),
+                                    Const(worker, 0),
+                                    Const(worker, kEmbeddingRows));
+  Output updates = RandomUniform(
+      worker, Const(worker, {num_updates, kEmbeddingDim}), DT_FLOAT);
+  ScatterAdd(ps.WithOpName("update"), var, indices, updates);
+  GraphDef def;
+  TF_CHECK_OK(root.ToGraphDef(&def));
+
+  // The pass reads the variable when the graph is built.
+  setenv("TF_AGGREGATE_SPARSE_UPDATES", aggregate ? "1" : "0",
+         /*overwrite=*/1);
+  std::unique_ptr<Session> session(NewSession(cluster->options));
+  TF_CHECK_OK(session->Create(def));
+  TF_CHECK_OK(session->Run({}, {}, {"init"}, nullptr));
+  state.SetLabel(aggregate ? "Aggregated" : "Not aggregated");
+
+  // Do a few warmup iterations.
+  for (int i = 0; i < 3; i++) {
+    TF_CHECK_OK(session->Run({}, {}, {"update"}, nullptr));
+  }
+
+  // Iterations.
+  for (auto s : state) {
+    TF_CHECK_OK(session->Run({}, {}, {"update"}, nullptr));
+  }
+  state.SetItemsProcessed(state.iterations() * num_updates);
+  TF_CHECK_OK(session->Close());
+  unsetenv("TF_AGGREGATE_SPARSE_UPDATES");
+}
+BENCHMARK(BM_SparseUpdates)->ArgsProduct({{0, 1}, {1000, 10000, 100000}});
+
 }  // namespace tensorflow
@@ -25,6 +25,11 @@ namespace tensorflow {
 
 TensorResponse::Source::~Source() {}
 
+TensorBuffer* TensorResponse::Source::ShareContents(const char* data,
+                                                    size_t size) {
+  return nullptr;
+}
+
 void TensorResponse::Clear() {
   on_host_ = false;
   device_ = nullptr;
@@ -143,8 +148,39 @@ bool ReadNestedMessage(protobuf::io::CodedInputStream* input,
 
 }  // namespace
 
+bool TensorResponse::ShareTensorContent(Source* source,
+                                        protobuf::io::CodedInputStream* input,
+                                        DataType dtype,
+                                        const TensorShape& shape,
+                                        int num_bytes) {
+  // Below this size a copy is cheaper than setting up a shared buffer.
+  constexpr int kMinSharedTensorBytes = 4096;
+  // Memory that must be usable for DMA has to come from allocator_.
+  if (num_bytes < kMinSharedTensorBytes || alloc_attrs_.gpu_compatible() ||
+      alloc_attrs_.nic_compatible()) {
+    return false;
+  }
+  if (static_cast<int64_t>(num_bytes) !=
+      shape.num_elements() * DataTypeSize(dtype)) {
+    return false;
+  }
+  const void* data;
+  int size;
+  if (!input->GetDirectBufferPointer(&data, &size) || size < num_bytes ||
+      reinterpret_cast<uintptr_t>(data) % EIGEN_MAX_ALIGN_BYTES != 0) {
+    return false;
+  }
+  TensorBuffer* buf =
+      source->ShareContents(static_cast<const char*>(data), num_bytes);
+  if (buf == nullptr) return false;
+  tensor_ = Tensor(dtype, shape, buf);
+  buf->Unref();
+  return input->Skip(num_bytes);
+}
+
 bool TensorResponse::ParseTensorSubmessage(
-    protobuf::io::CodedInputStream* input, TensorProto* tensor_meta) {
+    Source* source, protobuf::io::CodedInputStream* input,
+    TensorProto* tensor_meta) {
   bool seen_tensor_content = false;
   while (true) {
     auto p = input->ReadTagWithCutoff(127);
@@ -195,12 +231,13 @@ bool TensorResponse::ParseTensorSubmessage(
         if (!ReadVarintSizeAsInt(input, &num_bytes)) return false;
         seen_tensor_content = true;
         TensorShape shape(tensor_meta->tensor_shape());
+        if (ShareTensorContent(source, input, tensor_meta->dtype(), shape,
+                               num_bytes)) {
+          break;
+        }
         Tensor t(allocator_, tensor_meta->dtype(), shape);
         StringPiece buf = t.tensor_data();
         if (static_cast<size_t>(num_bytes) != buf.size()) return false;
-        // TODO(jeff,sanjay): Figure out a way to avoid this copy if
-        // the underlying ZeroCopyInputStream data is properly aligned
-        // and compatible with what allocator_ wants.
         if (!input->ReadRaw(const_cast<char*>(buf.data()), num_bytes))
           return false;
         tensor_ = std::move(t);
@@ -233,7 +270,7 @@ bool TensorResponse::ParseFast(Source* source) {
         std::pair<protobuf::io::CodedInputStream::Limit, int> p =
             input.IncrementRecursionDepthAndPushLimit(length);
         if (p.second < 0 ||
-            !ParseTensorSubmessage(&input, meta_.mutable_tensor())) {
+            !ParseTensorSubmessage(source, &input, meta_.mutable_tensor())) {
           return false;
         }
         if (!input.DecrementRecursionDepthAndPopLimit(p.first)) {
@@ -27,6 +27,7 @@ namespace tensorflow {
 
 class Allocator;
 class DeviceBase;
+class TensorBuffer;
 class TensorProto;
 
 // TensorResponse can be used as the destination of an RPC that returns
@@ -64,6 +65,16 @@ class TensorResponse {
     // Ownership of the returned stream is retained by the Source and
     // should not be deleted by the caller.
     virtual ::tensorflow::protobuf::io::ZeroCopyInputStream* contents() = 0;
+
+    // Returns a buffer that shares the `size` bytes at `data` instead of
+    // copying them, and keeps that memory alive for as long as the buffer is
+    // referenced. `data` must point into a block of the stream most recently
+    // returned by contents(). Returns nullptr if the memory cannot be
+    // shared, in which case ParseFrom copies the bytes. ParseFrom only asks
+    // for contents of at least 4KB that start aligned and within one block,
+    // which received streams rarely satisfy. The default implementation
+    // never shares.
+    virtual TensorBuffer* ShareContents(const char* data, size_t size);
   };
 
   // Parse the RecvTensorResponse encoded in the data yielded by
@@ -83,6 +94,13 @@ class TensorResponse {
   // live only until *this is destroyed or modified.
   const Tensor& tensor() const { return tensor_; }
 
+  // Returns the parsed tensor, for transports that fill in its contents out
+  // of band. Only valid if on_host().
+  Tensor* mutable_tensor() { return &tensor_; }
+
+  // Returns true if the tensor is parsed into host memory.
+  bool on_host() const { return on_host_; }
+
   // Return a reference to the parsed tensor metadata (no contents).
   // The result will remain live only until *this is destroyed or
   // modified.
@@ -92,8 +110,16 @@ class TensorResponse {
   DeviceBase* device() const { return device_; }
 
  private:
-  bool ParseTensorSubmessage(protobuf::io::CodedInputStream* input,
+  bool ParseTensorSubmessage(Source* source,
+                             protobuf::io::CodedInputStream* input,
                              TensorProto* tensor_meta);
+  // Points tensor_ at the next `num_bytes` of `input` if `source` can share
+  // them and they are suitably aligned. On success, advances `input` past
+  // them.
+  bool ShareTensorContent(Source* source,
+                          protobuf::io::CodedInputStream* input,
+                          DataType dtype, const TensorShape& shape,
+                          int num_bytes);
   bool ParseFast(Source* source);
   bool ParseSlow(Source* source);
 
@@ -99,14 +99,17 @@ void LocalRendezvous::ItemQueue::push_back(Item* item) {
 LocalRendezvous::~LocalRendezvous() {
   // Before destroying this rendezvous instance, make sure all the done-callback
   // calls have finished and the tensors have been released from the queue.
-  {
-    mutex_lock l(mu_);
-    while (pending_callback_counter_ != 0) {
-      pending_callback_cond_var_.wait_for(l, std::chrono::milliseconds(50));
+  bool table_empty = true;
+  for (Bucket& bucket : buckets_) {
+    mutex_lock l(bucket.mu);
+    while (bucket.pending_callback_counter != 0) {
+      bucket.pending_callback_cond_var.wait_for(l,
+                                                std::chrono::milliseconds(50));
     }
+    table_empty &= bucket.table.empty();
   }
 
-  if (!table_.empty()) {
+  if (!table_empty) {
     StartAbort(errors::Cancelled("LocalRendezvous deleted"));
   }
 }
@@ -131,15 +134,16 @@ Status LocalRendezvous::Send(const Rendezvous::ParsedKey& key,
         ->IncrementBy(1);
   }
 
-  mu_.lock();
-  if (!status_.ok()) {
+  Bucket& bucket = GetBucket(key_hash);
+  bucket.mu.lock();
+  Status s = GetStatus();
+  if (!s.ok()) {
     // Rendezvous has been aborted.
-    Status s = status_;
-    mu_.unlock();
+    bucket.mu.unlock();
     return s;
   }
 
-  ItemQueue* queue = &table_[key_hash];
+  ItemQueue* queue = &bucket.table[key_hash];
   if (queue->head == nullptr || queue->head->type == Item::kSend) {
     // There is no waiter for this message. Append the message
     // into the queue. The waiter will pick it up when arrives.
@@ -148,7 +152,7 @@ Status LocalRendezvous::Send(const Rendezvous::ParsedKey& key,
     // the lock.
     DVLOG(2) << "Enqueue Send Item (key:" << key.FullKey() << "). ";
     queue->push_back(new Item(send_args, val, is_dead));
-    mu_.unlock();
+    bucket.mu.unlock();
     return Status::OK();
   }
 
@@ -159,22 +163,22 @@ Status LocalRendezvous::Send(const Rendezvous::ParsedKey& key,
   // Delete the queue when the last element has been consumed.
   if (item->next == nullptr) {
     DVLOG(2) << "Clean up Send/Recv queue (key:" << key.FullKey() << "). ";
-    table_.erase(key_hash);
+    bucket.table.erase(key_hash);
   } else {
     queue->head = item->next;
   }
 
   // Invoke the done-callback, without holding the lock.
-  pending_callback_counter_++;
-  mu_.unlock();
+  bucket.pending_callback_counter++;
+  bucket.mu.unlock();
   DCHECK_EQ(item->type, Item::kRecv);
   (*item->recv_state.waiter)(Status::OK(), send_args, item->args, val, is_dead);
   delete item;
   {
-    mutex_lock l(mu_);
-    pending_callback_counter_--;
-    if (pending_callback_counter_ == 0) {
-      pending_callback_cond_var_.notify_all();
+    mutex_lock l(bucket.mu);
+    bucket.pending_callback_counter--;
+    if (bucket.pending_callback_counter == 0) {
+      bucket.pending_callback_cond_var.notify_all();
     }
   }
   return Status::OK();
@@ -186,16 +190,17 @@ void LocalRendezvous::RecvAsync(const Rendezvous::ParsedKey& key,
   uint64 key_hash = KeyHash(key.FullKey());
   DVLOG(2) << "Recv " << this << " " << key_hash << " " << key.FullKey();
 
-  mu_.lock();
-  if (!status_.ok()) {
+  Bucket& bucket = GetBucket(key_hash);
+  bucket.mu.lock();
+  Status s = GetStatus();
+  if (!s.ok()) {
     // Rendezvous has been aborted.
-    Status s = status_;
-    mu_.unlock();
+    bucket.mu.unlock();
     done(s, Rendezvous::Args(), recv_args, Tensor(), false);
     return;
   }
 
-  ItemQueue* queue = &table_[key_hash];
+  ItemQueue* queue = &bucket.table[key_hash];
   if (queue->head == nullptr || queue->head->type == Item::kRecv) {
     // There is no message to pick up.
     // Only recv-related fields need to be filled.
@@ -221,8 +226,9 @@ void LocalRendezvous::RecvAsync(const Rendezvous::ParsedKey& key,
       already_cancelled = !cm->RegisterCallback(token, [this, token, key_hash] {
         Item* item = nullptr;
         {
-          mutex_lock l(mu_);
-          ItemQueue* queue = &table_[key_hash];
+          Bucket& bucket = GetBucket(key_hash);
+          mutex_lock l(bucket.mu);
+          ItemQueue* queue = &bucket.table[key_hash];
           // Find an item in the queue with a cancellation token that matches
           // `token`, and remove it.
           if (queue->head != nullptr && queue->head->type == Item::kRecv) {
@@ -233,7 +239,7 @@ void LocalRendezvous::RecvAsync(const Rendezvous::ParsedKey& key,
                 if (queue->head->next == nullptr) {
                   // We have a single-element queue, so we can erase it from
                   // the table.
-                  table_.erase(key_hash);
+                  bucket.table.erase(key_hash);
                 } else {
                   // Remove the current item from the queue.
                   if (curr == queue->head) {
@@ -265,7 +271,7 @@ void LocalRendezvous::RecvAsync(const Rendezvous::ParsedKey& key,
       });
     }
     if (already_cancelled) {
-      mu_.unlock();
+      bucket.mu.unlock();
       // Unref case (2)
       if (rc_owner_) rc_owner_->Unref();
       done(StatusGroup::MakeDerived(
@@ -302,7 +308,7 @@ void LocalRendezvous::RecvAsync(const Rendezvous::ParsedKey& key,
       queue->push_back(new Item(recv_args, std::move(done), token));
     }
 
-    mu_.unlock();
+    bucket.mu.unlock();
     return;
   }
 
@@ -314,54 +320,63 @@ void LocalRendezvous::RecvAsync(const Rendezvous::ParsedKey& key,
   // Delete the queue when the last element has been consumed.
   if (item->next == nullptr) {
     DVLOG(2) << "Clean up Send/Recv queue (key:" << key.FullKey() << "). ";
-    table_.erase(key_hash);
+    bucket.table.erase(key_hash);
   } else {
     queue->head = item->next;
   }
 
   // Invoke the done-callback, without holding the lock.
-  pending_callback_counter_++;
-  mu_.unlock();
+  bucket.pending_callback_counter++;
+  bucket.mu.unlock();
   DCHECK_EQ(item->type, Item::kSend);
   done(Status::OK(), item->args, recv_args, *item->send_state.value,
        item->send_state.is_dead);
   delete item;
   {
-    mutex_lock l(mu_);
-    pending_callback_counter_--;
-    if (pending_callback_counter_ == 0) {
-      pending_callback_cond_var_.notify_all();
+    mutex_lock l(bucket.mu);
+    bucket.pending_callback_counter--;
+    if (bucket.pending_callback_counter == 0) {
+      bucket.pending_callback_cond_var.notify_all();
     }
   }
 }
 
 void LocalRendezvous::StartAbort(const Status& status) {
   CHECK(!status.ok());
-  Table table;
   {
-    mutex_lock l(mu_);
+    mutex_lock l(status_mu_);
     status_.Update(status);
-    table_.swap(table);
+    aborted_.store(true, std::memory_order_release);
   }
-  for (auto& p : table) {
-    Item* item = p.second.head;
-    while (item != nullptr) {
-      if (item->type == Item::kRecv) {
-        (*item->recv_state.waiter)(status, Rendezvous::Args(),
-                                   Rendezvous::Args(), Tensor(), false);
+  for (Bucket& bucket : buckets_) {
+    Table table;
+    {
+      mutex_lock l(bucket.mu);
+      bucket.table.swap(table);
+    }
+    for (auto& p : table) {
+      Item* item = p.second.head;
+      while (item != nullptr) {
+        if (item->type == Item::kRecv) {
+          (*item->recv_state.waiter)(status, Rendezvous::Args(),
+                                     Rendezvous::Args(), Tensor(), false);
+        }
+        Item* to_delete = item;
+        item = item->next;
+        delete to_delete;
       }
-      Item* to_delete = item;
-      item = item->next;
-      delete to_delete;
     }
   }
 }
 
-Status LocalRendezvous::status() {
-  mu_.lock();
-  Status s = status_;
-  mu_.unlock();
-  return s;
+Status LocalRendezvous::GetStatus() {
+  if (TF_PREDICT_TRUE(!aborted_.load(std::memory_order_acquire))) {
+    return Status::OK();
+  }
+  mutex_lock l(status_mu_);
+  return status_;
 }
 
+Status LocalRendezvous::status() { return GetStatus(); }
+
 }  // namespace tensorflow
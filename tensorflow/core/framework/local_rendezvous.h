@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_LOCAL_RENDEZVOUS_H_
 #define TENSORFLOW_CORE_FRAMEWORK_LOCAL_RENDEZVOUS_H_
 
+#include <atomic>
+
 #include "tensorflow/core/framework/rendezvous.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/status.h"
@@ -39,8 +41,7 @@ class LocalRendezvous {
   // Rendezvous), pass in its pointer in constructor so the LocalRendezvous
   // can make sure it outlives the async recv requests.
   // Pass in nullptr if the wrapping class is not refcounted.
-  explicit LocalRendezvous(Rendezvous* owner)
-      : rc_owner_(owner), pending_callback_counter_(0) {}
+  explicit LocalRendezvous(Rendezvous* owner) : rc_owner_(owner) {}
   ~LocalRendezvous();
 
   Status Send(const Rendezvous::ParsedKey& key,
@@ -68,16 +69,37 @@ class LocalRendezvous {
 
   typedef gtl::FlatMap<uint64, ItemQueue> Table;
 
+  // The pending items are striped over kNumBuckets tables by key hash, so that
+  // Send and Recv calls for different keys rarely contend on the same lock.
+  static constexpr int kNumBuckets = 16;
+
+  struct Bucket {
+    mutex mu;
+    Table table TF_GUARDED_BY(mu);
+    // Track the number of pending callbacks using a counter.
+    int pending_callback_counter TF_GUARDED_BY(mu) = 0;
+    condition_variable pending_callback_cond_var TF_GUARDED_BY(mu);
+  };
+
+  Bucket& GetBucket(uint64 key_hash) {
+    return buckets_[key_hash % kNumBuckets];
+  }
+
+  // Returns the status the rendezvous was aborted with, or OK. Send and Recv
+  // check it while holding the lock of the key's bucket: StartAbort() sets the
+  // status before it empties the buckets, so it cannot miss an item that was
+  // queued after a successful check.
+  Status GetStatus();
+
   // Pointer to the owner class of this LocalRendezvous if it is refcounted.
   const Rendezvous* rc_owner_;
 
-  // TODO(zhifengc): shard table_.
-  mutex mu_;
-  Table table_ TF_GUARDED_BY(mu_);
-  Status status_ TF_GUARDED_BY(mu_);
-  // Track the number of pening callbacks using a counter.
-  int pending_callback_counter_ TF_GUARDED_BY(mu_);
-  condition_variable pending_callback_cond_var_ TF_GUARDED_BY(mu_);
+  Bucket buckets_[kNumBuckets];
+
+  mutex status_mu_;
+  Status status_ TF_GUARDED_BY(status_mu_);
+  // Lets Send and Recv skip `status_mu_` until the rendezvous is aborted.
+  std::atomic<bool> aborted_{false};
 
   TF_DISALLOW_COPY_AND_ASSIGN(LocalRendezvous);
 };
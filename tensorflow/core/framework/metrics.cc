@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/monitoring/gauge.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/protobuf/data_service.pb.h"
 
 namespace tensorflow {
@@ -62,6 +63,11 @@ auto* graph_unused_outputs = monitoring::Counter<1>::New(
     "/tensorflow/core/graph_unused_outputs",
     "The number of unused outputs for ops of a given type.", "name");
 
+auto* collective_bytes_sent_counter = monitoring::Counter<1>::New(
+    "/tensorflow/core/collective_bytes_sent",
+    "The number of bytes sent to peers by collective implementations.",
+    "name");
+
 auto* tf_data_autotune_counter = monitoring::Counter<1>::New(
     "/tensorflow/data/autotune", "tf.data autotuning", "name");
 
@@ -211,6 +217,33 @@ auto* xla_compilation_time_usecs = monitoring::Counter<0>::New(
     "/tensorflow/core/xla_compilation_time_usecs",
     "The total time spent on compiling XLA graphs in microseconds.");
 
+auto* xla_async_compilation_backlog = monitoring::Gauge<int64, 0>::New(
+    "/tensorflow/core/xla_async_compilation_backlog",
+    "The number of XLA compilations queued or running in the background.");
+
+auto* xla_async_compilations_deferred = monitoring::Counter<0>::New(
+    "/tensorflow/core/xla_async_compilations_deferred",
+    "The number of background XLA compilations that were not started because "
+    "too many compilations were already in flight.");
+
+auto* xla_compilation_cache_lookups = monitoring::Counter<1>::New(
+    "/tensorflow/core/xla_compilation_cache_lookups",
+    "The number of XLA compilation cache lookups, by whether they found a "
+    "compiled executable.",
+    "result");
+
+auto* xla_compilation_cache_evictions = monitoring::Counter<0>::New(
+    "/tensorflow/core/xla_compilation_cache_evictions",
+    "The number of entries evicted from XLA compilation caches.");
+
+auto* xla_compilation_cache_entries = monitoring::Gauge<int64, 0>::New(
+    "/tensorflow/core/xla_compilation_cache_entries",
+    "The number of entries in XLA compilation caches.");
+
+auto* xla_compilation_cache_size_bytes = monitoring::Gauge<int64, 0>::New(
+    "/tensorflow/core/xla_compilation_cache_size_bytes",
+    "The estimated size of the executables in XLA compilation caches.");
+
 auto* xla_tpu_spmd_cores_per_replica = monitoring::Counter<1>::New(
     "/tensorflow/tpu/xla_spmd_cores_per_replica",
     "The number of cores used by XLA SPMD-replicated models.", "cores");
@@ -456,6 +489,43 @@ void UpdateXlaCompilationTime(const uint64 compilation_time_usecs) {
   }
 }
 
+void UpdateXlaAsyncCompilationBacklog(int64_t num_compilations_delta) {
+  static mutex* mu = new mutex;
+  static auto* xla_async_compilation_backlog_cell =
+      xla_async_compilation_backlog->GetCell();
+  mutex_lock lock(*mu);
+  xla_async_compilation_backlog_cell->Set(
+      xla_async_compilation_backlog_cell->value() + num_compilations_delta);
+}
+
+void RecordXlaAsyncCompilationDeferred() {
+  static auto* xla_async_compilations_deferred_cell =
+      xla_async_compilations_deferred->GetCell();
+  xla_async_compilations_deferred_cell->IncrementBy(1);
+}
+
+void RecordXlaCompilationCacheLookup(bool hit) {
+  static auto* hit_cell = xla_compilation_cache_lookups->GetCell("hit");
+  static auto* miss_cell = xla_compilation_cache_lookups->GetCell("miss");
+  (hit ? hit_cell : miss_cell)->IncrementBy(1);
+}
+
+void RecordXlaCompilationCacheEviction() {
+  static auto* xla_compilation_cache_evictions_cell =
+      xla_compilation_cache_evictions->GetCell();
+  xla_compilation_cache_evictions_cell->IncrementBy(1);
+}
+
+void UpdateXlaCompilationCacheSize(int64_t num_entries_delta,
+                                   int64_t size_bytes_delta) {
+  static mutex* mu = new mutex;
+  static auto* entries_cell = xla_compilation_cache_entries->GetCell();
+  static auto* size_bytes_cell = xla_compilation_cache_size_bytes->GetCell();
+  mutex_lock lock(*mu);
+  entries_cell->Set(entries_cell->value() + num_entries_delta);
+  size_bytes_cell->Set(size_bytes_cell->value() + size_bytes_delta);
+}
+
 void UpdateBfcAllocatorDelayTime(const uint64 delay_usecs) {
   static auto* bfc_allocator_delay_cell = bfc_allocator_delay->GetCell();
   if (delay_usecs > 0) {
@@ -467,6 +537,10 @@ void RecordUnusedOutput(const string& op_name) {
   graph_unused_outputs->GetCell(op_name)->IncrementBy(1);
 }
 
+monitoring::CounterCell* GetCollectiveBytesSentCounter(const string& name) {
+  return collective_bytes_sent_counter->GetCell(name);
+}
+
 void IncrementTestCounter(const string& name, const string& label) {
   test_counters->GetCell(name, label)->IncrementBy(1);
 }
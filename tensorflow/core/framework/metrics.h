@@ -166,6 +166,12 @@ void UpdateGraphPendingQueueLength(uint64 len);
 // Records that one output of an op of type `op_name` was unused.
 void RecordUnusedOutput(const string& op_name);
 
+// Returns a counter that can be used to record the number of bytes that a
+// collective implementation sent to its peers.
+//
+// The `name` argument identifies the implementation (e.g. "RingReduce").
+monitoring::CounterCell* GetCollectiveBytesSentCounter(const string& name);
+
 // Updates the metrics stored about time spent building graphs.
 //
 // By "GraphBuild", we refer to building a client graph, which is a sub-graph of
@@ -281,6 +287,26 @@ void UpdateTpuVariableDistributionTime(const uint64 distribution_time_usecs);
 // Updates the metrics stored about time XLA spents compiling graphs.
 void UpdateXlaCompilationTime(const uint64 compilation_time_usecs);
 
+// Adds `num_compilations_delta` to the number of XLA compilations queued or
+// running on the background compilation threads of all compilation caches.
+void UpdateXlaAsyncCompilationBacklog(int64_t num_compilations_delta);
+
+// Records that a background XLA compilation was not started because the
+// maximum number of concurrent compilations was reached.
+void RecordXlaAsyncCompilationDeferred();
+
+// Records a lookup in an XLA compilation cache, which either found a compiled
+// executable (`hit`) or did not.
+void RecordXlaCompilationCacheLookup(bool hit);
+
+// Records that an entry was evicted from an XLA compilation cache.
+void RecordXlaCompilationCacheEviction();
+
+// Updates the number of entries in, and the estimated size in bytes of, the
+// XLA compilation caches of the process.
+void UpdateXlaCompilationCacheSize(int64_t num_entries_delta,
+                                   int64_t size_bytes_delta);
+
 // Updates the metrics stored about time BFC allocator spents during delay.
 void UpdateBfcAllocatorDelayTime(const uint64 delay_usecs);
 
@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -394,6 +395,61 @@ TEST_F(LocalRendezvousTest, AbortThenRecvOrSend) {
       errors::IsAborted(rendez_->Recv(KeyFoo(), args, &val, &val_dead)));
 }
 
+TEST_F(LocalRendezvousTest, ConcurrentSendRecvManyKeys) {
+  static const int kThreads = 8;
+  static const int kKeysPerThread = 200;
+  std::vector<Rendezvous::ParsedKey> keys;
+  for (int i = 0; i < kThreads * kKeysPerThread; ++i) {
+    keys.push_back(MakeKey(strings::StrCat("key", i)));
+  }
+  BlockingCounter received(kThreads * kKeysPerThread);
+  for (int t = 0; t < kThreads; ++t) {
+    SchedClosure([this, t, &keys, &received]() {
+      Rendezvous::Args args;
+      for (int i = t * kKeysPerThread; i < (t + 1) * kKeysPerThread; ++i) {
+        // Alternate the order of Send and Recv, so that both kinds of items
+        // get queued.
+        if (i % 2 == 0) {
+          TF_ASSERT_OK(rendez_->Send(keys[i], args, V(strings::StrCat(i)),
+                                     false));
+        }
+        rendez_->RecvAsync(
+            keys[i], args,
+            [i, &received](const Status& s, const Rendezvous::Args&,
+                           const Rendezvous::Args&, const Tensor& v, bool) {
+              TF_EXPECT_OK(s);
+              EXPECT_EQ(strings::StrCat(i), V(v));
+              received.DecrementCount();
+            });
+        if (i % 2 == 1) {
+          TF_ASSERT_OK(rendez_->Send(keys[i], args, V(strings::StrCat(i)),
+                                     false));
+        }
+      }
+    });
+  }
+  received.Wait();
+}
+
+TEST_F(LocalRendezvousTest, AbortCancelsRecvsOnAllKeys) {
+  static const int kKeys = 100;
+  BlockingCounter aborted(kKeys);
+  Rendezvous::Args args;
+  for (int i = 0; i < kKeys; ++i) {
+    rendez_->RecvAsync(
+        MakeKey(strings::StrCat("key", i)), args,
+        [&aborted](const Status& s, const Rendezvous::Args&,
+                   const Rendezvous::Args&, const Tensor&, bool) {
+          EXPECT_TRUE(errors::IsAborted(s));
+          aborted.DecrementCount();
+        });
+  }
+  rendez_->StartAbort(errors::Aborted(""));
+  aborted.Wait();
+  EXPECT_TRUE(errors::IsAborted(rendez_->Send(MakeKey("key0"), args, V("x"),
+                                              false)));
+}
+
 class DummyDeviceContext : public DeviceContext {
  public:
   explicit DummyDeviceContext(int stream_id) : stream_id_(stream_id) {}
@@ -518,5 +574,43 @@ void BM_PingPong(::testing::benchmark::State& state) {
 }
 BENCHMARK(BM_PingPong)->Arg(100)->Arg(200)->Arg(300);
 
+// Sends and receives distinct tensors from `num_threads` threads at once, as
+// the _Send/_Recv pairs of a partitioned graph do.
+void BM_ConcurrentSendRecv(::testing::benchmark::State& state) {
+  const int num_threads = state.range(0);
+  const int kKeysPerThread = 1000;
+  std::vector<Rendezvous::ParsedKey> keys;
+  for (int i = 0; i < num_threads * kKeysPerThread; ++i) {
+    keys.push_back(MakeKey(strings::StrCat("key", i)));
+  }
+  thread::ThreadPool* pool =
+      new thread::ThreadPool(Env::Default(), "test", num_threads);
+  Tensor orig = V("val");
+
+  for (auto s : state) {
+    Rendezvous* rendez = NewLocalRendezvous();
+    BlockingCounter done(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+      pool->Schedule([&, t]() {
+        Rendezvous::Args args;
+        for (int i = t * kKeysPerThread; i < (t + 1) * kKeysPerThread; ++i) {
+          rendez->RecvAsync(keys[i], args,
+                            [](const Status& s, const Rendezvous::Args&,
+                               const Rendezvous::Args&, const Tensor&,
+                               bool) { TF_CHECK_OK(s); });
+          TF_CHECK_OK(rendez->Send(keys[i], args, orig, false));
+        }
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+    rendez->Unref();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(num_threads) * kKeysPerThread *
+                          state.iterations());
+  delete pool;
+}
+BENCHMARK(BM_ConcurrentSendRecv)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
 }  // namespace
 }  // namespace tensorflow
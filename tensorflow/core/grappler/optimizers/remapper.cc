@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/graph_view.h"
@@ -57,6 +58,9 @@ namespace grappler {
 //   (1) FusedBatchNorm + <Activation>
 //   (2) FusedBatchNorm + SideInput + <Activation>
 //
+// GatherV2 + SparseSegment{Sum,Mean,SqrtN}[WithNumSegments] ->
+//   _FusedSparseSegmentReduction  // Gather on axis 0, on CPU only.
+//
 // Sigmoid + Mul -> _MklSwish  // This fusion only works on Intel CPU.
 //
 //
@@ -73,6 +77,7 @@ constexpr char kFusedDepthwiseConv2dNative[] = "_FusedDepthwiseConv2dNative";
 constexpr char kFusedBatchNormEx[] = "_FusedBatchNormEx";
 constexpr char kFusedBatchNormGradEx[] = "_FusedBatchNormGradEx";
 constexpr char kTensorToHashBucket[] = "_TensorToHashBucketFast";
+constexpr char kFusedSparseSegmentReduction[] = "_FusedSparseSegmentReduction";
 
 constexpr char kDataFormat[] = "data_format";
 constexpr char kIsTraining[] = "is_training";
@@ -143,6 +148,17 @@ struct TensorToHashBucket {
   int string_to_hash_bucket = kMissingIndex;
 };
 
+// GatherV2 of embedding rows feeding a sparse segment reduction, which can be
+// replaced with a reduction reading the rows in place.
+struct GatherWithSparseSegmentReduction {
+  GatherWithSparseSegmentReduction() = default;
+  GatherWithSparseSegmentReduction(int gather, int sparse_segment_reduction)
+      : gather(gather), sparse_segment_reduction(sparse_segment_reduction) {}
+
+  int gather = kMissingIndex;
+  int sparse_segment_reduction = kMissingIndex;
+};
+
 // Contraction node followed by a BiasAdd.
 struct ContractionWithBiasAdd {
   ContractionWithBiasAdd() = default;
@@ -1667,6 +1683,82 @@ bool FindTensorToHashBucket(const RemapperContext& ctx, int node_index,
   return true;
 }
 
+bool IsSparseSegmentReductionCandidate(const NodeDef& node_def) {
+  if (!IsAnySparseSegmentReduction(node_def) || !NodeIsOnCpu(&node_def)) {
+    return false;
+  }
+  const DataType dtype = GetDataTypeFromAttr(node_def, "T");
+  return dtype == DT_FLOAT || dtype == DT_DOUBLE || dtype == DT_BFLOAT16 ||
+         dtype == DT_HALF;
+}
+
+// Returns true if `node_def` is a scalar Const holding zero.
+bool IsZeroScalarConstant(const NodeDef& node_def) {
+  Tensor const_tensor;
+  if (!IsConstant(node_def) ||
+      !const_tensor.FromProto(node_def.attr().at("value").tensor()) ||
+      const_tensor.NumElements() != 1) {
+    return false;
+  }
+  if (const_tensor.dtype() == DT_INT32) {
+    return const_tensor.flat<int32>()(0) == 0;
+  }
+  if (const_tensor.dtype() == DT_INT64) {
+    return const_tensor.flat<int64_t>()(0) == 0;
+  }
+  return false;
+}
+
+bool FindGatherWithSparseSegmentReduction(
+    const RemapperContext& ctx, int node_index,
+    GatherWithSparseSegmentReduction* matched) {
+  // Root of the pattern must be a SparseSegment{Sum,Mean,SqrtN} on CPU.
+  const auto* node_view = ctx.graph_view.GetNode(node_index);
+  const auto* node_def = node_view->node();
+  if (!IsSparseSegmentReductionCandidate(*node_def) ||
+      HasControlFaninOrFanout(*node_view)) {
+    return false;
+  }
+
+  // Its data must be the only consumed output of a GatherV2 on axis 0.
+  if (node_view->NumRegularFanins() < 1) return false;
+  const auto& regular_fanin_0 = node_view->GetRegularFanin(0);
+  if (regular_fanin_0.index() != 0) return false;
+  const auto* gather_node_view = regular_fanin_0.node_view();
+  const auto* gather_node_def = gather_node_view->node();
+  if (gather_node_def->op() != "GatherV2" ||
+      HasControlFaninOrFanout(*gather_node_view) ||
+      !HasAtMostOneFanoutAtPort0(*gather_node_view) ||
+      IsInPreserveSet(ctx, gather_node_def) || !NodeIsOnCpu(gather_node_def)) {
+    return false;
+  }
+  int batch_dims = 0;
+  if (TryGetNodeAttr(*gather_node_def, "batch_dims", &batch_dims) &&
+      batch_dims != 0) {
+    return false;
+  }
+  if (gather_node_view->NumRegularFanins() < 3 ||
+      !IsZeroScalarConstant(
+          *gather_node_view->GetRegularFanin(2).node_view()->node())) {
+    return false;
+  }
+
+  // The gathered ids must be a vector, so that the rows of the gather output
+  // are the rows of `params` selected by the ids.
+  const auto& props =
+      ctx.graph_properties.GetInputProperties(gather_node_def->name());
+  if (props.size() < 2 || props[1].shape().unknown_rank() ||
+      props[1].shape().dim_size() != 1) {
+    return false;
+  }
+
+  const GatherWithSparseSegmentReduction pattern{
+      gather_node_view->node_index(), node_index};
+  *matched = pattern;
+
+  return true;
+}
+
 bool FindFusedBatchMatMul(RemapperContext* ctx, int node_index,
                           std::map<string, int>* matched_nodes_map,
                           std::set<int>* remove_node_indices) {
@@ -2723,6 +2815,64 @@ Status AddTensorToHashBucketNode(RemapperContext* ctx,
   return Status::OK();
 }
 
+Status AddFusedSparseSegmentReductionNode(
+    RemapperContext* ctx, const GatherWithSparseSegmentReduction& matched,
+    std::vector<bool>* invalidated_nodes, std::vector<bool>* nodes_to_delete) {
+  const GraphDef* graph = ctx->graph_view.graph();
+  const NodeDef& gather = graph->node(matched.gather);
+  const NodeDef& reduction = graph->node(matched.sparse_segment_reduction);
+  VLOG(2) << "Fuse " << gather.op() << " with " << reduction.op() << ":"
+          << " gather=" << gather.name() << " reduction=" << reduction.name();
+
+  const string& op = reduction.op();
+  const bool with_num_segments = absl::EndsWith(op, "WithNumSegments");
+  string combiner = "sum";
+  if (absl::StartsWith(op, "SparseSegmentMean")) {
+    combiner = "mean";
+  } else if (absl::StartsWith(op, "SparseSegmentSqrtN")) {
+    combiner = "sqrtn";
+  }
+
+  NodeDef fused_op;
+  fused_op.set_name(reduction.name());
+  fused_op.set_op(kFusedSparseSegmentReduction);
+  fused_op.set_device(reduction.device());
+  fused_op.add_input(gather.input(0));     // 0: params
+  fused_op.add_input(gather.input(1));     // 1: ids
+  fused_op.add_input(reduction.input(1));  // 2: indices
+  fused_op.add_input(reduction.input(2));  // 3: segment_ids
+  if (with_num_segments) {
+    fused_op.add_input(reduction.input(3));  // 4: num_segments
+  }
+
+  auto* attr = fused_op.mutable_attr();
+  auto& src_attr = reduction.attr();
+  (*attr)["T"] = src_attr.at("T");
+  (*attr)["Tids"] = gather.attr().at("Tindices");
+  // The index types default to int32 and may be omitted from the NodeDef.
+  for (const char* type_attr : {"Tidx", "Tsegmentids", "Tnumsegments"}) {
+    auto it = src_attr.find(type_attr);
+    if (it != src_attr.end()) {
+      (*attr)[type_attr] = it->second;
+    } else {
+      SetAttrValue(DT_INT32, &(*attr)[type_attr]);
+    }
+  }
+  SetAttrValue(with_num_segments ? 1 : 0, &(*attr)["num_args"]);
+  SetAttrValue(combiner, &(*attr)["combiner"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_op), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+
+  (*invalidated_nodes)[matched.sparse_segment_reduction] = true;
+  (*nodes_to_delete)[matched.gather] = true;
+
+  return Status::OK();
+}
+
 Status AddFusedBatchMatMul(RemapperContext* ctx,
                            const std::map<string, int>& matched_nodes_map,
                            const std::set<int>& remove_node_indices,
@@ -2808,6 +2958,7 @@ bool IsContractionWithAdd(const RemapperContext& ctx, int node_index) {
 //   (3) Fusing Conv2D biasadd and relu on GPU
 //   (4) INTEL_MKL specific: Conv2D -> Add or Conv2D -> BiasAdd -> Add.
 //   (5) Fusing side output and/or activation into FusedBatchNormGrad.
+//   (6) Fusing GatherV2 into a sparse segment reduction.
 bool RequiresInferredShapes(const RemapperContext& ctx, int node_index) {
   // Candidate for a FusedBatchNorm splitting.
   const auto* node_view = ctx.graph_view.GetNode(node_index);
@@ -2897,13 +3048,24 @@ bool RequiresInferredShapes(const RemapperContext& ctx, int node_index) {
     return false;
   };
 
+  // Candidate for a GatherV2 + SparseSegmentReduction fusion.
+  const auto is_sparse_segment_reduction_candidate = [&]() -> bool {
+    if (!IsSparseSegmentReductionCandidate(*node_def)) return false;
+
+    if (node_view->NumRegularFanins() < 1) return false;
+    const auto& fanin_0 = node_view->GetRegularFanin(0);
+    return fanin_0.node_view()->node()->op() == "GatherV2";
+  };
+
   if (IsMKLEnabled())
     return is_batch_norm_candidate() || is_batch_norm_fusion_candidate() ||
-           IsContractionWithAdd(ctx, node_index);
+           IsContractionWithAdd(ctx, node_index) ||
+           is_sparse_segment_reduction_candidate();
 
   return is_relu_biasadd_conv_candidate() || is_batch_norm_candidate() ||
          is_batch_norm_fusion_candidate() ||
-         is_batch_norm_grad_fusion_candidate();
+         is_batch_norm_grad_fusion_candidate() ||
+         is_sparse_segment_reduction_candidate();
 }
 }  // namespace
 
@@ -3112,6 +3274,14 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       continue;
     }
 
+    GatherWithSparseSegmentReduction gather_with_reduction;
+    if (allow_non_differentiable_rewrites &&
+        FindGatherWithSparseSegmentReduction(ctx, i, &gather_with_reduction)) {
+      TF_RETURN_IF_ERROR(AddFusedSparseSegmentReductionNode(
+          &ctx, gather_with_reduction, &invalidated_nodes, &nodes_to_delete));
+      continue;
+    }
+
     // During inference, most of the inputs to FusedBatchNorm are constant, and
     // we can therefore replace the op with a much cheaper set of primitives.
     FusedBatchNorm fused_batch_norm;
@@ -1078,6 +1078,126 @@ TEST_F(RemapperTensorToHashBucketTest, I32) { RunTest<DT_INT32>(); }
 
 TEST_F(RemapperTensorToHashBucketTest, I64) { RunTest<DT_INT64>(); }
 
+class RemapperFuseGatherWithSparseSegmentReductionTest : public RemapperTest {
+ public:
+  void RunTest(const string& reduction_op, bool with_num_segments) {
+    using ::tensorflow::ops::Placeholder;
+
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+    auto params = Placeholder(s.WithOpName("params"), DT_FLOAT,
+                              ops::Placeholder::Shape({100, 16}));
+    auto ids = Placeholder(s.WithOpName("ids"), DT_INT64,
+                           ops::Placeholder::Shape({20}));
+    auto axis = ops::Const(s.WithOpName("axis"), 0, {});
+    auto gather = ops::GatherV2(s.WithOpName("gather"), params, ids, axis);
+
+    auto indices =
+        ops::Const(s.WithOpName("indices"), {0, 3, 5, 7, 2, 19, 11, 4}, {8});
+    auto segment_ids =
+        ops::Const(s.WithOpName("segment_ids"), {0, 0, 1, 1, 1, 3, 4, 4}, {8});
+    auto num_segments = ops::Const(s.WithOpName("num_segments"), 7, {});
+
+    Output reduction;
+    if (reduction_op == "SparseSegmentSum") {
+      reduction = with_num_segments
+                      ? ops::SparseSegmentSumWithNumSegments(
+                            s.WithOpName("reduction"), gather, indices,
+                            segment_ids, num_segments)
+                            .output
+                      : ops::SparseSegmentSum(s.WithOpName("reduction"), gather,
+                                              indices, segment_ids)
+                            .output;
+    } else if (reduction_op == "SparseSegmentMean") {
+      reduction = with_num_segments
+                      ? ops::SparseSegmentMeanWithNumSegments(
+                            s.WithOpName("reduction"), gather, indices,
+                            segment_ids, num_segments)
+                            .output
+                      : ops::SparseSegmentMean(s.WithOpName("reduction"),
+                                               gather, indices, segment_ids)
+                            .output;
+    } else {
+      reduction = with_num_segments
+                      ? ops::SparseSegmentSqrtNWithNumSegments(
+                            s.WithOpName("reduction"), gather, indices,
+                            segment_ids, num_segments)
+                            .output
+                      : ops::SparseSegmentSqrtN(s.WithOpName("reduction"),
+                                                gather, indices, segment_ids)
+                            .output;
+    }
+    auto fetch = ops::Identity(s.WithOpName("fetch"), reduction);
+
+    auto params_t = GenerateRandomTensor<DT_FLOAT>({100, 16});
+    Tensor ids_t(DT_INT64, {20});
+    for (int i = 0; i < 20; ++i) {
+      ids_t.vec<int64_t>()(i) = (i * 37) % 100;
+    }
+
+    GrapplerItem item;
+    item.fetch = {"fetch"};
+    item.feed = {{"params", params_t}, {"ids", ids_t}};
+    TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+    // Place all nodes on CPU.
+    for (int i = 0; i < item.graph.node_size(); ++i) {
+      item.graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+
+    Remapper optimizer(RewriterConfig::ON);
+    GraphDef output;
+    TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+    int found = 0;
+    for (const NodeDef& node : output.node()) {
+      EXPECT_NE(node.name(), "gather");
+      if (node.name() == "reduction") {
+        EXPECT_EQ(node.op(), "_FusedSparseSegmentReduction");
+        ASSERT_EQ(node.input_size(), with_num_segments ? 5 : 4);
+        EXPECT_EQ(node.input(0), "params");
+        EXPECT_EQ(node.input(1), "ids");
+        EXPECT_EQ(node.input(2), "indices");
+        EXPECT_EQ(node.input(3), "segment_ids");
+        EXPECT_EQ(node.attr().at("num_args").i(), with_num_segments ? 1 : 0);
+        found++;
+      }
+    }
+    EXPECT_EQ(found, 1);
+
+    auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+    ASSERT_EQ(tensors_expected.size(), 1);
+    auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+    ASSERT_EQ(tensors.size(), 1);
+    test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-6);
+  }
+};
+
+TEST_F(RemapperFuseGatherWithSparseSegmentReductionTest, Sum) {
+  RunTest("SparseSegmentSum", /*with_num_segments=*/false);
+}
+
+TEST_F(RemapperFuseGatherWithSparseSegmentReductionTest, Mean) {
+  RunTest("SparseSegmentMean", /*with_num_segments=*/false);
+}
+
+TEST_F(RemapperFuseGatherWithSparseSegmentReductionTest, SqrtN) {
+  RunTest("SparseSegmentSqrtN", /*with_num_segments=*/false);
+}
+
+TEST_F(RemapperFuseGatherWithSparseSegmentReductionTest, SumWithNumSegments) {
+  RunTest("SparseSegmentSum", /*with_num_segments=*/true);
+}
+
+TEST_F(RemapperFuseGatherWithSparseSegmentReductionTest, MeanWithNumSegments) {
+  RunTest("SparseSegmentMean", /*with_num_segments=*/true);
+}
+
+TEST_F(RemapperFuseGatherWithSparseSegmentReductionTest,
+       SqrtNWithNumSegments) {
+  RunTest("SparseSegmentSqrtN", /*with_num_segments=*/true);
+}
+
 class RemapperFuseMatMulWithBiasTest : public RemapperTest {
  public:
   template <DataType DTYPE>
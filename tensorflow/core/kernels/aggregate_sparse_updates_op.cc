@@ -0,0 +1,115 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/state_ops.cc.
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+
+// Sums the rows of `updates` that are scattered to the same index, so that
+// a scatter-add of the outputs has the same effect as one of the inputs.
+// The unique indices are output in order of first occurrence.
+template <typename T, typename Index>
+class AggregateSparseUpdatesOp : public OpKernel {
+ public:
+  explicit AggregateSparseUpdatesOp(OpKernelConstruction* c) : OpKernel(c) {}
+
+  void Compute(OpKernelContext* c) override {
+    const Tensor& indices = c->input(0);
+    const Tensor& updates = c->input(1);
+
+    // A scalar update is added at every index; there is nothing to sum.
+    if (TensorShapeUtils::IsScalar(updates.shape())) {
+      c->set_output(0, indices);
+      c->set_output(1, updates);
+      return;
+    }
+
+    OP_REQUIRES(c,
+                updates.dims() >= indices.dims() &&
+                    TensorShapeUtils::StartsWith(updates.shape(),
+                                                 indices.shape()),
+                errors::InvalidArgument(
+                    "Must have updates.shape = indices.shape + row_shape, got ",
+                    "updates.shape ", updates.shape().DebugString(),
+                    ", indices.shape ", indices.shape().DebugString()));
+
+    const int64 num_indices = indices.NumElements();
+    TensorShape row_shape;
+    for (int d = indices.dims(); d < updates.dims(); ++d) {
+      row_shape.AddDim(updates.dim_size(d));
+    }
+    const int64 row_size = row_shape.num_elements();
+
+    auto indices_flat = indices.flat<Index>();
+    absl::flat_hash_map<Index, int64> slots;
+    slots.reserve(num_indices);
+    std::vector<int64> slot_of(num_indices);
+    for (int64 i = 0; i < num_indices; ++i) {
+      slot_of[i] = slots.emplace(indices_flat(i), slots.size()).first->second;
+    }
+    const int64 num_unique = slots.size();
+
+    Tensor* unique_indices = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(0, TensorShape({num_unique}),
+                                         &unique_indices));
+    auto unique_flat = unique_indices->flat<Index>();
+    for (int64 i = 0; i < num_indices; ++i) {
+      unique_flat(slot_of[i]) = indices_flat(i);
+    }
+
+    TensorShape aggregated_shape({num_unique});
+    aggregated_shape.AppendShape(row_shape);
+    Tensor* aggregated = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(1, aggregated_shape, &aggregated));
+    T* out = aggregated->flat<T>().data();
+    const T* in = updates.flat<T>().data();
+    std::fill(out, out + num_unique * row_size, T(0));
+    for (int64 i = 0; i < num_indices; ++i) {
+      T* dst = out + slot_of[i] * row_size;
+      const T* src = in + i * row_size;
+      for (int64 j = 0; j < row_size; ++j) {
+        dst[j] += src[j];
+      }
+    }
+  }
+};
+
+#define REGISTER_AGGREGATE_SPARSE_UPDATES(type, index_type)            \
+  REGISTER_KERNEL_BUILDER(Name("_AggregateSparseUpdates")              \
+                              .Device(DEVICE_CPU)                      \
+                              .TypeConstraint<type>("T")               \
+                              .TypeConstraint<index_type>("Tindices"), \
+                          AggregateSparseUpdatesOp<type, index_type>)
+
+#define REGISTER_AGGREGATE_SPARSE_UPDATES_INDEX(type) \
+  REGISTER_AGGREGATE_SPARSE_UPDATES(type, int32);     \
+  REGISTER_AGGREGATE_SPARSE_UPDATES(type, int64);
+
+TF_CALL_NUMBER_TYPES(REGISTER_AGGREGATE_SPARSE_UPDATES_INDEX);
+
+#undef REGISTER_AGGREGATE_SPARSE_UPDATES_INDEX
+#undef REGISTER_AGGREGATE_SPARSE_UPDATES
+
+}  // namespace tensorflow
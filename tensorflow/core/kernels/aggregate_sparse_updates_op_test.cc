@@ -0,0 +1,178 @@
+/* Copyright 2022 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class AggregateSparseUpdatesOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(DataType type, DataType index_type) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "_AggregateSparseUpdates")
+                     .Input(FakeInput(index_type))
+                     .Input(FakeInput(type))
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(AggregateSparseUpdatesOpTest, SumsDuplicateRows) {
+  MakeOp(DT_FLOAT, DT_INT32);
+  AddInputFromArray<int32>(TensorShape({5}), {4, 1, 4, 0, 1});
+  AddInputFromArray<float>(TensorShape({5, 2}),
+                           {1, 2, 10, 20, 100, 200, 1000, 2000, 3, 4});
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorEqual<int32>(test::AsTensor<int32>({4, 1, 0}),
+                                 *GetOutput(0));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({101, 202, 13, 24, 1000, 2000}, {3, 2}),
+      *GetOutput(1));
+}
+
+TEST_F(AggregateSparseUpdatesOpTest, FlattensIndices) {
+  MakeOp(DT_INT64, DT_INT64);
+  AddInputFromArray<int64>(TensorShape({2, 2}), {7, 3, 3, 7});
+  AddInputFromArray<int64>(TensorShape({2, 2, 1}), {1, 2, 3, 4});
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({7, 3}), *GetOutput(0));
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({5, 5}, {2, 1}),
+                                 *GetOutput(1));
+}
+
+TEST_F(AggregateSparseUpdatesOpTest, PassesScalarUpdatesThrough) {
+  MakeOp(DT_FLOAT, DT_INT32);
+  AddInputFromArray<int32>(TensorShape({3}), {2, 2, 0});
+  AddInputFromArray<float>(TensorShape({}), {5});
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorEqual<int32>(test::AsTensor<int32>({2, 2, 0}),
+                                 *GetOutput(0));
+  test::ExpectTensorEqual<float>(test::AsScalar<float>(5), *GetOutput(1));
+}
+
+TEST_F(AggregateSparseUpdatesOpTest, Empty) {
+  MakeOp(DT_FLOAT, DT_INT32);
+  AddInputFromArray<int32>(TensorShape({0}), {});
+  AddInputFromArray<float>(TensorShape({0, 3}), {});
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(TensorShape({0}), GetOutput(0)->shape());
+  EXPECT_EQ(TensorShape({0, 3}), GetOutput(1)->shape());
+}
+
+TEST_F(AggregateSparseUpdatesOpTest, MismatchedShapes) {
+  MakeOp(DT_FLOAT, DT_INT32);
+  AddInputFromArray<int32>(TensorShape({3}), {0, 1, 2});
+  AddInputFromArray<float>(TensorShape({2, 3}), {1, 2, 3, 4, 5, 6});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(absl::StrContains(s.ToString(), "Must have updates.shape"))
+      << s;
+}
+
+class AggregateSparseUpdatesBM : public OpsTestBase {
+ public:
+  void TestBody() override {}
+  void MakeBenchmarkOp(const char* op, bool ref) {
+    NodeDefBuilder builder("myop", op);
+    if (ref) builder.Input(FakeInput(DT_FLOAT_REF));
+    TF_ASSERT_OK(builder.Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Finalize(node_def()));
+    TF_CHECK_OK(InitOp());
+  }
+};
+
+// Measures the work of a parameter server that applies the sparse gradient
+// of a worker, with or without aggregating it on the worker first. The
+// gradient has kNumUpdates rows that hit `num_distinct` rows of the
+// variable.
+void BM_ScatterAddOfSparseGradient(::testing::benchmark::State& state,
+                                   bool aggregate) {
+  const int embedding_size = state.range(0);
+  const int num_distinct = state.range(1);
+  const int kRows = 100000;
+  const int kNumUpdates = 10000;
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int32> rows(num_distinct);
+  for (int32& row : rows) row = rnd.Uniform(kRows);
+  std::vector<int32> indices;
+  std::vector<float> updates;
+  for (int i = 0; i < kNumUpdates; ++i) {
+    indices.push_back(rows[rnd.Uniform(num_distinct)]);
+    for (int j = 0; j < embedding_size; ++j) updates.push_back(i + j);
+  }
+  int64 num_rows_sent = kNumUpdates;
+  if (aggregate) {
+    // The aggregation runs on the worker, and is not measured.
+    AggregateSparseUpdatesBM worker;
+    worker.MakeBenchmarkOp("_AggregateSparseUpdates", /*ref=*/false);
+    worker.AddInputFromArray<int32>(TensorShape({kNumUpdates}), indices);
+    worker.AddInputFromArray<float>(TensorShape({kNumUpdates, embedding_size}),
+                                    updates);
+    TF_CHECK_OK(worker.RunOpKernel());
+    num_rows_sent = worker.GetOutput(0)->NumElements();
+    auto unique = worker.GetOutput(0)->flat<int32>();
+    auto aggregated = worker.GetOutput(1)->flat<float>();
+    indices.assign(unique.data(), unique.data() + unique.size());
+    updates.assign(aggregated.data(), aggregated.data() + aggregated.size());
+  }
+
+  AggregateSparseUpdatesBM ps;
+  ps.MakeBenchmarkOp("ScatterAdd", /*ref=*/true);
+  ps.AddInputFromArray<float>(
+      TensorShape({kRows, embedding_size}),
+      std::vector<float>(static_cast<size_t>(kRows) * embedding_size));
+  ps.AddInputFromArray<int32>(TensorShape({num_rows_sent}), indices);
+  ps.AddInputFromArray<float>(TensorShape({num_rows_sent, embedding_size}),
+                              updates);
+  for (auto s : state) {
+    TF_CHECK_OK(ps.RunOpKernel());
+  }
+  state.SetItemsProcessed(static_cast<int64>(kNumUpdates) * embedding_size *
+                          state.iterations());
+}
+
+void BM_ScatterAddOfRawGradient(::testing::benchmark::State& state) {
+  BM_ScatterAddOfSparseGradient(state, /*aggregate=*/false);
+}
+void BM_ScatterAddOfAggregatedGradient(::testing::benchmark::State& state) {
+  BM_ScatterAddOfSparseGradient(state, /*aggregate=*/true);
+}
+
+BENCHMARK(BM_ScatterAddOfRawGradient)
+    ->Args({64, 100})
+    ->Args({64, 1000})
+    ->Args({64, 10000})
+    ->Args({256, 1000});
+BENCHMARK(BM_ScatterAddOfAggregatedGradient)
+    ->Args({64, 100})
+    ->Args({64, 1000})
+    ->Args({64, 10000})
+    ->Args({256, 1000});
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,242 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// CPU kernel for _FusedSparseSegmentReduction, which the remapper creates from
+// GatherV2 + SparseSegment{Sum,Mean,SqrtN}[WithNumSegments]. It reads the
+// embedding rows `params[ids[indices[k]]]` in place instead of gathering them
+// into an [nnz, dim] intermediate first.
+
+#include <cmath>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/prefetch.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Rows are accumulated in float for 16-bit types, as by SparseSegmentReduction.
+template <typename T>
+struct AccumulatorType {
+  typedef T type;
+};
+template <>
+struct AccumulatorType<Eigen::half> {
+  typedef float type;
+};
+template <>
+struct AccumulatorType<bfloat16> {
+  typedef float type;
+};
+
+// How many rows ahead of the one being summed to prefetch.
+constexpr int64_t kPrefetchDistance = 8;
+
+}  // namespace
+
+template <typename T, typename Tids, typename Index, typename SegmentId>
+class FusedSparseSegmentReductionOp : public OpKernel {
+ public:
+  explicit FusedSparseSegmentReductionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    string combiner;
+    OP_REQUIRES_OK(context, context->GetAttr("combiner", &combiner));
+    OP_REQUIRES(context,
+                combiner == "sum" || combiner == "mean" || combiner == "sqrtn",
+                errors::InvalidArgument("Unsupported combiner: ", combiner));
+    is_mean_ = combiner == "mean";
+    is_sqrtn_ = combiner == "sqrtn";
+    int num_args;
+    OP_REQUIRES_OK(context, context->GetAttr("num_args", &num_args));
+    OP_REQUIRES(context, num_args <= 1,
+                errors::InvalidArgument(
+                    "Expected at most one num_segments input, got ", num_args));
+    has_num_segments_ = num_args == 1;
+  }
+
+  void Compute(OpKernelContext* context) override {
+    typedef typename AccumulatorType<T>::type Acc;
+
+    const Tensor& params = context->input(0);
+    const Tensor& ids = context->input(1);
+    const Tensor& indices = context->input(2);
+    const Tensor& segment_ids = context->input(3);
+    OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(params.shape()),
+                errors::InvalidArgument("params must be at least 1-D, got ",
+                                        params.shape().DebugString()));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(ids.shape()),
+                errors::InvalidArgument("ids should be a vector, got ",
+                                        ids.shape().DebugString()));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(indices.shape()),
+                errors::InvalidArgument("indices should be a vector, got ",
+                                        indices.shape().DebugString()));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(segment_ids.shape()),
+                errors::InvalidArgument("segment_ids should be a vector, got ",
+                                        segment_ids.shape().DebugString()));
+    const int64_t num_indices = indices.NumElements();
+    OP_REQUIRES(context, num_indices == segment_ids.NumElements(),
+                errors::InvalidArgument(
+                    "segment_ids and indices should have same size."));
+
+    const auto params_flat = params.flat_outer_dims<T>();
+    const int64_t num_rows = params_flat.dimension(0);
+    const int64_t num_col = params_flat.dimension(1);
+    const auto ids_vec = ids.vec<Tids>();
+    const auto indices_vec = indices.vec<Index>();
+    const auto segment_vec = segment_ids.vec<SegmentId>();
+
+    // Resolves the row of every index, and the start of every non-empty
+    // segment, checking them as GatherV2 and SparseSegmentReduction would.
+    std::vector<int64_t> rows(num_indices);
+    std::vector<int64_t> segment_starts;
+    std::vector<SegmentId> segments;
+    for (int64_t k = 0; k < num_indices; ++k) {
+      const Index index = internal::SubtleMustCopy(indices_vec(k));
+      OP_REQUIRES(context, FastBoundsCheck(index, ids_vec.size()),
+                  errors::InvalidArgument("Bad: indices[", k, "] == ", index,
+                                          " out of range [0, ", ids_vec.size(),
+                                          ")"));
+      const Tids id = internal::SubtleMustCopy(ids_vec(index));
+      OP_REQUIRES(context, FastBoundsCheck(id, num_rows),
+                  errors::InvalidArgument("ids[", index, "] = ", id,
+                                          " is not in [0, ", num_rows, ")"));
+      rows[k] = id;
+
+      const SegmentId segment = internal::SubtleMustCopy(segment_vec(k));
+      if (segments.empty() || segment != segments.back()) {
+        OP_REQUIRES(context, segments.empty() || segment > segments.back(),
+                    errors::InvalidArgument("segment ids are not increasing"));
+        OP_REQUIRES(context, segment >= 0,
+                    errors::InvalidArgument("segment ids must be >= 0"));
+        segments.push_back(segment);
+        segment_starts.push_back(k);
+      }
+    }
+    segment_starts.push_back(num_indices);
+
+    int64_t output_rows = segments.empty() ? 0 : segments.back() + 1;
+    if (has_num_segments_) {
+      const Tensor& num_segments = context->input(4);
+      OP_REQUIRES(context, TensorShapeUtils::IsScalar(num_segments.shape()),
+                  errors::InvalidArgument("num_segments should be a scalar, "
+                                          "not shape ",
+                                          num_segments.shape().DebugString()));
+      const int64_t num_segments_value =
+          num_segments.dtype() == DT_INT32
+              ? internal::SubtleMustCopy(num_segments.scalar<int32>()())
+              : internal::SubtleMustCopy(num_segments.scalar<int64_t>()());
+      OP_REQUIRES(
+          context, num_segments_value >= output_rows,
+          errors::InvalidArgument("segment ids must be < num_segments"));
+      output_rows = num_segments_value;
+    }
+
+    TensorShape output_shape = params.shape();
+    OP_REQUIRES_OK(context, output_shape.SetDimWithStatus(0, output_rows));
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    if (output_rows == 0 || num_col == 0) return;
+    auto output_flat = output->flat_outer_dims<T>();
+    // Segments without indices are zero, as for SparseSegmentReduction.
+    output_flat.setZero();
+    if (num_indices == 0) return;
+
+    typedef Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>> ConstRow;
+    typedef Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>> Row;
+    const T* params_data = params_flat.data();
+    T* output_data = output_flat.data();
+    const int64_t row_bytes = num_col * sizeof(T);
+
+    auto reduce_segments = [&](int64_t begin, int64_t end) {
+      Eigen::Array<Acc, Eigen::Dynamic, 1> sum(num_col);
+      for (int64_t s = begin; s < end; ++s) {
+        const int64_t start = segment_starts[s];
+        const int64_t limit = segment_starts[s + 1];
+        sum.setZero();
+        for (int64_t k = start; k < limit; ++k) {
+          if (k + kPrefetchDistance < num_indices) {
+            const char* next = reinterpret_cast<const char*>(
+                params_data + rows[k + kPrefetchDistance] * num_col);
+            for (int64_t offset = 0; offset < row_bytes; offset += 64) {
+              port::prefetch<port::PREFETCH_HINT_T0>(next + offset);
+            }
+          }
+          sum += ConstRow(params_data + rows[k] * num_col, num_col)
+                     .template cast<Acc>();
+        }
+        const int64_t num = limit - start;
+        if (is_mean_ && num > 1) {
+          sum /= static_cast<Acc>(num);
+        } else if (is_sqrtn_ && num > 1) {
+          sum /= static_cast<Acc>(std::sqrt(static_cast<double>(num)));
+        }
+        Row(output_data + segments[s] * num_col, num_col) =
+            sum.template cast<T>();
+      }
+    };
+
+    const int64_t num_segments = segments.size();
+    const int64_t cost_per_segment =
+        (num_indices / num_segments + 1) * num_col * 4;
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads.num_threads, worker_threads.workers, num_segments,
+          cost_per_segment, reduce_segments);
+  }
+
+ private:
+  bool is_mean_;
+  bool is_sqrtn_;
+  bool has_num_segments_;
+};
+
+#define REGISTER_KERNEL(T, Tids, Tidx, Tsegmentids)                       \
+  REGISTER_KERNEL_BUILDER(                                                \
+      Name("_FusedSparseSegmentReduction")                                \
+          .Device(DEVICE_CPU)                                             \
+          .TypeConstraint<T>("T")                                         \
+          .TypeConstraint<Tids>("Tids")                                   \
+          .TypeConstraint<Tidx>("Tidx")                                   \
+          .TypeConstraint<Tsegmentids>("Tsegmentids"),                    \
+      FusedSparseSegmentReductionOp<T, Tids, Tidx, Tsegmentids>);
+#define REGISTER_KERNELS_FOR_INDICES(T, Tids, Tidx) \
+  REGISTER_KERNEL(T, Tids, Tidx, int32)             \
+  REGISTER_KERNEL(T, Tids, Tidx, int64_t)
+#define REGISTER_KERNELS_FOR_IDS(T, Tids)         \
+  REGISTER_KERNELS_FOR_INDICES(T, Tids, int32)    \
+  REGISTER_KERNELS_FOR_INDICES(T, Tids, int64_t)
+#define REGISTER_CPU_KERNELS(T)           \
+  REGISTER_KERNELS_FOR_IDS(T, int32)      \
+  REGISTER_KERNELS_FOR_IDS(T, int64_t)
+
+TF_CALL_bfloat16(REGISTER_CPU_KERNELS);
+TF_CALL_half(REGISTER_CPU_KERNELS);
+TF_CALL_float(REGISTER_CPU_KERNELS);
+TF_CALL_double(REGISTER_CPU_KERNELS);
+
+#undef REGISTER_CPU_KERNELS
+#undef REGISTER_KERNELS_FOR_IDS
+#undef REGISTER_KERNELS_FOR_INDICES
+#undef REGISTER_KERNEL
+
+}  // namespace tensorflow
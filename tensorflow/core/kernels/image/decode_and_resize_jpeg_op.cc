@@ -0,0 +1,294 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/image_ops.cc
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/jpeg/jpeg_mem.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/image_resizer_state.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns the largest libjpeg downscaling ratio at which a `crop_height` x
+// `crop_width` window still has at least `out_height` x `out_width` pixels.
+int ChooseJpegRatio(int crop_height, int crop_width, int out_height,
+                    int out_width) {
+  for (int ratio : {8, 4, 2}) {
+    if (static_cast<int64_t>(out_height) * ratio <= crop_height &&
+        static_cast<int64_t>(out_width) * ratio <= crop_width) {
+      return ratio;
+    }
+  }
+  return 1;
+}
+
+// Interpolation weights of one output row or column, as for ResizeBilinear.
+struct CachedInterpolation {
+  int64_t lower;
+  int64_t upper;
+  float lerp;
+};
+
+// Computes the weights for `out_size` outputs sampling a `crop_size` window
+// starting at `crop_start` of the full-resolution image, which was decoded at
+// 1/`ratio` scale into `in_size` pixels starting at scaled pixel `in_start`.
+// Output coordinates are mapped into the crop exactly as ResizeBilinear does,
+// so for `ratio` == 1 the result matches ResizeBilinear of the crop.
+void ComputeInterpolationWeights(int64_t out_size, int64_t crop_start,
+                                 int64_t crop_size, int ratio,
+                                 int64_t in_start, int64_t in_size,
+                                 bool align_corners, bool half_pixel_centers,
+                                 std::vector<CachedInterpolation>* weights) {
+  const float scale = CalculateResizeScale(crop_size, out_size, align_corners);
+  weights->resize(out_size);
+  for (int64_t i = 0; i < out_size; ++i) {
+    const float in_crop = half_pixel_centers ? HalfPixelScaler()(i, scale)
+                                             : LegacyScaler()(i, scale);
+    // The scaled pixel `j` covers full-resolution pixels
+    // [j * ratio, (j + 1) * ratio).
+    const float in =
+        ratio == 1 ? in_crop
+                   : (crop_start + in_crop + 0.5f) / ratio - 0.5f - in_start;
+    const float in_f = std::floor(in);
+    CachedInterpolation& w = (*weights)[i];
+    w.lower = std::min(std::max(static_cast<int64_t>(in_f), int64_t{0}),
+                       in_size - 1);
+    w.upper = std::min(std::max(static_cast<int64_t>(std::ceil(in)),
+                                int64_t{0}),
+                       in_size - 1);
+    w.lerp = in - in_f;
+  }
+}
+
+// Decodes a window of a JPEG image and bilinearly resizes it. The image is
+// decoded with the largest DCT downscaling ratio that keeps the window at
+// least as large as the output, and only the scanlines and MCU columns
+// overlapping the window are decoded.
+class DecodeAndResizeJpegOp : public OpKernel {
+ public:
+  explicit DecodeAndResizeJpegOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("channels", &flags_.components));
+    OP_REQUIRES(context,
+                flags_.components == 0 || flags_.components == 1 ||
+                    flags_.components == 3,
+                errors::InvalidArgument("channels must be 0, 1, or 3, got ",
+                                        flags_.components));
+    OP_REQUIRES_OK(context, context->GetAttr("fancy_upscaling",
+                                             &flags_.fancy_upscaling));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("try_recover_truncated",
+                                    &flags_.try_recover_truncated_jpeg));
+    OP_REQUIRES_OK(context, context->GetAttr("acceptable_fraction",
+                                             &flags_.min_acceptable_fraction));
+    string dct_method;
+    OP_REQUIRES_OK(context, context->GetAttr("dct_method", &dct_method));
+    OP_REQUIRES(
+        context,
+        (dct_method.empty() || dct_method == "INTEGER_FAST" ||
+         dct_method == "INTEGER_ACCURATE"),
+        errors::InvalidArgument("dct_method must be one of "
+                                "{'', 'INTEGER_FAST', 'INTEGER_ACCURATE'}"));
+    // Same default as DecodeJpeg.
+    flags_.dct_method =
+        dct_method == "INTEGER_ACCURATE" ? JDCT_ISLOW : JDCT_IFAST;
+
+    OP_REQUIRES_OK(context, context->GetAttr("align_corners", &align_corners_));
+    OP_REQUIRES_OK(context, context->GetAttr("half_pixel_centers",
+                                             &half_pixel_centers_));
+    OP_REQUIRES(context, !(align_corners_ && half_pixel_centers_),
+                errors::InvalidArgument(
+                    "If half_pixel_centers is True, align_corners must be "
+                    "False."));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& contents = context->input(0);
+    OP_REQUIRES(context, TensorShapeUtils::IsScalar(contents.shape()),
+                errors::InvalidArgument("contents must be scalar, got shape ",
+                                        contents.shape().DebugString()));
+    const tstring& input = contents.scalar<tstring>()();
+    OP_REQUIRES(context, input.size() <= std::numeric_limits<int>::max(),
+                errors::InvalidArgument(
+                    "JPEG contents are too large for int: ", input.size()));
+
+    const Tensor& crop_window = context->input(1);
+    OP_REQUIRES(context,
+                crop_window.dims() == 1 && (crop_window.dim_size(0) == 4 ||
+                                            crop_window.dim_size(0) == 0),
+                errors::InvalidArgument(
+                    "crop_window must have shape [4] or [0], got shape ",
+                    crop_window.shape().DebugString()));
+    const Tensor& size = context->input(2);
+    OP_REQUIRES(context, size.dims() == 1 && size.dim_size(0) == 2,
+                errors::InvalidArgument("size must have shape [2], got shape ",
+                                        size.shape().DebugString()));
+    const int out_height = size.vec<int32>()(0);
+    const int out_width = size.vec<int32>()(1);
+    OP_REQUIRES(context, out_height > 0 && out_width > 0,
+                errors::InvalidArgument("output dimensions must be positive"));
+
+    int image_width = 0;
+    int image_height = 0;
+    OP_REQUIRES(context,
+                jpeg::GetImageInfo(input.data(), input.size(), &image_width,
+                                   &image_height, nullptr),
+                errors::InvalidArgument("Invalid JPEG data, size ",
+                                        input.size()));
+
+    int crop_y = 0;
+    int crop_x = 0;
+    int crop_height = image_height;
+    int crop_width = image_width;
+    if (crop_window.NumElements() == 4) {
+      auto crop_window_vec = crop_window.vec<int32>();
+      crop_y = crop_window_vec(0);
+      crop_x = crop_window_vec(1);
+      crop_height = crop_window_vec(2);
+      crop_width = crop_window_vec(3);
+      OP_REQUIRES(
+          context,
+          crop_height > 0 && crop_width > 0 && crop_y >= 0 && crop_x >= 0 &&
+              static_cast<int64_t>(crop_y) + crop_height <= image_height &&
+              static_cast<int64_t>(crop_x) + crop_width <= image_width,
+          errors::InvalidArgument("Invalid crop window: y=", crop_y,
+                                  ", x=", crop_x, ", height=", crop_height,
+                                  ", width=", crop_width, " for a ",
+                                  image_height, "x", image_width, " image"));
+    }
+
+    // Decodes the smallest window of the downscaled image covering the crop.
+    jpeg::UncompressFlags flags = flags_;
+    flags.ratio = ChooseJpegRatio(crop_height, crop_width, out_height,
+                                  out_width);
+    const int ratio = flags.ratio;
+    const int scaled_height = (image_height + ratio - 1) / ratio;
+    const int scaled_width = (image_width + ratio - 1) / ratio;
+    const int in_y = crop_y / ratio;
+    const int in_x = crop_x / ratio;
+    const int in_height =
+        std::min((crop_y + crop_height + ratio - 1) / ratio, scaled_height) -
+        in_y;
+    const int in_width =
+        std::min((crop_x + crop_width + ratio - 1) / ratio, scaled_width) -
+        in_x;
+    if (in_height != scaled_height || in_width != scaled_width) {
+      flags.crop = true;
+      flags.crop_y = in_y;
+      flags.crop_x = in_x;
+      flags.crop_height = in_height;
+      flags.crop_width = in_width;
+    }
+
+    std::unique_ptr<uint8[]> decoded;
+    int decoded_height = 0;
+    int decoded_width = 0;
+    int channels = 0;
+    uint8* buffer = jpeg::Uncompress(
+        input.data(), input.size(), flags, nullptr /* nwarn */,
+        [&](int width, int height, int components) -> uint8* {
+          decoded_height = height;
+          decoded_width = width;
+          channels = components;
+          decoded.reset(new uint8[static_cast<int64_t>(height) * width *
+                                  components]);
+          return decoded.get();
+        });
+    OP_REQUIRES(
+        context, buffer != nullptr,
+        errors::InvalidArgument(
+            "jpeg::Uncompress failed. Invalid JPEG data or crop window."));
+    OP_REQUIRES(context,
+                decoded_height == in_height && decoded_width == in_width,
+                errors::Internal("Decoded a ", decoded_height, "x",
+                                 decoded_width, " window, expected ",
+                                 in_height, "x", in_width));
+    VLOG(2) << "Decoded a " << in_height << "x" << in_width << " window at 1/"
+            << ratio << " scale for a " << crop_height << "x" << crop_width
+            << " crop resized to " << out_height << "x" << out_width;
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(
+        context,
+        context->allocate_output(
+            0, TensorShape({out_height, out_width, channels}), &output));
+
+    std::vector<CachedInterpolation> ys;
+    std::vector<CachedInterpolation> xs;
+    ComputeInterpolationWeights(out_height, crop_y, crop_height, ratio, in_y,
+                                in_height, align_corners_, half_pixel_centers_,
+                                &ys);
+    ComputeInterpolationWeights(out_width, crop_x, crop_width, ratio, in_x,
+                                in_width, align_corners_, half_pixel_centers_,
+                                &xs);
+
+    const uint8* in_data = decoded.get();
+    float* out_data = output->flat<float>().data();
+    const int64_t in_row_size = static_cast<int64_t>(in_width) * channels;
+    const int64_t out_row_size = static_cast<int64_t>(out_width) * channels;
+    auto resize_rows = [&](int64_t begin, int64_t end) {
+      for (int64_t y = begin; y < end; ++y) {
+        const uint8* top = in_data + ys[y].lower * in_row_size;
+        const uint8* bottom = in_data + ys[y].upper * in_row_size;
+        const float y_lerp = ys[y].lerp;
+        float* out = out_data + y * out_row_size;
+        for (int64_t x = 0; x < out_width; ++x) {
+          const int64_t left = xs[x].lower * channels;
+          const int64_t right = xs[x].upper * channels;
+          const float x_lerp = xs[x].lerp;
+          for (int c = 0; c < channels; ++c) {
+            const float top_left = top[left + c];
+            const float top_right = top[right + c];
+            const float bottom_left = bottom[left + c];
+            const float bottom_right = bottom[right + c];
+            const float top_value = top_left + (top_right - top_left) * x_lerp;
+            const float bottom_value =
+                bottom_left + (bottom_right - bottom_left) * x_lerp;
+            *out++ = top_value + (bottom_value - top_value) * y_lerp;
+          }
+        }
+      }
+    };
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads.num_threads, worker_threads.workers, out_height,
+          out_row_size * 10, resize_rows);
+  }
+
+ private:
+  jpeg::UncompressFlags flags_;
+  bool align_corners_;
+  bool half_pixel_centers_;
+};
+
+}  // namespace
+
+REGISTER_KERNEL_BUILDER(Name("DecodeAndResizeJpeg").Device(DEVICE_CPU),
+                        DecodeAndResizeJpegOp);
+
+}  // namespace tensorflow
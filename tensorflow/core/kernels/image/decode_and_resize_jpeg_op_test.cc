@@ -0,0 +1,301 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/jpeg/jpeg_mem.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns a smooth RGB test image, so that decoding at a reduced scale stays
+// close to decoding at full scale.
+tstring EncodeTestImage(int height, int width) {
+  std::vector<uint8> pixels(height * width * 3);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8* pixel = &pixels[(y * width + x) * 3];
+      pixel[0] = 255 * x / width;
+      pixel[1] = 255 * y / height;
+      pixel[2] = 128 + 64 * std::sin(x * 0.05) * std::cos(y * 0.05);
+    }
+  }
+  jpeg::CompressFlags flags;
+  flags.format = jpeg::FORMAT_RGB;
+  flags.quality = 95;
+  return jpeg::Compress(pixels.data(), width, height, flags);
+}
+
+// Options of ResizeBilinear.
+struct ResizeOptions {
+  bool align_corners = false;
+  bool half_pixel_centers = false;
+};
+
+// Maps output coordinate `i` into the crop as ResizeBilinear does.
+float SourceCoordinate(int i, int crop_size, int out_size,
+                       const ResizeOptions& options) {
+  const float scale = options.align_corners && out_size > 1
+                          ? (crop_size - 1) / static_cast<float>(out_size - 1)
+                          : crop_size / static_cast<float>(out_size);
+  return options.half_pixel_centers ? (i + 0.5f) * scale - 0.5f : i * scale;
+}
+
+// DecodeAndCropJpeg followed by ResizeBilinear, computed directly.
+std::vector<float> ReferenceDecodeAndResize(const tstring& jpeg, int crop_y,
+                                            int crop_x, int crop_height,
+                                            int crop_width, int out_height,
+                                            int out_width,
+                                            const ResizeOptions& options) {
+  jpeg::UncompressFlags flags;
+  flags.components = 3;
+  flags.dct_method = JDCT_IFAST;
+  int width, height, channels;
+  std::unique_ptr<uint8[]> image(jpeg::Uncompress(
+      jpeg.data(), jpeg.size(), flags, &width, &height, &channels, nullptr));
+  CHECK(image != nullptr);
+  auto pixel = [&](int y, int x, int c) -> float {
+    return image[((crop_y + y) * width + crop_x + x) * 3 + c];
+  };
+
+  std::vector<float> out;
+  for (int y = 0; y < out_height; ++y) {
+    const float in_y = SourceCoordinate(y, crop_height, out_height, options);
+    const int top = std::max<int>(std::floor(in_y), 0);
+    const int bottom = std::min<int>(std::ceil(in_y), crop_height - 1);
+    const float y_lerp = in_y - std::floor(in_y);
+    for (int x = 0; x < out_width; ++x) {
+      const float in_x = SourceCoordinate(x, crop_width, out_width, options);
+      const int left = std::max<int>(std::floor(in_x), 0);
+      const int right = std::min<int>(std::ceil(in_x), crop_width - 1);
+      const float x_lerp = in_x - std::floor(in_x);
+      for (int c = 0; c < 3; ++c) {
+        const float top_value =
+            pixel(top, left, c) +
+            (pixel(top, right, c) - pixel(top, left, c)) * x_lerp;
+        const float bottom_value =
+            pixel(bottom, left, c) +
+            (pixel(bottom, right, c) - pixel(bottom, left, c)) * x_lerp;
+        out.push_back(top_value + (bottom_value - top_value) * y_lerp);
+      }
+    }
+  }
+  return out;
+}
+
+// Largest differences from the reference when decoding at full and at
+// reduced scale.
+constexpr float kFullScaleTolerance = 1e-3;
+constexpr float kDownscaledTolerance = 8;
+
+class DecodeAndResizeJpegOpTest : public OpsTestBase {
+ protected:
+  Status MakeOpWithStatus(const ResizeOptions& options) {
+    TF_CHECK_OK(NodeDefBuilder("decode_and_resize", "DecodeAndResizeJpeg")
+                    .Input(FakeInput(DT_STRING))
+                    .Input(FakeInput(DT_INT32))
+                    .Input(FakeInput(DT_INT32))
+                    .Attr("channels", 3)
+                    .Attr("align_corners", options.align_corners)
+                    .Attr("half_pixel_centers", options.half_pixel_centers)
+                    .Finalize(node_def()));
+    inputs_.clear();
+    return InitOp();
+  }
+
+  void MakeOp(const ResizeOptions& options = ResizeOptions()) {
+    TF_ASSERT_OK(MakeOpWithStatus(options));
+  }
+
+  // Runs the op and compares it with the reference, which decodes at full
+  // scale. The largest difference must be at most `tolerance` and, if the
+  // op decodes at a reduced scale, more than the rounding errors of a full
+  // scale decode.
+  void RunAndCheck(const tstring& jpeg, int image_height, int image_width,
+                   std::vector<int32> crop_window, int out_height,
+                   int out_width, float tolerance, bool downscaled,
+                   const ResizeOptions& options = ResizeOptions()) {
+    MakeOp(options);
+    AddInputFromArray<tstring>(TensorShape({}), {jpeg});
+    AddInputFromArray<int32>(
+        TensorShape({static_cast<int64_t>(crop_window.size())}), crop_window);
+    AddInputFromArray<int32>(TensorShape({2}), {out_height, out_width});
+    TF_ASSERT_OK(RunOpKernel());
+
+    if (crop_window.empty()) {
+      crop_window = {0, 0, image_height, image_width};
+    }
+    const std::vector<float> expected = ReferenceDecodeAndResize(
+        jpeg, crop_window[0], crop_window[1], crop_window[2], crop_window[3],
+        out_height, out_width, options);
+    const Tensor& output = *GetOutput(0);
+    ASSERT_EQ(output.shape(), TensorShape({out_height, out_width, 3}));
+    auto output_flat = output.flat<float>();
+    float max_error = 0;
+    for (int i = 0; i < expected.size(); ++i) {
+      max_error = std::max(max_error, std::abs(output_flat(i) - expected[i]));
+    }
+    EXPECT_LE(max_error, tolerance);
+    if (downscaled) {
+      EXPECT_GT(max_error, kFullScaleTolerance);
+    }
+  }
+};
+
+TEST_F(DecodeAndResizeJpegOpTest, MatchesResizeBilinearAtFullScale) {
+  // Less than 2x downscaling decodes at full scale.
+  const tstring jpeg = EncodeTestImage(100, 120);
+  RunAndCheck(jpeg, 100, 120, {}, 64, 80, kFullScaleTolerance,
+              /*downscaled=*/false);
+  RunAndCheck(jpeg, 100, 120, {10, 20, 60, 70}, 40, 50, kFullScaleTolerance,
+              /*downscaled=*/false);
+}
+
+TEST_F(DecodeAndResizeJpegOpTest, MatchesResizeBilinearWithAlignCorners) {
+  const tstring jpeg = EncodeTestImage(100, 120);
+  ResizeOptions options;
+  options.align_corners = true;
+  RunAndCheck(jpeg, 100, 120, {}, 64, 80, kFullScaleTolerance,
+              /*downscaled=*/false, options);
+  RunAndCheck(jpeg, 100, 120, {10, 20, 60, 70}, 40, 50, kFullScaleTolerance,
+              /*downscaled=*/false, options);
+}
+
+TEST_F(DecodeAndResizeJpegOpTest, MatchesResizeBilinearWithHalfPixelCenters) {
+  const tstring jpeg = EncodeTestImage(100, 120);
+  ResizeOptions options;
+  options.half_pixel_centers = true;
+  RunAndCheck(jpeg, 100, 120, {}, 64, 80, kFullScaleTolerance,
+              /*downscaled=*/false, options);
+  RunAndCheck(jpeg, 100, 120, {10, 20, 60, 70}, 40, 50, kFullScaleTolerance,
+              /*downscaled=*/false, options);
+}
+
+TEST_F(DecodeAndResizeJpegOpTest, DownscalesWhileDecoding) {
+  const tstring jpeg = EncodeTestImage(512, 640);
+  // Ratios 8, 4 and 2, with and without a crop window which is not aligned
+  // to the JPEG blocks.
+  RunAndCheck(jpeg, 512, 640, {}, 64, 80, kDownscaledTolerance,
+              /*downscaled=*/true);
+  RunAndCheck(jpeg, 512, 640, {37, 51, 301, 402}, 64, 80,
+              kDownscaledTolerance, /*downscaled=*/true);
+  RunAndCheck(jpeg, 512, 640, {5, 3, 200, 250}, 90, 110,
+              kDownscaledTolerance, /*downscaled=*/true);
+}
+
+TEST_F(DecodeAndResizeJpegOpTest, DownscalesWithResizeOptions) {
+  const tstring jpeg = EncodeTestImage(512, 640);
+  ResizeOptions align_corners;
+  align_corners.align_corners = true;
+  RunAndCheck(jpeg, 512, 640, {37, 51, 301, 402}, 64, 80,
+              kDownscaledTolerance, /*downscaled=*/true, align_corners);
+  ResizeOptions half_pixel_centers;
+  half_pixel_centers.half_pixel_centers = true;
+  RunAndCheck(jpeg, 512, 640, {37, 51, 301, 402}, 64, 80,
+              kDownscaledTolerance, /*downscaled=*/true, half_pixel_centers);
+}
+
+TEST_F(DecodeAndResizeJpegOpTest, RejectsAlignCornersWithHalfPixelCenters) {
+  ResizeOptions options;
+  options.align_corners = true;
+  options.half_pixel_centers = true;
+  Status status = MakeOpWithStatus(options);
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+}
+
+TEST_F(DecodeAndResizeJpegOpTest, RejectsInvalidCropWindow) {
+  MakeOp();
+  AddInputFromArray<tstring>(TensorShape({}), {EncodeTestImage(32, 32)});
+  AddInputFromArray<int32>(TensorShape({4}), {16, 16, 32, 8});
+  AddInputFromArray<int32>(TensorShape({2}), {8, 8});
+  Status status = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+}
+
+TEST_F(DecodeAndResizeJpegOpTest, RejectsInvalidData) {
+  MakeOp();
+  AddInputFromArray<tstring>(TensorShape({}), {"not a jpeg"});
+  AddInputFromArray<int32>(TensorShape({0}), {});
+  AddInputFromArray<int32>(TensorShape({2}), {8, 8});
+  Status status = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+}
+
+// Decodes a large photo-sized image into a small model input, either with
+// DecodeAndResizeJpeg or with DecodeJpeg followed by ResizeBilinear.
+static Graph* DecodeAndResize(bool fused, int height, int width,
+                              int out_size) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor contents(DT_STRING, TensorShape({}));
+  contents.scalar<tstring>()() = EncodeTestImage(height, width);
+  Tensor size(DT_INT32, TensorShape({2}));
+  size.vec<int32>()(0) = out_size;
+  size.vec<int32>()(1) = out_size;
+
+  Node* ret;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DecodeAndResizeJpeg")
+                    .Input(test::graph::Constant(g, contents))
+                    .Input(test::graph::Constant(
+                        g, Tensor(DT_INT32, TensorShape({0}))))
+                    .Input(test::graph::Constant(g, size))
+                    .Attr("channels", 3)
+                    .Finalize(g, &ret));
+  } else {
+    Node* decoded;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DecodeJpeg")
+                    .Input(test::graph::Constant(g, contents))
+                    .Attr("channels", 3)
+                    .Finalize(g, &decoded));
+    Node* batched;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "ExpandDims")
+                    .Input(decoded)
+                    .Input(test::graph::Constant(g, Tensor(int32{0})))
+                    .Finalize(g, &batched));
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "ResizeBilinear")
+                    .Input(batched)
+                    .Input(test::graph::Constant(g, size))
+                    .Finalize(g, &ret));
+  }
+  return g;
+}
+
+static void BM_DecodeAndResizeJpeg(::testing::benchmark::State& state) {
+  const bool fused = state.range(0);
+  const int height = state.range(1);
+  const int width = height * 4 / 3;
+  const int out_size = 224;
+  test::Benchmark("cpu", DecodeAndResize(fused, height, width, out_size),
+                  /*old_benchmark_api*/ false)
+      .Run(state);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodeAndResizeJpeg)
+    ->UseRealTime()
+    ->ArgsProduct({{0, 1}, {480, 1536, 3072}});
+
+}  // namespace
+}  // namespace tensorflow
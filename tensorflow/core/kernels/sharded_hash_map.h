@@ -0,0 +1,325 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_SHARDED_HASH_MAP_H_
+#define TENSORFLOW_CORE_KERNELS_SHARDED_HASH_MAP_H_
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/platform/hash.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace lookup {
+
+// Hashes the keys of a ShardedHashMap. absl::Hash does not support tstring.
+template <class K>
+struct ShardedHashMapHash {
+  size_t operator()(const K& key) const { return absl::Hash<K>()(key); }
+};
+
+template <>
+struct ShardedHashMapHash<tstring> {
+  size_t operator()(const tstring& key) const { return Hash64(key); }
+};
+
+// A hash map split into kNumShards open-addressing maps, each guarded by its
+// own reader-writer lock, so that concurrent lookups and inserts only contend
+// when they hit the same shard.
+//
+// The batched operations group their keys by shard and take each shard's lock
+// once per batch. Given the CPU worker threads of a device, large batches
+// process different shards in parallel.
+//
+// Sample use:
+//
+// ShardedHashMap<int64, float> map;
+// map.InsertOrAssign(keys, num_keys, workers,
+//                    [&](int64 i, float* value) { *value = values[i]; });
+// map.Find(keys, num_keys, workers, [&](int64 i, const float* value) {
+//   out[i] = value != nullptr ? *value : default_value;
+// });
+template <class K, class V>
+class ShardedHashMap {
+ public:
+  static constexpr int kShardBits = 6;
+  static constexpr int kNumShards = 1 << kShardBits;
+
+  ShardedHashMap() = default;
+  ShardedHashMap(const ShardedHashMap&) = delete;
+  void operator=(const ShardedHashMap&) = delete;
+
+  // Returns the number of entries. Concurrent writers to other shards may
+  // change the map while it is being counted.
+  size_t size() const {
+    size_t size = 0;
+    for (const MapShard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      size += shard.map.size();
+    }
+    return size;
+  }
+
+  // Returns the number of bytes allocated for the slots of all shards.
+  int64 MemoryUsed() const {
+    int64 ret = 0;
+    for (const MapShard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      ret += shard.map.capacity() * (sizeof(std::pair<const K, V>) + 1);
+    }
+    return ret;
+  }
+
+  // Calls `fn(i, value)` for each `keys[i]`, where `value` points to the value
+  // stored for the key, or is nullptr if the key is absent. `value` is only
+  // valid during the call. If `workers` is not null, `fn` may be called
+  // concurrently for keys in different shards.
+  template <typename Fn>
+  void Find(const K* keys, int64 num_keys,
+            const DeviceBase::CpuWorkerThreads* workers, Fn fn) const {
+    ForEachShard(keys, num_keys, workers,
+                 [this, &fn](int s, const KeyCopy* keys, const int64* indices,
+                             int64 n) {
+                   const MapShard& shard = shards_[s];
+                   tf_shared_lock l(shard.mu);
+                   for (int64 j = 0; j < n; ++j) {
+                     const int64 i = indices[j];
+                     const K& key = keys[i];
+                     auto it = shard.map.find(key);
+                     fn(i, it == shard.map.end() ? nullptr : &it->second);
+                   }
+                 });
+  }
+
+  // Calls `fn(i, value)` for each `keys[i]`, where `value` points to the value
+  // stored for the key, default-constructed if the key is new, for `fn` to
+  // overwrite. A key which occurs more than once is visited in index order, so
+  // its last occurrence wins. Concurrency is as for Find().
+  template <typename Fn>
+  void InsertOrAssign(const K* keys, int64 num_keys,
+                      const DeviceBase::CpuWorkerThreads* workers, Fn fn) {
+    ForEachShard(keys, num_keys, workers,
+                 [this, &fn](int s, const KeyCopy* keys, const int64* indices,
+                             int64 n) {
+                   MapShard& shard = shards_[s];
+                   mutex_lock l(shard.mu);
+                   InsertIntoMap(&shard.map, keys, indices, n, fn);
+                 });
+  }
+
+  // Replaces the contents of the map with the given keys, whose values are
+  // filled in as by InsertOrAssign(). The new contents are built without
+  // holding any lock, and swapped in while all shards are locked, so readers
+  // see either the old or the new contents.
+  template <typename Fn>
+  void Assign(const K* keys, int64 num_keys,
+              const DeviceBase::CpuWorkerThreads* workers,
+              Fn fn) TF_NO_THREAD_SAFETY_ANALYSIS {
+    std::array<Map, kNumShards> maps;
+    ForEachShard(keys, num_keys, workers,
+                 [&maps, &fn](int s, const KeyCopy* keys, const int64* indices,
+                              int64 n) {
+                   InsertIntoMap(&maps[s], keys, indices, n, fn);
+                 });
+    for (MapShard& shard : shards_) {
+      shard.mu.lock();
+    }
+    for (int s = 0; s < kNumShards; ++s) {
+      shards_[s].map.swap(maps[s]);
+    }
+    for (MapShard& shard : shards_) {
+      shard.mu.unlock();
+    }
+    // The old contents are freed by `maps` after the locks are released.
+  }
+
+  // Removes the given keys, if present.
+  void Erase(const K* keys, int64 num_keys,
+             const DeviceBase::CpuWorkerThreads* workers) {
+    ForEachShard(keys, num_keys, workers,
+                 [this](int s, const KeyCopy* keys, const int64* indices,
+                        int64 n) {
+                   MapShard& shard = shards_[s];
+                   mutex_lock l(shard.mu);
+                   for (int64 j = 0; j < n; ++j) {
+                     const K& key = keys[indices[j]];
+                     shard.map.erase(key);
+                   }
+                 });
+  }
+
+  // Holds shared locks on all shards, so that the entries visited by ForEach()
+  // match size() while it is alive.
+  class SharedLock {
+   public:
+    explicit SharedLock(const ShardedHashMap& map) TF_NO_THREAD_SAFETY_ANALYSIS
+        : map_(map) {
+      for (const MapShard& shard : map_.shards_) {
+        shard.mu.lock_shared();
+      }
+    }
+
+    ~SharedLock() TF_NO_THREAD_SAFETY_ANALYSIS {
+      for (const MapShard& shard : map_.shards_) {
+        shard.mu.unlock_shared();
+      }
+    }
+
+    size_t size() const TF_NO_THREAD_SAFETY_ANALYSIS {
+      size_t size = 0;
+      for (const MapShard& shard : map_.shards_) {
+        size += shard.map.size();
+      }
+      return size;
+    }
+
+    // Calls `fn(key, value)` for every entry, in no particular order.
+    template <typename Fn>
+    void ForEach(Fn fn) const TF_NO_THREAD_SAFETY_ANALYSIS {
+      for (const MapShard& shard : map_.shards_) {
+        for (const auto& entry : shard.map) {
+          fn(entry.first, entry.second);
+        }
+      }
+    }
+
+   private:
+    const ShardedHashMap& map_;
+
+    TF_DISALLOW_COPY_AND_ASSIGN(SharedLock);
+  };
+
+ private:
+  // Batches with fewer keys are processed on the calling thread.
+  static constexpr int64 kMinParallelKeys = 4096;
+  // Rough cost of looking up or inserting one key, for Shard().
+  static constexpr int64 kCostPerKey = 100;
+
+  typedef absl::flat_hash_map<K, V, ShardedHashMapHash<K>> Map;
+
+  // Aligned to keep the locks of neighbouring shards off the same cache line.
+  struct alignas(64) MapShard {
+    mutable mutex mu;
+    Map map TF_GUARDED_BY(mu);
+  };
+
+  // The keys may live in a tensor which another op updates concurrently, so
+  // integral keys are copied once, and each key is looked up in the shard it
+  // was routed to. Other keys cannot be updated in place and are referenced.
+  template <class T, bool kIntegral = std::is_integral<T>::value>
+  struct KeyCopyOf {
+    typedef std::reference_wrapper<const T> type;
+    static type Copy(const T& key) { return std::cref(key); }
+  };
+  template <class T>
+  struct KeyCopyOf<T, true> {
+    typedef T type;
+    static type Copy(const T& key) { return internal::SubtleMustCopy(key); }
+  };
+  typedef typename KeyCopyOf<K>::type KeyCopy;
+
+  static int ShardOf(const K& key) {
+    // Takes the high bits of a multiplicative hash, which are independent of
+    // the low bits that each shard's map uses to place its keys.
+    const uint64 hash = ShardedHashMapHash<K>()(key);
+    return static_cast<int>((hash * 0x9E3779B97F4A7C15ULL) >>
+                            (64 - kShardBits));
+  }
+
+  // Calls `fn(s, key_copies, indices, n)` for every shard `s` holding any of
+  // the keys, where `indices` lists the `n` positions of those keys in
+  // increasing order, and `key_copies[i]` is the copy of `keys[i]` to use.
+  // Shards run in parallel on `workers` for large batches.
+  template <typename Fn>
+  void ForEachShard(const K* keys, int64 num_keys,
+                    const DeviceBase::CpuWorkerThreads* workers,
+                    const Fn& fn) const {
+    if (num_keys == 0) return;
+    std::vector<KeyCopy> key_copies;
+    key_copies.reserve(num_keys);
+    for (int64 i = 0; i < num_keys; ++i) {
+      key_copies.push_back(KeyCopyOf<K>::Copy(keys[i]));
+    }
+    if (num_keys == 1) {
+      const int64 index = 0;
+      fn(ShardOf(key_copies[0]), key_copies.data(), &index, 1);
+      return;
+    }
+
+    // Counting sort of the key indices by shard.
+    std::vector<uint8> shard_of(num_keys);
+    std::array<int64, kNumShards + 1> offsets{};
+    for (int64 i = 0; i < num_keys; ++i) {
+      shard_of[i] = ShardOf(key_copies[i]);
+      ++offsets[shard_of[i] + 1];
+    }
+    for (int s = 0; s < kNumShards; ++s) {
+      offsets[s + 1] += offsets[s];
+    }
+    std::vector<int64> indices(num_keys);
+    std::array<int64, kNumShards> next;
+    std::copy(offsets.begin(), offsets.end() - 1, next.begin());
+    for (int64 i = 0; i < num_keys; ++i) {
+      indices[next[shard_of[i]]++] = i;
+    }
+
+    auto process_shards = [&](int64 begin, int64 end) {
+      for (int64 s = begin; s < end; ++s) {
+        const int64 n = offsets[s + 1] - offsets[s];
+        if (n > 0) {
+          fn(static_cast<int>(s), key_copies.data(),
+             indices.data() + offsets[s], n);
+        }
+      }
+    };
+    if (workers == nullptr || workers->workers == nullptr ||
+        num_keys < kMinParallelKeys) {
+      process_shards(0, kNumShards);
+    } else {
+      Shard(workers->num_threads, workers->workers, kNumShards,
+            num_keys / kNumShards * kCostPerKey, process_shards);
+    }
+  }
+
+  template <typename Fn>
+  static void InsertIntoMap(Map* map, const KeyCopy* keys,
+                            const int64* indices, int64 n, const Fn& fn) {
+    for (int64 j = 0; j < n; ++j) {
+      const int64 i = indices[j];
+      const K& key = keys[i];
+      fn(i, &(*map)[key]);
+    }
+  }
+
+  std::array<MapShard, kNumShards> shards_;
+};
+
+}  // namespace lookup
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_SHARDED_HASH_MAP_H_
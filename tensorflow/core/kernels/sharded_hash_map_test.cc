@@ -0,0 +1,327 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/sharded_hash_map.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/platform/threadpool.h"
+
+namespace tensorflow {
+namespace lookup {
+namespace {
+
+typedef ShardedHashMap<int64, int64> Int64Map;
+
+// Returns the values found for `keys`, with -1 for absent keys.
+std::vector<int64> FindAll(const Int64Map& map, const std::vector<int64>& keys,
+                           const DeviceBase::CpuWorkerThreads* workers) {
+  std::vector<int64> values(keys.size());
+  map.Find(keys.data(), keys.size(), workers,
+           [&values](int64 i, const int64* value) {
+             values[i] = value != nullptr ? *value : -1;
+           });
+  return values;
+}
+
+void InsertAll(Int64Map* map, const std::vector<int64>& keys,
+               const std::vector<int64>& values,
+               const DeviceBase::CpuWorkerThreads* workers) {
+  map->InsertOrAssign(keys.data(), keys.size(), workers,
+                      [&values](int64 i, int64* value) { *value = values[i]; });
+}
+
+TEST(ShardedHashMapTest, InsertFindErase) {
+  Int64Map map;
+  InsertAll(&map, {1, 2, 3}, {10, 20, 30}, nullptr);
+  EXPECT_EQ(3, map.size());
+  EXPECT_EQ(std::vector<int64>({30, -1, 10, 20}),
+            FindAll(map, {3, 4, 1, 2}, nullptr));
+
+  const std::vector<int64> erased = {2, 5};
+  map.Erase(erased.data(), erased.size(), nullptr);
+  EXPECT_EQ(2, map.size());
+  EXPECT_EQ(std::vector<int64>({10, -1, 30}), FindAll(map, {1, 2, 3}, nullptr));
+}
+
+TEST(ShardedHashMapTest, LastDuplicateWins) {
+  Int64Map map;
+  InsertAll(&map, {7, 8, 7, 7}, {1, 2, 3, 4}, nullptr);
+  EXPECT_EQ(2, map.size());
+  EXPECT_EQ(std::vector<int64>({4, 2}), FindAll(map, {7, 8}, nullptr));
+}
+
+TEST(ShardedHashMapTest, AssignReplacesContents) {
+  Int64Map map;
+  InsertAll(&map, {1, 2}, {10, 20}, nullptr);
+  const std::vector<int64> keys = {2, 3};
+  map.Assign(keys.data(), keys.size(), nullptr,
+             [](int64 i, int64* value) { *value = 100 + i; });
+  EXPECT_EQ(2, map.size());
+  EXPECT_EQ(std::vector<int64>({-1, 100, 101}),
+            FindAll(map, {1, 2, 3}, nullptr));
+}
+
+TEST(ShardedHashMapTest, SharedLockVisitsEveryEntry) {
+  ShardedHashMap<tstring, int64> map;
+  std::vector<tstring> keys;
+  for (int i = 0; i < 1000; ++i) {
+    keys.push_back(strings::StrCat("key", i));
+  }
+  map.InsertOrAssign(keys.data(), keys.size(), nullptr,
+                     [](int64 i, int64* value) { *value = i; });
+
+  ShardedHashMap<tstring, int64>::SharedLock l(map);
+  EXPECT_EQ(1000, l.size());
+  std::vector<bool> seen(keys.size());
+  l.ForEach([&](const tstring& key, int64 value) {
+    EXPECT_EQ(keys[value], key);
+    seen[value] = true;
+  });
+  for (int i = 0; i < keys.size(); ++i) {
+    EXPECT_TRUE(seen[i]) << keys[i];
+  }
+}
+
+TEST(ShardedHashMapTest, ParallelBatchesMatchSequential) {
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  DeviceBase::CpuWorkerThreads workers;
+  workers.num_threads = 4;
+  workers.workers = &pool;
+
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> keys(100000);
+  std::vector<int64> values(keys.size());
+  for (int i = 0; i < keys.size(); ++i) {
+    keys[i] = rnd.Uniform64(50000);
+    values[i] = i;
+  }
+
+  Int64Map parallel;
+  Int64Map sequential;
+  InsertAll(&parallel, keys, values, &workers);
+  InsertAll(&sequential, keys, values, nullptr);
+  EXPECT_EQ(sequential.size(), parallel.size());
+  EXPECT_EQ(FindAll(sequential, keys, nullptr),
+            FindAll(parallel, keys, &workers));
+
+  parallel.Erase(keys.data(), keys.size() / 2, &workers);
+  sequential.Erase(keys.data(), keys.size() / 2, nullptr);
+  EXPECT_EQ(sequential.size(), parallel.size());
+  EXPECT_EQ(FindAll(sequential, keys, nullptr),
+            FindAll(parallel, keys, &workers));
+}
+
+TEST(ShardedHashMapTest, ConcurrentReadersAndWriters) {
+  constexpr int kNumThreads = 8;
+  constexpr int kNumKeys = 1000;
+  Int64Map map;
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&map, t]() {
+        // Each thread owns the keys congruent to `t`, and always stores the
+        // key itself as the value, so readers can check any value they see.
+        std::vector<int64> keys;
+        for (int64 k = t; k < kNumKeys; k += kNumThreads) {
+          keys.push_back(k);
+        }
+        for (int round = 0; round < 20; ++round) {
+          InsertAll(&map, keys, keys, nullptr);
+          std::vector<int64> all(kNumKeys);
+          for (int64 k = 0; k < kNumKeys; ++k) all[k] = k;
+          const std::vector<int64> values = FindAll(map, all, nullptr);
+          for (int64 k = 0; k < kNumKeys; ++k) {
+            EXPECT_TRUE(values[k] == -1 || values[k] == k);
+          }
+          map.Erase(keys.data(), keys.size() / 2, nullptr);
+        }
+        InsertAll(&map, keys, keys, nullptr);
+      });
+    }
+  }
+  EXPECT_EQ(kNumKeys, map.size());
+}
+
+TEST(ShardedHashMapTest, ConcurrentAssignAndFindShareWorkers) {
+  // Readers running on the workers must not wait for an Assign() which waits
+  // for the same workers.
+  constexpr int kNumThreads = 4;
+  thread::ThreadPool pool(Env::Default(), "test", 2);
+  DeviceBase::CpuWorkerThreads workers;
+  workers.num_threads = 2;
+  workers.workers = &pool;
+  std::vector<int64> keys(20000);
+  for (int64 k = 0; k < keys.size(); ++k) keys[k] = k;
+
+  Int64Map map;
+  InsertAll(&map, keys, keys, &workers);
+  {
+    thread::ThreadPool callers(Env::Default(), "callers", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      callers.Schedule([&map, &keys, &workers, t]() {
+        for (int round = 0; round < 20; ++round) {
+          if (t % 2 == 0) {
+            map.Assign(keys.data(), keys.size(), &workers,
+                       [&keys](int64 i, int64* value) { *value = keys[i]; });
+          } else {
+            EXPECT_EQ(keys, FindAll(map, keys, &workers));
+          }
+        }
+      });
+    }
+  }
+  EXPECT_EQ(keys.size(), map.size());
+}
+
+// The layout the mutable hash tables used before they were sharded, as a
+// baseline for the benchmarks below.
+class MutexHashMap {
+ public:
+  void Find(const int64* keys, int64 num_keys, int64* values) const {
+    tf_shared_lock l(mu_);
+    for (int64 i = 0; i < num_keys; ++i) {
+      auto it = map_.find(keys[i]);
+      values[i] = it == map_.end() ? -1 : it->second;
+    }
+  }
+
+  void Insert(const int64* keys, int64 num_keys, const int64* values) {
+    mutex_lock l(mu_);
+    for (int64 i = 0; i < num_keys; ++i) {
+      map_[keys[i]] = values[i];
+    }
+  }
+
+ private:
+  mutable mutex mu_;
+  std::unordered_map<int64, int64> map_ TF_GUARDED_BY(mu_);
+};
+
+constexpr int64 kBenchmarkTableSize = 1 << 20;
+constexpr int kBenchmarkBatchSize = 1024;
+// One in this many batches is an insert rather than a lookup.
+constexpr int kBenchmarkInsertEvery = 16;
+
+std::vector<int64> BenchmarkKeys(int seed) {
+  random::PhiloxRandom philox(seed, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> keys(kBenchmarkBatchSize);
+  for (int64& key : keys) {
+    key = rnd.Uniform64(2 * kBenchmarkTableSize);
+  }
+  return keys;
+}
+
+// Each benchmark thread issues batched lookups of random keys, half of which
+// are present, interleaved with occasional batched inserts.
+void BM_ShardedHashMapFind(::testing::benchmark::State& state) {
+  static Int64Map* map = nullptr;
+  if (state.thread_index() == 0) {
+    map = new Int64Map;
+    std::vector<int64> keys(kBenchmarkTableSize);
+    for (int64 i = 0; i < kBenchmarkTableSize; ++i) keys[i] = 2 * i;
+    InsertAll(map, keys, keys, nullptr);
+  }
+  const std::vector<int64> keys = BenchmarkKeys(state.thread_index());
+  std::vector<int64> values(keys.size());
+  int batch = 0;
+  for (auto s : state) {
+    if (++batch % kBenchmarkInsertEvery == 0) {
+      InsertAll(map, keys, keys, nullptr);
+    } else {
+      map->Find(keys.data(), keys.size(), nullptr,
+                [&values](int64 i, const int64* value) {
+                  values[i] = value != nullptr ? *value : -1;
+                });
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kBenchmarkBatchSize);
+  if (state.thread_index() == 0) {
+    delete map;
+  }
+}
+BENCHMARK(BM_ShardedHashMapFind)
+    ->UseRealTime()
+    ->Threads(1)
+    ->Threads(4)
+    ->Threads(16);
+
+void BM_MutexHashMapFind(::testing::benchmark::State& state) {
+  static MutexHashMap* map = nullptr;
+  if (state.thread_index() == 0) {
+    map = new MutexHashMap;
+    std::vector<int64> keys(kBenchmarkTableSize);
+    for (int64 i = 0; i < kBenchmarkTableSize; ++i) keys[i] = 2 * i;
+    map->Insert(keys.data(), keys.size(), keys.data());
+  }
+  const std::vector<int64> keys = BenchmarkKeys(state.thread_index());
+  std::vector<int64> values(keys.size());
+  int batch = 0;
+  for (auto s : state) {
+    if (++batch % kBenchmarkInsertEvery == 0) {
+      map->Insert(keys.data(), keys.size(), keys.data());
+    } else {
+      map->Find(keys.data(), keys.size(), values.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kBenchmarkBatchSize);
+  if (state.thread_index() == 0) {
+    delete map;
+  }
+}
+BENCHMARK(BM_MutexHashMapFind)
+    ->UseRealTime()
+    ->Threads(1)
+    ->Threads(4)
+    ->Threads(16);
+
+// A single large batch spread over a thread pool, as the table kernels do.
+void BM_ShardedHashMapParallelFind(::testing::benchmark::State& state) {
+  const int num_threads = state.range(0);
+  thread::ThreadPool pool(Env::Default(), "bench", num_threads);
+  DeviceBase::CpuWorkerThreads workers;
+  workers.num_threads = num_threads;
+  workers.workers = &pool;
+
+  Int64Map map;
+  std::vector<int64> keys(kBenchmarkTableSize);
+  for (int64 i = 0; i < kBenchmarkTableSize; ++i) keys[i] = 2 * i;
+  InsertAll(&map, keys, keys, &workers);
+  std::vector<int64> values(keys.size());
+  for (auto s : state) {
+    map.Find(keys.data(), keys.size(), &workers,
+             [&values](int64 i, const int64* value) { values[i] = *value; });
+  }
+  state.SetItemsProcessed(state.iterations() * kBenchmarkTableSize);
+}
+BENCHMARK(BM_ShardedHashMapParallelFind)
+    ->UseRealTime()
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16);
+
+}  // namespace
+}  // namespace lookup
+}  // namespace tensorflow
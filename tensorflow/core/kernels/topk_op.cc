@@ -29,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/gtl/top_n.h"
+#include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
@@ -107,6 +108,97 @@ class TopK : public OpKernel {
   bool sorted_;
 };
 
+namespace {
+
+// Rows are split into chunks of at least this many columns, which are searched
+// in parallel, when there are fewer rows than threads.
+constexpr int64_t kMinTopKChunkSize = 16 * 1024;
+// Chunks are only used while they hold at least this many times k columns,
+// so that the threshold filter below discards most of each chunk.
+constexpr int64_t kMinTopKChunkSizePerK = 8;
+// Columns are compared with the running threshold in blocks of this size.
+constexpr int kTopKBlockSize = 64;
+
+// Orders column indices by decreasing value, breaking ties by increasing
+// index, as the heap-based selection does.
+template <typename T>
+struct TopKStableGreater {
+  const T* data;
+  bool operator()(const int32_t a, const int32_t b) const {
+    if (data[b] < data[a]) return true;
+    if (data[b] > data[a]) return false;
+    return a < b;
+  }
+};
+
+// Returns how many chunks to split each row into, or 1 to search whole rows.
+int64_t NumTopKChunksPerRow(int64_t num_rows, int64_t num_cols, int k,
+                            int num_threads) {
+  if (num_rows >= num_threads || k >= num_cols) return 1;
+  const int64_t wanted = (num_threads + num_rows - 1) / num_rows;
+  const int64_t max_chunks =
+      std::min(num_cols / kMinTopKChunkSize,
+               num_cols / (kMinTopKChunkSizePerK * static_cast<int64_t>(k)));
+  return std::max<int64_t>(1, std::min(wanted, max_chunks));
+}
+
+// Writes the indices of the top `k` values of `input[begin, end)` to `top`,
+// ordered by TopKStableGreater. `end - begin` must be at least 2 * k.
+//
+// Candidates are collected in `buffer`, which is cut back to the best k with
+// a linear-time selection whenever it holds 2 * k of them. The k-th best value
+// then becomes the threshold a later column must exceed, and blocks of columns
+// are first checked with a branch-free comparison that the compiler
+// vectorizes, so that blocks without any candidate are skipped quickly.
+//
+// Returns false, leaving `top` undefined, if a NaN was seen, since NaNs do
+// not order with the threshold.
+template <typename T>
+bool ChunkTopK(const T* input, int32_t begin, int32_t end, int k,
+               std::vector<int32_t>* buffer, int32_t* top) {
+  const TopKStableGreater<T> greater{input};
+  buffer->resize(2 * k + kTopKBlockSize);
+  int32_t* candidates = buffer->data();
+  int64_t n = 0;
+  // Keeps the best k candidates and returns the value of the k-th.
+  auto shrink = [&]() -> T {
+    std::nth_element(candidates, candidates + k - 1, candidates + n, greater);
+    n = k;
+    return input[candidates[k - 1]];
+  };
+
+  int32_t i = begin;
+  for (; i < begin + 2 * k; ++i) {
+    if (Eigen::numext::isnan(input[i])) return false;
+    candidates[n++] = i;
+  }
+  T threshold = shrink();
+  while (i < end) {
+    const int32_t block_end = std::min<int64_t>(end, i + kTopKBlockSize);
+    bool any_above = false;
+    bool any_nan = false;
+    for (int32_t j = i; j < block_end; ++j) {
+      any_above |= input[j] > threshold;
+      any_nan |= Eigen::numext::isnan(input[j]);
+    }
+    if (any_nan) return false;
+    if (any_above) {
+      for (int32_t j = i; j < block_end; ++j) {
+        candidates[n] = j;
+        n += input[j] > threshold;
+      }
+      if (n >= 2 * k) threshold = shrink();
+    }
+    i = block_end;
+  }
+
+  std::partial_sort(candidates, candidates + k, candidates + n, greater);
+  std::copy(candidates, candidates + k, top);
+  return true;
+}
+
+}  // namespace
+
 namespace functor {
 
 template <typename T>
@@ -214,6 +306,54 @@ struct TopKFunctor<CPUDevice, T> {
       }  // for (int32 b = ...
     };
 
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+
+    // Long rows are split into chunks searched in parallel, each yielding its
+    // own top k, which are then merged.
+    const int64_t num_chunks =
+        NumTopKChunksPerRow(num_rows, num_cols, k, worker_threads.num_threads);
+    if (num_chunks > 1) {
+      std::vector<int32_t> chunk_top(num_rows * num_chunks * k);
+      std::vector<char> chunk_ok(num_rows * num_chunks);
+      auto SearchChunks = [&](int64_t start_chunk, int64_t limit_chunk) {
+        std::vector<int32_t> buffer;
+        for (int64_t i = start_chunk; i < limit_chunk; ++i) {
+          const int64_t b = i / num_chunks;
+          const int64_t c = i % num_chunks;
+          chunk_ok[i] =
+              ChunkTopK(&input(b, 0), c * num_cols / num_chunks,
+                        (c + 1) * num_cols / num_chunks, k, &buffer,
+                        chunk_top.data() + i * k);
+        }
+      };
+      // Most columns cost one comparison with the threshold.
+      const int64_t chunk_cost = num_cols / num_chunks *
+                                 (Eigen::TensorOpCost::AddCost<T>() +
+                                  Eigen::TensorOpCost::AddCost<int32>());
+      Shard(worker_threads.num_threads, worker_threads.workers,
+            num_rows * num_chunks, chunk_cost, SearchChunks);
+
+      for (int64_t b = 0; b < num_rows; ++b) {
+        if (!std::all_of(chunk_ok.begin() + b * num_chunks,
+                         chunk_ok.begin() + (b + 1) * num_chunks,
+                         [](char ok) { return ok; })) {
+          // Rows with NaNs are searched whole, as before.
+          SortIndices(b, b + 1);
+          continue;
+        }
+        int32_t* row_top = chunk_top.data() + b * num_chunks * k;
+        std::partial_sort(row_top, row_top + k, row_top + num_chunks * k,
+                          TopKStableGreater<T>{&input(b, 0)});
+        for (int i = 0; i < k; ++i) {
+          indices(b, i) = row_top[i];
+          values(b, i) = input(b, row_top[i]);
+        }
+      }
+      VLOG(3) << "TopK searched " << num_rows << " rows of " << num_cols
+              << " columns in " << num_chunks << " chunks each";
+      return Status::OK();
+    }
+
     // Guesstimate of cost; 4*N*log(K) where N == num_cols.
     // If K == N, assume the cost is N*log(K + 1).
     const double cmp_cost = 3 * Eigen::TensorOpCost::AddCost<int32>() +
@@ -228,7 +368,6 @@ struct TopKFunctor<CPUDevice, T> {
     const int64_t final_cost = (total_cost >= static_cast<double>(kint64max))
                                    ? kint64max
                                    : static_cast<int64_t>(total_cost);
-    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
           final_cost, SortIndices);
 
@@ -0,0 +1,145 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class TopKOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(bool sorted) {
+    TF_ASSERT_OK(NodeDefBuilder("topk", "TopKV2")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("sorted", sorted)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Runs TopKV2 on `input` and compares it with a stable sort of each row.
+  void RunAndCheck(const std::vector<float>& input, int64_t num_rows, int k,
+                   bool sorted) {
+    MakeOp(sorted);
+    const int64_t num_cols = input.size() / num_rows;
+    AddInputFromArray<float>(TensorShape({num_rows, num_cols}), input);
+    AddInputFromArray<int32>(TensorShape({}), {k});
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected_values(DT_FLOAT, TensorShape({num_rows, k}));
+    Tensor expected_indices(DT_INT32, TensorShape({num_rows, k}));
+    for (int64_t b = 0; b < num_rows; ++b) {
+      const float* row = input.data() + b * num_cols;
+      std::vector<int32> order(num_cols);
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(),
+                       [row](int32 x, int32 y) { return row[x] > row[y]; });
+      for (int i = 0; i < k; ++i) {
+        expected_values.matrix<float>()(b, i) = row[order[i]];
+        expected_indices.matrix<int32>()(b, i) = order[i];
+      }
+    }
+    test::ExpectTensorEqual<float>(expected_values, *GetOutput(0));
+    test::ExpectTensorEqual<int32>(expected_indices, *GetOutput(1));
+  }
+};
+
+std::vector<float> RandomInput(int64_t size, int num_distinct) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<float> input(size);
+  for (float& value : input) {
+    value = static_cast<float>(rnd.Uniform(num_distinct)) - num_distinct / 2;
+  }
+  return input;
+}
+
+TEST_F(TopKOpTest, LongRow) {
+  RunAndCheck(RandomInput(1 << 20, 1 << 30), 1, 100, /*sorted=*/true);
+}
+
+TEST_F(TopKOpTest, LongRowsWithTies) {
+  // Many equal values, so that the lowest indices must win the ties.
+  RunAndCheck(RandomInput(2 << 18, 1000), 2, 1000, /*sorted=*/true);
+}
+
+TEST_F(TopKOpTest, LongRowUnsorted) {
+  RunAndCheck(RandomInput(1 << 18, 1 << 30), 1, 7, /*sorted=*/false);
+}
+
+TEST_F(TopKOpTest, LongRowAscending) {
+  // Every column raises the threshold.
+  std::vector<float> input(1 << 18);
+  std::iota(input.begin(), input.end(), 0.0f);
+  RunAndCheck(input, 1, 50, /*sorted=*/true);
+}
+
+TEST_F(TopKOpTest, LongRowWithNaN) {
+  std::vector<float> input = RandomInput(1 << 18, 1 << 30);
+  input[12345] = std::numeric_limits<float>::quiet_NaN();
+  MakeOp(/*sorted=*/true);
+  AddInputFromArray<float>(TensorShape({1, 1 << 18}), input);
+  AddInputFromArray<int32>(TensorShape({}), {10});
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(GetOutput(1)->dim_size(1), 10);
+}
+
+static Graph* TopKGraph(int64_t batch, int64_t num_cols, int k) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_FLOAT, TensorShape({batch, num_cols}));
+  input.flat<float>().setRandom();
+  Tensor k_t(DT_INT32, TensorShape({}));
+  k_t.scalar<int32>()() = k;
+
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("topk"), "TopKV2")
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, k_t))
+                  .Finalize(g, &ret));
+  return g;
+}
+
+// Arguments are the row length, k and the batch size.
+static void BM_TopK(::testing::benchmark::State& state) {
+  const int64_t num_cols = state.range(0);
+  const int k = state.range(1);
+  const int64_t batch = state.range(2);
+  test::Benchmark("cpu", TopKGraph(batch, num_cols, k),
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetItemsProcessed(state.iterations() * batch * num_cols);
+}
+BENCHMARK(BM_TopK)
+    ->UseRealTime()
+    ->ArgsProduct({{1 << 12, 1 << 16, 1 << 20}, {10, 100, 1000}, {1, 8, 64}});
+
+}  // namespace
+}  // namespace tensorflow
@@ -13,9 +13,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/bounds_check.h"
@@ -26,12 +28,19 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/bfloat16.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace {
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
+// Vectors with at least this many elements are uniquified in parallel.
+constexpr int64_t kMinParallelUniqueSize = 64 * 1024;
+
+// The parallel path keeps the partition of each element in a byte.
+constexpr int kMaxUniquePartitions = 256;
+
 // `UniqueOpHashMap` defines the map type that is used when elements of type
 // `T` are to be uniquified. By default, we use `absl::flat_hash_map<T, TIndex>`
 // as the map type. Subsequent specializations are provided for
@@ -150,6 +159,14 @@ class UniqueOp : public OpKernel {
       auto Tin = input.flat<T>();
       const int64_t N = static_cast<int64_t>(Tin.size());
 
+      const DeviceBase::CpuWorkerThreads* worker_threads =
+          context->device()->tensorflow_cpu_worker_threads();
+      if (N >= kMinParallelUniqueSize && worker_threads != nullptr &&
+          worker_threads->num_threads > 1) {
+        ComputeParallel(context, input, axis, *worker_threads, idx);
+        return;
+      }
+
       typename UniqueOpHashMap<T, TIndex>::map_type uniq;
       uniq.reserve(2 * N);
       for (Eigen::Index i = 0, j = 0; i < N; ++i) {
@@ -237,6 +254,133 @@ class UniqueOp : public OpKernel {
       }
     }
   }
+
+ private:
+  // Computes the outputs for a vector input on `worker_threads`. The elements
+  // are partitioned by hash, and each partition is uniquified in input order
+  // with its own map. The unique elements are then numbered in order of their
+  // first occurrence, so the outputs match those of the serial loop.
+  void ComputeParallel(OpKernelContext* context, const Tensor& input,
+                       int64_t axis,
+                       const DeviceBase::CpuWorkerThreads& worker_threads,
+                       Tensor* idx) {
+    using MapType = typename UniqueOpHashMap<T, TIndex>::map_type;
+    auto Tin = input.flat<T>();
+    auto idx_vec = idx->template vec<TIndex>();
+    const int64_t N = static_cast<int64_t>(Tin.size());
+    const int num_partitions =
+        std::min(worker_threads.num_threads, kMaxUniquePartitions);
+    // Cost of hashing one element, and of looking it up in a map, for Shard().
+    const int64_t kHashCost = 20;
+    const int64_t kLookupCost = 100;
+
+    std::vector<uint8> partition(N);
+    auto partition_elements = [&Tin, &partition, num_partitions](
+                                  int64_t begin, int64_t end) {
+      typename MapType::hasher hasher;
+      for (int64_t i = begin; i < end; ++i) {
+        // Mixes the hash, which may be the identity for small types, and maps
+        // its high bits onto [0, num_partitions).
+        const uint64 h = hasher(Tin(i)) * 0x9E3779B97F4A7C15ULL;
+        partition[i] = static_cast<uint8>(((h >> 32) * num_partitions) >> 32);
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, N, kHashCost,
+          partition_elements);
+
+    // Each partition numbers its unique elements locally, storing the local
+    // id of every element in `idx_vec` and flagging first occurrences in
+    // `is_first`. `global_ids` later maps local ids to output positions.
+    const bool with_counts = num_outputs() > 2;
+    std::vector<uint8> is_first(N);
+    std::vector<std::vector<TIndex>> global_ids(num_partitions);
+    std::vector<std::vector<TIndex>> counts(num_partitions);
+    auto uniquify_partitions = [&](int64_t begin, int64_t end) {
+      for (int64_t p = begin; p < end; ++p) {
+        MapType uniq;
+        uniq.reserve(N / num_partitions);
+        TIndex j = 0;
+        for (int64_t i = 0; i < N; ++i) {
+          if (partition[i] != p) continue;
+          auto it = uniq.emplace(Tin(i), j);
+          idx_vec(i) = it.first->second;
+          if (it.second) {
+            is_first[i] = 1;
+            ++j;
+            if (with_counts) counts[p].push_back(0);
+          }
+          if (with_counts) ++counts[p][it.first->second];
+        }
+        global_ids[p].resize(j);
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, num_partitions,
+          N / num_partitions * kLookupCost, uniquify_partitions);
+
+    // Numbers the first occurrences in input order: each block of the input
+    // counts its first occurrences, and then numbers them from the total of
+    // the blocks before it.
+    const int64_t num_blocks = num_partitions;
+    const int64_t block_size = (N + num_blocks - 1) / num_blocks;
+    std::vector<int64_t> block_offsets(num_blocks + 1, 0);
+    auto count_first = [&](int64_t begin, int64_t end) {
+      for (int64_t b = begin; b < end; ++b) {
+        const int64_t limit = std::min(N, (b + 1) * block_size);
+        for (int64_t i = b * block_size; i < limit; ++i) {
+          block_offsets[b + 1] += is_first[i];
+        }
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, num_blocks,
+          block_size, count_first);
+    for (int64_t b = 0; b < num_blocks; ++b) {
+      block_offsets[b + 1] += block_offsets[b];
+    }
+    auto number_first = [&](int64_t begin, int64_t end) {
+      for (int64_t b = begin; b < end; ++b) {
+        TIndex next = block_offsets[b];
+        const int64_t limit = std::min(N, (b + 1) * block_size);
+        for (int64_t i = b * block_size; i < limit; ++i) {
+          if (is_first[i]) global_ids[partition[i]][idx_vec(i)] = next++;
+        }
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, num_blocks,
+          block_size, number_first);
+
+    const int64_t uniq_size = block_offsets[num_blocks];
+    TensorShape output_shape(input.shape());
+    output_shape.set_dim(axis, uniq_size);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    auto Tout = output->flat<T>();
+
+    auto write_outputs = [&](int64_t begin, int64_t end) {
+      for (int64_t b = begin; b < end; ++b) {
+        const int64_t limit = std::min(N, (b + 1) * block_size);
+        for (int64_t i = b * block_size; i < limit; ++i) {
+          const TIndex id = global_ids[partition[i]][idx_vec(i)];
+          idx_vec(i) = id;
+          if (is_first[i]) Tout(id) = Tin(i);
+        }
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, num_blocks,
+          block_size * 2, write_outputs);
+
+    if (with_counts) {
+      Tensor* count_output = nullptr;
+      OP_REQUIRES_OK(context,
+                     context->allocate_output(2, TensorShape({uniq_size}),
+                                              &count_output));
+      auto count_output_vec = count_output->template vec<TIndex>();
+      for (int p = 0; p < num_partitions; ++p) {
+        for (size_t j = 0; j < counts[p].size(); ++j) {
+          count_output_vec(global_ids[p][j]) = counts[p][j];
+        }
+      }
+    }
+  }
 };
 
 #define REGISTER_UNIQUE(type)                                      \
@@ -13,10 +13,16 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
 #include <memory>
+#include <unordered_map>
+#include <vector>
+
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
@@ -28,8 +34,10 @@ limitations under the License.
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/strcat.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
 
 namespace tensorflow {
 
@@ -37,6 +45,64 @@ namespace {
 
 const int kMaxStrLen = 40;
 
+class UniqueWithCountsOpTest : public OpsTestBase {
+ protected:
+  template <typename T>
+  void RunAndCheck(const std::vector<T>& input) {
+    TF_ASSERT_OK(NodeDefBuilder("unique", "UniqueWithCounts")
+                     .Input(FakeInput(DataTypeToEnum<T>::v()))
+                     .Attr("out_idx", DT_INT32)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    AddInputFromArray<T>(TensorShape({static_cast<int64_t>(input.size())}),
+                         input);
+    TF_ASSERT_OK(RunOpKernel());
+
+    // Numbers the unique elements in order of first occurrence.
+    std::unordered_map<T, int32> ids;
+    std::vector<T> expected_y;
+    std::vector<int32> expected_idx;
+    std::vector<int32> expected_count;
+    for (const T& x : input) {
+      auto it = ids.emplace(x, expected_y.size());
+      if (it.second) {
+        expected_y.push_back(x);
+        expected_count.push_back(0);
+      }
+      expected_idx.push_back(it.first->second);
+      ++expected_count[it.first->second];
+    }
+    const int64_t num_unique = expected_y.size();
+    test::ExpectTensorEqual<T>(
+        test::AsTensor<T>(expected_y, TensorShape({num_unique})),
+        *GetOutput(0));
+    test::ExpectTensorEqual<int32>(test::AsTensor<int32>(expected_idx),
+                                   *GetOutput(1));
+    test::ExpectTensorEqual<int32>(
+        test::AsTensor<int32>(expected_count, TensorShape({num_unique})),
+        *GetOutput(2));
+  }
+};
+
+// Large enough to take the parallel path when the device has several threads.
+constexpr int kLargeInputSize = 256 * 1024;
+
+TEST_F(UniqueWithCountsOpTest, LargeInt64InputKeepsFirstOccurrenceOrder) {
+  std::vector<int64_t> input(kLargeInputSize);
+  for (int i = 0; i < kLargeInputSize; ++i) {
+    input[i] = (static_cast<int64_t>(i) * 7919) % 50000 - 25000;
+  }
+  RunAndCheck(input);
+}
+
+TEST_F(UniqueWithCountsOpTest, LargeStringInputKeepsFirstOccurrenceOrder) {
+  std::vector<tstring> input(kLargeInputSize);
+  for (int i = 0; i < kLargeInputSize; ++i) {
+    input[i] = strings::StrCat("id", (i * 104729) % 100000);
+  }
+  RunAndCheck(input);
+}
+
 TensorProto GetRandomInt32TensorProto(int dim, int max_int) {
   TensorProto tensor_proto;
   tensor_proto.set_dtype(DT_INT32);
@@ -193,6 +259,46 @@ BENCHMARK(BM_Unique_INT32_Repeat)
     ->ArgPair(64 * 1024, 64 * 1024 * 1024)
     ->ArgPair(1024 * 1024, 64 * 1024 * 1024);
 
+// Compares the serial path (one thread) with the parallel one on inputs of
+// `dim` elements of which `distinct_percent` percent are distinct.
+void BM_UniqueWithCounts_INT64(::testing::benchmark::State& state) {
+  const int dim = state.range(0);
+  const int distinct_percent = state.range(1);
+  const int num_threads = state.range(2);
+  const int64_t num_distinct = std::max<int64_t>(
+      1, static_cast<int64_t>(dim) * distinct_percent / 100);
+
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor input(DT_INT64, TensorShape({dim}));
+  auto input_flat = input.flat<int64_t>();
+  for (int i = 0; i < dim; ++i) {
+    input_flat(i) = std::rand() % num_distinct;
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "UniqueWithCounts")
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("T", DT_INT64)
+                  .Attr("out_idx", DT_INT64)
+                  .Finalize(g, &node));
+  FixupSourceAndSinkEdges(g);
+
+  SessionOptions opts;
+  opts.config.set_intra_op_parallelism_threads(num_threads);
+  test::Benchmark("cpu", g, &opts, nullptr, nullptr,
+                  "SINGLE_THREADED_EXECUTOR", /*old_benchmark_api*/ false)
+      .Run(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * dim);
+}
+
+BENCHMARK(BM_UniqueWithCounts_INT64)
+    ->UseRealTime()
+    ->ArgNames({"dim", "distinct_pct", "threads"})
+    ->ArgsProduct({{64 * 1024, 1024 * 1024, 8 * 1024 * 1024},
+                   {1, 10, 100},
+                   {1, 8}});
+
 BENCHMARK(BM_Unique_STRING)
     ->UseRealTime()
     ->Arg(32)
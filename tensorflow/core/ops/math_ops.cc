@@ -1445,6 +1445,61 @@ REGISTER_OP("SparseSegmentSqrtNGrad")
     .Attr("Tsegmentids: {int32, int64} = DT_INT32")
     .SetShapeFn(SparseSegmentReductionGradShapeFn);
 
+REGISTER_OP("_FusedSparseSegmentReduction")
+    .Input("params: T")
+    .Input("ids: Tids")
+    .Input("indices: Tidx")
+    .Input("segment_ids: Tsegmentids")
+    .Input("num_segments: num_args * Tnumsegments")
+    .Output("output: T")
+    .Attr("T: {bfloat16, half, float, double}")
+    .Attr("Tids: {int32, int64}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .Attr("Tsegmentids: {int32, int64} = DT_INT32")
+    .Attr("Tnumsegments: {int32, int64} = DT_INT32")
+    .Attr("num_args: int >= 0 = 0")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle params_shape;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &params_shape));
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+      ShapeHandle indices_shape;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &indices_shape));
+      ShapeHandle segment_ids_shape;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 1, &segment_ids_shape));
+      TF_RETURN_IF_ERROR(c->Merge(indices_shape, segment_ids_shape, &unused));
+
+      int num_args;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_args", &num_args));
+      if (num_args > 1) {
+        return errors::InvalidArgument(
+            "Expected at most one num_segments, got ", num_args);
+      }
+      DimensionHandle num_segments = c->UnknownDim();
+      if (num_args == 1) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 0, &unused));
+        TF_RETURN_IF_ERROR(c->MakeDimForScalarInput(4, &num_segments));
+      }
+
+      ShapeHandle subshape;
+      TF_RETURN_IF_ERROR(c->Subshape(params_shape, 1, &subshape));
+      ShapeHandle out;
+      TF_RETURN_IF_ERROR(
+          c->Concatenate(c->Vector(num_segments), subshape, &out));
+      c->set_output(0, out);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Internal operation which is a composition of GatherV2 on axis 0 and
+SparseSegment{Sum,Mean,SqrtN}[WithNumSegments]: computes the sparse segment
+reduction of `params[ids[indices]]` without materializing the gathered rows.
+Reserved for internal use.
+
+Do not invoke this operator directly in Python. A fusion optimization is
+expected to create these operators.
+)doc");
+
 REGISTER_OP("All")
     .Input("input: bool")
     .Input("reduction_indices: Tidx")
@@ -179,6 +179,40 @@ REGISTER_OP("ScatterSub")
     .Attr("use_locking: bool = false")
     .SetShapeFn(ScatterUpdateShape);
 
+// Sums the rows of `updates` that share an index. Used to aggregate sparse
+// updates on the producer's device before they are sent to the variable, see
+// SparseUpdateAggregationPass.
+REGISTER_OP("_AggregateSparseUpdates")
+    .Input("indices: Tindices")
+    .Input("updates: T")
+    .Output("unique_indices: Tindices")
+    .Output("aggregated_updates: T")
+    .Attr("T: numbertype")
+    .Attr("Tindices: {int32, int64}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle indices_shape = c->input(0);
+      ShapeHandle updates_shape = c->input(1);
+      // Scalar updates apply to every index, and are passed through.
+      if (c->RankKnown(updates_shape) && c->Rank(updates_shape) == 0) {
+        c->set_output(0, indices_shape);
+        c->set_output(1, updates_shape);
+        return Status::OK();
+      }
+      c->set_output(0, c->Vector(InferenceContext::kUnknownDim));
+      if (!c->RankKnown(indices_shape) || !c->RankKnown(updates_shape)) {
+        c->set_output(1, c->UnknownShape());
+        return Status::OK();
+      }
+      ShapeHandle row_shape;
+      TF_RETURN_IF_ERROR(
+          c->Subshape(updates_shape, c->Rank(indices_shape), &row_shape));
+      ShapeHandle out;
+      TF_RETURN_IF_ERROR(c->Concatenate(
+          c->Vector(InferenceContext::kUnknownDim), row_shape, &out));
+      c->set_output(1, out);
+      return Status::OK();
+    });
+
 REGISTER_OP("ScatterMul")
     .Input("ref: Ref(T)")
     .Input("indices: Tindices")